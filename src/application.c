@@ -1,39 +1,373 @@
+#include <math.h>
+
+#include "application.h"
+#include "batchRenderer.h"
 #include "benchmark.h"
+#include "capture.h"
 #include "graphics.h"
+#include "jobSystem.h"
+#include "loadModel.h"
+#include "meshInstances.h"
+#include "modelReloader.h"
+#include "pathTracer.h"
+#include "sceneGraph.h"
+#include "softwareRenderer.h"
 #include "windowSystem.h"
 
 static double GLFWTime;
 static double OpenGLTIME;
 static int FPS = 60;
+static ApplicationOptions * applicationOptions;
+static ScreenSize captureSize;
+static voidFunction renderFunction;
+static bool windowReady;
+static bool rendererReady;
+static bool captureReady;
+static bool batchReady;
+static bool reloaderReady;
 
 void groupRuntime()
 {
+    if (reloaderReady)
+        reloadModel();
+
     GLFWTime = benchmark(processInputGLFW);
-    OpenGLTIME = benchmark(renderOpenGL);
+    OpenGLTIME = benchmark(renderFunction);
     processFrameGLFW(GLFWTime + OpenGLTIME, 60);
 }
 
-void initialiseApplication(char * modelName)
+/*
+    Swaps in the model file once the reloader has parsed a new version, and
+    reports the time from the change being seen to the upload completing.
+*/
+void reloadModel()
+{
+    Mesh reloadedMesh;
+    double changeTime;
+
+    if (!pollModelReloader(&reloadedMesh, &changeTime))
+        return;
+
+    size_t vertexCount = reloadedMesh.vertexCount;
+    size_t pointCount = reloadedMesh.pointCount;
+    long long uploaded = updateMeshOpenGL(&reloadedMesh);
+    finishOpenGL();
+
+    printf("\rReloaded %s in %.1f ms, uploaded %.1f of %.1f MB\n",
+        applicationOptions->modelName,
+        (currentTime() - changeTime) * 1000.0,
+        uploaded / 1048576.0,
+        (2.0 * sizeof(float) * vertexCount + sizeof(PointVertex) * pointCount) / 1048576.0
+    );
+}
+
+/*
+    Renders one full revolution of the model, a fixed angle per frame, into
+    the capture. Frames are not tied to the interactive frame rate.
+*/
+void captureTurntable()
+{
+    float angleStep = 2.0 * M_PI / applicationOptions->frameCount;
+
+    for (int frame = 0; frame < applicationOptions->frameCount && applicationOpenGLFW(); frame++)
+    {
+        beginCaptureFrame();
+        renderOpenGL();
+        endCaptureFrame();
+
+        if (!applicationOptions->headless)
+        {
+            presentCapture(getScreenSize());
+            presentFrameGLFW();
+        }
+
+        rotateModelOpenGL(angleStep);
+    }
+}
+
+void renderAndPresentSoftware()
+{
+    renderSoftware();
+    presentSoftware();
+}
+
+/*
+    Draws the image frameCount times so the backends can be compared on the
+    same mesh, waiting for the GPU each frame so OpenGL times are complete.
+*/
+void renderImageFrames()
 {
-    initialiseGLFW();
+    for (int frame = 0; frame < applicationOptions->frameCount; frame++)
+    {
+        if (applicationOptions->softwareRenderer)
+            renderSoftware();
+        else
+        {
+            beginCaptureFrame();
+            renderOpenGL();
+            finishOpenGL();
+        }
+    }
+}
+
+void initialiseApplication(ApplicationOptions * options)
+{
+    applicationOptions = options;
+
+    // Loading, mesh processing and the CPU renderers share one pool
+    initialiseJobSystem(options->threadCount);
+
+    // Every renderer, and the batch loaders, load through loadModel
+    selectModelGroups(options->groupNames);
+
+    // The projection follows the capture resolution rather than the window
+    captureSize.width = options->width;
+    captureSize.height = options->height;
+
+    if (options->mode == MODE_PATH_TRACE)
+    {
+        rendererReady = initialisePathTracer(&captureSize, options->modelName);
+        return;
+    }
+
+    // A headless software render needs no window or OpenGL context at all
+    if (options->mode == MODE_IMAGE && options->softwareRenderer)
+    {
+        rendererReady = initialiseSoftwareRenderer(&captureSize, options->modelName, options->threadCount);
+        return;
+    }
+
+    if (options->headless)
+        initialiseHeadlessGLFW();
+    else
+        initialiseGLFW();
+
+    windowReady = true;
+
+    if (options->softwareRenderer)
+    {
+        initialiseWindowSizeCallbackGLFW(softwareViewPortResizeCallback);
+        initialiseMouseMovementCallbackGLFW(softwareMouseDragCallback);
+        initialiseMouseScrollCallbackGLFW(softwareScrollCallBack);
+        initialiseSoftwarePresentation(procAddressGLFW());
+        rendererReady = initialiseSoftwareRenderer(getScreenSize(), options->modelName, options->threadCount);
+        renderFunction = renderAndPresentSoftware;
+        return;
+    }
+
+    // Flat shading derives normals from the positions, so none are loaded
+    selectModelNormals(options->shadingQuality != SHADING_QUALITY_FLAT);
+
+    // Only OpenGL draws instances, the CPU renderers read every corner
+    selectInstanceDetection(options->instancing);
+    selectInstanceList(options->instanceList);
+    selectInstanceGrid(options->gridColumns, options->gridRows);
+    selectSceneFile(options->sceneFile);
+    setShadingQualityOpenGL(options->shadingQuality);
+    setClusterCullingOpenGL(options->gpuCulling);
+    setDepthPrepassOpenGL(options->depthPrepass);
+
+    // Spinning nodes follow the clock, which would make captured frames
+    // depend on how long each one took to render
+    setSceneAnimationOpenGL(options->mode == MODE_INTERACTIVE);
+
+    // Turntable frames each turn the view, where culling against the depth
+    // of the frame before could drop parts just coming into view
+    setOcclusionCullingOpenGL(options->occlusionCulling && options->mode != MODE_TURNTABLE);
     initialiseWindowSizeCallbackGLFW(viewPortResizeCallback);
     initialiseMouseMovementCallbackGLFW(mouseDragCallback);
     initialiseMouseScrollCallbackGLFW(scrollCallBack);
-    initialiseOpenGL(procAddressGLFW(), getScreenSize(), modelName);
+    initialiseKeyPressCallbackGLFW(keyPressCallback);
+    renderFunction = renderOpenGL;
+    rendererReady = true;
+
+    if (options->mode == MODE_TURNTABLE)
+    {
+        initialiseOpenGL(procAddressGLFW(), &captureSize, options->modelNames, options->modelCount);
+        captureReady = initialiseCapture(options->outputPath, options->width, options->height);
+    }
+    else if (options->mode == MODE_IMAGE)
+    {
+        initialiseOpenGL(procAddressGLFW(), &captureSize, options->modelNames, options->modelCount);
+        captureReady = initialiseImageCapture(options->width, options->height);
+    }
+    else if (options->mode == MODE_BATCH)
+    {
+        // One context and shader program serve every model in the batch
+        initialiseOpenGL(procAddressGLFW(), &captureSize, NULL, 0);
+
+        // Loaders leave one core free for the render and writer threads
+        int workerCount = options->threadCount > 1 ? options->threadCount - 1 : 1;
+
+        captureReady = initialiseImageCapture(options->width, options->height);
+        batchReady = captureReady && initialiseBatch(options->batchSource, options->outputPath, workerCount);
+    }
+    else
+    {
+        initialiseOpenGL(procAddressGLFW(), getScreenSize(), options->modelNames, options->modelCount);
+        watchShadersOpenGL();
+
+        // A reload replaces the whole mesh, so only a lone model is watched
+        if (options->modelCount == 1 && options->sceneFile == NULL)
+            reloaderReady = initialiseModelReloader(options->modelName);
+    }
 }
 
 void renderFrames()
 {
+    if (!rendererReady)
+        return;
+
+    if (applicationOptions->mode == MODE_PATH_TRACE)
+    {
+        renderPathTracer(applicationOptions->outputPath, applicationOptions->sampleCount);
+        return;
+    }
+
+    if (applicationOptions->mode == MODE_BATCH)
+    {
+        if (batchReady)
+        {
+            double batchTime = benchmark(renderBatch);
+            printf("Batch finished in %.3f seconds\n", batchTime);
+            releaseBatch();
+        }
+
+        if (captureReady)
+            releaseCapture();
+
+        return;
+    }
+
+    if (applicationOptions->mode == MODE_TURNTABLE)
+    {
+        if (!captureReady)
+            return;
+
+        double captureTime = benchmark(captureTurntable);
+        releaseCapture();
+
+        printf("Captured %d frames in %.3f seconds (%.1f FPS)\n",
+            applicationOptions->frameCount,
+            captureTime,
+            applicationOptions->frameCount / captureTime
+        );
+        return;
+    }
+
+    if (applicationOptions->mode == MODE_IMAGE)
+    {
+        if (!applicationOptions->softwareRenderer && !captureReady)
+            return;
+
+        double renderTime = benchmark(renderImageFrames);
+
+        printf("%s renderer: %d frames in %.3f seconds (%.3f ms per frame)\n",
+            applicationOptions->softwareRenderer ? "Software" : "OpenGL",
+            applicationOptions->frameCount,
+            renderTime,
+            renderTime * 1000.0 / applicationOptions->frameCount
+        );
+
+        if (!applicationOptions->softwareRenderer)
+        {
+            printOverdrawStatistics("Last frame");
+            printOcclusionStatistics("Last frame");
+        }
+
+        if (applicationOptions->softwareRenderer)
+            writeSoftwareImage(applicationOptions->outputPath);
+        else
+        {
+            endCaptureFrameAs(applicationOptions->outputPath);
+            releaseCapture();
+        }
+        return;
+    }
+
     while(applicationOpenGLFW())
+    {
         benchmarkPrint(groupRuntime, "Main Loop");
+        printOverdrawStatistics(NULL);
+        printOcclusionStatistics(NULL);
+    }
+}
+
+/*
+    Prints the fragments shaded for each pixel of the last measured frame,
+    and with the depth pre-pass, the fragments it drew. Without a label they
+    are appended to the frame time line, which is rewritten every frame.
+*/
+void printOverdrawStatistics(char * label)
+{
+    OverdrawStatistics statistics = overdrawStatisticsOpenGL();
+
+    if (statistics.shadedPerPixel == 0.0f)
+        return;
+
+    if (label == NULL)
+    {
+        if (statistics.depthPrepass)
+            printf(", shaded %.2f per pixel of %.2f drawn   ", statistics.shadedPerPixel, statistics.drawnPerPixel);
+        else
+            printf(", shaded %.2f per pixel   ", statistics.shadedPerPixel);
+
+        fflush(stdout);
+    }
+    else if (statistics.depthPrepass)
+        printf("%s: shaded %.2f fragments per pixel, with a depth pre-pass drawing %.2f\n", label, statistics.shadedPerPixel, statistics.drawnPerPixel);
+    else
+        printf("%s: shaded %.2f fragments per pixel\n", label, statistics.shadedPerPixel);
+}
+
+/*
+    Prints how many of the boxes tested against the depth pyramid in the
+    last frame it hid. Without a label the counts are appended to the frame
+    time line, which is rewritten every frame.
+*/
+void printOcclusionStatistics(char * label)
+{
+    OcclusionStatistics statistics = occlusionStatisticsOpenGL();
+
+    if (statistics.tested == 0)
+        return;
+
+    float rate = 100.0f * statistics.occluded / statistics.tested;
+
+    if (label == NULL)
+    {
+        printf(", occluded %d of %d (%.1f%%)   ", statistics.occluded, statistics.tested, rate);
+        fflush(stdout);
+    }
+    else
+        printf("%s: occluded %d of %d boxes tested (%.1f%%)\n", label, statistics.occluded, statistics.tested, rate);
 }
 
 void releaseResources()
 {
-    releaseGLFW();
-    releaseOpenGL();
+    if (applicationOptions->mode == MODE_PATH_TRACE)
+    {
+        if (rendererReady)
+            releasePathTracer();
+    }
+    else if (applicationOptions->softwareRenderer)
+    {
+        if (rendererReady)
+            releaseSoftwareRenderer();
+    }
+    else
+    {
+        if (reloaderReady)
+            releaseModelReloader();
+
+        releaseOpenGL();
+    }
+
+    if (windowReady)
+        releaseGLFW();
+
+    releaseJobSystem();
 
     printf("\r");
     fflush(stdout);
 }
-
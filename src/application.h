@@ -1,16 +1,24 @@
 #ifndef APPLICATION
 #define APPLICATION
 
+#include "commandLine.h"
+
 
 // Public method(s)
 
-void initialiseApplication(char * modelName);
+void initialiseApplication(ApplicationOptions * options);
 void renderFrames();
 void releaseResources();
 
 // Private Methods(s)
 
 void groupRuntime();
+void reloadModel();
+void captureTurntable();
+void renderAndPresentSoftware();
+void renderImageFrames();
+void printOverdrawStatistics(char * label);
+void printOcclusionStatistics(char * label);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,295 @@
+/******************************************************************************
+ * File:        batchRenderer.c
+ * Description: Renders thumbnails for a whole directory, or a list file, of
+ *              OBJ models with a single OpenGL context and shader program.
+ *              - Loader threads parse upcoming models while the current one
+ *                renders, bounded by a small prefetch window so memory stays
+ *                flat however many models are queued.
+ *              - The render thread only uploads and draws; images are read
+ *                back and encoded by the capture pipeline's writer thread.
+ *              - Each model is fitted with the centre and scale computed by
+ *                loadOBJ, exactly as in the interactive viewer.
+ ******************************************************************************/
+
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batchRenderer.h"
+#include "capture.h"
+#include "graphics.h"
+
+#define BATCH_PREFETCH_DEPTH 4
+#define BATCH_PATH_LENGTH 512
+
+static char ** modelPaths;
+static int modelCount;
+static int modelCapacity;
+static char * thumbnailDirectory;
+
+// Loaded models waiting to be rendered, guarded by batchMutex
+static BatchModel prefetched[BATCH_PREFETCH_DEPTH];
+static bool prefetchedReady[BATCH_PREFETCH_DEPTH];
+static int prefetchedCount;
+static int modelsInFlight;
+static int nextModelToLoad;
+
+static pthread_t * loaderThreads;
+static int loaderCount;
+static pthread_mutex_t batchMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t modelReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t prefetchSpace = PTHREAD_COND_INITIALIZER;
+
+// Public method(s)
+
+bool initialiseBatch(char * source, char * outputDirectory, int workerCount)
+{
+    thumbnailDirectory = outputDirectory;
+
+    DIR * directory = opendir(source);
+
+    if (directory != NULL)
+    {
+        closedir(directory);
+
+        if (!collectDirectory(source))
+            return false;
+    }
+    else if (!collectFileList(source))
+        return false;
+
+    if (modelCount == 0)
+    {
+        printf("No OBJ models found in %s\n", source);
+        return false;
+    }
+
+    prefetchedCount = 0;
+    modelsInFlight = 0;
+    nextModelToLoad = 0;
+
+    loaderCount = workerCount;
+    loaderThreads = (pthread_t *)malloc(sizeof(pthread_t) * loaderCount);
+
+    for (int i = 0; i < loaderCount; i++)
+        pthread_create(&loaderThreads[i], NULL, loaderThreadMain, NULL);
+
+    return true;
+}
+
+void renderBatch()
+{
+    BatchModel batchModel;
+    char thumbnail[BATCH_PATH_LENGTH];
+    int rendered = 0;
+
+    while (nextLoadedModel(&batchModel))
+    {
+        if (!batchModel.loaded)
+        {
+            printf("Skipping %s\n", modelPaths[batchModel.modelIndex]);
+            releaseMesh(&batchModel.mesh);
+            continue;
+        }
+
+        thumbnailPath(modelPaths[batchModel.modelIndex], thumbnail, sizeof(thumbnail));
+
+        setMeshOpenGL(&batchModel.mesh);
+        beginCaptureFrame();
+        renderOpenGL();
+        endCaptureFrameAs(thumbnail);
+
+        rendered++;
+    }
+
+    printf("Rendered %d of %d thumbnails\n", rendered, modelCount);
+}
+
+void releaseBatch()
+{
+    for (int i = 0; i < loaderCount; i++)
+        pthread_join(loaderThreads[i], NULL);
+
+    for (int i = 0; i < modelCount; i++)
+        free(modelPaths[i]);
+
+    free(modelPaths);
+    free(loaderThreads);
+
+    modelPaths = NULL;
+    loaderThreads = NULL;
+    modelCount = 0;
+    modelCapacity = 0;
+    loaderCount = 0;
+}
+
+// Private method(s)
+
+bool collectDirectory(char * directoryPath)
+{
+    DIR * directory = opendir(directoryPath);
+
+    if (directory == NULL)
+    {
+        printf("Could not open directory: %s\n", directoryPath);
+        return false;
+    }
+
+    struct dirent * entry;
+    char modelPath[BATCH_PATH_LENGTH];
+
+    while ((entry = readdir(directory)) != NULL)
+    {
+        size_t length = strlen(entry->d_name);
+
+        if (length <= 4 || strcmp(&entry->d_name[length - 4], ".obj"))
+            continue;
+
+        snprintf(modelPath, sizeof(modelPath), "%s/%s", directoryPath, entry->d_name);
+        addModelPath(modelPath);
+    }
+
+    closedir(directory);
+
+    return true;
+}
+
+/*
+    A list file holds one model path per line. Blank lines are ignored.
+*/
+bool collectFileList(char * listPath)
+{
+    FILE * input = fopen(listPath, "r");
+
+    if (input == NULL)
+    {
+        printf("Could not open model list: %s\n", listPath);
+        return false;
+    }
+
+    char line[BATCH_PATH_LENGTH];
+
+    while (fgets(line, sizeof(line), input) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] != '\0')
+            addModelPath(line);
+    }
+
+    fclose(input);
+
+    return true;
+}
+
+void addModelPath(char * modelPath)
+{
+    if (modelCount == modelCapacity)
+    {
+        modelCapacity = modelCapacity == 0 ? 64 : modelCapacity * 2;
+        modelPaths = (char **)realloc(modelPaths, sizeof(char *) * modelCapacity);
+    }
+
+    modelPaths[modelCount++] = strdup(modelPath);
+}
+
+/*
+    Blocks until a loader thread has a model ready. Returns false once every
+    model has been handed out.
+*/
+bool nextLoadedModel(BatchModel * batchModel)
+{
+    pthread_mutex_lock(&batchMutex);
+
+    while (prefetchedCount == 0 && (nextModelToLoad < modelCount || modelsInFlight > 0))
+        pthread_cond_wait(&modelReady, &batchMutex);
+
+    if (prefetchedCount == 0)
+    {
+        pthread_mutex_unlock(&batchMutex);
+        return false;
+    }
+
+    for (int i = 0; i < BATCH_PREFETCH_DEPTH; i++)
+    {
+        if (prefetchedReady[i])
+        {
+            *batchModel = prefetched[i];
+            prefetchedReady[i] = false;
+            break;
+        }
+    }
+
+    prefetchedCount--;
+    pthread_cond_signal(&prefetchSpace);
+    pthread_mutex_unlock(&batchMutex);
+
+    return true;
+}
+
+void * loaderThreadMain(void * argument)
+{
+    while (true)
+    {
+        pthread_mutex_lock(&batchMutex);
+
+        // Models being parsed count against the window so it never overflows
+        while (prefetchedCount + modelsInFlight >= BATCH_PREFETCH_DEPTH && nextModelToLoad < modelCount)
+            pthread_cond_wait(&prefetchSpace, &batchMutex);
+
+        if (nextModelToLoad == modelCount)
+        {
+            pthread_mutex_unlock(&batchMutex);
+            break;
+        }
+
+        int modelIndex = nextModelToLoad++;
+        modelsInFlight++;
+        pthread_mutex_unlock(&batchMutex);
+
+        BatchModel batchModel;
+        batchModel.modelIndex = modelIndex;
+        batchModel.loaded = loadModel(modelPaths[modelIndex], &batchModel.mesh) > 0;
+
+        pthread_mutex_lock(&batchMutex);
+
+        for (int i = 0; i < BATCH_PREFETCH_DEPTH; i++)
+        {
+            if (!prefetchedReady[i])
+            {
+                prefetched[i] = batchModel;
+                prefetchedReady[i] = true;
+                break;
+            }
+        }
+
+        prefetchedCount++;
+        modelsInFlight--;
+        pthread_cond_signal(&modelReady);
+        pthread_mutex_unlock(&batchMutex);
+    }
+
+    // Wake the render thread in case this was the last model
+    pthread_mutex_lock(&batchMutex);
+    pthread_cond_broadcast(&modelReady);
+    pthread_cond_broadcast(&prefetchSpace);
+    pthread_mutex_unlock(&batchMutex);
+
+    return NULL;
+}
+
+/*
+    models/key.obj becomes <output directory>/key.png
+*/
+void thumbnailPath(char * modelPath, char * thumbnail, int thumbnailLength)
+{
+    char * fileName = strrchr(modelPath, '/');
+    fileName = fileName == NULL ? modelPath : fileName + 1;
+
+    int nameLength = strlen(fileName) - 4;
+
+    snprintf(thumbnail, thumbnailLength, "%s/%.*s.png", thumbnailDirectory, nameLength, fileName);
+}
@@ -0,0 +1,29 @@
+#ifndef BATCH_RENDERER
+#define BATCH_RENDERER
+
+#include <stdbool.h>
+
+#include "loadModel.h"
+
+typedef struct BatchModel
+{
+    Mesh mesh;
+    int modelIndex;
+    bool loaded;
+}
+BatchModel;
+
+// Public method(s)
+bool initialiseBatch(char * source, char * outputDirectory, int workerCount);
+void renderBatch();
+void releaseBatch();
+
+// Private method(s)
+bool collectDirectory(char * directoryPath);
+bool collectFileList(char * listPath);
+void addModelPath(char * modelPath);
+bool nextLoadedModel(BatchModel * batchModel);
+void * loaderThreadMain(void * argument);
+void thumbnailPath(char * modelPath, char * thumbnail, int thumbnailLength);
+
+#endif
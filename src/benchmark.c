@@ -22,24 +22,28 @@ double benchmark(voidFunction function)
 }
 
 double computeTime(voidFunction function) {
-#ifdef _WIN32
-    LARGE_INTEGER freq, start, end;
-    QueryPerformanceFrequency(&freq);
-    QueryPerformanceCounter(&start);
+    double start = currentTime();
 
     function();
 
-    QueryPerformanceCounter(&end);
-    return (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
-#else
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    return currentTime() - start;
+}
 
-    function();
+/*
+    Monotonic time in seconds, for timing work that is not a voidFunction.
+*/
+double currentTime()
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+
+    return (double)now.QuadPart / freq.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    long seconds = end.tv_sec - start.tv_sec;
-    long nanoseconds = end.tv_nsec - start.tv_nsec;
-    return seconds + nanoseconds * 1e-9;
+    return now.tv_sec + now.tv_nsec * 1e-9;
 #endif
 }
\ No newline at end of file
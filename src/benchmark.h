@@ -9,6 +9,7 @@ typedef void (*voidFunction)();
 void benchmarkPrint(voidFunction function, const char* functionName);
 double benchmark(voidFunction function);
 double computeTime(voidFunction function);
+double currentTime();
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,475 @@
+/******************************************************************************
+ * File:        bvh.c
+ * Description: Bounding volume hierarchy over a triangle soup for ray
+ *              queries.
+ *              - Built top down with binned surface area heuristic (SAH)
+ *                splits, using an explicit task stack so deep trees cannot
+ *                overflow the call stack.
+ *              - Leaves hold at most four triangles, stored as one structure
+ *                of arrays pack so a leaf is tested with a single four-wide
+ *                Moller-Trumbore intersection.
+ *              - Traversal visits the nearer child first and skips subtrees
+ *                beyond the closest hit found so far.
+ * Notes:       Triangles are intersected from both sides.
+ ******************************************************************************/
+
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bvh.h"
+#include "simdTypes.h"
+
+#define BVH_BIN_COUNT 16
+#define BVH_MAX_SAH_DEPTH 48
+#define BVH_STACK_SIZE 128
+#define BVH_EPSILON 1e-5f
+
+typedef struct BuildTask
+{
+    int nodeIndex;
+    int first;
+    int count;
+    int depth;
+}
+BuildTask;
+
+// Public method(s)
+
+bool buildBVH(BoundingVolumeHierarchy * bvh, const float * positions, int triangleCount)
+{
+    bvh->nodes = NULL;
+    bvh->packs = NULL;
+    bvh->nodeCount = 0;
+    bvh->packCount = 0;
+
+    if (triangleCount <= 0)
+        return false;
+
+    BuildReference * references = (BuildReference *)malloc(sizeof(BuildReference) * triangleCount);
+
+    for (int i = 0; i < triangleCount; i++)
+    {
+        const float * triangle = &positions[9 * (size_t)i];
+        BuildReference * reference = &references[i];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            reference->boundsMin[axis] = fminf(fminf(triangle[axis], triangle[3 + axis]), triangle[6 + axis]);
+            reference->boundsMax[axis] = fmaxf(fmaxf(triangle[axis], triangle[3 + axis]), triangle[6 + axis]);
+            reference->centroid[axis] = (reference->boundsMin[axis] + reference->boundsMax[axis]) * 0.5f;
+        }
+
+        reference->triangleIndex = i;
+    }
+
+    // A binary tree with leaves of at least one triangle has under 2n nodes
+    bvh->nodes = (BVHNode *)malloc(sizeof(BVHNode) * 2 * triangleCount);
+    bvh->packs = (TrianglePack *)malloc(sizeof(TrianglePack) * triangleCount);
+
+    BuildTask * tasks = (BuildTask *)malloc(sizeof(BuildTask) * 2 * triangleCount);
+    int taskCount = 0;
+
+    bvh->nodeCount = 1;
+    tasks[taskCount++] = (BuildTask){0, 0, triangleCount, 0};
+
+    while (taskCount > 0)
+    {
+        BuildTask task = tasks[--taskCount];
+        BVHNode * node = &bvh->nodes[task.nodeIndex];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            node->boundsMin[axis] = FLT_MAX;
+            node->boundsMax[axis] = -FLT_MAX;
+        }
+
+        for (int i = task.first; i < task.first + task.count; i++)
+            growBounds(node->boundsMin, node->boundsMax, references[i].boundsMin, references[i].boundsMax);
+
+        if (task.count <= BVH_LEAF_SIZE)
+        {
+            makeLeaf(bvh, node, references, task.first, task.count, positions);
+            continue;
+        }
+
+        int leftCount = partitionReferences(references, task.first, task.count, task.depth);
+
+        node->leftOrFirst = bvh->nodeCount;
+        node->count = 0;
+        bvh->nodeCount += 2;
+
+        tasks[taskCount++] = (BuildTask){node->leftOrFirst, task.first, leftCount, task.depth + 1};
+        tasks[taskCount++] = (BuildTask){node->leftOrFirst + 1, task.first + leftCount, task.count - leftCount, task.depth + 1};
+    }
+
+    free(tasks);
+    free(references);
+
+    return true;
+}
+
+void initialiseRay(Ray * ray, const float * origin, const float * direction)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        ray->origin[axis] = origin[axis];
+        ray->direction[axis] = direction[axis];
+        ray->inverseDirection[axis] = 1.0f / direction[axis];
+    }
+}
+
+/*
+    Finds the closest hit before maxDistance.
+*/
+bool intersectBVH(BoundingVolumeHierarchy * bvh, Ray * ray, float maxDistance, RayHit * hit)
+{
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    bool found = false;
+
+    hit->distance = maxDistance;
+    hit->triangleIndex = -1;
+
+    if (bvh->nodeCount == 0 || intersectBounds(&bvh->nodes[0], ray, maxDistance) == INFINITY)
+        return false;
+
+    int nodeIndex = 0;
+
+    while (true)
+    {
+        BVHNode * node = &bvh->nodes[nodeIndex];
+
+        if (node->count > 0)
+        {
+            found |= intersectPack(&bvh->packs[node->leftOrFirst], ray, hit, false);
+
+            if (stackSize == 0)
+                break;
+
+            nodeIndex = stack[--stackSize];
+            continue;
+        }
+
+        int left = node->leftOrFirst;
+        float leftDistance = intersectBounds(&bvh->nodes[left], ray, hit->distance);
+        float rightDistance = intersectBounds(&bvh->nodes[left + 1], ray, hit->distance);
+
+        if (leftDistance == INFINITY && rightDistance == INFINITY)
+        {
+            if (stackSize == 0)
+                break;
+
+            nodeIndex = stack[--stackSize];
+        }
+        else if (rightDistance == INFINITY)
+            nodeIndex = left;
+        else if (leftDistance == INFINITY)
+            nodeIndex = left + 1;
+        else
+        {
+            nodeIndex = leftDistance <= rightDistance ? left : left + 1;
+            stack[stackSize++] = leftDistance <= rightDistance ? left + 1 : left;
+        }
+    }
+
+    return found;
+}
+
+/*
+    Returns as soon as any hit before maxDistance is found, for shadow rays.
+*/
+bool occludedBVH(BoundingVolumeHierarchy * bvh, Ray * ray, float maxDistance)
+{
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+
+    RayHit hit;
+    hit.distance = maxDistance;
+
+    if (bvh->nodeCount == 0)
+        return false;
+
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        BVHNode * node = &bvh->nodes[stack[--stackSize]];
+
+        if (intersectBounds(node, ray, maxDistance) == INFINITY)
+            continue;
+
+        if (node->count > 0)
+        {
+            if (intersectPack(&bvh->packs[node->leftOrFirst], ray, &hit, true))
+                return true;
+        }
+        else
+        {
+            stack[stackSize++] = node->leftOrFirst;
+            stack[stackSize++] = node->leftOrFirst + 1;
+        }
+    }
+
+    return false;
+}
+
+void releaseBVH(BoundingVolumeHierarchy * bvh)
+{
+    free(bvh->nodes);
+    free(bvh->packs);
+
+    bvh->nodes = NULL;
+    bvh->packs = NULL;
+    bvh->nodeCount = 0;
+    bvh->packCount = 0;
+}
+
+// Private method(s)
+
+float surfaceArea(const float * boundsMin, const float * boundsMax)
+{
+    float x = boundsMax[0] - boundsMin[0];
+    float y = boundsMax[1] - boundsMin[1];
+    float z = boundsMax[2] - boundsMin[2];
+
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+void growBounds(float * boundsMin, float * boundsMax, const float * pointMin, const float * pointMax)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        boundsMin[axis] = fminf(boundsMin[axis], pointMin[axis]);
+        boundsMax[axis] = fmaxf(boundsMax[axis], pointMax[axis]);
+    }
+}
+
+void makeLeaf(BoundingVolumeHierarchy * bvh, BVHNode * node, BuildReference * references, int first, int count, const float * positions)
+{
+    TrianglePack * pack = &bvh->packs[bvh->packCount];
+    memset(pack, 0, sizeof(TrianglePack));
+
+    for (int lane = 0; lane < BVH_LEAF_SIZE; lane++)
+    {
+        if (lane >= count)
+        {
+            pack->triangleIndex[lane] = -1;
+            continue;
+        }
+
+        int triangleIndex = references[first + lane].triangleIndex;
+        const float * triangle = &positions[9 * (size_t)triangleIndex];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            pack->v0[axis][lane] = triangle[axis];
+            pack->edge1[axis][lane] = triangle[3 + axis] - triangle[axis];
+            pack->edge2[axis][lane] = triangle[6 + axis] - triangle[axis];
+        }
+
+        pack->triangleIndex[lane] = triangleIndex;
+    }
+
+    node->leftOrFirst = bvh->packCount++;
+    node->count = count;
+}
+
+/*
+    Splits at the cheapest of BVH_BIN_COUNT candidate planes per axis, by
+    surface area heuristic. Falls back to a median split when the centroids
+    cannot be separated, or past BVH_MAX_SAH_DEPTH so depth stays bounded.
+    Returns the number of references placed on the left.
+*/
+int partitionReferences(BuildReference * references, int first, int count, int depth)
+{
+    float centroidMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float centroidMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+    for (int i = first; i < first + count; i++)
+        growBounds(centroidMin, centroidMax, references[i].centroid, references[i].centroid);
+
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+
+    for (int axis = 0; axis < 3 && depth < BVH_MAX_SAH_DEPTH; axis++)
+    {
+        float extent = centroidMax[axis] - centroidMin[axis];
+
+        if (extent <= 0.0f)
+            continue;
+
+        int binCounts[BVH_BIN_COUNT] = {0};
+        float binMin[BVH_BIN_COUNT][3];
+        float binMax[BVH_BIN_COUNT][3];
+
+        for (int bin = 0; bin < BVH_BIN_COUNT; bin++)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                binMin[bin][i] = FLT_MAX;
+                binMax[bin][i] = -FLT_MAX;
+            }
+        }
+
+        float binScale = BVH_BIN_COUNT / extent;
+
+        for (int i = first; i < first + count; i++)
+        {
+            int bin = (int)((references[i].centroid[axis] - centroidMin[axis]) * binScale);
+            bin = bin < BVH_BIN_COUNT ? bin : BVH_BIN_COUNT - 1;
+
+            binCounts[bin]++;
+            growBounds(binMin[bin], binMax[bin], references[i].boundsMin, references[i].boundsMax);
+        }
+
+        // Sweep from the right to find the area of every right hand side
+        float rightAreas[BVH_BIN_COUNT];
+        float sweepMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+        float sweepMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+        for (int bin = BVH_BIN_COUNT - 1; bin > 0; bin--)
+        {
+            growBounds(sweepMin, sweepMax, binMin[bin], binMax[bin]);
+            rightAreas[bin] = surfaceArea(sweepMin, sweepMax);
+        }
+
+        int leftCount = 0;
+        int rightCount = count;
+
+        for (int i = 0; i < 3; i++)
+        {
+            sweepMin[i] = FLT_MAX;
+            sweepMax[i] = -FLT_MAX;
+        }
+
+        for (int split = 1; split < BVH_BIN_COUNT; split++)
+        {
+            leftCount += binCounts[split - 1];
+            rightCount -= binCounts[split - 1];
+            growBounds(sweepMin, sweepMax, binMin[split - 1], binMax[split - 1]);
+
+            if (leftCount == 0 || rightCount == 0)
+                continue;
+
+            float cost = leftCount * surfaceArea(sweepMin, sweepMax) + rightCount * rightAreas[split];
+
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    if (bestAxis == -1)
+    {
+        // References keep their order, so halving them still makes progress
+        return count / 2;
+    }
+
+    float extent = centroidMax[bestAxis] - centroidMin[bestAxis];
+    float binScale = BVH_BIN_COUNT / extent;
+
+    int left = first;
+    int right = first + count - 1;
+
+    while (left <= right)
+    {
+        int bin = (int)((references[left].centroid[bestAxis] - centroidMin[bestAxis]) * binScale);
+        bin = bin < BVH_BIN_COUNT ? bin : BVH_BIN_COUNT - 1;
+
+        if (bin < bestSplit)
+            left++;
+        else
+        {
+            BuildReference swap = references[left];
+            references[left] = references[right];
+            references[right--] = swap;
+        }
+    }
+
+    return left - first;
+}
+
+/*
+    Slab test. Returns the entry distance, or INFINITY on a miss.
+*/
+float intersectBounds(BVHNode * node, Ray * ray, float maxDistance)
+{
+    float nearest = 0.0f;
+    float farthest = maxDistance;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float t0 = (node->boundsMin[axis] - ray->origin[axis]) * ray->inverseDirection[axis];
+        float t1 = (node->boundsMax[axis] - ray->origin[axis]) * ray->inverseDirection[axis];
+
+        nearest = fmaxf(nearest, fminf(t0, t1));
+        farthest = fminf(farthest, fmaxf(t0, t1));
+    }
+
+    return nearest <= farthest ? nearest : INFINITY;
+}
+
+/*
+    Moller-Trumbore against all four triangles of a pack at once.
+*/
+bool intersectPack(TrianglePack * pack, Ray * ray, RayHit * hit, bool anyHit)
+{
+    float4 v0[3], edge1[3], edge2[3];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        memcpy(&v0[axis], pack->v0[axis], sizeof(float4));
+        memcpy(&edge1[axis], pack->edge1[axis], sizeof(float4));
+        memcpy(&edge2[axis], pack->edge2[axis], sizeof(float4));
+    }
+
+    float dx = ray->direction[0], dy = ray->direction[1], dz = ray->direction[2];
+
+    float4 px = dy * edge2[2] - dz * edge2[1];
+    float4 py = dz * edge2[0] - dx * edge2[2];
+    float4 pz = dx * edge2[1] - dy * edge2[0];
+    float4 determinant = edge1[0] * px + edge1[1] * py + edge1[2] * pz;
+    float4 inverseDeterminant = 1.0f / determinant;
+
+    float4 tx = ray->origin[0] - v0[0];
+    float4 ty = ray->origin[1] - v0[1];
+    float4 tz = ray->origin[2] - v0[2];
+    float4 u = (tx * px + ty * py + tz * pz) * inverseDeterminant;
+
+    float4 qx = ty * edge1[2] - tz * edge1[1];
+    float4 qy = tz * edge1[0] - tx * edge1[2];
+    float4 qz = tx * edge1[1] - ty * edge1[0];
+    float4 v = (dx * qx + dy * qy + dz * qz) * inverseDeterminant;
+    float4 distance = (edge2[0] * qx + edge2[1] * qy + edge2[2] * qz) * inverseDeterminant;
+
+    int4 valid = ((determinant > BVH_EPSILON * BVH_EPSILON) | (determinant < -BVH_EPSILON * BVH_EPSILON)) &
+                 (u >= 0.0f) & (v >= 0.0f) & (u + v <= 1.0f) &
+                 (distance > BVH_EPSILON) & (distance < hit->distance);
+
+    bool found = false;
+
+    for (int lane = 0; lane < BVH_LEAF_SIZE; lane++)
+    {
+        if (!valid[lane] || distance[lane] >= hit->distance)
+            continue;
+
+        if (anyHit)
+            return true;
+
+        hit->distance = distance[lane];
+        hit->u = u[lane];
+        hit->v = v[lane];
+        hit->triangleIndex = pack->triangleIndex[lane];
+        found = true;
+    }
+
+    return found;
+}
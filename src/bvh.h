@@ -0,0 +1,81 @@
+#ifndef BOUNDING_VOLUME_HIERARCHY
+#define BOUNDING_VOLUME_HIERARCHY
+
+#include <stdbool.h>
+
+#define BVH_LEAF_SIZE 4
+
+// Interior nodes have two children stored together at leftOrFirst. Leaf
+// nodes have a non-zero count and leftOrFirst indexes their triangle pack.
+typedef struct BVHNode
+{
+    float boundsMin[3];
+    int leftOrFirst;
+    float boundsMax[3];
+    int count;
+}
+BVHNode;
+
+// Up to four triangles in structure of arrays layout for four-wide tests.
+// Unused lanes have a triangle index of -1 and degenerate edges.
+typedef struct TrianglePack
+{
+    float v0[3][BVH_LEAF_SIZE];
+    float edge1[3][BVH_LEAF_SIZE];
+    float edge2[3][BVH_LEAF_SIZE];
+    int triangleIndex[BVH_LEAF_SIZE];
+}
+TrianglePack;
+
+typedef struct BoundingVolumeHierarchy
+{
+    BVHNode * nodes;
+    int nodeCount;
+    TrianglePack * packs;
+    int packCount;
+}
+BoundingVolumeHierarchy;
+
+typedef struct Ray
+{
+    float origin[3];
+    float direction[3];
+    float inverseDirection[3];
+}
+Ray;
+
+typedef struct RayHit
+{
+    float distance;
+    float u;
+    float v;
+    int triangleIndex;
+}
+RayHit;
+
+// Triangle bounds and centroid, reordered in place while building
+typedef struct BuildReference
+{
+    float boundsMin[3];
+    float boundsMax[3];
+    float centroid[3];
+    int triangleIndex;
+}
+BuildReference;
+
+// Public method(s)
+bool buildBVH(BoundingVolumeHierarchy * bvh, const float * positions, int triangleCount);
+void initialiseRay(Ray * ray, const float * origin, const float * direction);
+bool intersectBVH(BoundingVolumeHierarchy * bvh, Ray * ray, float maxDistance, RayHit * hit);
+bool occludedBVH(BoundingVolumeHierarchy * bvh, Ray * ray, float maxDistance);
+void releaseBVH(BoundingVolumeHierarchy * bvh);
+
+// Private method(s)
+float surfaceArea(const float * boundsMin, const float * boundsMax);
+void growBounds(float * boundsMin, float * boundsMax, const float * pointMin, const float * pointMax);
+void makeLeaf(BoundingVolumeHierarchy * bvh, BVHNode * node, BuildReference * references, int first, int count, const float * positions);
+int partitionReferences(BuildReference * references, int first, int count, int depth);
+float intersectBounds(BVHNode * node, Ray * ray, float maxDistance);
+bool intersectPack(TrianglePack * pack, Ray * ray, RayHit * hit, bool anyHit);
+
+#endif
@@ -0,0 +1,340 @@
+/******************************************************************************
+ * File:        capture.c
+ * Description: Streams rendered frames to disk without stalling the render
+ *              loop.
+ *              - Frames are rendered into an offscreen target at the capture
+ *                resolution and read back asynchronously into a ring of pixel
+ *                buffer objects (PBOs).
+ *              - A PBO is only mapped once its fence has signalled, a few
+ *                frames after the read was issued, so the GPU is never
+ *                waited on.
+ *              - Mapped pixels are copied into a bounded queue which a writer
+ *                thread drains, converting to Y4M (4:4:4) or PNG.
+ *              - Image captures give every frame its own PNG path, which is
+ *                how batch thumbnails reuse the same pipeline.
+ * Notes:       Y4M output uses BT.601 limited range, which is what most
+ *              players and encoders assume for YUV4MPEG2 streams.
+ ******************************************************************************/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "capture.h"
+#include "getGLErrors.h"
+#include "imageWriter.h"
+#include "offscreenTarget.h"
+
+#define CAPTURE_SAMPLES 4
+#define CAPTURE_FRAME_RATE 30
+#define CAPTURE_PBO_COUNT 3
+#define CAPTURE_QUEUE_LENGTH 8
+#define CAPTURE_PATH_LENGTH 512
+
+typedef struct CaptureSlot
+{
+    unsigned char * pixels;
+    char framePath[CAPTURE_PATH_LENGTH];
+}
+CaptureSlot;
+
+static OffscreenTarget target;
+static CaptureFormat format;
+static FILE * videoOutput;
+static char framePathPrefix[CAPTURE_PATH_LENGTH];
+static size_t frameSize;
+static int framesIssued;
+
+// PBO ring, a slot is in use while its frame number is not -1
+static unsigned int pixelBuffers[CAPTURE_PBO_COUNT];
+static GLsync pixelBufferFences[CAPTURE_PBO_COUNT];
+static int pixelBufferFrames[CAPTURE_PBO_COUNT];
+static char pixelBufferPaths[CAPTURE_PBO_COUNT][CAPTURE_PATH_LENGTH];
+
+// Queue between the render thread and the writer thread
+static CaptureSlot queue[CAPTURE_QUEUE_LENGTH];
+static int queueHead;
+static int queueTail;
+static int queueCount;
+static bool queueClosed;
+static pthread_t writerThread;
+static pthread_mutex_t queueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueNotEmpty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queueNotFull = PTHREAD_COND_INITIALIZER;
+
+// Public method(s)
+
+bool initialiseCapture(char * outputPath, int width, int height)
+{
+    size_t pathLength = strlen(outputPath);
+
+    if (pathLength > 4 && !strcmp(&outputPath[pathLength - 4], ".y4m"))
+    {
+        format = CAPTURE_FORMAT_Y4M;
+        videoOutput = fopen(outputPath, "wb");
+
+        if (videoOutput == NULL)
+        {
+            printf("Could not open capture output: %s\n", outputPath);
+            return false;
+        }
+
+        fprintf(videoOutput, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, CAPTURE_FRAME_RATE);
+    }
+    else if (pathLength > 4 && !strcmp(&outputPath[pathLength - 4], ".png") && pathLength < CAPTURE_PATH_LENGTH)
+    {
+        // frames.png is written as frames_0000.png, frames_0001.png, ...
+        format = CAPTURE_FORMAT_PNG;
+        memcpy(framePathPrefix, outputPath, pathLength - 4);
+        framePathPrefix[pathLength - 4] = '\0';
+    }
+    else
+    {
+        printf("Capture output must end in .y4m or .png: %s\n", outputPath);
+        return false;
+    }
+
+    return startCapture(width, height);
+}
+
+/*
+    Starts a capture where every frame is written as its own PNG, at the path
+    given to endCaptureFrameAs.
+*/
+bool initialiseImageCapture(int width, int height)
+{
+    format = CAPTURE_FORMAT_PNG;
+    framePathPrefix[0] = '\0';
+
+    return startCapture(width, height);
+}
+
+void beginCaptureFrame()
+{
+    bindOffscreenTarget(&target);
+}
+
+void endCaptureFrame()
+{
+    char framePath[CAPTURE_PATH_LENGTH] = "";
+
+    if (format == CAPTURE_FORMAT_PNG)
+        snprintf(framePath, sizeof(framePath), "%s_%04d.png", framePathPrefix, framesIssued);
+
+    endCaptureFrameAs(framePath);
+}
+
+void endCaptureFrameAs(char * framePath)
+{
+    int slot = framesIssued % CAPTURE_PBO_COUNT;
+
+    // The ring is full, so the oldest read must be collected before reuse
+    if (pixelBufferFrames[slot] != -1)
+        collectPixelBuffer(slot);
+
+    resolveOffscreenTarget(&target);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    pixelBufferFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pixelBufferFrames[slot] = framesIssued++;
+    snprintf(pixelBufferPaths[slot], CAPTURE_PATH_LENGTH, "%s", framePath);
+    GET_GL_ERRORS();
+}
+
+void presentCapture(ScreenSize * windowSize)
+{
+    presentOffscreenTarget(&target, windowSize->width, windowSize->height);
+}
+
+void releaseCapture()
+{
+    // Collect outstanding reads in the order they were issued
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++)
+    {
+        int slot = (framesIssued + i) % CAPTURE_PBO_COUNT;
+
+        if (pixelBufferFrames[slot] != -1)
+            collectPixelBuffer(slot);
+    }
+
+    pthread_mutex_lock(&queueMutex);
+    queueClosed = true;
+    pthread_cond_signal(&queueNotEmpty);
+    pthread_mutex_unlock(&queueMutex);
+
+    pthread_join(writerThread, NULL);
+
+    if (videoOutput != NULL)
+        fclose(videoOutput);
+
+    format = CAPTURE_FORMAT_PNG;
+
+    videoOutput = NULL;
+
+    for (int i = 0; i < CAPTURE_QUEUE_LENGTH; i++)
+        free(queue[i].pixels);
+
+    glDeleteBuffers(CAPTURE_PBO_COUNT, pixelBuffers);
+    releaseOffscreenTarget(&target);
+}
+
+// Private method(s)
+
+bool startCapture(int width, int height)
+{
+    if (!createOffscreenTarget(&target, width, height, CAPTURE_SAMPLES))
+        return false;
+
+    frameSize = (size_t)width * height * 4;
+    framesIssued = 0;
+
+    glGenBuffers(CAPTURE_PBO_COUNT, pixelBuffers);
+
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+        pixelBufferFences[i] = NULL;
+        pixelBufferFrames[i] = -1;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    GET_GL_ERRORS();
+
+    for (int i = 0; i < CAPTURE_QUEUE_LENGTH; i++)
+        queue[i].pixels = (unsigned char *)malloc(frameSize);
+
+    queueHead = 0;
+    queueTail = 0;
+    queueCount = 0;
+    queueClosed = false;
+
+    if (pthread_create(&writerThread, NULL, writerThreadMain, NULL) != 0)
+    {
+        printf("Could not start capture writer thread.\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+    Maps a PBO whose read has been issued and hands its pixels to the writer.
+    Blocks only when the writer has fallen a full queue behind.
+*/
+void collectPixelBuffer(int slot)
+{
+    glClientWaitSync(pixelBufferFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(pixelBufferFences[slot]);
+    pixelBufferFences[slot] = NULL;
+
+    pthread_mutex_lock(&queueMutex);
+    while (queueCount == CAPTURE_QUEUE_LENGTH)
+        pthread_cond_wait(&queueNotFull, &queueMutex);
+    pthread_mutex_unlock(&queueMutex);
+
+    // Only the render thread fills the tail slot, so it is copied unlocked
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+    void * mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+
+    if (mapped != NULL)
+    {
+        memcpy(queue[queueTail].pixels, mapped, frameSize);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    GET_GL_ERRORS();
+
+    memcpy(queue[queueTail].framePath, pixelBufferPaths[slot], CAPTURE_PATH_LENGTH);
+    pixelBufferFrames[slot] = -1;
+
+    pthread_mutex_lock(&queueMutex);
+    queueTail = (queueTail + 1) % CAPTURE_QUEUE_LENGTH;
+    queueCount++;
+    pthread_cond_signal(&queueNotEmpty);
+    pthread_mutex_unlock(&queueMutex);
+}
+
+void * writerThreadMain(void * argument)
+{
+    unsigned char * planes = NULL;
+
+    if (format == CAPTURE_FORMAT_Y4M)
+        planes = (unsigned char *)malloc(frameSize / 4 * 3);
+
+    while (true)
+    {
+        pthread_mutex_lock(&queueMutex);
+        while (queueCount == 0 && !queueClosed)
+            pthread_cond_wait(&queueNotEmpty, &queueMutex);
+
+        if (queueCount == 0)
+        {
+            pthread_mutex_unlock(&queueMutex);
+            break;
+        }
+        pthread_mutex_unlock(&queueMutex);
+
+        // Only the writer thread reads the head slot, so it is used unlocked
+        CaptureSlot * frame = &queue[queueHead];
+
+        if (format == CAPTURE_FORMAT_Y4M)
+            writeY4MFrame(frame->pixels, planes);
+        else
+            writePNG(frame->framePath, frame->pixels, target.width, target.height, true);
+
+        pthread_mutex_lock(&queueMutex);
+        queueHead = (queueHead + 1) % CAPTURE_QUEUE_LENGTH;
+        queueCount--;
+        pthread_cond_signal(&queueNotFull);
+        pthread_mutex_unlock(&queueMutex);
+    }
+
+    free(planes);
+
+    return NULL;
+}
+
+/*
+    Converts bottom-up RGBA to top-down planar Y, U and V using integer
+    BT.601 coefficients.
+*/
+void writeY4MFrame(unsigned char * pixels, unsigned char * planes)
+{
+    int width = target.width;
+    int height = target.height;
+    size_t planeSize = (size_t)width * height;
+
+    unsigned char * yPlane = planes;
+    unsigned char * uPlane = planes + planeSize;
+    unsigned char * vPlane = planes + planeSize * 2;
+
+    for (int row = 0; row < height; row++)
+    {
+        unsigned char * source = pixels + (size_t)(height - 1 - row) * width * 4;
+        size_t destination = (size_t)row * width;
+
+        for (int column = 0; column < width; column++)
+        {
+            int r = source[column * 4];
+            int g = source[column * 4 + 1];
+            int b = source[column * 4 + 2];
+
+            yPlane[destination + column] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            uPlane[destination + column] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            vPlane[destination + column] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+
+    fputs("FRAME\n", videoOutput);
+    fwrite(planes, 1, planeSize * 3, videoOutput);
+}
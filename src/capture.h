@@ -0,0 +1,30 @@
+#ifndef CAPTURE
+#define CAPTURE
+
+#include <stdbool.h>
+
+#include "inputTracking.h"
+
+typedef enum CaptureFormat
+{
+    CAPTURE_FORMAT_Y4M,
+    CAPTURE_FORMAT_PNG
+}
+CaptureFormat;
+
+// Public method(s)
+bool initialiseCapture(char * outputPath, int width, int height);
+bool initialiseImageCapture(int width, int height);
+void beginCaptureFrame();
+void endCaptureFrame();
+void endCaptureFrameAs(char * framePath);
+void presentCapture(ScreenSize * windowSize);
+void releaseCapture();
+
+// Private method(s)
+bool startCapture(int width, int height);
+void collectPixelBuffer(int slot);
+void * writerThreadMain(void * argument);
+void writeY4MFrame(unsigned char * pixels, unsigned char * planes);
+
+#endif
@@ -0,0 +1,376 @@
+/******************************************************************************
+ * File:        clusterCulling.c
+ * Description: Culls the mesh in clusters of up to CLUSTER_CORNERS corners
+ *              on the GPU, where OpenGL 4.3 compute shaders are available.
+ *              - Clusters split each batch within its buffer chunk, and
+ *                their bounding spheres are found once per upload.
+ *              - Each frame the renderer queues whole spans of clusters,
+ *                and a compute shader tests every cluster of them against
+ *                the view and writes its indirect draw command, with no
+ *                instances when it is hidden. The CPU never reads which
+ *                clusters are visible.
+ *              - Clusters inside the view are also tested against the last
+ *                frame's depth pyramid, and the counts of those tested and
+ *                hidden are read back once their fence signals.
+ * Notes:       The 4.1 context macOS is limited to has no compute shaders,
+ *              so there draws are culled by group on the CPU instead.
+ ******************************************************************************/
+
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glad/glad.h>
+
+#include "clusterCulling.h"
+#include "createShader.h"
+#include "depthPyramid.h"
+#include "getGLErrors.h"
+#include "jobSystem.h"
+
+// Clusters whose spheres one job finds
+#define CLUSTER_BOUNDS_GRAIN 256
+
+// Public method(s)
+
+/*
+    Builds the culling program when the context is OpenGL 4.3 or later with
+    compute shaders and storage buffers. Returns false when it is not, or
+    the program fails to build, and the renderer culls on the CPU.
+*/
+bool initialiseClusterCuller(ClusterCuller * culler)
+{
+    int major = 0;
+    int minor = 0;
+
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+    if (major * 10 + minor < 43 || !GLAD_GL_ARB_compute_shader || !GLAD_GL_ARB_shader_storage_buffer_object ||
+        !GLAD_GL_ARB_shader_image_load_store)
+        return false;
+
+    culler->program = createComputeProgram(CLUSTER_CULL_SHADER_PATH);
+
+    if (culler->program == 0)
+        return false;
+
+    culler->planesLocation = glGetUniformLocation(culler->program, "planes");
+    culler->runCountLocation = glGetUniformLocation(culler->program, "runCount");
+    culler->threadCountLocation = glGetUniformLocation(culler->program, "threadCount");
+    culler->depthViewProjectionLocation = glGetUniformLocation(culler->program, "depthViewProjection");
+    culler->pyramidLevelsLocation = glGetUniformLocation(culler->program, "pyramidLevels");
+
+    glUseProgram(culler->program);
+    glUniform1i(glGetUniformLocation(culler->program, "depthPyramid"), DEPTH_PYRAMID_TEXTURE_UNIT);
+    glUniform1f(glGetUniformLocation(culler->program, "depthBias"), DEPTH_PYRAMID_BIAS);
+
+    glGenBuffers(1, &culler->clusterBuffer);
+    glGenBuffers(1, &culler->runBuffer);
+    glGenBuffers(1, &culler->groupBuffer);
+    glGenBuffers(CLUSTER_STATISTICS_COUNT, culler->statisticsBuffers);
+
+    for (int i = 0; i < CLUSTER_STATISTICS_COUNT; i++)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->statisticsBuffers[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * 2, NULL, GL_DYNAMIC_READ);
+        culler->statisticsFences[i] = NULL;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    culler->statisticsSlot = 0;
+    GET_GL_ERRORS();
+
+    return true;
+}
+
+/*
+    Splits the mesh's batches into clusters, finds their spheres and
+    uploads them, and collects each model's clusters into spans sharing a
+    material and chunk. Corners of instanced groups are drawn per instance
+    and have no clusters. Returns the number of bytes uploaded.
+*/
+long long uploadMeshClusters(ClusterCuller * culler, Mesh * mesh, size_t chunkCorners)
+{
+    int clusterCount = splitClusters(mesh, chunkCorners, NULL, NULL);
+    MeshCluster * clusters = (MeshCluster *)malloc(sizeof(MeshCluster) * (clusterCount > 0 ? clusterCount : 1));
+    size_t * clusterFirsts = (size_t *)malloc(sizeof(size_t) * (clusterCount > 0 ? clusterCount : 1));
+
+    splitClusters(mesh, chunkCorners, clusters, clusterFirsts);
+
+    ClusterBounds bounds = {mesh, clusters, clusterFirsts};
+    parallelFor(clusterCount, CLUSTER_BOUNDS_GRAIN, boundClusters, &bounds);
+
+    culler->spans = (ClusterSpan *)realloc(culler->spans, sizeof(ClusterSpan) * (clusterCount > 0 ? clusterCount : 1));
+    culler->modelSpanStarts = (int *)realloc(culler->modelSpanStarts, sizeof(int) * (mesh->modelCount + 1));
+    culler->modelSpanStarts[0] = 0;
+    culler->modelCount = mesh->modelCount;
+    culler->clusterCount = clusterCount;
+    culler->spanCount = 0;
+
+    // A model's groups are contiguous, so a cluster's group gives its model
+    int model = 0;
+
+    for (int i = 0; i < clusterCount; i++)
+    {
+        MeshCluster * cluster = &clusters[i];
+        int chunk = clusterFirsts[i] / chunkCorners;
+
+        while (model < mesh->modelCount - 1 && cluster->group >= mesh->models[model].firstGroup + mesh->models[model].groupCount)
+            culler->modelSpanStarts[++model] = culler->spanCount;
+
+        ClusterSpan * span = culler->spanCount > culler->modelSpanStarts[model] ? &culler->spans[culler->spanCount - 1] : NULL;
+
+        if (span == NULL || span->material != cluster->material || span->chunk != chunk)
+        {
+            span = &culler->spans[culler->spanCount++];
+            span->firstCluster = i;
+            span->clusterCount = 0;
+            span->material = cluster->material;
+            span->chunk = chunk;
+        }
+
+        span->clusterCount++;
+    }
+
+    while (model < mesh->modelCount)
+        culler->modelSpanStarts[++model] = culler->spanCount;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->clusterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(MeshCluster) * clusterCount, clusters, GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    GET_GL_ERRORS();
+
+    free(clusters);
+    free(clusterFirsts);
+
+    // Group flags are uploaded whole before the next cull
+    culler->groupCount = 0;
+
+    return (long long)sizeof(MeshCluster) * clusterCount;
+}
+
+/*
+    Dispatches a thread for every cluster of the runs, which test their
+    clusters against the frustum planes, in the scene's space, and write
+    their commands into the command buffer. runs are in thread order, and
+    each run's transform is read from the transform buffer. Clusters in view
+    are tested against the depth pyramid bound to its texture unit, drawn
+    with depthViewProjection, unless pyramidLevels is 0. The barrier makes
+    the commands visible to the indirect draws which follow.
+*/
+void cullClusters(ClusterCuller * culler, Mesh * mesh, ClusterRun * runs, int runCount, int threadCount, float (* planes)[4], float (* depthViewProjection)[4], int pyramidLevels, unsigned int transformBuffer, unsigned int commandBuffer)
+{
+    uploadGroupVisibility(culler, mesh);
+    collectClusterStatistics(culler);
+
+    // Counts start from zero in the next buffer of the ring, and a cull
+    // never read back is replaced by this newer one
+    unsigned int statistics[2] = {0, 0};
+    int slot = culler->statisticsSlot;
+    culler->statisticsSlot = (slot + 1) % CLUSTER_STATISTICS_COUNT;
+
+    if (culler->statisticsFences[slot] != NULL)
+        glDeleteSync((GLsync)culler->statisticsFences[slot]);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->statisticsBuffers[slot]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(statistics), statistics);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->runBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterRun) * runCount, runs, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING_CLUSTERS, culler->clusterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING_RUNS, culler->runBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING_TRANSFORMS, transformBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING_GROUPS, culler->groupBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING_COMMANDS, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING_STATISTICS, culler->statisticsBuffers[slot]);
+
+    glUseProgram(culler->program);
+    glUniform4fv(culler->planesLocation, 6, (float *)planes);
+    glUniform1i(culler->runCountLocation, runCount);
+    glUniform1i(culler->threadCountLocation, threadCount);
+    glUniformMatrix4fv(culler->depthViewProjectionLocation, 1, GL_FALSE, (float *)depthViewProjection);
+    glUniform1i(culler->pyramidLevelsLocation, pyramidLevels);
+    glDispatchCompute((threadCount + CLUSTER_CULL_GROUP_SIZE - 1) / CLUSTER_CULL_GROUP_SIZE, 1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    culler->statisticsFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    GET_GL_ERRORS();
+}
+
+void releaseClusterCuller(ClusterCuller * culler)
+{
+    glDeleteProgram(culler->program);
+    glDeleteBuffers(1, &culler->clusterBuffer);
+    glDeleteBuffers(1, &culler->runBuffer);
+    glDeleteBuffers(1, &culler->groupBuffer);
+    glDeleteBuffers(CLUSTER_STATISTICS_COUNT, culler->statisticsBuffers);
+
+    for (int i = 0; i < CLUSTER_STATISTICS_COUNT; i++)
+    {
+        if (culler->statisticsFences[i] != NULL)
+            glDeleteSync((GLsync)culler->statisticsFences[i]);
+
+        culler->statisticsFences[i] = NULL;
+    }
+
+    free(culler->spans);
+    free(culler->modelSpanStarts);
+    free(culler->groupVisibility);
+    culler->program = 0;
+    culler->spans = NULL;
+    culler->modelSpanStarts = NULL;
+    culler->groupVisibility = NULL;
+    culler->spanCount = 0;
+    culler->modelCount = 0;
+    culler->clusterCount = 0;
+    culler->groupCount = 0;
+    culler->tested = 0;
+    culler->occluded = 0;
+}
+
+// Private method(s)
+
+/*
+    Counts the clusters of the mesh's batches, and fills them in as well
+    when clusters is not NULL. clusterFirsts receives each cluster's first
+    corner in the whole mesh.
+*/
+int splitClusters(Mesh * mesh, size_t chunkCorners, MeshCluster * clusters, size_t * clusterFirsts)
+{
+    int count = 0;
+
+    for (int i = 0; i < mesh->batchCount; i++)
+    {
+        MeshBatch * batch = &mesh->batches[i];
+
+        if (mesh->groups[batch->group].instanced)
+            continue;
+
+        for (size_t first = batch->first, end = batch->first + batch->count; first < end; count++)
+        {
+            size_t chunkStart = first / chunkCorners * chunkCorners;
+            size_t last = end < chunkStart + chunkCorners ? end : chunkStart + chunkCorners;
+
+            if (last - first > CLUSTER_CORNERS)
+                last = first + CLUSTER_CORNERS;
+
+            if (clusters != NULL)
+            {
+                clusters[count].baseVertex = first - chunkStart;
+                clusters[count].cornerCount = last - first;
+                clusters[count].group = batch->group;
+                clusters[count].material = batch->material;
+                clusterFirsts[count] = first;
+            }
+
+            first = last;
+        }
+    }
+
+    return count;
+}
+
+// Sphere around the centre of each cluster's box, through its furthest corner
+void boundClusters(void * argument, size_t first, size_t end)
+{
+    ClusterBounds * bounds = (ClusterBounds *)argument;
+
+    for (size_t i = first; i < end; i++)
+    {
+        MeshCluster * cluster = &bounds->clusters[i];
+        float * positions = &bounds->mesh->vertices[3 * bounds->clusterFirsts[i]];
+        float boxMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+        float boxMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+        for (int corner = 0; corner < cluster->cornerCount; corner++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                boxMin[axis] = fminf(boxMin[axis], positions[3 * corner + axis]);
+                boxMax[axis] = fmaxf(boxMax[axis], positions[3 * corner + axis]);
+            }
+        }
+
+        float radiusSquared = 0.0f;
+
+        for (int axis = 0; axis < 3; axis++)
+            cluster->center[axis] = 0.5f * (boxMin[axis] + boxMax[axis]);
+
+        for (int corner = 0; corner < cluster->cornerCount; corner++)
+        {
+            float dx = positions[3 * corner] - cluster->center[0];
+            float dy = positions[3 * corner + 1] - cluster->center[1];
+            float dz = positions[3 * corner + 2] - cluster->center[2];
+
+            radiusSquared = fmaxf(radiusSquared, dx * dx + dy * dy + dz * dz);
+        }
+
+        cluster->radius = sqrtf(radiusSquared);
+    }
+}
+
+// Uploads the flag of each group clusters are drawn for, when one has changed
+void uploadGroupVisibility(ClusterCuller * culler, Mesh * mesh)
+{
+    bool changed = culler->groupCount != mesh->groupCount;
+
+    if (changed)
+    {
+        culler->groupVisibility = (unsigned int *)realloc(culler->groupVisibility, sizeof(unsigned int) * (mesh->groupCount > 0 ? mesh->groupCount : 1));
+        culler->groupCount = mesh->groupCount;
+    }
+
+    for (int i = 0; i < mesh->groupCount; i++)
+    {
+        unsigned int visible = mesh->groups[i].visible && !mesh->groups[i].instanced;
+
+        changed = changed || culler->groupVisibility[i] != visible;
+        culler->groupVisibility[i] = visible;
+    }
+
+    if (!changed)
+        return;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->groupBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * culler->groupCount, culler->groupVisibility, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*
+    Takes in the counts of the newest cull whose fence has signalled,
+    without waiting for the others. The counts are left as they were when
+    none has finished.
+*/
+void collectClusterStatistics(ClusterCuller * culler)
+{
+    // Culls complete in the order issued, oldest from the next slot written
+    for (int i = 0; i < CLUSTER_STATISTICS_COUNT; i++)
+    {
+        int slot = (culler->statisticsSlot + i) % CLUSTER_STATISTICS_COUNT;
+        GLsync fence = (GLsync)culler->statisticsFences[slot];
+
+        if (fence == NULL)
+            continue;
+
+        GLenum status = glClientWaitSync(fence, 0, 0);
+
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(fence);
+        culler->statisticsFences[slot] = NULL;
+
+        unsigned int statistics[2];
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->statisticsBuffers[slot]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(statistics), statistics);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        culler->tested = statistics[0];
+        culler->occluded = statistics[1];
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef CLUSTER_CULLING
+#define CLUSTER_CULLING
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "loadModel.h"
+
+#define CLUSTER_CULL_SHADER_PATH "src/res/shaders/cull.compute.shader"
+
+// Corners of a cluster at most, a multiple of three so clusters hold whole
+// triangles. The compute shader's work group size must match.
+#define CLUSTER_CORNERS 3072
+#define CLUSTER_CULL_GROUP_SIZE 64
+
+// Shader storage bindings of the culling program's buffers
+#define CLUSTER_BINDING_CLUSTERS 0
+#define CLUSTER_BINDING_RUNS 1
+#define CLUSTER_BINDING_TRANSFORMS 2
+#define CLUSTER_BINDING_GROUPS 3
+#define CLUSTER_BINDING_COMMANDS 4
+#define CLUSTER_BINDING_STATISTICS 5
+
+// Statistics buffers the culls write in turn, so that each is read back
+// only once its fence shows the GPU has finished with it
+#define CLUSTER_STATISTICS_COUNT 3
+
+// std430 layout of a cluster, up to CLUSTER_CORNERS corners of one batch
+// within one buffer chunk, from baseVertex of the chunk. The sphere encloses
+// its corners in the mesh's space. material only groups clusters into spans.
+typedef struct MeshCluster
+{
+    float center[3];
+    float radius;
+    int baseVertex;
+    int cornerCount;
+    int group;
+    int material;
+}
+MeshCluster;
+
+// Clusters of one model sharing a material and chunk, in batch order
+typedef struct ClusterSpan
+{
+    int firstCluster;
+    int clusterCount;
+    int material;
+    int chunk;
+}
+ClusterSpan;
+
+// std430 layout of a span culled this frame. Threads from firstThread test
+// its clusters against the view with the transform at index transform, and
+// write their commands from firstCommand.
+typedef struct ClusterRun
+{
+    int firstThread;
+    int firstCluster;
+    int clusterCount;
+    int firstCommand;
+    int transform;
+}
+ClusterRun;
+
+// The clusters whose spheres are found, one job each slice, and their
+// first corners in the mesh
+typedef struct ClusterBounds
+{
+    Mesh * mesh;
+    MeshCluster * clusters;
+    size_t * clusterFirsts;
+}
+ClusterBounds;
+
+// The culling program, the resident mesh's clusters, and the spans each
+// model's clusters form. Spans of model m are modelSpanStarts[m] to
+// modelSpanStarts[m + 1] - 1. groupVisibility holds the flags last uploaded,
+// one per group. tested and occluded count the clusters of the newest
+// finished cull tested against the depth pyramid, and those it hid. Each
+// statistics buffer's fence, a GLsync, is set while its cull is unread.
+typedef struct ClusterCuller
+{
+    unsigned int program;
+    unsigned int clusterBuffer;
+    unsigned int runBuffer;
+    unsigned int groupBuffer;
+    unsigned int statisticsBuffers[CLUSTER_STATISTICS_COUNT];
+    void * statisticsFences[CLUSTER_STATISTICS_COUNT];
+    int statisticsSlot;
+    int planesLocation;
+    int runCountLocation;
+    int threadCountLocation;
+    int depthViewProjectionLocation;
+    int pyramidLevelsLocation;
+    ClusterSpan * spans;
+    int spanCount;
+    int * modelSpanStarts;
+    int modelCount;
+    int clusterCount;
+    unsigned int * groupVisibility;
+    int groupCount;
+    unsigned int tested;
+    unsigned int occluded;
+}
+ClusterCuller;
+
+// Public method(s)
+bool initialiseClusterCuller(ClusterCuller * culler);
+long long uploadMeshClusters(ClusterCuller * culler, Mesh * mesh, size_t chunkCorners);
+void cullClusters(ClusterCuller * culler, Mesh * mesh, ClusterRun * runs, int runCount, int threadCount, float (* planes)[4], float (* depthViewProjection)[4], int pyramidLevels, unsigned int transformBuffer, unsigned int commandBuffer);
+void releaseClusterCuller(ClusterCuller * culler);
+
+// Private method(s)
+int splitClusters(Mesh * mesh, size_t chunkCorners, MeshCluster * clusters, size_t * clusterFirsts);
+void boundClusters(void * argument, size_t first, size_t end);
+void uploadGroupVisibility(ClusterCuller * culler, Mesh * mesh);
+void collectClusterStatistics(ClusterCuller * culler);
+
+#endif
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "commandLine.h"
+
+#define DEFAULT_CAPTURE_WIDTH 1280
+#define DEFAULT_CAPTURE_HEIGHT 720
+#define DEFAULT_TURNTABLE_FRAMES 360
+#define DEFAULT_THUMBNAIL_SIZE 256
+#define DEFAULT_PATH_SAMPLES 64
+
+// Public method(s)
+
+bool parseCommandLine(int argc, char * argv[], ApplicationOptions * options)
+{
+    options->mode = MODE_INTERACTIVE;
+    options->modelName = NULL;
+    options->modelNames = (char **)malloc(sizeof(char *) * argc);
+    options->modelCount = 0;
+    options->sceneFile = NULL;
+    options->outputPath = NULL;
+    options->batchSource = NULL;
+    options->groupNames = NULL;
+    options->instanceList = NULL;
+    options->width = DEFAULT_CAPTURE_WIDTH;
+    options->height = DEFAULT_CAPTURE_HEIGHT;
+    options->frameCount = DEFAULT_TURNTABLE_FRAMES;
+    options->sampleCount = DEFAULT_PATH_SAMPLES;
+    options->shadingQuality = SHADING_QUALITY_FULL;
+    options->depthPrepass = DEPTH_PREPASS_AUTO;
+    options->threadCount = 0;
+    options->gridColumns = 0;
+    options->gridRows = 0;
+    options->headless = false;
+    options->softwareRenderer = false;
+    options->instancing = true;
+    options->gpuCulling = true;
+    options->occlusionCulling = true;
+
+    bool sizeGiven = false;
+    bool framesGiven = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        // Options which take a value must not be the final argument
+        bool hasValue = i + 1 < argc;
+
+        if (!strcmp(argv[i], "--turntable") && hasValue)
+        {
+            options->mode = MODE_TURNTABLE;
+            options->outputPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--batch") && hasValue)
+        {
+            options->mode = MODE_BATCH;
+            options->batchSource = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--pathtrace") && hasValue)
+        {
+            options->mode = MODE_PATH_TRACE;
+            options->outputPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--samples") && hasValue)
+        {
+            options->sampleCount = atoi(argv[++i]);
+
+            if (options->sampleCount <= 0)
+                return false;
+        }
+        else if (!strcmp(argv[i], "--groups") && hasValue)
+            options->groupNames = argv[++i];
+        else if (!strcmp(argv[i], "--scene") && hasValue)
+            options->sceneFile = argv[++i];
+        else if (!strcmp(argv[i], "--instances") && hasValue)
+            options->instanceList = argv[++i];
+        else if (!strcmp(argv[i], "--grid") && hasValue)
+        {
+            if (!parseSize(argv[++i], &options->gridColumns, &options->gridRows))
+                return false;
+        }
+        else if (!strcmp(argv[i], "--output") && hasValue)
+            options->outputPath = argv[++i];
+        else if (!strcmp(argv[i], "--threads") && hasValue)
+        {
+            options->threadCount = atoi(argv[++i]);
+
+            if (options->threadCount <= 0)
+                return false;
+        }
+        else if (!strcmp(argv[i], "--frames") && hasValue)
+        {
+            options->frameCount = atoi(argv[++i]);
+
+            if (options->frameCount <= 0)
+                return false;
+
+            framesGiven = true;
+        }
+        else if (!strcmp(argv[i], "--size") && hasValue)
+        {
+            if (!parseSize(argv[++i], &options->width, &options->height))
+                return false;
+
+            sizeGiven = true;
+        }
+        else if (!strcmp(argv[i], "--quality") && hasValue)
+        {
+            if (!parseQuality(argv[++i], &options->shadingQuality))
+                return false;
+        }
+        else if (!strcmp(argv[i], "--prepass") && hasValue)
+        {
+            if (!parseDepthPrepass(argv[++i], &options->depthPrepass))
+                return false;
+        }
+        else if (!strcmp(argv[i], "--headless"))
+            options->headless = true;
+        else if (!strcmp(argv[i], "--software"))
+            options->softwareRenderer = true;
+        else if (!strcmp(argv[i], "--no-instancing"))
+            options->instancing = false;
+        else if (!strcmp(argv[i], "--cpu-culling"))
+            options->gpuCulling = false;
+        else if (!strcmp(argv[i], "--no-occlusion"))
+            options->occlusionCulling = false;
+        else if (argv[i][0] == '-')
+        {
+            printf("Unknown option: %s\n", argv[i]);
+            return false;
+        }
+        else
+            options->modelNames[options->modelCount++] = argv[i];
+    }
+
+    // The CPU renderers and the reloader only take the first model
+    if (options->modelCount > 0)
+        options->modelName = options->modelNames[0];
+
+    if (options->threadCount == 0)
+        options->threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (options->threadCount < 1)
+        options->threadCount = 1;
+
+    // A single image is written when an output is given without another mode
+    if (options->mode == MODE_INTERACTIVE && options->outputPath != NULL)
+    {
+        options->mode = MODE_IMAGE;
+        options->headless = true;
+
+        if (!framesGiven)
+            options->frameCount = 1;
+    }
+
+    // The path tracer only writes an image, so it never opens a window
+    if (options->mode == MODE_PATH_TRACE)
+        options->headless = true;
+
+    // Without a capture there is nothing to show in a hidden window
+    if (options->headless && options->mode == MODE_INTERACTIVE)
+        return false;
+
+    // The software renderer draws interactively or to a single image
+    if (options->softwareRenderer && options->mode != MODE_INTERACTIVE && options->mode != MODE_IMAGE)
+        return false;
+
+    if (options->mode == MODE_BATCH)
+    {
+        // Thumbnails are only written to disk, so there is no window to show
+        options->headless = true;
+
+        if (!sizeGiven)
+        {
+            options->width = DEFAULT_THUMBNAIL_SIZE;
+            options->height = DEFAULT_THUMBNAIL_SIZE;
+        }
+
+        return options->modelName == NULL && options->sceneFile == NULL && options->outputPath != NULL;
+    }
+
+    // Only OpenGL draws scenes, which may name all of their models themselves
+    if (options->sceneFile != NULL && !options->softwareRenderer && options->mode != MODE_PATH_TRACE)
+        return true;
+
+    return options->modelName != NULL && (options->modelCount == 1 || (!options->softwareRenderer && options->mode != MODE_PATH_TRACE));
+}
+
+void printUsage()
+{
+    printf("Usage: ./model-viewer <model>.obj [<model>.obj ...] [options]\n");
+    printf("       ./model-viewer --batch <directory|list.txt> --output <directory> [options]\n");
+    printf("  --turntable <out.y4m|out.png>  Record a 360 degree turntable as Y4M video or a PNG sequence\n");
+    printf("  --batch <directory|list.txt>   Render a thumbnail for every OBJ in a directory or list file\n");
+    printf("  --pathtrace <image.png>        Render a path traced reference image on the CPU\n");
+    printf("  --output <directory|image.png> Directory thumbnails are written to, or a single rendered image\n");
+    printf("  --groups <name,name,...>       Load only these groups, through an index written next to the model\n");
+    printf("  --scene <scene.txt>            Place models in a hierarchy, one \"name parent x y z axisX axisY axisZ degrees scale spin [model]\" a line\n");
+    printf("  --instances <list.txt>         Place copies of groups, one \"x y z axisX axisY axisZ degrees group\" a line\n");
+    printf("  --grid <columns>x<rows>        Repeat the model in a grid of instances, to benchmark draw throughput\n");
+    printf("  --no-instancing                Draw groups which repeat another group's geometry from their own corners\n");
+    printf("  --cpu-culling                  Cull groups on the CPU even where compute shaders could cull clusters\n");
+    printf("  --no-occlusion                 Draw parts hidden behind others in the last frame as well\n");
+    printf("  --threads <count>              Worker threads (default: one per core)\n");
+    printf("  --software                     Render on the CPU instead of OpenGL\n");
+    printf("  --frames <count>               Frames per revolution (default %d), or frames to time for an image\n", DEFAULT_TURNTABLE_FRAMES);
+    printf("  --samples <count>              Path traced samples per pixel (default %d)\n", DEFAULT_PATH_SAMPLES);
+    printf("  --size <width>x<height>        Capture resolution (default %dx%d, thumbnails %dx%d)\n",
+        DEFAULT_CAPTURE_WIDTH, DEFAULT_CAPTURE_HEIGHT, DEFAULT_THUMBNAIL_SIZE, DEFAULT_THUMBNAIL_SIZE);
+    printf("  --quality <full|auto|fast|flat>\n");
+    printf("                                 Per-pixel, Gouraud for dense meshes, Gouraud or flat shading\n");
+    printf("  --prepass <auto|on|off>        Draw depth before shading when overdraw is high, always or never\n");
+    printf("  --headless                     Render without showing a window\n");
+}
+
+// Private method(s)
+
+bool parseSize(char * argument, int * width, int * height)
+{
+    if (sscanf(argument, "%dx%d", width, height) != 2)
+        return false;
+
+    return *width > 0 && *height > 0;
+}
+
+bool parseQuality(char * argument, ShadingQuality * quality)
+{
+    if (!strcmp(argument, "full"))
+        *quality = SHADING_QUALITY_FULL;
+    else if (!strcmp(argument, "auto"))
+        *quality = SHADING_QUALITY_AUTO;
+    else if (!strcmp(argument, "fast"))
+        *quality = SHADING_QUALITY_FAST;
+    else if (!strcmp(argument, "flat"))
+        *quality = SHADING_QUALITY_FLAT;
+    else
+        return false;
+
+    return true;
+}
+
+bool parseDepthPrepass(char * argument, DepthPrepassMode * mode)
+{
+    if (!strcmp(argument, "auto"))
+        *mode = DEPTH_PREPASS_AUTO;
+    else if (!strcmp(argument, "on"))
+        *mode = DEPTH_PREPASS_ON;
+    else if (!strcmp(argument, "off"))
+        *mode = DEPTH_PREPASS_OFF;
+    else
+        return false;
+
+    return true;
+}
\ No newline at end of file
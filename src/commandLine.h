@@ -0,0 +1,55 @@
+#ifndef COMMAND_LINE
+#define COMMAND_LINE
+
+#include <stdbool.h>
+
+#include "graphics.h"
+
+typedef enum ApplicationMode
+{
+    MODE_INTERACTIVE,
+    MODE_TURNTABLE,
+    MODE_BATCH,
+    MODE_IMAGE,
+    MODE_PATH_TRACE
+}
+ApplicationMode;
+
+typedef struct ApplicationOptions
+{
+    ApplicationMode mode;
+    char * modelName;
+    char ** modelNames;
+    int modelCount;
+    char * sceneFile;
+    char * outputPath;
+    char * batchSource;
+    char * groupNames;
+    char * instanceList;
+    int width;
+    int height;
+    int frameCount;
+    int sampleCount;
+    ShadingQuality shadingQuality;
+    DepthPrepassMode depthPrepass;
+    int threadCount;
+    int gridColumns;
+    int gridRows;
+    bool headless;
+    bool softwareRenderer;
+    bool instancing;
+    bool gpuCulling;
+    bool occlusionCulling;
+}
+ApplicationOptions;
+
+// Public method(s)
+bool parseCommandLine(int argc, char * argv[], ApplicationOptions * options);
+void printUsage();
+
+// Private method(s)
+bool parseSize(char * argument, int * width, int * height);
+bool parseQuality(char * argument, ShadingQuality * quality);
+bool parseDepthPrepass(char * argument, DepthPrepassMode * mode);
+
+#endif
@@ -1,29 +1,316 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+#endif
 
 #include <glad/glad.h>
 
+#include "benchmark.h"
 #include "createShader.h"
 
+#define PROGRAM_CACHE_MAGIC 0x4D56504Bu
+#define SHADER_PROGRAM_CACHE_SIZE 32
+
+typedef struct ProgramCacheHeader
+{
+    unsigned int magic;
+    unsigned int binaryFormat;
+    int binaryLength;
+}
+ProgramCacheHeader;
+
+// Linked programs by source files and variant, built the first time used
+typedef struct ShaderProgramEntry
+{
+    char * vertexShaderPath;
+    char * fragmentShaderPath;
+    unsigned int variant;
+    unsigned int program;
+}
+ShaderProgramEntry;
 
 unsigned int shaderProgramID = 0;
 
+static ShaderProgramEntry shaderPrograms[SHADER_PROGRAM_CACHE_SIZE];
+static int shaderProgramCount = 0;
+static bool parallelCompileConfigured = false;
+
+static const char * variantDefines[] = {
+    "GOURAUD_SHADING",
+    "FLAT_SHADING",
+    "NO_SPECULAR",
+    "DEPTH_ONLY"
+};
+
 // Public method(s)
 
-unsigned int createShaderProgram(char * vertexShaderPath, char * fragmentShaderPath)
+/*
+    Returns the program for a combination of ShaderVariant flags, compiling
+    and linking it only the first time that combination is requested.
+*/
+unsigned int createShaderProgram(char * vertexShaderPath, char * fragmentShaderPath, unsigned int variant)
 {
+    for (int i = 0; i < shaderProgramCount; i++)
+    {
+        ShaderProgramEntry * entry = &shaderPrograms[i];
+
+        if (entry->variant == variant && !strcmp(entry->vertexShaderPath, vertexShaderPath) &&
+            !strcmp(entry->fragmentShaderPath, fragmentShaderPath))
+            return entry->program;
+    }
+
     char * vertexShaderSource = loadShaderFromFile(vertexShaderPath);
     char * fragmentShaderSource = loadShaderFromFile(fragmentShaderPath);
 
-    shaderProgramID = glCreateProgram();
+    if (vertexShaderSource == NULL || fragmentShaderSource == NULL)
+    {
+        free(vertexShaderSource);
+        free(fragmentShaderSource);
+        return 0;
+    }
 
-    // An OpenGL specific shader type must be specified
-    int vertexShader = compileAndAttachShader(vertexShaderSource, GL_VERTEX_SHADER);
-    int fragmentShader = compileAndAttachShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
+    char * vertexVariantSource = injectVariantDefines(vertexShaderSource, variant);
+    char * fragmentVariantSource = injectVariantDefines(fragmentShaderSource, variant);
+
+    unsigned int program = linkShaderProgram(vertexVariantSource, fragmentVariantSource);
 
     // Free memory allocation during loadShaderFromFile()
     free(vertexShaderSource);
     free(fragmentShaderSource);
+    free(vertexVariantSource);
+    free(fragmentVariantSource);
+
+    if (shaderProgramCount < SHADER_PROGRAM_CACHE_SIZE)
+    {
+        ShaderProgramEntry * entry = &shaderPrograms[shaderProgramCount++];
+        entry->vertexShaderPath = strdup(vertexShaderPath);
+        entry->fragmentShaderPath = strdup(fragmentShaderPath);
+        entry->variant = variant;
+        entry->program = program;
+    }
+
+    return program;
+}
+
+/*
+    Compiles and links a compute shader into a program of its own, which the
+    caller deletes. Returns 0 when the file cannot be read or the shader
+    fails to build.
+*/
+unsigned int createComputeProgram(char * computeShaderPath)
+{
+    char * computeShaderSource = loadShaderFromFile(computeShaderPath);
+
+    if (computeShaderSource == NULL)
+        return 0;
+
+    shaderProgramID = glCreateProgram();
+
+    int computeShader = compileAndAttachShader(computeShaderSource, GL_COMPUTE_SHADER);
+
+    glLinkProgram(shaderProgramID);
+    glDeleteShader(computeShader);
+    free(computeShaderSource);
+
+    int status;
+    glGetProgramiv(shaderProgramID, GL_LINK_STATUS, &status);
+
+    if (!status)
+    {
+        char linkStatus[512];
+        glGetProgramInfoLog(shaderProgramID, 512, NULL, linkStatus);
+        printf("Compute shader linking error: %s\n", linkStatus);
+        glDeleteProgram(shaderProgramID);
+        return 0;
+    }
+
+    return shaderProgramID;
+}
+
+void releaseShaderPrograms()
+{
+    for (int i = 0; i < shaderProgramCount; i++)
+    {
+        glDeleteProgram(shaderPrograms[i].program);
+        free(shaderPrograms[i].vertexShaderPath);
+        free(shaderPrograms[i].fragmentShaderPath);
+    }
+
+    shaderProgramCount = 0;
+}
+
+/*
+    Starts compiling and linking a new program for a variant from the current
+    files, without waiting for the driver. With KHR_parallel_shader_compile
+    the work happens on driver threads, otherwise it completes on first poll.
+*/
+bool beginShaderProgramRebuild(char * vertexShaderPath, char * fragmentShaderPath, unsigned int variant, PendingShaderProgram * pending)
+{
+    if (!parallelCompileConfigured)
+    {
+        // Let the driver choose how many compiler threads to use
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+        parallelCompileConfigured = true;
+    }
+
+    char * vertexShaderSource = loadShaderFromFile(vertexShaderPath);
+    char * fragmentShaderSource = loadShaderFromFile(fragmentShaderPath);
+
+    if (vertexShaderSource == NULL || fragmentShaderSource == NULL)
+    {
+        free(vertexShaderSource);
+        free(fragmentShaderSource);
+        return false;
+    }
+
+    char * vertexVariantSource = injectVariantDefines(vertexShaderSource, variant);
+    char * fragmentVariantSource = injectVariantDefines(fragmentShaderSource, variant);
+
+    pending->startTime = currentTime();
+    pending->variant = variant;
+    pending->vertexShaderPath = vertexShaderPath;
+    pending->fragmentShaderPath = fragmentShaderPath;
+    pending->cacheAvailable = programCachePath(pending->cachePath, sizeof(pending->cachePath),
+        hashShaderSources(vertexVariantSource, fragmentVariantSource));
+
+    pending->program = glCreateProgram();
+    glProgramParameteri(pending->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    pending->vertexShader = compileShaderAsync(vertexVariantSource, GL_VERTEX_SHADER);
+    pending->fragmentShader = compileShaderAsync(fragmentVariantSource, GL_FRAGMENT_SHADER);
+    glAttachShader(pending->program, pending->vertexShader);
+    glAttachShader(pending->program, pending->fragmentShader);
+    glLinkProgram(pending->program);
+
+    free(vertexShaderSource);
+    free(fragmentShaderSource);
+    free(vertexVariantSource);
+    free(fragmentVariantSource);
+
+    return true;
+}
+
+/*
+    Checks a rebuild without blocking while the driver reports it is still
+    compiling. A program which links replaces the cached one for its variant,
+    and the old program is deleted. A failed one, or one matching no cached
+    program, is discarded after printing why, leaving the old program in use.
+*/
+ShaderBuildStatus pollShaderProgramRebuild(PendingShaderProgram * pending)
+{
+    if (pending->program == 0)
+        return SHADER_BUILD_FAILED;
+
+    if (GLAD_GL_KHR_parallel_shader_compile)
+    {
+        int complete;
+        glGetProgramiv(pending->program, GL_COMPLETION_STATUS_KHR, &complete);
+
+        if (!complete)
+            return SHADER_BUILD_PENDING;
+    }
+
+    int status;
+    glGetProgramiv(pending->program, GL_LINK_STATUS, &status);
+
+    if (!status)
+    {
+        bool compiled = printShaderErrors(pending->vertexShader, "vertex");
+        compiled = printShaderErrors(pending->fragmentShader, "fragment") && compiled;
+
+        if (compiled)
+        {
+            char linkStatus[512];
+            glGetProgramInfoLog(pending->program, 512, NULL, linkStatus);
+            printf("Shader linking error: %s\n", linkStatus);
+        }
+
+        cancelShaderProgramRebuild(pending);
+        return SHADER_BUILD_FAILED;
+    }
+
+    glDeleteShader(pending->vertexShader);
+    glDeleteShader(pending->fragmentShader);
+
+    bool replaced = false;
+
+    for (int i = 0; i < shaderProgramCount; i++)
+    {
+        ShaderProgramEntry * entry = &shaderPrograms[i];
+
+        if (entry->variant == pending->variant && !strcmp(entry->vertexShaderPath, pending->vertexShaderPath) &&
+            !strcmp(entry->fragmentShaderPath, pending->fragmentShaderPath))
+        {
+            glDeleteProgram(entry->program);
+            entry->program = pending->program;
+            replaced = true;
+        }
+    }
+
+    // A program built for no cached variant would be used by nothing
+    if (!replaced)
+    {
+        printf("No shader program matches the rebuilt %s and %s\n", pending->vertexShaderPath, pending->fragmentShaderPath);
+        glDeleteProgram(pending->program);
+        pending->program = 0;
+        return SHADER_BUILD_FAILED;
+    }
+
+    if (pending->cacheAvailable)
+    {
+        shaderProgramID = pending->program;
+        saveProgramBinary(pending->cachePath);
+    }
+
+    return SHADER_BUILD_READY;
+}
+
+void cancelShaderProgramRebuild(PendingShaderProgram * pending)
+{
+    if (pending->program == 0)
+        return;
+
+    glDeleteShader(pending->vertexShader);
+    glDeleteShader(pending->fragmentShader);
+    glDeleteProgram(pending->program);
+
+    pending->program = 0;
+}
+
+// Private method(s)
+
+/*
+    Links the program from a cached binary when the driver accepts it, and
+    otherwise compiles the sources and caches the result for the next launch.
+    The cache key covers the driver strings, so a driver update invalidates it.
+*/
+unsigned int linkShaderProgram(char * vertexShaderSource, char * fragmentShaderSource)
+{
+    double startTime = currentTime();
+
+    char cachePath[PROGRAM_CACHE_PATH_LENGTH];
+    bool cacheAvailable = programCachePath(cachePath, sizeof(cachePath), hashShaderSources(vertexShaderSource, fragmentShaderSource));
+
+    shaderProgramID = glCreateProgram();
+
+    if (cacheAvailable && loadProgramBinary(cachePath))
+    {
+        printf("Shader program loaded from cache in %.3f ms\n", (currentTime() - startTime) * 1000.0);
+        return shaderProgramID;
+    }
+
+    glProgramParameteri(shaderProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    // An OpenGL specific shader type must be specified
+    int vertexShader = compileAndAttachShader(vertexShaderSource, GL_VERTEX_SHADER);
+    int fragmentShader = compileAndAttachShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
 
     glLinkProgram(shaderProgramID);
 
@@ -41,11 +328,14 @@ unsigned int createShaderProgram(char * vertexShaderPath, char * fragmentShaderP
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
+    printf("Shader program compiled in %.3f ms\n", (currentTime() - startTime) * 1000.0);
+
+    if (status && cacheAvailable)
+        saveProgramBinary(cachePath);
+
     return shaderProgramID;
 }
 
-// Private method(s)
-
 char * loadShaderFromFile(char * filePath)
 {
     FILE * input = fopen(filePath, "rb");
@@ -109,4 +399,241 @@ int compileAndAttachShader(char * shaderSource, unsigned int shaderType)
     glAttachShader(shaderProgramID, shaderID);
 
     return shaderID;
+}
+
+/*
+    64-bit FNV-1a over the driver strings and both sources. Each string is
+    hashed with its terminator so that moving text between them changes
+    the key.
+*/
+uint64_t hashShaderSources(char * vertexShaderSource, char * fragmentShaderSource)
+{
+    const char * strings[5] = {
+        (const char *)glGetString(GL_VENDOR),
+        (const char *)glGetString(GL_RENDERER),
+        (const char *)glGetString(GL_VERSION),
+        vertexShaderSource,
+        fragmentShaderSource
+    };
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (int i = 0; i < 5; i++)
+    {
+        const char * string = strings[i] != NULL ? strings[i] : "";
+
+        do
+        {
+            hash ^= (unsigned char)*string;
+            hash *= 0x100000001B3ull;
+        }
+        while (*string++ != '\0');
+    }
+
+    return hash;
+}
+
+/*
+    Builds the cache file path for a key, creating the cache directory under
+    LOCALAPPDATA on Windows, or XDG_CACHE_HOME (defaulting to ~/.cache)
+    elsewhere.
+*/
+bool programCachePath(char * cachePath, int cachePathLength, uint64_t key)
+{
+    char directory[PROGRAM_CACHE_PATH_LENGTH];
+    int length;
+
+#ifdef _WIN32
+    const char * base = getenv("LOCALAPPDATA");
+
+    if (base == NULL)
+        return false;
+
+    length = snprintf(directory, sizeof(directory), "%s/ModelViewer", base);
+#else
+    const char * base = getenv("XDG_CACHE_HOME");
+    const char * home = getenv("HOME");
+
+    char parent[PROGRAM_CACHE_PATH_LENGTH];
+
+    if (base != NULL && base[0] != '\0')
+        snprintf(parent, sizeof(parent), "%s", base);
+    else if (home != NULL)
+        snprintf(parent, sizeof(parent), "%s/.cache", home);
+    else
+        return false;
+
+    mkdir(parent, 0755);
+    length = snprintf(directory, sizeof(directory), "%s/model-viewer", parent);
+#endif
+
+    if (length <= 0 || length >= (int)sizeof(directory))
+        return false;
+
+#ifdef _WIN32
+    _mkdir(directory);
+#else
+    mkdir(directory, 0755);
+#endif
+
+    length = snprintf(cachePath, cachePathLength, "%s/program_%016llx.bin", directory, (unsigned long long)key);
+
+    return length > 0 && length < cachePathLength;
+}
+
+bool loadProgramBinary(char * cachePath)
+{
+    FILE * input = fopen(cachePath, "rb");
+
+    if (input == NULL)
+        return false;
+
+    fseek(input, 0, SEEK_END);
+    long fileSize = ftell(input);
+    fseek(input, 0, SEEK_SET);
+
+    ProgramCacheHeader header;
+    void * binary = NULL;
+    bool loaded = false;
+
+    // A length other than the rest of the file means a truncated or corrupt
+    // cache, which is compiled again before anything is allocated for it
+    if (fread(&header, sizeof(header), 1, input) == 1 && header.magic == PROGRAM_CACHE_MAGIC && header.binaryLength > 0 &&
+        header.binaryLength == fileSize - (long)sizeof(header))
+    {
+        binary = malloc(header.binaryLength);
+
+        if (binary != NULL && fread(binary, 1, header.binaryLength, input) == (size_t)header.binaryLength)
+        {
+            glProgramBinary(shaderProgramID, header.binaryFormat, binary, header.binaryLength);
+
+            int status;
+            glGetProgramiv(shaderProgramID, GL_LINK_STATUS, &status);
+            loaded = status;
+        }
+    }
+
+    free(binary);
+    fclose(input);
+
+    // Drivers may reject binaries from an older build, compile and replace it
+    if (!loaded)
+    {
+        printf("Shader cache rejected, compiling from source.\n");
+
+        glDeleteProgram(shaderProgramID);
+        shaderProgramID = glCreateProgram();
+    }
+
+    return loaded;
+}
+
+/*
+    Written to a temporary file and renamed into place, so a concurrent
+    launch never reads a partial binary.
+*/
+void saveProgramBinary(char * cachePath)
+{
+    int formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+    if (formatCount == 0)
+        return;
+
+    ProgramCacheHeader header;
+    header.magic = PROGRAM_CACHE_MAGIC;
+    glGetProgramiv(shaderProgramID, GL_PROGRAM_BINARY_LENGTH, &header.binaryLength);
+
+    if (header.binaryLength <= 0)
+        return;
+
+    void * binary = malloc(header.binaryLength);
+
+    if (binary == NULL)
+        return;
+
+    GLenum binaryFormat;
+    glGetProgramBinary(shaderProgramID, header.binaryLength, &header.binaryLength, &binaryFormat, binary);
+    header.binaryFormat = binaryFormat;
+
+    char temporaryPath[PROGRAM_CACHE_PATH_LENGTH + 8];
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", cachePath);
+
+    FILE * output = fopen(temporaryPath, "wb");
+
+    if (output != NULL)
+    {
+        bool written = fwrite(&header, sizeof(header), 1, output) == 1 &&
+            fwrite(binary, 1, header.binaryLength, output) == (size_t)header.binaryLength;
+
+        fclose(output);
+
+        if (!written || rename(temporaryPath, cachePath) != 0)
+            remove(temporaryPath);
+    }
+
+    free(binary);
+}
+
+/*
+    Copies the source with a #define for every flag in the variant inserted
+    after the #version line, which must stay the first statement.
+*/
+char * injectVariantDefines(char * shaderSource, unsigned int variant)
+{
+    char defines[256] = "";
+    int definesLength = 0;
+
+    for (int i = 0; i < (int)(sizeof(variantDefines) / sizeof(variantDefines[0])); i++)
+    {
+        if (variant & (1u << i))
+            definesLength += snprintf(defines + definesLength, sizeof(defines) - definesLength, "#define %s\n", variantDefines[i]);
+    }
+
+    char * versionLine = strstr(shaderSource, "#version");
+    char * insertAt = versionLine != NULL ? strchr(versionLine, '\n') : NULL;
+    insertAt = insertAt != NULL ? insertAt + 1 : shaderSource;
+
+    size_t sourceLength = strlen(shaderSource);
+    size_t prefixLength = insertAt - shaderSource;
+    char * variantSource = (char *)malloc(sourceLength + definesLength + 1);
+
+    memcpy(variantSource, shaderSource, prefixLength);
+    memcpy(variantSource + prefixLength, defines, definesLength);
+    memcpy(variantSource + prefixLength + definesLength, insertAt, sourceLength - prefixLength + 1);
+
+    return variantSource;
+}
+
+/*
+    Queues a compile without querying its status, since the query would wait
+    for the compiler to finish.
+*/
+unsigned int compileShaderAsync(char * shaderSource, unsigned int shaderType)
+{
+    unsigned int shaderID = glCreateShader(shaderType);
+
+    glShaderSource(shaderID, 1, (char const * const *)&shaderSource, NULL);
+    glCompileShader(shaderID);
+
+    return shaderID;
+}
+
+/*
+    Prints the compile log of a shader which failed. Returns whether it
+    compiled.
+*/
+bool printShaderErrors(unsigned int shaderID, char * stage)
+{
+    int status;
+    glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
+
+    if (!status)
+    {
+        char compilationStatus[512];
+        glGetShaderInfoLog(shaderID, 512, NULL, compilationStatus);
+        printf("Shader compilation error in %s shader: %s\n", stage, compilationStatus);
+    }
+
+    return status;
 }
\ No newline at end of file
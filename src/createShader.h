@@ -1,12 +1,65 @@
 #ifndef LOAD_SHADER
 #define LOAD_SHADER
 
+#include <stdbool.h>
+#include <stdint.h>
+
+// Flags combined to select a specialised program. Gouraud and flat shading
+// are alternatives to the default per-pixel lighting and are not combined.
+typedef enum ShaderVariant
+{
+    SHADER_VARIANT_DEFAULT = 0,
+    SHADER_VARIANT_GOURAUD = 1 << 0,
+    SHADER_VARIANT_FLAT = 1 << 1,
+    SHADER_VARIANT_NO_SPECULAR = 1 << 2,
+    SHADER_VARIANT_DEPTH_ONLY = 1 << 3
+}
+ShaderVariant;
+
+#define SHADER_VARIANT_COUNT 16
+#define PROGRAM_CACHE_PATH_LENGTH 1024
+
+typedef enum ShaderBuildStatus
+{
+    SHADER_BUILD_PENDING,
+    SHADER_BUILD_READY,
+    SHADER_BUILD_FAILED
+}
+ShaderBuildStatus;
+
+// A program rebuilt in the background, kept until its link has completed
+typedef struct PendingShaderProgram
+{
+    unsigned int program;
+    unsigned int vertexShader;
+    unsigned int fragmentShader;
+    unsigned int variant;
+    char * vertexShaderPath;
+    char * fragmentShaderPath;
+    char cachePath[PROGRAM_CACHE_PATH_LENGTH];
+    bool cacheAvailable;
+    double startTime;
+}
+PendingShaderProgram;
 
 // Public method(s)
-unsigned int createShaderProgram(char * vertexShaderPath, char * fragmentShaderPath);
+unsigned int createShaderProgram(char * vertexShaderPath, char * fragmentShaderPath, unsigned int variant);
+unsigned int createComputeProgram(char * computeShaderPath);
+void releaseShaderPrograms();
+bool beginShaderProgramRebuild(char * vertexShaderPath, char * fragmentShaderPath, unsigned int variant, PendingShaderProgram * pending);
+ShaderBuildStatus pollShaderProgramRebuild(PendingShaderProgram * pending);
+void cancelShaderProgramRebuild(PendingShaderProgram * pending);
 
 // Private method(s)
+unsigned int linkShaderProgram(char * vertexShaderSource, char * fragmentShaderSource);
 char * loadShaderFromFile(char * filePath);
 int compileAndAttachShader(char * shader, unsigned int shaderType);
+uint64_t hashShaderSources(char * vertexShaderSource, char * fragmentShaderSource);
+bool programCachePath(char * cachePath, int cachePathLength, uint64_t key);
+bool loadProgramBinary(char * cachePath);
+void saveProgramBinary(char * cachePath);
+char * injectVariantDefines(char * shaderSource, unsigned int variant);
+unsigned int compileShaderAsync(char * shaderSource, unsigned int shaderType);
+bool printShaderErrors(unsigned int shaderID, char * stage);
 
 #endif
\ No newline at end of file
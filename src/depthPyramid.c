@@ -0,0 +1,467 @@
+/******************************************************************************
+ * File:        depthPyramid.c
+ * Description: A hierarchical depth pyramid of the last frame, for culling
+ *              parts hidden behind others before they are drawn.
+ *              - At the end of each frame the depth buffer is copied, and
+ *                reduced into a mipmapped texture where each texel holds the
+ *                farthest depth of the texels below it. Level 0 is the
+ *                largest power of two size that fits the frame, so every
+ *                later level halves it exactly.
+ *              - A box is hidden when its nearest depth lies behind the
+ *                farthest depth everywhere it covers. On the level where the
+ *                box spans at most two texels a side, that takes four reads.
+ *              - The compute culling program samples the pyramid directly.
+ *                CPU tests use a small level read back into a ring of pixel
+ *                buffers, each mapped only once its fence has signalled, so
+ *                the GPU is never waited on.
+ * Notes:       Boxes are projected with the view the depth was drawn from,
+ *              so a part coming out from behind another as the view moves
+ *              may appear a frame or two late.
+ ******************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "createShader.h"
+#include "depthPyramid.h"
+#include "getGLErrors.h"
+
+static unsigned int program;
+static int sourceSizeLocation;
+static int targetSizeLocation;
+static unsigned int vertexArray;
+
+// The frame's depth copied into a texture, and the pyramid reduced from it
+static unsigned int copyFramebuffer;
+static unsigned int reduceFramebuffer;
+static unsigned int depthCopy;
+static int depthCopyFormat;
+static unsigned int pyramidTexture;
+static int sourceWidth;
+static int sourceHeight;
+static int pyramidWidth;
+static int pyramidHeight;
+static int levelCount;
+static bool pyramidReady;
+static mat4 pyramidViewProjection;
+
+// Read backs of readLevel in flight, and the last one collected
+static unsigned int readBuffers[DEPTH_PYRAMID_READ_COUNT];
+static GLsync readFences[DEPTH_PYRAMID_READ_COUNT];
+static mat4 readViewProjections[DEPTH_PYRAMID_READ_COUNT];
+static int readSlot;
+static int readLevel;
+static int readWidth;
+static int readHeight;
+static float *depths;
+static bool depthsReady;
+static mat4 depthsViewProjection;
+
+// Public method(s)
+
+bool initialiseDepthPyramid()
+{
+    program = createShaderProgram(DEPTH_PYRAMID_VERTEX_SHADER_PATH, DEPTH_PYRAMID_FRAGMENT_SHADER_PATH, SHADER_VARIANT_DEFAULT);
+
+    if (program == 0)
+        return false;
+
+    sourceSizeLocation = glGetUniformLocation(program, "sourceSize");
+    targetSizeLocation = glGetUniformLocation(program, "targetSize");
+
+    // The full screen triangle is made from vertex indices alone
+    glGenVertexArrays(1, &vertexArray);
+    glGenFramebuffers(1, &copyFramebuffer);
+    glGenFramebuffers(1, &reduceFramebuffer);
+    glGenTextures(1, &depthCopy);
+    glGenTextures(1, &pyramidTexture);
+    glGenBuffers(DEPTH_PYRAMID_READ_COUNT, readBuffers);
+    GET_GL_ERRORS();
+
+    sourceWidth = 0;
+    sourceHeight = 0;
+    depthCopyFormat = 0;
+    readSlot = 0;
+    pyramidReady = false;
+    depthsReady = false;
+
+    return true;
+}
+
+/*
+    Copies the depth of the frame just drawn, in the bound framebuffer's
+    viewport, and reduces it into the pyramid. The framebuffer, viewport
+    and texture unit 0 are left bound as they were, but the program is not.
+    viewProjection takes the scene's space to the frame's clip space.
+*/
+void buildDepthPyramid(mat4 viewProjection)
+{
+    int viewport[4];
+    int framebuffer;
+
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+    // A minimised window has nothing to copy
+    if (viewport[2] <= 0 || viewport[3] <= 0)
+        return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+
+    // Blits between depth buffers need the same format on both sides
+    int depthFormat = matchingDepthFormat(framebuffer);
+
+    if (viewport[2] != sourceWidth || viewport[3] != sourceHeight || depthFormat != depthCopyFormat)
+        resizeDepthPyramid(viewport[2], viewport[3], depthFormat);
+
+    // A multisampled depth buffer is resolved to one sample a pixel
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyFramebuffer);
+    glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+        0, 0, sourceWidth, sourceHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, reduceFramebuffer);
+    glUseProgram(program);
+    glBindVertexArray(vertexArray);
+
+    reduceDepthLevel(depthCopy, sourceWidth, sourceHeight, 0);
+
+    for (int level = 1; level < levelCount; level++)
+        reduceDepthLevel(pyramidTexture, pyramidWidth >> (level - 1) > 1 ? pyramidWidth >> (level - 1) : 1,
+            pyramidHeight >> (level - 1) > 1 ? pyramidHeight >> (level - 1) : 1, level);
+
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    readDepthLevel(viewProjection);
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    GET_GL_ERRORS();
+
+    glm_mat4_copy(viewProjection, pyramidViewProjection);
+    pyramidReady = true;
+}
+
+/*
+    Takes in the newest read back whose fence has signalled, without
+    waiting for the others. Returns whether boxOccluded has depths to test
+    against.
+*/
+bool collectDepthPyramid()
+{
+    // Reads complete in the order issued, oldest from the next slot written
+    for (int i = 0; i < DEPTH_PYRAMID_READ_COUNT; i++)
+    {
+        int slot = (readSlot + i) % DEPTH_PYRAMID_READ_COUNT;
+
+        if (readFences[slot] == NULL)
+            continue;
+
+        GLenum status = glClientWaitSync(readFences[slot], 0, 0);
+
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(readFences[slot]);
+        readFences[slot] = NULL;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers[slot]);
+        void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float) * readWidth * readHeight, GL_MAP_READ_BIT);
+
+        if (mapped != NULL)
+        {
+            memcpy(depths, mapped, sizeof(float) * readWidth * readHeight);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glm_mat4_copy(readViewProjections[slot], depthsViewProjection);
+            depthsReady = true;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    GET_GL_ERRORS();
+
+    return depthsReady;
+}
+
+/*
+    Whether the box, which transform takes into the scene's space, was
+    hidden in the last depth read back. Boxes reaching behind the camera,
+    and every box before the first read back, count as visible.
+*/
+bool boxOccluded(mat4 transform, float *boxMin, float *boxMax)
+{
+    if (!depthsReady)
+        return false;
+
+    mat4 boxToClip;
+    glm_mat4_mul(depthsViewProjection, transform, boxToClip);
+
+    float low[2] = {1.0f, 1.0f};
+    float high[2] = {0.0f, 0.0f};
+    float nearest = 1.0f;
+
+    for (int i = 0; i < 8; i++)
+    {
+        vec4 corner = {i & 1 ? boxMax[0] : boxMin[0], i & 2 ? boxMax[1] : boxMin[1], i & 4 ? boxMax[2] : boxMin[2], 1.0f};
+        vec4 clip;
+        glm_mat4_mulv(boxToClip, corner, clip);
+
+        if (clip[3] <= 0.0f || clip[2] < -clip[3])
+            return false;
+
+        for (int axis = 0; axis < 2; axis++)
+        {
+            float window = 0.5f * clip[axis] / clip[3] + 0.5f;
+            low[axis] = fminf(low[axis], window);
+            high[axis] = fmaxf(high[axis], window);
+        }
+
+        nearest = fminf(nearest, 0.5f * clip[2] / clip[3] + 0.5f);
+    }
+
+    // Boxes off the screen are left to the frustum tests
+    if (low[0] > 1.0f || low[1] > 1.0f || high[0] < 0.0f || high[1] < 0.0f)
+        return false;
+
+    int firstX = (int)(fmaxf(low[0], 0.0f) * readWidth);
+    int firstY = (int)(fmaxf(low[1], 0.0f) * readHeight);
+    int lastX = (int)(fminf(high[0], 1.0f) * readWidth);
+    int lastY = (int)(fminf(high[1], 1.0f) * readHeight);
+
+    firstX = firstX < readWidth ? firstX : readWidth - 1;
+    firstY = firstY < readHeight ? firstY : readHeight - 1;
+    lastX = lastX < readWidth ? lastX : readWidth - 1;
+    lastY = lastY < readHeight ? lastY : readHeight - 1;
+
+    for (int y = firstY; y <= lastY; y++)
+    {
+        for (int x = firstX; x <= lastX; x++)
+        {
+            if (depths[y * readWidth + x] + DEPTH_PYRAMID_BIAS >= nearest)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+    Binds the pyramid to the texture unit, leaving unit 0 active, and
+    copies the view it was drawn from. Returns its number of levels, or 0
+    before the first frame has been reduced.
+*/
+int bindDepthPyramid(unsigned int unit, mat4 viewProjection)
+{
+    if (!pyramidReady)
+        return 0;
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glm_mat4_copy(pyramidViewProjection, viewProjection);
+
+    return levelCount;
+}
+
+// Forgets the depth of frames drawn before the scene changed
+void invalidateDepthPyramid()
+{
+    pyramidReady = false;
+    depthsReady = false;
+    dropDepthReads();
+}
+
+void releaseDepthPyramid()
+{
+    dropDepthReads();
+
+    // The program belongs to the shader program cache
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteFramebuffers(1, &copyFramebuffer);
+    glDeleteFramebuffers(1, &reduceFramebuffer);
+    glDeleteTextures(1, &depthCopy);
+    glDeleteTextures(1, &pyramidTexture);
+    glDeleteBuffers(DEPTH_PYRAMID_READ_COUNT, readBuffers);
+
+    free(depths);
+    depths = NULL;
+    program = 0;
+    sourceWidth = 0;
+    sourceHeight = 0;
+    pyramidReady = false;
+    depthsReady = false;
+}
+
+// Private method(s)
+
+/*
+    Sizes the depth copy to the frame, and the pyramid and read backs to
+    match. Depths from before are dropped.
+*/
+void resizeDepthPyramid(int width, int height, int depthFormat)
+{
+    sourceWidth = width;
+    sourceHeight = height;
+    depthCopyFormat = depthFormat;
+    pyramidWidth = previousPowerOfTwo(width);
+    pyramidHeight = previousPowerOfTwo(height);
+
+    for (levelCount = 1; pyramidWidth >> (levelCount - 1) > 1 || pyramidHeight >> (levelCount - 1) > 1; levelCount++)
+        ;
+
+    bool stencil = depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8;
+    GLenum pixelType = depthFormat == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8 :
+        depthFormat == GL_DEPTH32F_STENCIL8 ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_FLOAT;
+
+    glBindTexture(GL_TEXTURE_2D, depthCopy);
+    glTexImage2D(GL_TEXTURE_2D, 0, depthFormat, width, height, 0, stencil ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT, pixelType, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, copyFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthCopy, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        printf("Depth pyramid copy framebuffer incomplete.\n");
+
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+
+    for (int level = 0; level < levelCount; level++)
+    {
+        int levelWidth = pyramidWidth >> level > 1 ? pyramidWidth >> level : 1;
+        int levelHeight = pyramidHeight >> level > 1 ? pyramidHeight >> level : 1;
+
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, NULL);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (readLevel = 0; pyramidWidth >> readLevel > DEPTH_PYRAMID_READ_WIDTH; readLevel++)
+        ;
+
+    readWidth = pyramidWidth >> readLevel > 1 ? pyramidWidth >> readLevel : 1;
+    readHeight = pyramidHeight >> readLevel > 1 ? pyramidHeight >> readLevel : 1;
+
+    for (int i = 0; i < DEPTH_PYRAMID_READ_COUNT; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float) * readWidth * readHeight, NULL, GL_STREAM_READ);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    GET_GL_ERRORS();
+
+    depths = (float *)realloc(depths, sizeof(float) * readWidth * readHeight);
+    invalidateDepthPyramid();
+}
+
+/*
+    The sized depth format of the framebuffer bound for reading, which the
+    depth copy must share for glBlitFramebuffer to copy into it.
+*/
+int matchingDepthFormat(int framebuffer)
+{
+    GLenum depthAttachment = framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+    GLenum stencilAttachment = framebuffer == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+    int depthBits = 24;
+    int componentType = GL_UNSIGNED_NORMALIZED;
+    int stencilType = GL_NONE;
+    int stencilBits = 0;
+
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, depthAttachment, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthBits);
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, depthAttachment, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &componentType);
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, stencilAttachment, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &stencilType);
+
+    if (stencilType != GL_NONE)
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, stencilAttachment, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+
+    if (stencilBits > 0)
+        return componentType == GL_FLOAT ? GL_DEPTH32F_STENCIL8 : GL_DEPTH24_STENCIL8;
+
+    if (componentType == GL_FLOAT)
+        return GL_DEPTH_COMPONENT32F;
+
+    return depthBits == 16 ? GL_DEPTH_COMPONENT16 : depthBits == 32 ? GL_DEPTH_COMPONENT32 : GL_DEPTH_COMPONENT24;
+}
+
+// Writes the farthest depth under each texel of the level into it
+void reduceDepthLevel(unsigned int source, int belowWidth, int belowHeight, int level)
+{
+    int width = pyramidWidth >> level > 1 ? pyramidWidth >> level : 1;
+    int height = pyramidHeight >> level > 1 ? pyramidHeight >> level : 1;
+
+    glBindTexture(GL_TEXTURE_2D, source);
+
+    // Only the level below may be read, as the level written is attached
+    if (source == pyramidTexture)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+    }
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, level);
+    glViewport(0, 0, width, height);
+    glUniform2i(sourceSizeLocation, belowWidth, belowHeight);
+    glUniform2i(targetSizeLocation, width, height);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// Starts reading the small level back into the next pixel buffer of the ring
+void readDepthLevel(mat4 viewProjection)
+{
+    int slot = readSlot;
+    readSlot = (readSlot + 1) % DEPTH_PYRAMID_READ_COUNT;
+
+    // A read never collected is replaced by this newer one
+    if (readFences[slot] != NULL)
+        glDeleteSync(readFences[slot]);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, readLevel);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffers[slot]);
+    glReadPixels(0, 0, readWidth, readHeight, GL_RED, GL_FLOAT, (void *)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glm_mat4_copy(viewProjection, readViewProjections[slot]);
+}
+
+void dropDepthReads()
+{
+    for (int i = 0; i < DEPTH_PYRAMID_READ_COUNT; i++)
+    {
+        if (readFences[i] != NULL)
+            glDeleteSync(readFences[i]);
+
+        readFences[i] = NULL;
+    }
+}
+
+// The largest power of two no greater than value, which is at least 1
+int previousPowerOfTwo(int value)
+{
+    int power = 1;
+
+    while (power * 2 <= value)
+        power *= 2;
+
+    return power;
+}
@@ -0,0 +1,42 @@
+#ifndef DEPTH_PYRAMID
+#define DEPTH_PYRAMID
+
+#include <stdbool.h>
+
+#include <cglm/cglm.h>
+
+#define DEPTH_PYRAMID_VERTEX_SHADER_PATH "src/res/shaders/pyramid.vertex.shader"
+#define DEPTH_PYRAMID_FRAGMENT_SHADER_PATH "src/res/shaders/pyramid.fragment.shader"
+
+// Texture unit the compute culling program reads the pyramid from, clear of
+// the diffuse maps on unit 0
+#define DEPTH_PYRAMID_TEXTURE_UNIT 1
+
+// Read backs for CPU tests use the first level at most this wide, and a
+// ring of this many pixel buffers so that none is mapped before it is read
+#define DEPTH_PYRAMID_READ_WIDTH 64
+#define DEPTH_PYRAMID_READ_COUNT 3
+
+// Boxes count as hidden only when they lie behind the stored depth by more
+// than this, so surfaces lying on their own box's face, whose stored depth
+// is rounded, never hide it
+#define DEPTH_PYRAMID_BIAS (1.0f / (1 << 20))
+
+// Public method(s)
+bool initialiseDepthPyramid();
+void buildDepthPyramid(mat4 viewProjection);
+bool collectDepthPyramid();
+bool boxOccluded(mat4 transform, float * boxMin, float * boxMax);
+int bindDepthPyramid(unsigned int unit, mat4 viewProjection);
+void invalidateDepthPyramid();
+void releaseDepthPyramid();
+
+// Private method(s)
+void resizeDepthPyramid(int width, int height, int depthFormat);
+int matchingDepthFormat(int framebuffer);
+void reduceDepthLevel(unsigned int source, int belowWidth, int belowHeight, int level);
+void readDepthLevel(mat4 viewProjection);
+void dropDepthReads();
+int previousPowerOfTwo(int value);
+
+#endif
@@ -0,0 +1,162 @@
+/******************************************************************************
+ * File:        fileWatcher.c
+ * Description: Reports when watched files are rewritten, without blocking
+ *              the caller, so the render loop can poll it every frame.
+ *              - On Linux the parent directory is watched with inotify, which
+ *                also sees editors that save by renaming a new file into
+ *                place and would otherwise drop a watch on the file itself.
+ *              - Elsewhere the modification time and size are compared on
+ *                every poll.
+ ******************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+#include "fileWatcher.h"
+
+static WatchedFile watchedFiles[FILE_WATCHER_MAX_FILES];
+static int watchedFileCount = 0;
+static int inotifyDescriptor = -1;
+
+// Public method(s)
+
+/*
+    Starts watching a file and returns the index used to query it, or -1
+    when it cannot be watched.
+*/
+int watchFile(char * filePath)
+{
+    if (watchedFileCount == FILE_WATCHER_MAX_FILES || strlen(filePath) >= FILE_WATCHER_PATH_LENGTH)
+        return -1;
+
+    WatchedFile * file = &watchedFiles[watchedFileCount];
+    strcpy(file->path, filePath);
+    file->changed = false;
+    file->watchDescriptor = -1;
+
+    readFileStatus(file->path, &file->modifiedTime, &file->fileSize);
+
+    char * separator = strrchr(file->path, '/');
+    file->name = separator != NULL ? separator + 1 : file->path;
+
+#ifdef __linux__
+    if (inotifyDescriptor == -1)
+        inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (inotifyDescriptor != -1)
+    {
+        char directory[FILE_WATCHER_PATH_LENGTH] = ".";
+
+        if (separator != NULL)
+            snprintf(directory, sizeof(directory), "%.*s", (int)(separator - file->path), file->path);
+
+        // Watching the same directory twice returns the same descriptor
+        file->watchDescriptor = inotify_add_watch(inotifyDescriptor, directory[0] != '\0' ? directory : "/", IN_CLOSE_WRITE | IN_MOVED_TO);
+
+        if (file->watchDescriptor == -1)
+            printf("Could not watch %s, falling back to polling.\n", filePath);
+    }
+#endif
+
+    return watchedFileCount++;
+}
+
+/*
+    Collects changes since the last poll. Never blocks.
+*/
+void pollFileWatcher()
+{
+#ifdef __linux__
+    if (inotifyDescriptor != -1)
+    {
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+
+        while ((length = read(inotifyDescriptor, events, sizeof(events))) > 0)
+        {
+            for (char * position = events; position < events + length;)
+            {
+                struct inotify_event * event = (struct inotify_event *)position;
+
+                for (int i = 0; i < watchedFileCount; i++)
+                {
+                    if (watchedFiles[i].watchDescriptor == event->wd && event->len > 0 && !strcmp(watchedFiles[i].name, event->name))
+                        watchedFiles[i].changed = true;
+                }
+
+                position += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+#endif
+
+    for (int i = 0; i < watchedFileCount; i++)
+    {
+        WatchedFile * file = &watchedFiles[i];
+
+        if (file->watchDescriptor != -1)
+            continue;
+
+        time_t modifiedTime;
+        long long fileSize;
+
+        if (readFileStatus(file->path, &modifiedTime, &fileSize) &&
+            (modifiedTime != file->modifiedTime || fileSize != file->fileSize))
+        {
+            file->modifiedTime = modifiedTime;
+            file->fileSize = fileSize;
+            file->changed = true;
+        }
+    }
+}
+
+/*
+    Returns whether the file changed since this was last called for it.
+*/
+bool consumeFileChange(int watchIndex)
+{
+    if (watchIndex < 0 || watchIndex >= watchedFileCount)
+        return false;
+
+    bool changed = watchedFiles[watchIndex].changed;
+    watchedFiles[watchIndex].changed = false;
+
+    return changed;
+}
+
+void releaseFileWatcher()
+{
+#ifdef __linux__
+    if (inotifyDescriptor != -1)
+        close(inotifyDescriptor);
+#endif
+
+    inotifyDescriptor = -1;
+    watchedFileCount = 0;
+}
+
+// Private method(s)
+
+bool readFileStatus(char * filePath, time_t * modifiedTime, long long * fileSize)
+{
+    struct stat status;
+
+    if (stat(filePath, &status) != 0)
+    {
+        *modifiedTime = 0;
+        *fileSize = -1;
+        return false;
+    }
+
+    *modifiedTime = status.st_mtime;
+    *fileSize = status.st_size;
+
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef FILE_WATCHER
+#define FILE_WATCHER
+
+#include <stdbool.h>
+#include <time.h>
+
+#define FILE_WATCHER_MAX_FILES 16
+#define FILE_WATCHER_PATH_LENGTH 1024
+
+typedef struct WatchedFile
+{
+    char path[FILE_WATCHER_PATH_LENGTH];
+    char * name;
+    int watchDescriptor;
+    time_t modifiedTime;
+    long long fileSize;
+    bool changed;
+}
+WatchedFile;
+
+// Public method(s)
+int watchFile(char * filePath);
+void pollFileWatcher();
+bool consumeFileChange(int watchIndex);
+void releaseFileWatcher();
+
+// Private method(s)
+bool readFileStatus(char * filePath, time_t * modifiedTime, long long * fileSize);
+
+#endif
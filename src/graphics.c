@@ -1,17 +1,133 @@
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <cglm/cglm.h>
 #include <glad/glad.h>
 
 #include "createShader.h"
+#include "depthPyramid.h"
+#include "fileWatcher.h"
+#include "benchmark.h"
+#include "clusterCulling.h"
 #include "getGLErrors.h"
 #include "graphics.h"
 #include "loadModel.h"
 #include "quaternion.h"
+#include "renderQueue.h"
+#include "sceneGraph.h"
+#include "sceneSettings.h"
+#include "textureLoader.h"
+
+#define VERTEX_SHADER_PATH "src/res/shaders/vertex.shader"
+#define FRAGMENT_SHADER_PATH "src/res/shaders/fragment.shader"
+#define POINT_VERTEX_SHADER_PATH "src/res/shaders/points.vertex.shader"
+#define POINT_FRAGMENT_SHADER_PATH "src/res/shaders/points.fragment.shader"
+
+// Reloaded meshes are compared and uploaded in chunks of this many floats
+#define MESH_UPDATE_CHUNK_FLOATS 16384
+
+// Corners in each buffer chunk. Every buffer stays well under 1 GB, which
+// drivers that cap single allocations accept, and the firsts and counts of
+// draws within a chunk fit a GLint.
+#define MESH_BUFFER_CHUNK_CORNERS (3 << 24)
+
+// Points in each point buffer, which are filled with whole chunks and so
+// stay under 1 GB as the mesh's buffers do
+#define POINT_BUFFER_MAX_POINTS (1 << 26)
+
+// Point chunks far enough away to be subsampled draw about this many points
+// for each pixel of the circle they cover on screen
+#define POINT_CLOUD_POINTS_PER_PIXEL 1.0f
+
+// First of the four attribute locations of an instance's transform columns
+#define INSTANCE_TRANSFORM_LOCATION 3
+
+// The element buffer starts with the elements 0 to this - 1, which draw
+// runs of corners up to this long from any base vertex
+#define RENDER_SEQUENCE_ELEMENTS (1 << 16)
+
+// Automatic quality uses Gouraud shading below this many pixels per triangle
+#define SHADING_AUTO_PIXELS_PER_TRIANGLE 4
+
+// Uniform buffer binding point of the Material block
+#define MATERIAL_BLOCK_BINDING 0
+
+// Automatic mode draws the depth pre-pass once more than this many
+// fragments are drawn for each pixel, and stops below the lower figure, so
+// it does not switch every frame near the limit
+#define DEPTH_PREPASS_OVERDRAW_ON 2.0f
+#define DEPTH_PREPASS_OVERDRAW_OFF 1.5f
+
+// Frames whose overdraw queries may be waiting on the GPU at once
+#define OVERDRAW_QUERY_COUNT 4
+
+static MeshBufferChunk *chunks;
+static int chunkCount;
+static unsigned int materialUBO;
+
+// Elements of the instanced groups' corners after the sequence, and the
+// transforms of the nodes and instances visible this frame
+static unsigned int elementBuffer;
+static unsigned int instanceBuffer;
+static InstancedDraw *instancedDraws;
+static int instancedDrawCount;
+static float *frameTransforms;
+static int frameTransformCount;
+static int frameTransformCapacity;
+static int *prototypeFirsts;
+static int *prototypeCounts;
+static float *prototypeDepths;
+static int *modelDrawStarts;
+
+// This frame's draws, submitted by indirect multi-draws where the context
+// has them and by base vertex multi-draws from transform runs otherwise
+static RenderQueue renderQueue;
+static bool indirectDraws;
+static unsigned int indirectBuffer;
+static IndirectDrawCommand *indirectCommands;
+static int indirectCapacity;
+static GLsizei *runCounts;
+static void **runIndices;
+static GLint *runBaseVertices;
+static int runCapacity;
+
+// Spans of clusters culled by the compute shader, where the context allows
+static ClusterCuller clusterCuller;
+static bool clusterCullingAllowed = true;
+static bool clusterCulling;
+static ClusterRun *clusterRuns;
+static int clusterRunCapacity;
+
+// Parts hidden in a recent frame's depth are skipped, and counted
+static bool occlusionCullingAllowed = true;
+static bool occlusionCulling;
+static bool occlusionReady;
+static OcclusionStatistics occlusionStatistics;
+
+// Depth pre-pass and the overdraw measured to decide on it
+static DepthPrepassMode depthPrepassMode = DEPTH_PREPASS_AUTO;
+static bool depthPrepass;
+static OverdrawQuery overdrawQueries[OVERDRAW_QUERY_COUNT];
+static int overdrawQueryNext;
+static OverdrawStatistics overdrawStatistics;
+
+static int materialStride;
+
+// Diffuse map of each material, white for materials without one
+static unsigned int whiteTexture;
+static unsigned int *materialTextures;
+static unsigned int *textures;
+static int textureCount;
+// Point cloud buffers, with the buffer of each point chunk and the chunk's
+// first point in it
+static PointBuffer *pointBuffers;
+static int pointBufferCount;
+static int *pointChunkBuffers;
+static int *pointChunkFirsts;
+static PointShaderUniforms pointShader;
 
-static unsigned int VBO;
-static unsigned int VAO;
-static unsigned int NBO;
 static mat4 proj;
 static mat4 view;
 static mat4 model;
@@ -19,138 +135,1824 @@ static mat4 mvp;
 static mat3 normalMatrix;
 static vec3 lightPosition;
 static vec3 lightColor;
-static vec3 modelColor;
 static vec3 cameraPosition;
 static ScreenSize *screenPtr;
-static float scale = 4.0;
-static float *vertices;
-static float *normals;
-static float reflectance;
-static int vertexCount = 36;
-static int shaderProgram;
-static int uniformLocationMVP;
-static int uniformLocationModel;
-static int uniformLocationLightPosition;
-static int uniformLocationLightColor;
-static int uniformLocationModelColor;
-static int uniformLocationModelReflectance;
-static int uniformLocationCameraPosition;
-static int uniformLocationNormalMatrix;
-
-void initialiseOpenGL(void *procAddressFunction, ScreenSize *screenSize, char *modelName)
-{
-    vertexCount = loadModel(modelName, &scale, &vertices, &normals);
+static Mesh mesh;
+static size_t bufferCapacity;
 
+// The models of the mesh placed in the scene, spinning from the start time
+// when the viewer is interactive
+static SceneGraph scene;
+static double sceneStartTime;
+static bool sceneAnimationAllowed = true;
+static bool *nodesDrawn;
+static int nodesDrawnCapacity;
+
+// Groups drawn this frame, after visibility and frustum culling
+static bool *groupsDrawn;
+static int groupsDrawnCapacity;
+static ShaderUniforms shaderVariants[SHADER_VARIANT_COUNT];
+static ShaderUniforms *activeShader;
+static ShadingQuality shadingQuality = SHADING_QUALITY_FULL;
+
+// Shader hot reload, rebuilt programs replace the old ones once linked
+static bool shaderWatchEnabled;
+static int vertexShaderWatch;
+static int fragmentShaderWatch;
+static PendingShaderProgram pendingShaders[SHADER_VARIANT_COUNT];
+
+void initialiseOpenGL(void *procAddressFunction, ScreenSize *screenSize, char **modelNames, int modelCount)
+{
     screenPtr = screenSize;
 
     if (!gladLoadGLLoader((GLADloadproc)procAddressFunction))
         printf("Failed to initialise GLAD.\n");
 
-    shaderProgram = createShaderProgram("src/res/shaders/vertex.shader", "src/res/shaders/fragment.shader");
-    glUseProgram(shaderProgram);
+    // Vertex buffers are created in chunks as models are uploaded, and every
+    // chunk's vertex array reads these two
+    glGenBuffers(1, &elementBuffer);
+    glGenBuffers(1, &instanceBuffer);
 
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    
-    // Setup positions
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertexCount, vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    GET_GL_ERRORS();
+    // Indirect draws pick each draw's transform with its base instance, both
+    // core from OpenGL 4.3 but available as extensions to the 4.1 context
+    indirectDraws = GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+
+    if (indirectDraws)
+        glGenBuffers(1, &indirectBuffer);
+
+    printf("Submitting draws with %s\n", indirectDraws ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex");
+
+    // Compute shaders need OpenGL 4.3, which contexts on macOS lack
+    clusterCulling = clusterCullingAllowed && indirectDraws && initialiseClusterCuller(&clusterCuller);
+    printf("Culling %s\n", clusterCulling ? "clusters on the GPU" : "groups on the CPU");
+
+    occlusionCulling = occlusionCullingAllowed && initialiseDepthPyramid();
+
+    if (occlusionCulling)
+        printf("Culling parts hidden in the last frame's depth\n");
 
-    // Setup Normals 
-    glGenBuffers(1, &NBO);
-    glBindBuffer(GL_ARRAY_BUFFER, NBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertexCount, normals, GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(1);
+    for (int i = 0; i < OVERDRAW_QUERY_COUNT; i++)
+    {
+        glGenQueries(1, &overdrawQueries[i].depthQuery);
+        glGenQueries(1, &overdrawQueries[i].shadingQuery);
+        overdrawQueries[i].pending = false;
+    }
+
+    overdrawQueryNext = 0;
+    depthPrepass = depthPrepassMode == DEPTH_PREPASS_ON;
+
+    // Each material occupies one aligned slot, bound as a range per draw
+    int uniformAlignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    materialStride = (sizeof(MaterialBlock) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    glGenBuffers(1, &materialUBO);
     GET_GL_ERRORS();
 
-    // Unbind VAO and buffers
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Sampled by materials without a diffuse map, leaving their colour as is
+    unsigned char whitePixel[4] = {255, 255, 255, 255};
+    glGenTextures(1, &whiteTexture);
+    glBindTexture(GL_TEXTURE_2D, whiteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, whitePixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
     GET_GL_ERRORS();
 
     glm_mat4_identity(model);
     glm_mat4_identity(view);
     glm_mat4_identity(proj);
 
-    glm_vec3_copy((vec3){0.0f, 0.0f, 10.0f}, cameraPosition);
-    glm_perspective(glm_rad(45.0f), screenPtr->width / screenPtr->height, 0.1, 100, proj);
-    glm_lookat(cameraPosition, (vec3){0, 0, 0}, (vec3){0, 1, 0}, view);
-    glm_translate(model, (vec3){0, 0, 0});
-    glm_scale(model, (vec3){scale, scale, scale});
+    glm_vec3_copy((vec3)SCENE_CAMERA_POSITION, cameraPosition);
+    glm_perspective(glm_rad(SCENE_FIELD_OF_VIEW), screenPtr->width / screenPtr->height, SCENE_NEAR_PLANE, SCENE_FAR_PLANE, proj);
+    glm_lookat(cameraPosition, (vec3)SCENE_CAMERA_TARGET, (vec3)SCENE_CAMERA_UP, view);
     glm_mat4_mulN((mat4 *[]){&proj, &view, &model}, 3, mvp);
 
     glm_mat4_pick3(model, normalMatrix);
     glm_mat3_inv(normalMatrix, normalMatrix);
     glm_mat3_transpose(normalMatrix);
 
-    glm_vec3_copy((vec3){0.5f, 0.5f, 0.5f}, modelColor);
-    glm_vec3_copy((vec3){0.8f, 0.1f, 0.2f}, lightColor);
-    glm_vec3_copy((vec3){5.0f, 5.0f, 10.0f}, lightPosition);
-
-    // Lower values yeild more reflectance. 80 = Medium reflectance
-    reflectance = 80.0;
-
-    uniformLocationMVP = glGetUniformLocation(shaderProgram, "MVP");
-    uniformLocationModel = glGetUniformLocation(shaderProgram, "model");
-    uniformLocationModelColor = glGetUniformLocation(shaderProgram, "modelColor");
-    uniformLocationModelReflectance = glGetUniformLocation(shaderProgram, "modelReflectance");
-    uniformLocationLightColor = glGetUniformLocation(shaderProgram, "lightColor");
-    uniformLocationLightPosition = glGetUniformLocation(shaderProgram, "lightPosition");
-    uniformLocationCameraPosition = glGetUniformLocation(shaderProgram, "cameraPosition");
-    uniformLocationNormalMatrix = glGetUniformLocation(shaderProgram, "normalMatrix");
-
-    glUniformMatrix4fv(uniformLocationMVP, 1, GL_FALSE, (float *)mvp);
-    glUniformMatrix4fv(uniformLocationModel, 1, GL_FALSE, (float *)model);
-    glUniformMatrix3fv(uniformLocationNormalMatrix, 1, GL_FALSE, (float *)normalMatrix);
-    glUniform3fv(uniformLocationModelColor, 1, (float *)modelColor);
-    glUniform3fv(uniformLocationLightColor, 1, (float *)lightColor);
-    glUniform3fv(uniformLocationLightPosition, 1, (float *)lightPosition);
-    glUniform3fv(uniformLocationCameraPosition, 1, (float *)cameraPosition);
-    glUniform1f(uniformLocationModelReflectance, reflectance);
-    GET_GL_ERRORS();
+    glm_vec3_copy((vec3)SCENE_LIGHT_COLOR, lightColor);
+    glm_vec3_copy((vec3)SCENE_LIGHT_POSITION, lightPosition);
+
+    activeShader = NULL;
+    useShaderVariantOpenGL(selectShaderVariantOpenGL());
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
     GET_GL_ERRORS();
+
+    sceneStartTime = currentTime();
+
+    // Batch rendering starts without a model and supplies them later
+    if (modelCount > 0)
+    {
+        Mesh loadedMesh;
+
+        if (loadScene(modelNames, modelCount, &scene, &loadedMesh))
+            installMeshOpenGL(&loadedMesh);
+    }
+}
+
+/*
+    Replaces the resident model, taking ownership of the mesh's memory. The
+    model matrix is reset so the new model is centred and scaled to fit, and
+    the scene becomes the new model alone.
+*/
+void setMeshOpenGL(Mesh *newMesh)
+{
+    installMeshOpenGL(newMesh);
+    createModelScene(&scene, &mesh);
+}
+
+// Uploads a mesh, whose models the scene already places, in place of the
+// resident one
+void installMeshOpenGL(Mesh *newMesh)
+{
+    releaseMesh(&mesh);
+    mesh = *newMesh;
+
+    uploadMeshChunksOpenGL(&mesh);
+    uploadElementsOpenGL(&mesh);
+    uploadPointBuffersOpenGL(&mesh);
+    enableVertexAttributesOpenGL();
+
+    if (clusterCulling)
+        uploadMeshClusters(&clusterCuller, &mesh, MESH_BUFFER_CHUNK_CORNERS);
+
+    if (occlusionCulling)
+        invalidateDepthPyramid();
+
+    uploadMaterialsOpenGL();
+    loadMaterialTexturesOpenGL();
+
+    // The loader has already scaled the model to fit the view
+    glm_mat4_identity(model);
+}
+
+/*
+    Replaces the resident model with a new version of the same file, taking
+    ownership of its memory. Only chunks which differ from the resident mesh
+    are uploaded, and the camera and model matrix are kept. Returns the
+    number of bytes uploaded.
+*/
+long long updateMeshOpenGL(Mesh *newMesh)
+{
+    long long uploaded;
+
+    if (newMesh->vertexCount > bufferCapacity || (newMesh->texcoords != NULL && mesh.texcoords == NULL) ||
+        (newMesh->normals != NULL && mesh.normals == NULL) || newMesh->pointCount > 0 || mesh.pointCount > 0 ||
+        newMesh->instanceCount > 0 || mesh.instanceCount > 0)
+    {
+        // The buffers must grow, or now hold texture coordinates or normals,
+        // so everything is uploaded again. Point clouds are regrouped into
+        // chunks on every load, and instanced meshes drop the corners of
+        // copies, so both are always uploaded whole.
+        uploaded = uploadMeshChunksOpenGL(newMesh) + uploadElementsOpenGL(newMesh) + uploadPointBuffersOpenGL(newMesh);
+    }
+    else
+    {
+        size_t oldCorners = mesh.vertexCount / 3;
+        size_t newCorners = newMesh->vertexCount / 3;
+        uploaded = 0;
+
+        // Each chunk compares the corners it holds in both versions
+        for (int i = 0; (size_t)i * MESH_BUFFER_CHUNK_CORNERS < newCorners; i++)
+        {
+            size_t first = (size_t)i * MESH_BUFFER_CHUNK_CORNERS;
+            size_t oldCount = meshChunkCorners(oldCorners, i);
+            size_t newCount = meshChunkCorners(newCorners, i);
+
+            uploaded += uploadChangedRangesOpenGL(chunks[i].VBO, &mesh.vertices[3 * first], 3 * oldCount, &newMesh->vertices[3 * first], 3 * newCount);
+
+            if (newMesh->normals != NULL)
+                uploaded += uploadChangedRangesOpenGL(chunks[i].NBO, &mesh.normals[3 * first], 3 * oldCount, &newMesh->normals[3 * first], 3 * newCount);
+
+            if (newMesh->texcoords != NULL)
+                uploaded += uploadChangedRangesOpenGL(chunks[i].UVBO, &mesh.texcoords[2 * first], 2 * oldCount, &newMesh->texcoords[2 * first], 2 * newCount);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GET_GL_ERRORS();
+    }
+
+    // Groups hidden by the user stay hidden in the new version of the file
+    for (int i = 0; i < newMesh->groupCount; i++)
+    {
+        int group = findGroup(&mesh, newMesh->groups[i].name);
+
+        if (group != -1)
+            newMesh->groups[i].visible = mesh.groups[group].visible;
+    }
+
+    // Textures are only decoded again when a diffuse map has changed
+    bool mapsChanged = newMesh->materialCount != mesh.materialCount;
+
+    for (int i = 0; i < newMesh->materialCount && !mapsChanged; i++)
+        mapsChanged = strcmp(newMesh->materials[i].diffuseMap, mesh.materials[i].diffuseMap) != 0;
+
+    releaseMesh(&mesh);
+    mesh = *newMesh;
+    refreshSceneModels(&scene, &mesh);
+
+    // Moved corners move the cluster spheres, so every cluster is bound again
+    if (clusterCulling)
+        uploaded += uploadMeshClusters(&clusterCuller, &mesh, MESH_BUFFER_CHUNK_CORNERS);
+
+    if (occlusionCulling)
+        invalidateDepthPyramid();
+
+    enableVertexAttributesOpenGL();
+    uploadMaterialsOpenGL();
+    uploaded += (long long)materialStride * mesh.materialCount;
+
+    if (mapsChanged)
+        loadMaterialTexturesOpenGL();
+
+    return uploaded;
 }
 
 void renderOpenGL()
 {
     // MVP is updated due to screensize changes impacting the projection matrix
-    glm_perspective(glm_rad(45.0f), screenPtr->width / screenPtr->height, 0.1, 100, proj);
+    glm_perspective(glm_rad(SCENE_FIELD_OF_VIEW), screenPtr->width / screenPtr->height, SCENE_NEAR_PLANE, SCENE_FAR_PLANE, proj);
     glm_mat4_mulN((mat4 *[]){&proj, &view, &model}, 3, mvp);
     glm_mat4_pick3(model, normalMatrix);
     glm_mat3_inv(normalMatrix, normalMatrix);
     glm_mat3_transpose(normalMatrix);
-    glUniformMatrix4fv(uniformLocationModel, 1, GL_FALSE, (float *)model);
-    glUniformMatrix4fv(uniformLocationMVP, 1, GL_FALSE, (float *)mvp);
-    glUniformMatrix3fv(uniformLocationNormalMatrix, 1, GL_FALSE, (float *)normalMatrix);
+
+    // Only the nodes spinning, and the nodes above them, are updated
+    if (sceneAnimationAllowed)
+        animateSceneGraph(&scene, currentTime() - sceneStartTime);
+
+    updateSceneGraph(&scene);
+
+    if (shaderWatchEnabled)
+        reloadShadersOpenGL();
+
+    useShaderVariantOpenGL(selectShaderVariantOpenGL());
+    glUniformMatrix4fv(activeShader->model, 1, GL_FALSE, (float *)model);
+    glUniformMatrix4fv(activeShader->MVP, 1, GL_FALSE, (float *)mvp);
+    glUniformMatrix3fv(activeShader->normalMatrix, 1, GL_FALSE, (float *)normalMatrix);
     
     GET_GL_ERRORS();
 
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    vec3 clearColor = SCENE_CLEAR_COLOR;
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.0f);
     GET_GL_ERRORS();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     GET_GL_ERRORS();
-    glBindVertexArray(VAO);
-    GET_GL_ERRORS();
 
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount / 3);
+    if (mesh.pointCount > 0)
+        drawPointChunksOpenGL();
+    else
+        drawSceneOpenGL();
+
+    // The next frames cull against this one's depth, and the mesh
+    // variants must be bound again after the pyramid's program
+    if (occlusionCulling && mesh.pointCount == 0)
+    {
+        buildDepthPyramid(mvp);
+        activeShader = NULL;
+    }
+
     GET_GL_ERRORS();
     glBindVertexArray(0);
     GET_GL_ERRORS();
 }
 
+/*
+    Waits for queued rendering to complete, so frame times include GPU work.
+*/
+void finishOpenGL()
+{
+    glFinish();
+}
+
 void releaseOpenGL()
 {
     // TODO is everything being free'd?
-    free(vertices);
-    free(normals);
+    releaseMesh(&mesh);
+    releaseSceneGraph(&scene);
+    resizeMeshChunksOpenGL(0);
+    uploadElementsOpenGL(&mesh);
+    releasePointBuffersOpenGL();
+    bufferCapacity = 0;
+    free(groupsDrawn);
+    free(nodesDrawn);
+    free(frameTransforms);
+    free(indirectCommands);
+    free(runCounts);
+    free(runIndices);
+    free(runBaseVertices);
+    free(clusterRuns);
+    groupsDrawn = NULL;
+    nodesDrawn = NULL;
+    frameTransforms = NULL;
+    indirectCommands = NULL;
+    runCounts = NULL;
+    runIndices = NULL;
+    runBaseVertices = NULL;
+    clusterRuns = NULL;
+    groupsDrawnCapacity = 0;
+    nodesDrawnCapacity = 0;
+    frameTransformCapacity = 0;
+    indirectCapacity = 0;
+    runCapacity = 0;
+    clusterRunCapacity = 0;
+    releaseRenderQueue(&renderQueue);
+
+    if (clusterCulling)
+        releaseClusterCuller(&clusterCuller);
+
+    if (occlusionCulling)
+        releaseDepthPyramid();
+
+    for (int i = 0; i < OVERDRAW_QUERY_COUNT; i++)
+    {
+        glDeleteQueries(1, &overdrawQueries[i].depthQuery);
+        glDeleteQueries(1, &overdrawQueries[i].shadingQuery);
+        overdrawQueries[i].pending = false;
+    }
+
+    glDeleteBuffers(1, &materialUBO);
+    glDeleteBuffers(1, &elementBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &indirectBuffer);
+    releaseMaterialTexturesOpenGL();
+    glDeleteTextures(1, &whiteTexture);
+
+    for (int i = 0; i < SHADER_VARIANT_COUNT; i++)
+        cancelShaderProgramRebuild(&pendingShaders[i]);
+
+    releaseShaderPrograms();
+
+    for (int i = 0; i < SHADER_VARIANT_COUNT; i++)
+        shaderVariants[i].program = 0;
+
+    pointShader.program = 0;
+}
+
+/*
+    Number keys toggle the first nine groups, and zero shows every group.
+*/
+void keyPressCallback(int key)
+{
+    if (key == '0')
+    {
+        for (int i = 0; i < mesh.groupCount; i++)
+            mesh.groups[i].visible = true;
+
+        printf("\rShowing all %d groups\n", mesh.groupCount);
+    }
+    else if (key >= '1' && key <= '9' && key - '1' < mesh.groupCount)
+    {
+        MeshGroup *group = &mesh.groups[key - '1'];
+        group->visible = !group->visible;
+
+        printf("\r%s group %s\n", group->visible ? "Showing" : "Hiding", group->name);
+    }
+}
+
+void setShadingQualityOpenGL(ShadingQuality quality)
+{
+    shadingQuality = quality;
+}
+
+// Whether clusters may be culled on the GPU, chosen before initialiseOpenGL
+void setClusterCullingOpenGL(bool allowed)
+{
+    clusterCullingAllowed = allowed;
+}
+
+// Whether scene nodes spin with the clock. Captures keep every node at its
+// placement, so their frames do not depend on how fast they render.
+void setSceneAnimationOpenGL(bool allowed)
+{
+    sceneAnimationAllowed = allowed;
+}
+
+// Whether hidden parts may be culled, chosen before initialiseOpenGL
+void setOcclusionCullingOpenGL(bool allowed)
+{
+    occlusionCullingAllowed = allowed;
+}
+
+/*
+    Boxes tested against the depth pyramid in the last frame, and those it
+    hid. Clusters culled on the GPU are counted once their cull has finished.
+*/
+OcclusionStatistics occlusionStatisticsOpenGL()
+{
+    return occlusionStatistics;
+}
+
+// Whether meshes are drawn with a depth pre-pass, or only when overdraw is high
+void setDepthPrepassOpenGL(DepthPrepassMode mode)
+{
+    depthPrepassMode = mode;
+    depthPrepass = mode == DEPTH_PREPASS_ON;
+}
+
+/*
+    Fragments shaded and drawn for each pixel in the last frame whose
+    queries have been read back, normally two or three frames ago.
+*/
+OverdrawStatistics overdrawStatisticsOpenGL()
+{
+    return overdrawStatistics;
+}
+
+/*
+    Rebuilds every compiled variant whenever a shader file is saved, while
+    the current programs keep drawing.
+*/
+void watchShadersOpenGL()
+{
+    vertexShaderWatch = watchFile(VERTEX_SHADER_PATH);
+    fragmentShaderWatch = watchFile(FRAGMENT_SHADER_PATH);
+    shaderWatchEnabled = true;
+}
+
+/*
+    Binds the program for a variant, building it and looking up its uniforms
+    the first time. Uniforms which never change are set once on creation.
+*/
+ShaderUniforms *useShaderVariantOpenGL(unsigned int variant)
+{
+    ShaderUniforms *shader = &shaderVariants[variant];
+
+    if (shader->program == 0)
+    {
+        shader->program = createShaderProgram(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH, variant);
+        initialiseShaderUniformsOpenGL(shader);
+    }
+    else if (shader != activeShader)
+        glUseProgram(shader->program);
+
+    activeShader = shader;
+
+    return shader;
+}
+
+/*
+    Queues the draws of each model node whose box, and whose ancestors'
+    boxes, are in the view frustum and not hidden in the depth pyramid,
+    sorts them and submits them. A node outside the view, or hidden, takes
+    every node below it out of the draw as well, since its box encloses
+    theirs. Nodes are stored after their parents, so
+    one pass in order settles every node.
+*/
+void drawSceneOpenGL()
+{
+    if (nodesDrawnCapacity < scene.nodeCount)
+    {
+        nodesDrawnCapacity = scene.nodeCount;
+        nodesDrawn = (bool *)realloc(nodesDrawn, sizeof(bool) * nodesDrawnCapacity);
+    }
+
+    if (groupsDrawnCapacity < mesh.groupCount)
+    {
+        groupsDrawnCapacity = mesh.groupCount;
+        groupsDrawn = (bool *)realloc(groupsDrawn, sizeof(bool) * groupsDrawnCapacity);
+    }
+
+    clearRenderQueue(&renderQueue);
+    frameTransformCount = 0;
+
+    occlusionReady = occlusionCulling && collectDepthPyramid();
+    occlusionStatistics.tested = 0;
+    occlusionStatistics.occluded = 0;
+
+    // Node boxes are in the scene's space, which the model matrix moves
+    vec4 planes[6];
+    mat4 sceneSpace = GLM_MAT4_IDENTITY_INIT;
+    glm_frustum_planes(mvp, planes);
+
+    for (int i = 0; i < scene.nodeCount; i++)
+    {
+        SceneNode *node = &scene.nodes[i];
+        nodesDrawn[i] = (node->parent == -1 || nodesDrawn[node->parent]) && boxInFrustum(planes, node->boundsMin, node->boundsMax) &&
+            !boxOccludedOpenGL(sceneSpace, node->boundsMin, node->boundsMax);
+
+        if (nodesDrawn[i] && node->model != -1 && node->model < mesh.modelCount)
+            queueModelDrawsOpenGL(node);
+    }
+
+    if (renderQueue.count == 0)
+        return;
+
+    sortRenderQueue(&renderQueue);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 16 * frameTransformCount, frameTransforms, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (indirectDraws)
+        prepareIndirectDrawsOpenGL();
+
+    drawQueuedPassesOpenGL();
+
+    GET_GL_ERRORS();
+}
+
+/*
+    Queues the node's visible batches, in pieces no longer than the element
+    sequence and within one chunk, and a draw of each instanced batch part
+    for all of the prototype's visible instances. Groups hidden by the user,
+    outside the view frustum or behind the depth pyramid are skipped. Each
+    draw is keyed by its depth from the camera, the nearest instance's for
+    instanced draws. With GPU culling, each span of the model's clusters is
+    queued whole instead, at the depth of the model's centre, for the
+    compute shader to cull.
+*/
+void queueModelDrawsOpenGL(SceneNode *node)
+{
+    MeshModel *drawModel = &mesh.models[node->model];
+    int program = activeShader - shaderVariants;
+    int transform = pushFrameTransformOpenGL(node->modelWorld);
+    mat4 nodeMVP;
+    mat4 nodeModelView;
+
+    glm_mat4_mul(mvp, node->modelWorld, nodeMVP);
+    glm_mat4_mulN((mat4 *[]){&view, &model, &node->modelWorld}, 3, nodeModelView);
+
+    // Planes from the node's MVP are in the same space as the group bounds
+    vec4 planes[6];
+    glm_frustum_planes(nodeMVP, planes);
+
+    if (clusterCulling)
+    {
+        float center[3];
+        glm_vec3_center(drawModel->boundsMin, drawModel->boundsMax, center);
+        float depth = viewDepth(nodeModelView, center);
+
+        for (int i = clusterCuller.modelSpanStarts[node->model]; i < clusterCuller.modelSpanStarts[node->model + 1]; i++)
+        {
+            ClusterSpan *span = &clusterCuller.spans[i];
+
+            RenderItem *item = pushRenderItem(&renderQueue);
+            item->key = renderSortKey(program, span->material, span->chunk, depth, transform, false);
+            item->firstElement = 0;
+            item->elementCount = 0;
+            item->baseVertex = 0;
+            item->instanceCount = 1;
+            item->firstInstance = transform;
+            item->material = span->material;
+            item->chunk = span->chunk;
+            item->firstCluster = span->firstCluster;
+            item->clusterCount = span->clusterCount;
+        }
+    }
+
+    for (int i = drawModel->firstGroup; i < drawModel->firstGroup + drawModel->groupCount && !clusterCulling; i++)
+    {
+        MeshGroup *group = &mesh.groups[i];
+        groupsDrawn[i] = group->visible && group->count > 0 && !group->instanced && sphereInFrustum(planes, group->center, group->radius) &&
+            !boxOccludedOpenGL(node->modelWorld, group->boundsMin, group->boundsMax);
+    }
+
+    for (int i = drawModel->firstBatch; i < drawModel->firstBatch + drawModel->batchCount && !clusterCulling; i++)
+    {
+        MeshBatch *batch = &mesh.batches[i];
+
+        if (!groupsDrawn[batch->group])
+            continue;
+
+        float depth = viewDepth(nodeModelView, mesh.groups[batch->group].center);
+
+        for (size_t first = batch->first, end = batch->first + batch->count; first < end;)
+        {
+            int chunk = first / MESH_BUFFER_CHUNK_CORNERS;
+            size_t chunkStart = (size_t)chunk * MESH_BUFFER_CHUNK_CORNERS;
+            size_t last = end < chunkStart + MESH_BUFFER_CHUNK_CORNERS ? end : chunkStart + MESH_BUFFER_CHUNK_CORNERS;
+
+            if (last - first > RENDER_SEQUENCE_ELEMENTS)
+                last = first + RENDER_SEQUENCE_ELEMENTS;
+
+            RenderItem *item = pushRenderItem(&renderQueue);
+            item->key = renderSortKey(program, batch->material, chunk, depth, transform, !indirectDraws);
+            item->firstElement = 0;
+            item->elementCount = last - first;
+            item->baseVertex = first - chunkStart;
+            item->instanceCount = 1;
+            item->firstInstance = transform;
+            item->material = batch->material;
+            item->chunk = chunk;
+            item->firstCluster = 0;
+            item->clusterCount = 0;
+
+            first = last;
+        }
+    }
+
+    if (modelDrawStarts == NULL || modelDrawStarts[node->model] == modelDrawStarts[node->model + 1])
+        return;
+
+    memset(&prototypeCounts[drawModel->firstGroup], 0, sizeof(int) * drawModel->groupCount);
+
+    // Instances are sorted by prototype, so each one's visible transforms
+    // are pushed as one run
+    for (int i = drawModel->firstInstance; i < drawModel->firstInstance + drawModel->instanceCount; i++)
+    {
+        MeshInstance *instance = &mesh.instances[i];
+
+        if (!mesh.groups[instance->group].visible || !sphereInFrustum(planes, instance->center, instance->radius))
+            continue;
+
+        float boxMin[3] = {instance->center[0] - instance->radius, instance->center[1] - instance->radius, instance->center[2] - instance->radius};
+        float boxMax[3] = {instance->center[0] + instance->radius, instance->center[1] + instance->radius, instance->center[2] + instance->radius};
+
+        if (boxOccludedOpenGL(node->modelWorld, boxMin, boxMax))
+            continue;
+
+        mat4 instanceWorld;
+        glm_mat4_mul(node->modelWorld, instance->transform, instanceWorld);
+
+        int slot = pushFrameTransformOpenGL(instanceWorld);
+        float depth = viewDepth(nodeModelView, instance->center);
+
+        if (prototypeCounts[instance->prototype]++ == 0)
+        {
+            prototypeFirsts[instance->prototype] = slot;
+            prototypeDepths[instance->prototype] = depth;
+        }
+        else
+            prototypeDepths[instance->prototype] = fminf(prototypeDepths[instance->prototype], depth);
+    }
+
+    for (int i = modelDrawStarts[node->model]; i < modelDrawStarts[node->model + 1]; i++)
+    {
+        InstancedDraw *draw = &instancedDraws[i];
+        int instanceCount = prototypeCounts[draw->prototype];
+
+        if (instanceCount == 0)
+            continue;
+
+        RenderItem *item = pushRenderItem(&renderQueue);
+        item->key = renderSortKey(program, draw->material, draw->chunk, prototypeDepths[draw->prototype], prototypeFirsts[draw->prototype], !indirectDraws);
+        item->firstElement = RENDER_SEQUENCE_ELEMENTS + draw->firstElement;
+        item->elementCount = draw->elementCount;
+        item->baseVertex = 0;
+        item->instanceCount = instanceCount;
+        item->firstInstance = prototypeFirsts[draw->prototype];
+        item->material = draw->material;
+        item->chunk = draw->chunk;
+        item->firstCluster = 0;
+        item->clusterCount = 0;
+    }
+}
+
+// Tests a box in view, which transform takes into the scene's space,
+// against the depth pyramid, counting the result
+bool boxOccludedOpenGL(mat4 transform, float *boxMin, float *boxMax)
+{
+    if (!occlusionReady)
+        return false;
+
+    bool occluded = boxOccluded(transform, boxMin, boxMax);
+
+    occlusionStatistics.tested++;
+    occlusionStatistics.occluded += occluded;
+
+    return occluded;
+}
+
+// Appends a transform to this frame's, returning its index
+int pushFrameTransformOpenGL(mat4 transform)
+{
+    if (frameTransformCount == frameTransformCapacity)
+    {
+        frameTransformCapacity = frameTransformCapacity ? 2 * frameTransformCapacity : 256;
+        frameTransforms = (float *)realloc(frameTransforms, sizeof(float) * 16 * frameTransformCapacity);
+    }
+
+    memcpy(&frameTransforms[16 * frameTransformCount], transform, sizeof(float) * 16);
+
+    return frameTransformCount++;
+}
+
+// Distance of a point in front of the camera, from 0 there to 1 at the far plane
+float viewDepth(mat4 modelView, float *point)
+{
+    float depth = -(modelView[0][2] * point[0] + modelView[1][2] * point[1] + modelView[2][2] * point[2] + modelView[3][2]);
+
+    return depth / SCENE_FAR_PLANE;
+}
+
+/*
+    Draws the queued draws, first into the depth buffer alone when the
+    pre-pass is on, so the shading pass runs the fragment shader only for
+    the nearest surface at each pixel. The samples passing the depth test
+    in each pass are counted whenever a query is free, and the overdraw
+    they show decides on the pre-pass in automatic mode.
+*/
+void drawQueuedPassesOpenGL()
+{
+    collectOverdrawOpenGL();
+
+    // Frames are only measured with a free query, never waiting on the GPU
+    OverdrawQuery *query = &overdrawQueries[overdrawQueryNext];
+    bool measured = !query->pending;
+
+    if (measured)
+    {
+        query->depthPrepass = depthPrepass;
+        query->samples = viewportSamplesOpenGL();
+    }
+
+    if (depthPrepass)
+    {
+        unsigned int shadingVariant = activeShader - shaderVariants;
+
+        useShaderVariantOpenGL(SHADER_VARIANT_DEPTH_ONLY);
+        glUniformMatrix4fv(activeShader->MVP, 1, GL_FALSE, (float *)mvp);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+        if (measured)
+            glBeginQuery(GL_SAMPLES_PASSED, query->depthQuery);
+
+        submitDrawsOpenGL(true);
+
+        if (measured)
+            glEndQuery(GL_SAMPLES_PASSED);
+
+        // Only fragments at the depth the pre-pass kept are shaded. Both
+        // variants compute positions identically, so theirs match exactly.
+        useShaderVariantOpenGL(shadingVariant);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    if (measured)
+        glBeginQuery(GL_SAMPLES_PASSED, query->shadingQuery);
+
+    submitDrawsOpenGL(false);
+
+    if (measured)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        query->pending = true;
+        overdrawQueryNext = (overdrawQueryNext + 1) % OVERDRAW_QUERY_COUNT;
+    }
+
+    if (depthPrepass)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+}
+
+// Submits the queued draws for the depth pre-pass or the shading pass
+void submitDrawsOpenGL(bool depthOnly)
+{
+    if (indirectDraws)
+        submitIndirectDrawsOpenGL(depthOnly);
+    else
+        submitBaseVertexDrawsOpenGL(depthOnly);
+}
+
+/*
+    Writes an indirect command for every queued draw and uploads them. Each
+    command's base instance points the transform attributes at its own
+    transforms, so draws of any node or prototype share a call. Spans of
+    clusters leave a command for each cluster, which the compute shader
+    writes before the draws read them, once for both passes.
+*/
+void prepareIndirectDrawsOpenGL()
+{
+    int commandCount = 0;
+
+    for (int i = 0; i < renderQueue.count; i++)
+        commandCount += renderQueue.items[i].clusterCount > 0 ? renderQueue.items[i].clusterCount : 1;
+
+    if (indirectCapacity < commandCount)
+    {
+        indirectCapacity = commandCount > renderQueue.capacity ? commandCount : renderQueue.capacity;
+        indirectCommands = (IndirectDrawCommand *)realloc(indirectCommands, sizeof(IndirectDrawCommand) * indirectCapacity);
+    }
+
+    if (clusterRunCapacity < renderQueue.count)
+    {
+        clusterRunCapacity = renderQueue.capacity;
+        clusterRuns = (ClusterRun *)realloc(clusterRuns, sizeof(ClusterRun) * clusterRunCapacity);
+    }
+
+    int runCount = 0;
+    int threadCount = 0;
+
+    for (int i = 0, next = 0; i < renderQueue.count; i++)
+    {
+        RenderItem *item = &renderQueue.items[i];
+
+        if (item->clusterCount > 0)
+        {
+            ClusterRun *run = &clusterRuns[runCount++];
+            run->firstThread = threadCount;
+            run->firstCluster = item->firstCluster;
+            run->clusterCount = item->clusterCount;
+            run->firstCommand = next;
+            run->transform = item->firstInstance;
+
+            threadCount += item->clusterCount;
+            next += item->clusterCount;
+            continue;
+        }
+
+        IndirectDrawCommand *command = &indirectCommands[next++];
+
+        command->count = item->elementCount;
+        command->instanceCount = item->instanceCount;
+        command->firstIndex = item->firstElement;
+        command->baseVertex = item->baseVertex;
+        command->baseInstance = item->firstInstance;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(IndirectDrawCommand) * commandCount, indirectCommands, GL_STREAM_DRAW);
+
+    if (runCount > 0)
+    {
+        // Cluster spheres are in the mesh's space, and their transforms
+        // take them into the scene's, as node boxes are
+        vec4 planes[6];
+        glm_frustum_planes(mvp, planes);
+
+        mat4 depthViewProjection = GLM_MAT4_IDENTITY_INIT;
+        int pyramidLevels = occlusionCulling ? bindDepthPyramid(DEPTH_PYRAMID_TEXTURE_UNIT, depthViewProjection) : 0;
+
+        cullClusters(&clusterCuller, &mesh, clusterRuns, runCount, threadCount, planes, depthViewProjection, pyramidLevels, instanceBuffer, indirectBuffer);
+        glUseProgram(activeShader->program);
+
+        occlusionStatistics.tested += clusterCuller.tested;
+        occlusionStatistics.occluded += clusterCuller.occluded;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/*
+    Submits each run of prepared commands sharing a material and chunk with
+    one glMultiDrawElementsIndirect. The depth pre-pass binds no materials,
+    so its runs only break between chunks.
+*/
+void submitIndirectDrawsOpenGL(bool depthOnly)
+{
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+
+    for (int first = 0, end, next = 0; first < renderQueue.count; first = end)
+    {
+        RenderItem *item = &renderQueue.items[first];
+        int drawCount = 0;
+
+        for (end = first; end < renderQueue.count; end++)
+        {
+            RenderItem *other = &renderQueue.items[end];
+
+            if ((other->material != item->material && !depthOnly) || other->chunk != item->chunk)
+                break;
+
+            drawCount += other->clusterCount > 0 ? other->clusterCount : 1;
+        }
+
+        if (depthOnly)
+            glBindVertexArray(chunks[item->chunk].depthVAO);
+        else
+        {
+            glBindVertexArray(chunks[item->chunk].VAO);
+            bindMaterialOpenGL(item->material);
+        }
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(sizeof(IndirectDrawCommand) * next), drawCount, 0);
+
+        next += drawCount;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/*
+    Submits each run of single instance draws sharing a material, chunk and
+    transform with one glMultiDrawElementsBaseVertex, and each instanced
+    draw with glDrawElementsInstancedBaseVertex. Without base instances in
+    OpenGL 4.1, the transform attributes are pointed at the run's transforms
+    before it is drawn, and keys put draws with the same transform together.
+    The depth pre-pass binds no materials, and draws through the chunks'
+    position only vertex arrays.
+*/
+void submitBaseVertexDrawsOpenGL(bool depthOnly)
+{
+    if (runCapacity < renderQueue.count)
+    {
+        runCapacity = renderQueue.capacity;
+        runCounts = (GLsizei *)realloc(runCounts, sizeof(GLsizei) * runCapacity);
+        runIndices = (void **)realloc(runIndices, sizeof(void *) * runCapacity);
+        runBaseVertices = (GLint *)realloc(runBaseVertices, sizeof(GLint) * runCapacity);
+    }
+
+    int boundChunk = -1;
+    int boundMaterial = -1;
+    int boundTransform = -1;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    for (int first = 0, end; first < renderQueue.count; first = end)
+    {
+        RenderItem *item = &renderQueue.items[first];
+        int runCount = 0;
+
+        for (end = first; end < renderQueue.count; end++)
+        {
+            RenderItem *next = &renderQueue.items[end];
+
+            if (end > first && (item->instanceCount > 1 || next->instanceCount > 1 || (next->material != item->material && !depthOnly) ||
+                next->chunk != item->chunk || next->firstInstance != item->firstInstance))
+                break;
+
+            runCounts[runCount] = next->elementCount;
+            runIndices[runCount] = (void *)(sizeof(GLuint) * next->firstElement);
+            runBaseVertices[runCount++] = next->baseVertex;
+        }
+
+        // Attribute pointers belong to the vertex array, so a new chunk
+        // needs them set again as well
+        if (item->chunk != boundChunk)
+        {
+            glBindVertexArray(depthOnly ? chunks[item->chunk].depthVAO : chunks[item->chunk].VAO);
+            boundChunk = item->chunk;
+            boundTransform = -1;
+        }
+
+        if (item->material != boundMaterial && !depthOnly)
+        {
+            bindMaterialOpenGL(item->material);
+            boundMaterial = item->material;
+        }
+
+        if (item->firstInstance != boundTransform)
+        {
+            size_t offset = sizeof(float) * 16 * item->firstInstance;
+
+            for (int column = 0; column < 4; column++)
+                glVertexAttribPointer(INSTANCE_TRANSFORM_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (void *)(offset + sizeof(float) * 4 * column));
+
+            boundTransform = item->firstInstance;
+        }
+
+        if (item->instanceCount > 1)
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, item->elementCount, GL_UNSIGNED_INT, runIndices[0], item->instanceCount, item->baseVertex);
+        else
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, runCounts, GL_UNSIGNED_INT, (const void * const *)runIndices, runCount, runBaseVertices);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+    Reads back the overdraw queries the GPU has finished, oldest first, and
+    in automatic mode turns the depth pre-pass on or off by the latest. The
+    pre-pass's own count is what the shading pass would draw without it.
+*/
+void collectOverdrawOpenGL()
+{
+    for (int i = 0; i < OVERDRAW_QUERY_COUNT; i++)
+    {
+        OverdrawQuery *query = &overdrawQueries[(overdrawQueryNext + i) % OVERDRAW_QUERY_COUNT];
+        GLuint available;
+
+        if (!query->pending)
+            continue;
+
+        // Queries finish in order, so none after this one is ready either
+        glGetQueryObjectuiv(query->shadingQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available)
+            break;
+
+        GLuint64 shaded;
+        GLuint64 drawn;
+        glGetQueryObjectui64v(query->shadingQuery, GL_QUERY_RESULT, &shaded);
+        drawn = shaded;
+
+        if (query->depthPrepass)
+            glGetQueryObjectui64v(query->depthQuery, GL_QUERY_RESULT, &drawn);
+
+        overdrawStatistics.shadedPerPixel = shaded / query->samples;
+        overdrawStatistics.drawnPerPixel = drawn / query->samples;
+        overdrawStatistics.depthPrepass = query->depthPrepass;
+        query->pending = false;
+    }
+
+    if (depthPrepassMode != DEPTH_PREPASS_AUTO)
+        return;
+
+    if (!depthPrepass && overdrawStatistics.drawnPerPixel > DEPTH_PREPASS_OVERDRAW_ON)
+    {
+        depthPrepass = true;
+        printf("\r%.2f fragments drawn per pixel, drawing a depth pre-pass\n", overdrawStatistics.drawnPerPixel);
+    }
+    else if (depthPrepass && overdrawStatistics.drawnPerPixel < DEPTH_PREPASS_OVERDRAW_OFF)
+    {
+        depthPrepass = false;
+        printf("\r%.2f fragments drawn per pixel, dropping the depth pre-pass\n", overdrawStatistics.drawnPerPixel);
+    }
+}
+
+// Samples in the viewport of the bound framebuffer, one for each pixel
+// unless it is multisampled
+float viewportSamplesOpenGL()
+{
+    int viewport[4];
+    int samples;
+
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_SAMPLES, &samples);
+
+    return (float)viewport[2] * viewport[3] * (samples > 1 ? samples : 1);
+}
+
+// Binds the material's slot of the uniform buffer and its diffuse map
+void bindMaterialOpenGL(int material)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, materialUBO, (GLintptr)material * materialStride, sizeof(MaterialBlock));
+    glBindTexture(GL_TEXTURE_2D, materialTextures != NULL && materialTextures[material] != 0 ? materialTextures[material] : whiteTexture);
+}
+
+/*
+    Creates or deletes buffer chunks until there are count of them. New
+    chunks have their vertex arrays' layouts set, with only positions, and
+    the transforms of instances, enabled.
+*/
+void resizeMeshChunksOpenGL(int count)
+{
+    for (int i = count; i < chunkCount; i++)
+    {
+        glDeleteVertexArrays(1, &chunks[i].VAO);
+        glDeleteVertexArrays(1, &chunks[i].depthVAO);
+        glDeleteBuffers(1, &chunks[i].VBO);
+        glDeleteBuffers(1, &chunks[i].NBO);
+        glDeleteBuffers(1, &chunks[i].UVBO);
+    }
+
+    if (count > chunkCount)
+        chunks = (MeshBufferChunk *)realloc(chunks, sizeof(MeshBufferChunk) * count);
+
+    for (int i = chunkCount; i < count; i++)
+    {
+        MeshBufferChunk *chunk = &chunks[i];
+
+        // Corners are read through the shared element buffer
+        glGenVertexArrays(1, &chunk->VAO);
+        glBindVertexArray(chunk->VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+        // Setup positions
+        glGenBuffers(1, &chunk->VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->VBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+
+        // Setup Normals, enabled only for models which have them
+        glGenBuffers(1, &chunk->NBO);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->NBO);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+
+        // Setup Texture Coordinates, enabled only for models which have them
+        glGenBuffers(1, &chunk->UVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->UVBO);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+
+        // The columns of a transform advance once per instance, and a draw's
+        // base instance, or the pointers' offset, picks its transforms
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+        for (int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(INSTANCE_TRANSFORM_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (void *)(sizeof(float) * 4 * column));
+            glEnableVertexAttribArray(INSTANCE_TRANSFORM_LOCATION + column);
+            glVertexAttribDivisor(INSTANCE_TRANSFORM_LOCATION + column, 1);
+        }
+
+        // The depth pre-pass reads the same positions and transforms, and
+        // never fetches normals or texture coordinates
+        glGenVertexArrays(1, &chunk->depthVAO);
+        glBindVertexArray(chunk->depthVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk->VBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+        for (int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(INSTANCE_TRANSFORM_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16, (void *)(sizeof(float) * 4 * column));
+            glEnableVertexAttribArray(INSTANCE_TRANSFORM_LOCATION + column);
+            glVertexAttribDivisor(INSTANCE_TRANSFORM_LOCATION + column, 1);
+        }
+    }
+
+    if (count == 0)
+    {
+        free(chunks);
+        chunks = NULL;
+    }
+
+    chunkCount = count;
+
+    // Unbind VAO and buffers
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    GET_GL_ERRORS();
+}
+
+/*
+    Splits a mesh's corners into as many buffer chunks as they need and
+    uploads every one of them. Returns the number of bytes uploaded.
+*/
+long long uploadMeshChunksOpenGL(Mesh *uploadMesh)
+{
+    size_t cornerCount = uploadMesh->vertexCount / 3;
+    long long uploaded = 0;
+
+    resizeMeshChunksOpenGL((cornerCount + MESH_BUFFER_CHUNK_CORNERS - 1) / MESH_BUFFER_CHUNK_CORNERS);
+
+    for (int i = 0; i < chunkCount; i++)
+    {
+        size_t first = (size_t)i * MESH_BUFFER_CHUNK_CORNERS;
+        size_t count = meshChunkCorners(cornerCount, i);
+        size_t normalBytes = uploadMesh->normals != NULL ? sizeof(GLfloat) * 3 * count : 0;
+        size_t textureBytes = uploadMesh->texcoords != NULL ? sizeof(GLfloat) * 2 * count : 0;
+
+        glBindBuffer(GL_ARRAY_BUFFER, chunks[i].VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * count, &uploadMesh->vertices[3 * first], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, chunks[i].NBO);
+        glBufferData(GL_ARRAY_BUFFER, normalBytes, normalBytes > 0 ? &uploadMesh->normals[3 * first] : NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, chunks[i].UVBO);
+        glBufferData(GL_ARRAY_BUFFER, textureBytes, textureBytes > 0 ? &uploadMesh->texcoords[2 * first] : NULL, GL_STATIC_DRAW);
+
+        uploaded += sizeof(GLfloat) * 3 * count + normalBytes + textureBytes;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GET_GL_ERRORS();
+
+    bufferCapacity = uploadMesh->vertexCount;
+
+    return uploaded;
+}
+
+// Number of a mesh's corners which fall in the given chunk
+size_t meshChunkCorners(size_t cornerCount, int chunk)
+{
+    size_t first = (size_t)chunk * MESH_BUFFER_CHUNK_CORNERS;
+
+    if (first >= cornerCount)
+        return 0;
+
+    return cornerCount - first < MESH_BUFFER_CHUNK_CORNERS ? cornerCount - first : MESH_BUFFER_CHUNK_CORNERS;
+}
+
+/*
+    Uploads the shared element buffer, the sequence every run of corners is
+    drawn through followed by the elements of the instanced groups. A draw
+    is listed for each part of an instanced group's batches within one
+    chunk, in batch order so each model's draws are a run. Returns the
+    number of bytes uploaded. The mesh chunks must already be sized for the
+    mesh.
+*/
+long long uploadElementsOpenGL(Mesh *uploadMesh)
+{
+    free(instancedDraws);
+    free(prototypeFirsts);
+    free(prototypeCounts);
+    free(prototypeDepths);
+    free(modelDrawStarts);
+    instancedDraws = NULL;
+    prototypeFirsts = NULL;
+    prototypeCounts = NULL;
+    prototypeDepths = NULL;
+    modelDrawStarts = NULL;
+    instancedDrawCount = 0;
+
+    if (uploadMesh->vertexCount == 0)
+        return 0;
+
+    size_t elementCount = RENDER_SEQUENCE_ELEMENTS;
+
+    for (int i = 0; i < uploadMesh->batchCount; i++)
+    {
+        if (uploadMesh->groups[uploadMesh->batches[i].group].instanced)
+            elementCount += uploadMesh->batches[i].count;
+    }
+
+    unsigned int *elements = (unsigned int *)malloc(sizeof(unsigned int) * elementCount);
+    size_t written = RENDER_SEQUENCE_ELEMENTS;
+
+    for (unsigned int i = 0; i < RENDER_SEQUENCE_ELEMENTS; i++)
+        elements[i] = i;
+
+    // Splitting at chunk ends adds at most one draw for each chunk
+    if (uploadMesh->instanceCount > 0)
+        instancedDraws = (InstancedDraw *)malloc(sizeof(InstancedDraw) * (uploadMesh->batchCount + chunkCount));
+
+    for (int i = 0; i < uploadMesh->batchCount && uploadMesh->instanceCount > 0; i++)
+    {
+        MeshBatch *batch = &uploadMesh->batches[i];
+
+        if (!uploadMesh->groups[batch->group].instanced)
+            continue;
+
+        for (size_t first = batch->first, end = batch->first + batch->count; first < end;)
+        {
+            int chunk = first / MESH_BUFFER_CHUNK_CORNERS;
+            size_t chunkStart = (size_t)chunk * MESH_BUFFER_CHUNK_CORNERS;
+            size_t last = end < chunkStart + MESH_BUFFER_CHUNK_CORNERS ? end : chunkStart + MESH_BUFFER_CHUNK_CORNERS;
+            InstancedDraw *draw = &instancedDraws[instancedDrawCount++];
+
+            draw->firstElement = written - RENDER_SEQUENCE_ELEMENTS;
+            draw->elementCount = last - first;
+            draw->prototype = batch->group;
+            draw->material = batch->material;
+            draw->chunk = chunk;
+
+            weldCorners(uploadMesh, first, last - first, chunkStart, &elements[written]);
+            written += last - first;
+            first = last;
+        }
+    }
+
+    // Element buffers are only bound through a vertex array, so the data is
+    // written through the array buffer target, which any buffer accepts
+    glBindBuffer(GL_ARRAY_BUFFER, elementBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * elementCount, elements, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GET_GL_ERRORS();
+
+    free(elements);
+
+    if (uploadMesh->instanceCount == 0)
+        return sizeof(GLuint) * elementCount;
+
+    prototypeFirsts = (int *)malloc(sizeof(int) * uploadMesh->groupCount);
+    prototypeCounts = (int *)malloc(sizeof(int) * uploadMesh->groupCount);
+    prototypeDepths = (float *)malloc(sizeof(float) * uploadMesh->groupCount);
+
+    // Models own runs of groups in order, so their draws are runs as well
+    modelDrawStarts = (int *)malloc(sizeof(int) * (uploadMesh->modelCount + 1));
+
+    for (int i = 0, draw = 0; i <= uploadMesh->modelCount; i++)
+    {
+        int groupEnd = i < uploadMesh->modelCount ? uploadMesh->models[i].firstGroup : uploadMesh->groupCount;
+
+        while(draw < instancedDrawCount && instancedDraws[draw].prototype < groupEnd)
+            draw++;
+
+        modelDrawStarts[i] = draw;
+    }
+
+    return sizeof(GLuint) * elementCount;
+}
+
+/*
+    Writes the chunk relative elements of count corners from first. Corners
+    equal in position, normal and texture coordinates share the element of
+    the first of them, so the vertex cache can reuse their results for every
+    instance drawn.
+*/
+void weldCorners(Mesh *weldMesh, size_t first, size_t count, size_t chunkStart, unsigned int *elements)
+{
+    size_t tableSize = 1;
+
+    while(tableSize < 2 * count)
+        tableSize *= 2;
+
+    // Open addressing, holding the first corner seen with each key
+    size_t *table = (size_t *)malloc(sizeof(size_t) * tableSize);
+    memset(table, 0xFF, sizeof(size_t) * tableSize);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float key[8];
+        int keyLength = cornerKey(weldMesh, first + i, key);
+
+        // FNV-1a over the bytes of the key
+        unsigned int hash = 2166136261u;
+        unsigned char *bytes = (unsigned char *)key;
+
+        for (size_t byte = 0; byte < sizeof(float) * keyLength; byte++)
+            hash = (hash ^ bytes[byte]) * 16777619u;
+
+        size_t slot = hash & (tableSize - 1);
+        size_t corner = first + i;
+
+        while(table[slot] != (size_t)-1)
+        {
+            float other[8];
+            cornerKey(weldMesh, table[slot], other);
+
+            if (!memcmp(key, other, sizeof(float) * keyLength))
+            {
+                corner = table[slot];
+                break;
+            }
+
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (corner == first + i)
+            table[slot] = corner;
+
+        elements[i] = corner - chunkStart;
+    }
+
+    free(table);
+}
+
+// Copies what a corner is drawn with into key, and returns its length
+int cornerKey(Mesh *keyMesh, size_t corner, float *key)
+{
+    int length = 3;
+    memcpy(key, &keyMesh->vertices[3 * corner], sizeof(float) * 3);
+
+    if (keyMesh->normals != NULL)
+    {
+        memcpy(&key[length], &keyMesh->normals[3 * corner], sizeof(float) * 3);
+        length += 3;
+    }
+
+    if (keyMesh->texcoords != NULL)
+    {
+        memcpy(&key[length], &keyMesh->texcoords[2 * corner], sizeof(float) * 2);
+        length += 2;
+    }
+
+    return length;
+}
+
+/*
+    Draws the point cloud one chunk at a time, skipping chunks outside the
+    view frustum. Chunks far enough away that their points would crowd
+    together draw only the first part of their shuffled points, with each
+    point grown so the subsample covers the same area.
+*/
+void drawPointChunksOpenGL()
+{
+    if (pointShader.program == 0)
+    {
+        pointShader.program = createShaderProgram(POINT_VERTEX_SHADER_PATH, POINT_FRAGMENT_SHADER_PATH, SHADER_VARIANT_DEFAULT);
+        pointShader.MVP = glGetUniformLocation(pointShader.program, "MVP");
+        pointShader.chunkOrigin = glGetUniformLocation(pointShader.program, "chunkOrigin");
+        pointShader.chunkExtent = glGetUniformLocation(pointShader.program, "chunkExtent");
+        pointShader.pointScale = glGetUniformLocation(pointShader.program, "pointScale");
+    }
+
+    // The mesh variants must be bound again after this program
+    glUseProgram(pointShader.program);
+    glUniformMatrix4fv(pointShader.MVP, 1, GL_FALSE, (float *)mvp);
+    activeShader = NULL;
+
+    // Planes from the full MVP are in the same space as the chunk bounds
+    vec4 planes[6];
+    glm_frustum_planes(mvp, planes);
+
+    // Model units to pixels one unit in front of the camera, after zooming
+    float modelScale = glm_vec3_norm(model[0]);
+    float pixelScale = proj[1][1] * screenPtr->height / 2.0f * modelScale;
+    int boundBuffer = -1;
+
+    for (int i = 0; i < mesh.pointChunkCount; i++)
+    {
+        PointChunk *chunk = &mesh.pointChunks[i];
+
+        if (!sphereInFrustum(planes, chunk->center, chunk->radius))
+            continue;
+
+        size_t drawCount = pointChunkDrawCount(chunk, modelScale, pixelScale);
+
+        if (pointChunkBuffers[i] != boundBuffer)
+        {
+            boundBuffer = pointChunkBuffers[i];
+            glBindVertexArray(pointBuffers[boundBuffer].VAO);
+        }
+
+        glUniform3fv(pointShader.chunkOrigin, 1, chunk->origin);
+        glUniform3fv(pointShader.chunkExtent, 1, chunk->extent);
+        glUniform1f(pointShader.pointScale, chunk->spacing * pixelScale * sqrtf((float)chunk->count / drawCount));
+        glDrawArrays(GL_POINTS, pointChunkFirsts[i], drawCount);
+    }
+}
+
+/*
+    Number of a chunk's points to draw, about POINT_CLOUD_POINTS_PER_PIXEL
+    for each pixel of its bounding circle on screen. Chunks the camera is
+    close to or inside draw every point.
+*/
+size_t pointChunkDrawCount(PointChunk *chunk, float modelScale, float pixelScale)
+{
+    // Distance in front of the camera, the w of the centre's clip position
+    float depth = mvp[0][3] * chunk->center[0] + mvp[1][3] * chunk->center[1] + mvp[2][3] * chunk->center[2] + mvp[3][3];
+
+    if (depth <= chunk->radius * modelScale)
+        return chunk->count;
+
+    float projectedRadius = chunk->radius * pixelScale / depth;
+    float budget = GLM_PIf * projectedRadius * projectedRadius * POINT_CLOUD_POINTS_PER_PIXEL;
+
+    if (budget >= chunk->count)
+        return chunk->count;
+
+    return budget > 1.0f ? (size_t)budget : 1;
+}
+
+/*
+    Packs the point chunks into as few buffers as hold them, whole chunks to
+    a buffer, and uploads them. Positions are read as normalised unsigned
+    shorts and scaled over each chunk's box in the shader. Returns the
+    number of bytes uploaded.
+*/
+long long uploadPointBuffersOpenGL(Mesh *uploadMesh)
+{
+    releasePointBuffersOpenGL();
+
+    if (uploadMesh->pointCount == 0)
+        return 0;
+
+    pointChunkBuffers = (int *)malloc(sizeof(int) * uploadMesh->pointChunkCount);
+    pointChunkFirsts = (int *)malloc(sizeof(int) * uploadMesh->pointChunkCount);
+    size_t bufferFirst = 0;
+
+    // Chunks are stored one after another, so each buffer holds a run of them
+    for (int i = 0; i < uploadMesh->pointChunkCount; i++)
+    {
+        PointChunk *chunk = &uploadMesh->pointChunks[i];
+
+        if (pointBufferCount == 0 || chunk->first + chunk->count - bufferFirst > POINT_BUFFER_MAX_POINTS)
+        {
+            bufferFirst = chunk->first;
+            pointBufferCount++;
+        }
+
+        pointChunkBuffers[i] = pointBufferCount - 1;
+        pointChunkFirsts[i] = chunk->first - bufferFirst;
+    }
+
+    pointBuffers = (PointBuffer *)malloc(sizeof(PointBuffer) * pointBufferCount);
+    long long uploaded = 0;
+
+    for (int i = 0, chunk = 0; i < pointBufferCount; i++)
+    {
+        size_t first = uploadMesh->pointChunks[chunk].first;
+        size_t end = first;
+
+        for (; chunk < uploadMesh->pointChunkCount && pointChunkBuffers[chunk] == i; chunk++)
+            end = uploadMesh->pointChunks[chunk].first + uploadMesh->pointChunks[chunk].count;
+
+        glGenVertexArrays(1, &pointBuffers[i].VAO);
+        glBindVertexArray(pointBuffers[i].VAO);
+
+        glGenBuffers(1, &pointBuffers[i].VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, pointBuffers[i].VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(PointVertex) * (end - first), &uploadMesh->points[first], GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PointVertex), (void *)offsetof(PointVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PointVertex), (void *)offsetof(PointVertex, color));
+        glEnableVertexAttribArray(1);
+
+        uploaded += sizeof(PointVertex) * (end - first);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    GET_GL_ERRORS();
+
+    return uploaded;
+}
+
+void releasePointBuffersOpenGL()
+{
+    for (int i = 0; i < pointBufferCount; i++)
+    {
+        glDeleteVertexArrays(1, &pointBuffers[i].VAO);
+        glDeleteBuffers(1, &pointBuffers[i].VBO);
+    }
+
+    free(pointBuffers);
+    free(pointChunkBuffers);
+    free(pointChunkFirsts);
+    pointBuffers = NULL;
+    pointChunkBuffers = NULL;
+    pointChunkFirsts = NULL;
+    pointBufferCount = 0;
+}
+
+/*
+    Loads the diffuse map of every material, decoding each image file once
+    however many materials share it. Models without texture coordinates
+    keep the white texture, since nothing would place their maps.
+*/
+void loadMaterialTexturesOpenGL()
+{
+    releaseMaterialTexturesOpenGL();
+
+    if (mesh.texcoords == NULL || mesh.materialCount == 0)
+        return;
+
+    char **paths = (char **)malloc(sizeof(char *) * mesh.materialCount);
+    int *pathIndices = (int *)malloc(sizeof(int) * mesh.materialCount);
+    int pathCount = 0;
+
+    for (int i = 0; i < mesh.materialCount; i++)
+    {
+        pathIndices[i] = -1;
+
+        if (mesh.materials[i].diffuseMap[0] == '\0')
+            continue;
+
+        for (int j = 0; j < pathCount && pathIndices[i] == -1; j++)
+        {
+            if (!strcmp(paths[j], mesh.materials[i].diffuseMap))
+                pathIndices[i] = j;
+        }
+
+        if (pathIndices[i] == -1)
+        {
+            pathIndices[i] = pathCount;
+            paths[pathCount++] = mesh.materials[i].diffuseMap;
+        }
+    }
+
+    textures = (unsigned int *)calloc(pathCount + 1, sizeof(unsigned int));
+    textureCount = pathCount;
+    loadTexturesOpenGL(paths, pathCount, textures);
+
+    materialTextures = (unsigned int *)calloc(mesh.materialCount, sizeof(unsigned int));
+
+    for (int i = 0; i < mesh.materialCount; i++)
+        materialTextures[i] = pathIndices[i] != -1 ? textures[pathIndices[i]] : 0;
+
+    free(paths);
+    free(pathIndices);
+}
+
+void releaseMaterialTexturesOpenGL()
+{
+    // Textures which failed to load are 0, which glDeleteTextures ignores
+    if (textures != NULL)
+        glDeleteTextures(textureCount, textures);
+
+    free(textures);
+    free(materialTextures);
+    textures = NULL;
+    materialTextures = NULL;
+    textureCount = 0;
+}
+
+/*
+    Enables the normal and texture coordinate attributes the mesh has. A
+    mesh without normals can only be drawn by the flat variant, which
+    derives them itself. Models without texture coordinates read a constant
+    (0, 0) instead of the buffer, which samples the white texture.
+*/
+void enableVertexAttributesOpenGL()
+{
+    for (int i = 0; i < chunkCount; i++)
+    {
+        glBindVertexArray(chunks[i].VAO);
+
+        if (mesh.normals != NULL)
+            glEnableVertexAttribArray(1);
+        else
+            glDisableVertexAttribArray(1);
+
+        if (mesh.texcoords != NULL)
+            glEnableVertexAttribArray(2);
+        else
+        {
+            glDisableVertexAttribArray(2);
+            glVertexAttrib2f(2, 0.0f, 0.0f);
+        }
+    }
+
+    glBindVertexArray(0);
+}
+
+/*
+    Copies every material of the mesh into its slot of the uniform buffer.
+    This happens only when the mesh changes, never while drawing.
+*/
+void uploadMaterialsOpenGL()
+{
+    int materialCount = mesh.materialCount > 0 ? mesh.materialCount : 1;
+    char *blocks = (char *)calloc(materialCount, materialStride);
+
+    for (int i = 0; i < mesh.materialCount; i++)
+    {
+        MaterialBlock *block = (MaterialBlock *)&blocks[i * materialStride];
+        Material *material = &mesh.materials[i];
+
+        glm_vec3_copy(material->diffuse, block->diffuse);
+        glm_vec3_copy(material->specular, block->specular);
+        block->specular[3] = material->shininess;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, materialUBO);
+    glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)materialCount * materialStride, blocks, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GET_GL_ERRORS();
+
+    free(blocks);
+}
+
+/*
+    Tests the corner of the box furthest along each plane's normal, which is
+    outside only when the whole box is. An empty box is never in view.
+*/
+bool boxInFrustum(vec4 *planes, float *boxMin, float *boxMax)
+{
+    if (boxMin[0] > boxMax[0])
+        return false;
+
+    for (int i = 0; i < 6; i++)
+    {
+        vec3 corner;
+
+        for (int axis = 0; axis < 3; axis++)
+            corner[axis] = planes[i][axis] > 0.0f ? boxMax[axis] : boxMin[axis];
+
+        if (glm_vec3_dot(planes[i], corner) + planes[i][3] < 0.0f)
+            return false;
+    }
+
+    return true;
+}
+
+bool sphereInFrustum(vec4 *planes, float *center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (glm_vec3_dot(planes[i], center) + planes[i][3] < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+    Uploads each run of chunks which differ between the old and new arrays
+    with one glBufferSubData. Returns the number of bytes uploaded.
+*/
+long long uploadChangedRangesOpenGL(unsigned int buffer, float *oldData, size_t oldCount, float *newData, size_t newCount)
+{
+    long long uploaded = 0;
+    size_t runStart = 0;
+    bool running = false;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // One step past the last chunk closes a run which reaches the end
+    for (size_t chunkStart = 0; chunkStart < newCount + MESH_UPDATE_CHUNK_FLOATS; chunkStart += MESH_UPDATE_CHUNK_FLOATS)
+    {
+        bool changed = false;
+
+        if (chunkStart < newCount)
+        {
+            size_t chunkEnd = chunkStart + MESH_UPDATE_CHUNK_FLOATS < newCount ? chunkStart + MESH_UPDATE_CHUNK_FLOATS : newCount;
+
+            changed = chunkEnd > oldCount ||
+                memcmp(&oldData[chunkStart], &newData[chunkStart], sizeof(float) * (chunkEnd - chunkStart)) != 0;
+        }
+
+        if (changed && !running)
+        {
+            runStart = chunkStart;
+            running = true;
+        }
+        else if (!changed && running)
+        {
+            size_t runEnd = chunkStart < newCount ? chunkStart : newCount;
+
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * runStart, sizeof(float) * (runEnd - runStart), &newData[runStart]);
+            uploaded += sizeof(float) * (runEnd - runStart);
+            running = false;
+        }
+    }
+
+    return uploaded;
+}
+
+/*
+    Starts rebuilds for changed shader files and swaps in each variant whose
+    rebuild has linked. A save during a rebuild restarts it from the new file.
+*/
+void reloadShadersOpenGL()
+{
+    pollFileWatcher();
+
+    bool vertexChanged = consumeFileChange(vertexShaderWatch);
+    bool fragmentChanged = consumeFileChange(fragmentShaderWatch);
+
+    for (int variant = 0; variant < SHADER_VARIANT_COUNT; variant++)
+    {
+        PendingShaderProgram *pending = &pendingShaders[variant];
+
+        if ((vertexChanged || fragmentChanged) && shaderVariants[variant].program != 0)
+        {
+            cancelShaderProgramRebuild(pending);
+            beginShaderProgramRebuild(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH, variant, pending);
+        }
+
+        if (pending->program == 0)
+            continue;
+
+        ShaderBuildStatus status = pollShaderProgramRebuild(pending);
+
+        if (status == SHADER_BUILD_READY)
+        {
+            ShaderUniforms *shader = &shaderVariants[variant];
+            shader->program = pending->program;
+            initialiseShaderUniformsOpenGL(shader);
+            pending->program = 0;
+
+            // The new program is bound, so the next use must bind again
+            activeShader = NULL;
+
+            printf("Reloaded shader variant %d in %.1f ms\n", variant, (currentTime() - pending->startTime) * 1000.0);
+        }
+        else if (status == SHADER_BUILD_FAILED)
+            printf("Shader variant %d failed to rebuild, keeping the previous program\n", variant);
+    }
+}
+
+/*
+    Looks up the uniforms of a newly linked program and sets the ones which
+    never change. Leaves the program bound.
+*/
+void initialiseShaderUniformsOpenGL(ShaderUniforms *shader)
+{
+    glUseProgram(shader->program);
+
+    // The depth only variant has no Material block
+    unsigned int materialBlock = glGetUniformBlockIndex(shader->program, "Material");
+
+    if (materialBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader->program, materialBlock, MATERIAL_BLOCK_BINDING);
+
+    glUniform1i(glGetUniformLocation(shader->program, "diffuseMap"), 0);
+
+    // Locations differ between variants, and are -1 for unused uniforms
+    shader->MVP = glGetUniformLocation(shader->program, "MVP");
+    shader->model = glGetUniformLocation(shader->program, "model");
+    shader->lightColor = glGetUniformLocation(shader->program, "lightColor");
+    shader->lightPosition = glGetUniformLocation(shader->program, "lightPosition");
+    shader->cameraPosition = glGetUniformLocation(shader->program, "cameraPosition");
+    shader->normalMatrix = glGetUniformLocation(shader->program, "normalMatrix");
+
+    glUniformMatrix4fv(shader->MVP, 1, GL_FALSE, (float *)mvp);
+    glUniformMatrix4fv(shader->model, 1, GL_FALSE, (float *)model);
+    glUniformMatrix3fv(shader->normalMatrix, 1, GL_FALSE, (float *)normalMatrix);
+    glUniform3fv(shader->lightColor, 1, (float *)lightColor);
+    glUniform3fv(shader->lightPosition, 1, (float *)lightPosition);
+    glUniform3fv(shader->cameraPosition, 1, (float *)cameraPosition);
+    GET_GL_ERRORS();
+}
+
+/*
+    Picks the cheapest variant that keeps the look of the quality mode. Once
+    triangles average only a few pixels, per-vertex lighting is sampled about
+    as often as per-pixel lighting, so automatic mode switches to Gouraud.
+    A model loaded without normals is always drawn flat.
+*/
+unsigned int selectShaderVariantOpenGL()
+{
+    if (mesh.normals == NULL && mesh.vertexCount > 0)
+        return SHADER_VARIANT_FLAT | SHADER_VARIANT_NO_SPECULAR;
+
+    switch (shadingQuality)
+    {
+        case SHADING_QUALITY_AUTO:
+        {
+            size_t triangleCount = mesh.vertexCount / 9;
+            float pixelCount = screenPtr->width * screenPtr->height;
+
+            return triangleCount * SHADING_AUTO_PIXELS_PER_TRIANGLE >= pixelCount ? SHADER_VARIANT_GOURAUD : SHADER_VARIANT_DEFAULT;
+        }
+        case SHADING_QUALITY_FAST:
+            return SHADER_VARIANT_GOURAUD;
+        case SHADING_QUALITY_FLAT:
+            return SHADER_VARIANT_FLAT | SHADER_VARIANT_NO_SPECULAR;
+        default:
+            return SHADER_VARIANT_DEFAULT;
+    }
+}
+
+/*
+    Spins the model about the vertical axis, used for turntable captures.
+*/
+void rotateModelOpenGL(float angle)
+{
+    quaternionRotationAxisAngle(&model, (vec3){0.0f, 1.0f, 0.0f}, angle);
 }
 
 void viewPortResizeCallback(ScreenSize *screenSize) { glViewport(0, 0, screenSize->width, screenSize->height); }
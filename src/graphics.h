@@ -1,14 +1,196 @@
 #ifndef GRAPHICS
 #define GRAPHICS
 
+#include <stdbool.h>
+
+#include <cglm/cglm.h>
+
 #include "inputTracking.h"
+#include "loadModel.h"
+#include "sceneGraph.h"
+
+typedef enum ShadingQuality
+{
+    SHADING_QUALITY_FULL,
+    SHADING_QUALITY_AUTO,
+    SHADING_QUALITY_FAST,
+    SHADING_QUALITY_FLAT
+}
+ShadingQuality;
+
+typedef enum DepthPrepassMode
+{
+    DEPTH_PREPASS_AUTO,
+    DEPTH_PREPASS_ON,
+    DEPTH_PREPASS_OFF
+}
+DepthPrepassMode;
+
+// A linked shader variant and its uniform locations
+typedef struct ShaderUniforms
+{
+    unsigned int program;
+    int MVP;
+    int model;
+    int normalMatrix;
+    int lightColor;
+    int lightPosition;
+    int cameraPosition;
+}
+ShaderUniforms;
+
+// The point cloud program and its uniform locations
+typedef struct PointShaderUniforms
+{
+    unsigned int program;
+    int MVP;
+    int chunkOrigin;
+    int chunkExtent;
+    int pointScale;
+}
+PointShaderUniforms;
+
+// Whole point chunks packed into one vertex buffer, drawn through its own
+// vertex array
+typedef struct PointBuffer
+{
+    unsigned int VAO;
+    unsigned int VBO;
+}
+PointBuffer;
+
+// One run of the mesh's corners, in vertex buffers of its own and drawn
+// through its own vertex array. The vertex array reads the corners through
+// the shared element buffer, with a transform per instance. The depth
+// pre-pass reads only the positions, through a vertex array of its own.
+typedef struct MeshBufferChunk
+{
+    unsigned int VAO;
+    unsigned int depthVAO;
+    unsigned int VBO;
+    unsigned int NBO;
+    unsigned int UVBO;
+}
+MeshBufferChunk;
+
+// The part of an instanced group's batch within one chunk, drawn once for
+// every visible instance of the prototype
+typedef struct InstancedDraw
+{
+    size_t firstElement;
+    int elementCount;
+    int prototype;
+    int material;
+    int chunk;
+}
+InstancedDraw;
+
+// Boxes tested against the depth pyramid in a frame, and those it hid
+typedef struct OcclusionStatistics
+{
+    int tested;
+    int occluded;
+}
+OcclusionStatistics;
+
+// Fragments shaded for each pixel in the last measured frame, and those
+// drawn at all, which without the depth pre-pass are the same
+typedef struct OverdrawStatistics
+{
+    float shadedPerPixel;
+    float drawnPerPixel;
+    bool depthPrepass;
+}
+OverdrawStatistics;
+
+// Occlusion queries counting the samples which passed the depth test in a
+// frame's depth and shading passes, read back once the GPU has finished
+typedef struct OverdrawQuery
+{
+    unsigned int depthQuery;
+    unsigned int shadingQuery;
+    bool depthPrepass;
+    bool pending;
+    float samples;
+}
+OverdrawQuery;
+
+// Layout of a glMultiDrawElementsIndirect command
+typedef struct IndirectDrawCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+}
+IndirectDrawCommand;
+
+// std140 layout of the Material uniform block, the specular exponent is
+// stored in specular[3]
+typedef struct MaterialBlock
+{
+    float diffuse[4];
+    float specular[4];
+}
+MaterialBlock;
 
 // Public method(s)
-void initialiseOpenGL(void * procAddressFunction, ScreenSize * screenSize, char * modelName);
+void initialiseOpenGL(void * procAddressFunction, ScreenSize * screenSize, char ** modelNames, int modelCount);
+void setMeshOpenGL(Mesh * newMesh);
+long long updateMeshOpenGL(Mesh * newMesh);
 void renderOpenGL();
+void finishOpenGL();
 void releaseOpenGL();
+void rotateModelOpenGL(float angle);
 void viewPortResizeCallback(ScreenSize * screenSize);
 void mouseDragCallback(MousePosition * positions, ScreenSize * screenSize);
 void scrollCallBack(ScrollPosition * positions);
+void keyPressCallback(int key);
+void setShadingQualityOpenGL(ShadingQuality quality);
+void setClusterCullingOpenGL(bool allowed);
+void setSceneAnimationOpenGL(bool allowed);
+void setOcclusionCullingOpenGL(bool allowed);
+OcclusionStatistics occlusionStatisticsOpenGL();
+void setDepthPrepassOpenGL(DepthPrepassMode mode);
+OverdrawStatistics overdrawStatisticsOpenGL();
+void watchShadersOpenGL();
+
+// Private method(s)
+void installMeshOpenGL(Mesh * newMesh);
+void drawSceneOpenGL();
+void queueModelDrawsOpenGL(SceneNode * node);
+bool boxOccludedOpenGL(mat4 transform, float * boxMin, float * boxMax);
+int pushFrameTransformOpenGL(mat4 transform);
+float viewDepth(mat4 modelView, float * point);
+void drawQueuedPassesOpenGL();
+void submitDrawsOpenGL(bool depthOnly);
+void prepareIndirectDrawsOpenGL();
+void submitIndirectDrawsOpenGL(bool depthOnly);
+void submitBaseVertexDrawsOpenGL(bool depthOnly);
+void collectOverdrawOpenGL();
+float viewportSamplesOpenGL();
+void bindMaterialOpenGL(int material);
+void resizeMeshChunksOpenGL(int count);
+long long uploadMeshChunksOpenGL(Mesh * uploadMesh);
+size_t meshChunkCorners(size_t cornerCount, int chunk);
+long long uploadElementsOpenGL(Mesh * uploadMesh);
+void weldCorners(Mesh * weldMesh, size_t first, size_t count, size_t chunkStart, unsigned int * elements);
+int cornerKey(Mesh * keyMesh, size_t corner, float * key);
+void drawPointChunksOpenGL();
+size_t pointChunkDrawCount(PointChunk * chunk, float modelScale, float pixelScale);
+long long uploadPointBuffersOpenGL(Mesh * uploadMesh);
+void releasePointBuffersOpenGL();
+void uploadMaterialsOpenGL();
+void loadMaterialTexturesOpenGL();
+void releaseMaterialTexturesOpenGL();
+void enableVertexAttributesOpenGL();
+bool boxInFrustum(float (* planes)[4], float * boxMin, float * boxMax);
+bool sphereInFrustum(float (* planes)[4], float * center, float radius);
+long long uploadChangedRangesOpenGL(unsigned int buffer, float * oldData, size_t oldCount, float * newData, size_t newCount);
+void reloadShadersOpenGL();
+void initialiseShaderUniformsOpenGL(ShaderUniforms * shader);
+ShaderUniforms * useShaderVariantOpenGL(unsigned int variant);
+unsigned int selectShaderVariantOpenGL();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "imageWriter.h"
+
+
+/*
+    Writes tightly packed RGBA pixels as a PNG. Images read back from OpenGL
+    start at the bottom row, so bottomUp walks the rows with a negative stride
+    rather than flipping a copy. Safe to call from several threads at once.
+*/
+bool writePNG(const char * filePath, const unsigned char * pixels, int width, int height, bool bottomUp)
+{
+    int stride = width * 4;
+    const unsigned char * firstRow = pixels;
+
+    if (bottomUp)
+    {
+        firstRow = pixels + (size_t)stride * (height - 1);
+        stride = -stride;
+    }
+
+    if (!stbi_write_png(filePath, width, height, 4, firstRow, stride))
+    {
+        printf("Could not write image: %s\n", filePath);
+        return false;
+    }
+
+    return true;
+}
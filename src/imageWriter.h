@@ -0,0 +1,9 @@
+#ifndef IMAGE_WRITER
+#define IMAGE_WRITER
+
+#include <stdbool.h>
+
+// Public method(s)
+bool writePNG(const char * filePath, const unsigned char * pixels, int width, int height, bool bottomUp);
+
+#endif
@@ -0,0 +1,528 @@
+/******************************************************************************
+ * File:        jobSystem.c
+ * Description: A fixed pool of worker threads which the loader, mesh
+ *              processing and the CPU renderers share.
+ *              - Each worker has its own queue. It runs its newest jobs
+ *                first, while idle workers steal the oldest jobs of the
+ *                others, so work submitted together spreads out and work
+ *                submitted from inside a job stays warm in its cache.
+ *              - Jobs count down a JobCounter as they finish, and a job can
+ *                be held back until a counter reaches zero.
+ *              - Waiting runs queued jobs instead of blocking, so the thread
+ *                that submitted the work helps finish it.
+ *              - Time spent in jobs is kept per worker and reported when the
+ *                pool is released.
+ * Notes:       The thread that initialises the pool is worker zero. Other
+ *              threads may submit and wait as well, and their jobs are
+ *              dealt out between the workers' queues. Before the pool is
+ *              initialised every job runs where it is submitted.
+ ******************************************************************************/
+
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "benchmark.h"
+#include "jobSystem.h"
+
+static int workerCount;
+static pthread_t workers[JOB_MAX_WORKERS];
+static bool workersStarted[JOB_MAX_WORKERS];
+static JobQueue queues[JOB_MAX_WORKERS];
+static JobWorkerStats workerStats[JOB_MAX_WORKERS];
+static JobWorkerStats otherThreadStats;
+static double poolStartTime;
+
+// -1 on threads outside the pool. Only the outermost job on a thread is
+// timed, since a job that waits runs others inside it.
+static _Thread_local int currentWorker = -1;
+static _Thread_local int jobDepth;
+
+// Idle workers sleep until a job is queued anywhere
+static atomic_int queuedJobs;
+static atomic_int sleepingWorkers;
+static atomic_uint nextOtherQueue;
+static bool poolShutdown;
+static pthread_mutex_t sleepMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobQueued = PTHREAD_COND_INITIALIZER;
+
+// Public method(s)
+
+/*
+    Starts a pool of requestedWorkers workers, the calling thread being
+    worker zero and each of the others a new thread. A worker whose thread
+    cannot be started leaves its queue to be emptied by the others.
+*/
+bool initialiseJobSystem(int requestedWorkers)
+{
+    workerCount = requestedWorkers;
+
+    if (workerCount < 1)
+        workerCount = 1;
+    if (workerCount > JOB_MAX_WORKERS)
+        workerCount = JOB_MAX_WORKERS;
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        pthread_mutex_init(&queues[i].mutex, NULL);
+        queues[i].front = 0;
+        queues[i].count = 0;
+        atomic_store(&workerStats[i].busyNanoseconds, 0);
+        atomic_store(&workerStats[i].jobCount, 0);
+        atomic_store(&workerStats[i].stolenCount, 0);
+    }
+
+    atomic_store(&otherThreadStats.busyNanoseconds, 0);
+    atomic_store(&otherThreadStats.jobCount, 0);
+    atomic_store(&otherThreadStats.stolenCount, 0);
+    atomic_store(&queuedJobs, 0);
+    atomic_store(&sleepingWorkers, 0);
+
+    poolShutdown = false;
+    poolStartTime = currentTime();
+    currentWorker = 0;
+
+    int startedCount = 1;
+
+    for (int i = 1; i < workerCount; i++)
+    {
+        workersStarted[i] = pthread_create(&workers[i], NULL, jobWorkerMain, (void *)(size_t)i) == 0;
+        startedCount += workersStarted[i];
+    }
+
+    if (startedCount < workerCount)
+        printf("Started %d of %d job workers\n", startedCount, workerCount);
+
+    return startedCount == workerCount;
+}
+
+/*
+    Lets the workers finish every queued job, stops them and reports how
+    busy each one was.
+*/
+void releaseJobSystem()
+{
+    if (workerCount == 0)
+        return;
+
+    pthread_mutex_lock(&sleepMutex);
+    poolShutdown = true;
+    pthread_cond_broadcast(&jobQueued);
+    pthread_mutex_unlock(&sleepMutex);
+
+    for (int i = 1; i < workerCount; i++)
+    {
+        if (workersStarted[i])
+            pthread_join(workers[i], NULL);
+    }
+
+    reportJobUtilisation();
+
+    for (int i = 0; i < workerCount; i++)
+        pthread_mutex_destroy(&queues[i].mutex);
+
+    workerCount = 0;
+    currentWorker = -1;
+}
+
+/*
+    The number of workers, including the thread that started the pool, or
+    one before it is started.
+*/
+int jobWorkerCount()
+{
+    return workerCount > 0 ? workerCount : 1;
+}
+
+void initialiseJobCounter(JobCounter * counter)
+{
+    atomic_init(&counter->pending, 0);
+    atomic_flag_clear(&counter->lock);
+    counter->continuationCount = 0;
+}
+
+/*
+    Queues a job on the calling worker, or on the next worker in turn from
+    a thread outside the pool. counter may be NULL.
+*/
+void submitJob(jobFP function, void * argument, JobCounter * counter)
+{
+    if (counter != NULL)
+        atomic_fetch_add(&counter->pending, 1);
+
+    Job job = { function, argument, counter };
+    queueJob(&job);
+}
+
+/*
+    Queues a job once every job counted by dependency has finished. It is
+    counted in counter straight away, so waiting on counter covers it.
+*/
+void submitJobAfter(JobCounter * dependency, jobFP function, void * argument, JobCounter * counter)
+{
+    if (counter != NULL)
+        atomic_fetch_add(&counter->pending, 1);
+
+    Job job = { function, argument, counter };
+
+    lockJobCounter(dependency);
+
+    bool held = atomic_load(&dependency->pending) > 0 && dependency->continuationCount < JOB_MAX_CONTINUATIONS;
+
+    if (held)
+        dependency->continuations[dependency->continuationCount++] = job;
+
+    unlockJobCounter(dependency);
+
+    if (held)
+        return;
+
+    // With no room left to hold it, the job waits for its dependency here
+    waitForJobs(dependency);
+    queueJob(&job);
+}
+
+/*
+    Runs queued jobs, from any worker, until every job counted by counter
+    has finished.
+*/
+void waitForJobs(JobCounter * counter)
+{
+    while (atomic_load(&counter->pending) > 0)
+    {
+        if (!runOneJob())
+            sched_yield();
+    }
+
+    // The job that finished last may still be releasing the counter, which
+    // could be on the caller's stack
+    lockJobCounter(counter);
+    unlockJobCounter(counter);
+}
+
+/*
+    Runs one queued job on the calling thread, its own newest job if it is
+    a worker with one, or else one stolen from another worker. Returns false
+    when no job is queued.
+*/
+bool runOneJob()
+{
+    Job job;
+    bool stolen;
+
+    if (workerCount == 0 || !takeJob(currentWorker, &job, &stolen))
+        return false;
+
+    runJob(currentWorker, &job, stolen);
+
+    return true;
+}
+
+/*
+    Calls function over count indices, one grain of grainSize at a time,
+    on up to one runner per worker. Every grain starts at a multiple of
+    grainSize, even with a single runner. Runners claim the next grain until
+    none are left, so uneven grains balance out, and the caller is one of
+    them. A grainSize of 0 gives each worker about four grains.
+*/
+void parallelFor(size_t count, size_t grainSize, parallelForFP function, void * argument)
+{
+    if (count == 0)
+        return;
+
+    int runnerCount = jobWorkerCount();
+
+    if (grainSize == 0)
+        grainSize = (count + 4 * runnerCount - 1) / (4 * runnerCount);
+
+    size_t grainCount = (count + grainSize - 1) / grainSize;
+
+    if ((size_t)runnerCount > grainCount)
+        runnerCount = (int)grainCount;
+
+    ParallelForRange range;
+    range.function = function;
+    range.argument = argument;
+    range.count = count;
+    range.grainSize = grainSize;
+    atomic_init(&range.next, 0);
+
+    if (runnerCount == 1)
+    {
+        runParallelForRange(&range);
+        return;
+    }
+
+    JobCounter counter;
+    initialiseJobCounter(&counter);
+
+    for (int i = 1; i < runnerCount; i++)
+        submitJob(runParallelForRange, &range, &counter);
+
+    Job callerRunner = { runParallelForRange, &range, NULL };
+    runJob(currentWorker, &callerRunner, false);
+
+    waitForJobs(&counter);
+}
+
+/*
+    Prints the share of the time since the pool started that each worker
+    spent running jobs, and how many of its jobs it stole.
+*/
+void reportJobUtilisation()
+{
+    double elapsed = currentTime() - poolStartTime;
+
+    printf("\rJob system: %d workers over %.3f seconds\n", workerCount, elapsed);
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        printf("  Worker %d: %.1f%% busy, %lld jobs (%lld stolen)\n",
+            i,
+            atomic_load(&workerStats[i].busyNanoseconds) / 1e9 / elapsed * 100.0,
+            atomic_load(&workerStats[i].jobCount),
+            atomic_load(&workerStats[i].stolenCount)
+        );
+    }
+
+    if (atomic_load(&otherThreadStats.jobCount) > 0)
+    {
+        printf("  Other threads: %.3f seconds, %lld jobs\n",
+            atomic_load(&otherThreadStats.busyNanoseconds) / 1e9,
+            atomic_load(&otherThreadStats.jobCount)
+        );
+    }
+}
+
+// Private method(s)
+
+void * jobWorkerMain(void * argument)
+{
+    int workerIndex = (int)(size_t)argument;
+    currentWorker = workerIndex;
+
+    while (true)
+    {
+        Job job;
+        bool stolen;
+
+        if (takeJob(workerIndex, &job, &stolen))
+        {
+            runJob(workerIndex, &job, stolen);
+            continue;
+        }
+
+        // Submitters only signal when a worker sleeps, and count the job
+        // before looking, so checking queuedJobs under the mutex loses no
+        // wake up
+        pthread_mutex_lock(&sleepMutex);
+        atomic_fetch_add(&sleepingWorkers, 1);
+
+        while (atomic_load(&queuedJobs) <= 0 && !poolShutdown)
+            pthread_cond_wait(&jobQueued, &sleepMutex);
+
+        atomic_fetch_sub(&sleepingWorkers, 1);
+        bool finished = poolShutdown && atomic_load(&queuedJobs) <= 0;
+        pthread_mutex_unlock(&sleepMutex);
+
+        if (finished)
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+    Queues a job whose counter already includes it. A job that finds its
+    queue full, or no pool at all, runs straight away instead.
+*/
+void queueJob(Job * job)
+{
+    if (workerCount == 0)
+    {
+        runJob(-1, job, false);
+        return;
+    }
+
+    int queueIndex = currentWorker >= 0 ? currentWorker : (int)(atomic_fetch_add(&nextOtherQueue, 1) % workerCount);
+
+    if (!pushJob(queueIndex, job))
+    {
+        runJob(currentWorker, job, false);
+        return;
+    }
+
+    if (atomic_load(&sleepingWorkers) > 0)
+    {
+        pthread_mutex_lock(&sleepMutex);
+        pthread_cond_signal(&jobQueued);
+        pthread_mutex_unlock(&sleepMutex);
+    }
+}
+
+bool pushJob(int queueIndex, Job * job)
+{
+    JobQueue * queue = &queues[queueIndex];
+    bool pushed = false;
+
+    pthread_mutex_lock(&queue->mutex);
+
+    if (queue->count < JOB_QUEUE_CAPACITY)
+    {
+        queue->jobs[(queue->front + queue->count) % JOB_QUEUE_CAPACITY] = *job;
+        queue->count++;
+        atomic_fetch_add(&queuedJobs, 1);
+        pushed = true;
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return pushed;
+}
+
+/*
+    Takes the newest job, from the back, which only the owner does.
+*/
+bool popJob(int queueIndex, Job * job)
+{
+    JobQueue * queue = &queues[queueIndex];
+    bool popped = false;
+
+    pthread_mutex_lock(&queue->mutex);
+
+    if (queue->count > 0)
+    {
+        queue->count--;
+        *job = queue->jobs[(queue->front + queue->count) % JOB_QUEUE_CAPACITY];
+        atomic_fetch_sub(&queuedJobs, 1);
+        popped = true;
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return popped;
+}
+
+/*
+    Takes the oldest job, from the front, for another thread.
+*/
+bool stealJob(int queueIndex, Job * job)
+{
+    JobQueue * queue = &queues[queueIndex];
+    bool stolen = false;
+
+    pthread_mutex_lock(&queue->mutex);
+
+    if (queue->count > 0)
+    {
+        *job = queue->jobs[queue->front];
+        queue->front = (queue->front + 1) % JOB_QUEUE_CAPACITY;
+        queue->count--;
+        atomic_fetch_sub(&queuedJobs, 1);
+        stolen = true;
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return stolen;
+}
+
+/*
+    Pops from the worker's own queue, then tries the others in turn starting
+    with the next worker, so thieves do not all pick the same victim.
+*/
+bool takeJob(int workerIndex, Job * job, bool * stolen)
+{
+    *stolen = false;
+
+    if (workerIndex >= 0 && popJob(workerIndex, job))
+        return true;
+
+    *stolen = true;
+
+    for (int offset = 1; offset <= workerCount; offset++)
+    {
+        int victim = (workerIndex + offset + workerCount) % workerCount;
+
+        if (victim != workerIndex && stealJob(victim, job))
+            return true;
+    }
+
+    return false;
+}
+
+void runJob(int workerIndex, Job * job, bool stolen)
+{
+    JobWorkerStats * stats = workerIndex >= 0 ? &workerStats[workerIndex] : &otherThreadStats;
+    double startTime = jobDepth == 0 ? currentTime() : 0.0;
+
+    jobDepth++;
+    job->function(job->argument);
+    jobDepth--;
+
+    if (jobDepth == 0)
+        atomic_fetch_add(&stats->busyNanoseconds, (long long)((currentTime() - startTime) * 1e9));
+
+    atomic_fetch_add(&stats->jobCount, 1);
+
+    if (stolen)
+        atomic_fetch_add(&stats->stolenCount, 1);
+
+    finishJob(job->counter);
+}
+
+/*
+    Counts a job off, and queues the jobs held back on the counter once it
+    reaches zero. The count drops under the counter's lock, so a waiter that
+    sees zero and takes the lock knows the counter is no longer used.
+*/
+void finishJob(JobCounter * counter)
+{
+    if (counter == NULL)
+        return;
+
+    Job released[JOB_MAX_CONTINUATIONS];
+    int releasedCount = 0;
+
+    lockJobCounter(counter);
+
+    if (atomic_fetch_sub(&counter->pending, 1) == 1)
+    {
+        releasedCount = counter->continuationCount;
+        memcpy(released, counter->continuations, sizeof(Job) * releasedCount);
+        counter->continuationCount = 0;
+    }
+
+    unlockJobCounter(counter);
+
+    for (int i = 0; i < releasedCount; i++)
+        queueJob(&released[i]);
+}
+
+void lockJobCounter(JobCounter * counter)
+{
+    while (atomic_flag_test_and_set_explicit(&counter->lock, memory_order_acquire))
+        sched_yield();
+}
+
+void unlockJobCounter(JobCounter * counter)
+{
+    atomic_flag_clear_explicit(&counter->lock, memory_order_release);
+}
+
+void runParallelForRange(void * argument)
+{
+    ParallelForRange * range = (ParallelForRange *)argument;
+
+    while (true)
+    {
+        size_t first = atomic_fetch_add(&range->next, range->grainSize);
+
+        if (first >= range->count)
+            break;
+
+        size_t end = range->count - first > range->grainSize ? first + range->grainSize : range->count;
+        range->function(range->argument, first, end);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef JOB_SYSTEM
+#define JOB_SYSTEM
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JOB_MAX_WORKERS 64
+#define JOB_QUEUE_CAPACITY 1024
+#define JOB_MAX_CONTINUATIONS 64
+
+typedef void (* jobFP)(void * argument);
+
+// Runs a parallel for over indices first to end - 1
+typedef void (* parallelForFP)(void * argument, size_t first, size_t end);
+
+typedef struct JobCounter JobCounter;
+
+typedef struct Job
+{
+    jobFP function;
+    void * argument;
+    JobCounter * counter;
+}
+Job;
+
+// Counts the unfinished jobs submitted with it. Jobs submitted after it are
+// held here until it reaches zero.
+struct JobCounter
+{
+    atomic_int pending;
+    atomic_flag lock;
+    int continuationCount;
+    Job continuations[JOB_MAX_CONTINUATIONS];
+};
+
+// Jobs are pushed and popped at the back by the worker owning the queue,
+// and stolen from the front by the others
+typedef struct JobQueue
+{
+    pthread_mutex_t mutex;
+    Job jobs[JOB_QUEUE_CAPACITY];
+    int front;
+    int count;
+}
+JobQueue;
+
+// Time spent in jobs by one worker, for the utilisation report
+typedef struct JobWorkerStats
+{
+    _Atomic long long busyNanoseconds;
+    _Atomic long long jobCount;
+    _Atomic long long stolenCount;
+}
+JobWorkerStats;
+
+// The indices a parallel for hands out, grainSize at a time
+typedef struct ParallelForRange
+{
+    parallelForFP function;
+    void * argument;
+    size_t count;
+    size_t grainSize;
+    atomic_size_t next;
+}
+ParallelForRange;
+
+// Public method(s)
+bool initialiseJobSystem(int workerCount);
+void releaseJobSystem();
+int jobWorkerCount();
+void initialiseJobCounter(JobCounter * counter);
+void submitJob(jobFP function, void * argument, JobCounter * counter);
+void submitJobAfter(JobCounter * dependency, jobFP function, void * argument, JobCounter * counter);
+void waitForJobs(JobCounter * counter);
+bool runOneJob();
+void parallelFor(size_t count, size_t grainSize, parallelForFP function, void * argument);
+void reportJobUtilisation();
+
+// Private method(s)
+void * jobWorkerMain(void * argument);
+void queueJob(Job * job);
+bool pushJob(int queueIndex, Job * job);
+bool popJob(int queueIndex, Job * job);
+bool stealJob(int queueIndex, Job * job);
+bool takeJob(int workerIndex, Job * job, bool * stolen);
+void runJob(int workerIndex, Job * job, bool stolen);
+void finishJob(JobCounter * counter);
+void lockJobCounter(JobCounter * counter);
+void unlockJobCounter(JobCounter * counter);
+void runParallelForRange(void * argument);
+
+#endif
@@ -3,59 +3,256 @@
  * Author:      Jasraj Kalar
  * Created:     2024-09-30
  * Description: This file contains the implementation of an OBJ file loader for
- *              integration with OpenGL. It handles OBJ files using 
- *              triangulation.
+ *              integration with OpenGL. Polygon faces are triangulated as
+ *              they are loaded.
  *              Main functionalities include:
  *              - Capture vertices and normals from an OBJ file in the format 
  *                expected by OpenGL.
  *              - Perform scale calculations for the model.
  *              - Provide count of vertices for OpenGL functions.
- * Notes:       The loader only supports triangular mesh types.
+ *              - Keep g/o groups with bounds, and usemtl materials read
+ *                from the MTL library, as batches sorted by material.
+ *              - Load only selected groups through a sidecar index.
+ *              - Generate smoothed normals for faces without them.
+ *              - Hand files of v records without faces to the point cloud
+ *                loader.
+ *              - Share the corners of repeated groups between instances.
+ * Notes:       Convex polygons are split as fans, and concave ones by ear
+ *              clipping.
  * License:     MIT License
  ******************************************************************************/
 
 
+#include <float.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "benchmark.h"
+#include "jobSystem.h"
+#include "simdTypes.h"
 #include "loadModel.h"
+#include "materialLibrary.h"
+#include "meshInstances.h"
+#include "modelIndex.h"
+#include "pointCloud.h"
 
 #define TRIANGULAR_MESH_TYPE 3
 #define ZOOM_LEVEL_CLOSE 6
 #define ZOOM_LEVEL_MEDIUM 5
 #define ZOOM_LEVEL_FAR 4
 
-int loadModel(char * filename, float * scale, float ** vertices, float ** normals)
+// Normals are generated in slices of this many faces, each one a job
+#define NORMAL_FACES_PER_SLICE 65536
+
+// Bounds are reduced in jobs of at least this many positions, and at most
+// BOUNDS_MAX_JOBS jobs
+#define BOUNDS_POSITIONS_PER_JOB 65536
+#define BOUNDS_MAX_JOBS 256
+
+static char * groupSelection = NULL;
+static bool normalsSelected = true;
+
+/*
+    Defines a parser for triangles and quads whose corners all have one
+    layout, which fails on any record that does not match it exactly. The
+    layout is fixed when the parser is defined, so its checks are resolved
+    by the compiler, and mismatches are collected as it goes instead of
+    branching on each field.
+*/
+#define DEFINE_FACE_PARSER(name, hasTexture, hasNormal)                         \
+    int name(char * cursor, int * vertices, int * textures, int * normals)    \
+    {                                                                           \
+        bool matched = true;                                                    \
+        int cornerCount = 3;                                                    \
+                                                                                \
+        for (int corner = 0; corner < cornerCount; corner++)                   \
+        {                                                                       \
+            char * start = cursor + strspn(cursor, " \t");                     \
+            matched &= start != cursor;                                         \
+            cursor = start;                                                     \
+                                                                                \
+            vertices[corner] = readFaceIndex(&cursor);                          \
+            textures[corner] = 0;                                               \
+            normals[corner] = 0;                                                \
+            matched &= cursor != start;                                         \
+                                                                                \
+            if (hasTexture || hasNormal)                                        \
+            {                                                                   \
+                matched &= *cursor == '/';                                      \
+                cursor += *cursor == '/';                                       \
+            }                                                                   \
+                                                                                \
+            if (hasTexture)                                                     \
+            {                                                                   \
+                start = cursor;                                                 \
+                textures[corner] = readFaceIndex(&cursor);                      \
+                matched &= cursor != start;                                     \
+            }                                                                   \
+                                                                                \
+            if (hasNormal)                                                      \
+            {                                                                   \
+                matched &= *cursor == '/';                                      \
+                cursor += *cursor == '/';                                       \
+                start = cursor;                                                 \
+                normals[corner] = readFaceIndex(&cursor);                       \
+                matched &= cursor != start;                                     \
+            }                                                                   \
+                                                                                \
+            /* Another index after the third corner makes a quad */            \
+            if (corner == 2)                                                    \
+                cornerCount += (unsigned char)(cursor[strspn(cursor, " \t")] - '0') < 10; \
+        }                                                                       \
+                                                                                \
+        cursor += strspn(cursor, " \t");                                        \
+        matched &= *cursor == '\0' || *cursor == '\r' || *cursor == '\n';       \
+                                                                                \
+        return matched ? cornerCount : 0;                                       \
+    }
+
+DEFINE_FACE_PARSER(parseFaceV, false, false)
+DEFINE_FACE_PARSER(parseFaceVT, true, false)
+DEFINE_FACE_PARSER(parseFaceVN, false, true)
+DEFINE_FACE_PARSER(parseFaceVTVN, true, true)
+
+// Indexed by FaceLayout
+static faceParserFP faceParsers[] = { parseFaceGeneric, parseFaceV, parseFaceVT, parseFaceVN, parseFaceVTVN };
+
+/*
+    Restricts later loads to a comma separated list of groups, read through
+    the model's sidecar index instead of parsing the whole file. NULL loads
+    every group again.
+*/
+void selectModelGroups(char * groupNames)
 {
-    int vertexCount;
+    groupSelection = groupNames;
+}
+
+/*
+    Sets whether later loads produce normals. Without them the mesh has no
+    normal buffer and can only be shaded flat, which halves its memory.
+    With them, faces the file gives no normals are smoothed.
+*/
+void selectModelNormals(bool normals)
+{
+    normalsSelected = normals;
+}
+
+/*
+    Returns the number of position floats loaded, or -1 when the model
+    could not be read. For a point cloud these are the points' positions,
+    and the mesh has no corners.
+*/
+long long loadModel(char * filename, Mesh * mesh)
+{
+    mesh->vertices = NULL;
+    mesh->normals = NULL;
+    mesh->texcoords = NULL;
+    mesh->vertexCount = 0;
+    mesh->scale = 1.0;
+    mesh->center[0] = mesh->center[1] = mesh->center[2] = 0.0f;
+    mesh->radius = 0.0f;
+    mesh->groups = NULL;
+    mesh->groupCount = 0;
+    mesh->materials = NULL;
+    mesh->materialCount = 0;
+    mesh->batches = NULL;
+    mesh->batchCount = 0;
+    mesh->instances = NULL;
+    mesh->instanceCount = 0;
+    mesh->models = NULL;
+    mesh->modelCount = 0;
+    mesh->points = NULL;
+    mesh->pointCount = 0;
+    mesh->pointChunks = NULL;
+    mesh->pointChunkCount = 0;
 
     // Verify the file is an obj file
-    if (!strcmp(&filename[strlen(filename) - 4], ".obj"))
-        vertexCount = loadOBJ(filename, scale, vertices, normals);
+    size_t length = strlen(filename);
+    long long floatCount = -1;
 
-    return vertexCount;
+    if (length > 4 && !strcmp(&filename[length - 4], ".obj"))
+        floatCount = groupSelection != NULL ? loadOBJGroups(filename, groupSelection, mesh) : loadOBJ(filename, mesh);
+
+    // Point clouds count their positions, but have no corners
+    mesh->vertexCount = floatCount > 0 && mesh->pointCount == 0 ? floatCount : 0;
+
+    if (mesh->vertexCount > 0)
+        instanceMesh(mesh);
+
+    if (floatCount > 0)
+        describeMeshModel(mesh);
+
+    return floatCount;
+}
+
+void releaseMesh(Mesh * mesh)
+{
+    free(mesh->vertices);
+    free(mesh->normals);
+    free(mesh->texcoords);
+    free(mesh->groups);
+    free(mesh->materials);
+    free(mesh->batches);
+    free(mesh->instances);
+    free(mesh->models);
+    free(mesh->points);
+    free(mesh->pointChunks);
+
+    mesh->vertices = NULL;
+    mesh->normals = NULL;
+    mesh->texcoords = NULL;
+    mesh->groups = NULL;
+    mesh->materials = NULL;
+    mesh->batches = NULL;
+    mesh->instances = NULL;
+    mesh->models = NULL;
+    mesh->points = NULL;
+    mesh->pointChunks = NULL;
+    mesh->vertexCount = 0;
+    mesh->groupCount = 0;
+    mesh->materialCount = 0;
+    mesh->batchCount = 0;
+    mesh->instanceCount = 0;
+    mesh->modelCount = 0;
+    mesh->pointCount = 0;
+    mesh->pointChunkCount = 0;
 }
 
 /*
     OBJ Format
 
     v       Vertex      xCoord yCoord zCoord                (Position Coordinates)
-    vt      Texture     uCoord vCoord                       (Not used)
+    vt      Texture     uCoord vCoord                       (Texture coordinates)
     vn      Normals     xCoord yCoord zCoord                (Direction of each normal)
-    f       Faces       v1/vt1/vn1 v2/vt2/vn2 v3/vt3/vn3    (Specify each triangle)
+    f       Faces       v1/vt1/vn1 v2/vt2/vn2 v3/vt3/vn3    (Specify each polygon, three or more corners)
+                        v1//vn1, v1/vt1 or v1               (Missing normals are generated)
+    g / o   Group       name                                (Faces until the next group)
+    usemtl  Material    name                                (Faces until the next usemtl)
+    mtllib  Library     file name                           (MTL file defining the materials)
+
+    A polygon of n corners becomes n - 2 triangles. Faces with fewer than
+    three corners, or with a position not yet defined, are skipped. Files
+    with more than LOAD_MODEL_MAX_RECORDS records of one kind, or triangles,
+    are refused.
+
+    A file with v records but no faces is a point cloud, loaded by
+    loadPointCloud. Its v records may carry a colour, v x y z r g b.
 
-    Support is limited to OBJ files using triangulation.
+    Faces are sorted by material and then by group, so each material draws
+    from one run of the buffers however often usemtl switches back to it.
 */
 
-int loadOBJ(char * filename, float * scale, float ** vertices, float ** normals)
+long long loadOBJ(char * filename, Mesh * mesh)
 {
-    int vertexCount     = 0;
-    int normalCount     = 0;
-    int faceCount       = 0;
+    size_t vertexCount  = 0;
+    size_t normalCount  = 0;
+    size_t textureCount = 0;
+    size_t faceCount    = 0;
+    size_t polygonCount = 0;
 
-    // LoadOBJ is currently limited to triangular mesh types
+    // Polygons are stored as triangles
     int meshType = TRIANGULAR_MESH_TYPE;
 
     FILE *input = fopen(filename, "r");
@@ -65,23 +262,95 @@ int loadOBJ(char * filename, float * scale, float ** vertices, float ** normals)
         return -1;
     }
 
-    char line[256];
+    char line[LOAD_MODEL_LINE_LENGTH];
+    char libraryName[256] = "";
 
-    // Capture the number of vertices, normals and faces in the obj file
+    int groupCapacity = 0;
+    int materialCapacity = 0;
+
+    // Group or material of each g/o and usemtl record in file order,
+    // replayed in the second pass
+    int * switches = NULL;
+    int switchCount = 0;
+    int switchCapacity = 0;
+
+    // Capture the number of vertices, normals and faces in the obj file, and
+    // the groups and materials they use
     while(fgets(line, sizeof(line), input) != NULL)
     {
+        int switchedTo = -1;
+        char name[MESH_GROUP_NAME_LENGTH] = "default";
+
         if (line[0] == 'v' && line[1] == ' ')
             vertexCount++;
         else if (line[0] == 'v' && line[1] == 'n')
             normalCount++;
+        else if (line[0] == 'v' && line[1] == 't')
+            textureCount++;
         else if (line[0] == 'f')
-            faceCount++;
+        {
+            // faceCount counts triangles, n - 2 for each polygon
+            int cornerCount = countFaceCorners(line + 1);
+            faceCount += cornerCount > 2 ? cornerCount - 2 : 0;
+            polygonCount++;
+        }
+        else if ((line[0] == 'g' || line[0] == 'o') && (line[1] == ' ' || line[1] == '\n' || line[1] == '\r'))
+        {
+            sscanf(line + 1, " %63[^\r\n]", name);
+            switchedTo = findOrAddGroup(mesh, &groupCapacity, name);
+        }
+        else if (!strncmp(line, "usemtl ", 7))
+        {
+            sscanf(line + 6, " %63[^\r\n]", name);
+            switchedTo = findOrAddMaterial(mesh, &materialCapacity, name);
+        }
+        else
+            sscanf(line, "mtllib %255[^\r\n]", libraryName);
+
+        if (switchedTo == -1)
+            continue;
+
+        if (switchCount == switchCapacity)
+        {
+            switchCapacity = switchCapacity ? 2 * switchCapacity : 16;
+            switches = (int *)realloc(switches, sizeof(int) * switchCapacity);
+        }
+
+        switches[switchCount++] = switchedTo;
     }
 
-    float * uniqueVertices = (float *)malloc(sizeof(float) * vertexCount * meshType);
-    float * uniqueNormals = (float *)malloc(sizeof(float) * normalCount * meshType);
-    int * faceVertices = (int *)malloc(sizeof(int) * faceCount * meshType);
-    int * faceNormals = (int *)malloc(sizeof(int) * faceCount * meshType);
+    if (vertexCount > LOAD_MODEL_MAX_RECORDS || normalCount > LOAD_MODEL_MAX_RECORDS ||
+        textureCount > LOAD_MODEL_MAX_RECORDS || faceCount > LOAD_MODEL_MAX_RECORDS)
+    {
+        printf("Too many records in %s, at most %d of each kind are supported.\n", filename, LOAD_MODEL_MAX_RECORDS);
+        fclose(input);
+        free(switches);
+        return -1;
+    }
+
+    if (polygonCount == 0 && vertexCount > 0)
+    {
+        long long pointFloats = loadPointCloud(input, vertexCount, mesh);
+        fclose(input);
+        free(switches);
+        return pointFloats;
+    }
+
+    if (libraryName[0] != '\0' && mesh->materialCount > 0)
+        loadMaterialLibrary(filename, libraryName, mesh);
+
+    OBJData data;
+    data.vertices = (float *)malloc(sizeof(float) * vertexCount * meshType);
+    data.normals = (float *)malloc(sizeof(float) * normalCount * meshType);
+    data.texcoords = textureCount > 0 ? (float *)malloc(sizeof(float) * textureCount * 2) : NULL;
+    data.faceVertices = (int *)malloc(sizeof(int) * faceCount * meshType);
+    data.faceNormals = (int *)malloc(sizeof(int) * faceCount * meshType);
+    data.faceTexcoords = (int *)malloc(sizeof(int) * faceCount * meshType);
+    data.faceGroups = (int *)malloc(sizeof(int) * faceCount);
+    data.faceMaterials = (int *)malloc(sizeof(int) * faceCount);
+    data.polygonSizes = (int *)malloc(sizeof(int) * (polygonCount + 1));
+    data.polygonCount = 0;
+    size_t triangleCapacity = faceCount;
 
     // Reset file pointer to top of file
     fseek(input, 0, SEEK_SET);
@@ -89,15 +358,13 @@ int loadOBJ(char * filename, float * scale, float ** vertices, float ** normals)
     // Reset counters for additional computations
     vertexCount     = 0;
     normalCount     = 0;
+    textureCount    = 0;
     faceCount       = 0;
-    
-    float xLargest = 0.0;
-    float yLargest = 0.0;
-    float zLargest = 0.0;
+    switchCount     = 0;
 
-    float xSmallest = 0.0;
-    float ySmallest = 0.0;
-    float zSmallest = 0.0;
+    int currentGroup = -1;
+    int currentMaterial = -1;
+    faceParserFP faceParser = NULL;
 
     // Store file components in memory
     while(fgets(line, sizeof(line), input) != NULL)
@@ -105,106 +372,1031 @@ int loadOBJ(char * filename, float * scale, float ** vertices, float ** normals)
         if (line[0] == 'v' && line[1] == ' ')
         {
             sscanf(line, "v %f %f %f\n",
-                &uniqueVertices[vertexCount],
-                &uniqueVertices[vertexCount + 1],
-                &uniqueVertices[vertexCount + 2]
+                &data.vertices[vertexCount],
+                &data.vertices[vertexCount + 1],
+                &data.vertices[vertexCount + 2]
             );
 
-            if (uniqueVertices[vertexCount] > xLargest)
-                xLargest = uniqueVertices[vertexCount];
-            if (uniqueVertices[vertexCount + 1] > yLargest)
-                yLargest = uniqueVertices[vertexCount + 1];
-            if (uniqueVertices[vertexCount + 2] > zLargest)
-                zLargest = uniqueVertices[vertexCount + 2];
-
-            if (uniqueVertices[vertexCount] < xSmallest)
-                xSmallest = uniqueVertices[vertexCount];
-            if (uniqueVertices[vertexCount + 1] < ySmallest)
-                ySmallest = uniqueVertices[vertexCount + 1];
-            if (uniqueVertices[vertexCount + 2] < zSmallest)
-                zSmallest = uniqueVertices[vertexCount + 2];
-
             vertexCount += 3;
         }
         else if (line[0] == 'v' && line[1] == 'n')
         {
             sscanf(line, "vn %f %f %f\n",
-                &uniqueNormals[normalCount],
-                &uniqueNormals[normalCount + 1],
-                &uniqueNormals[normalCount + 2] 
+                &data.normals[normalCount],
+                &data.normals[normalCount + 1],
+                &data.normals[normalCount + 2] 
             );
 
             normalCount += 3;
         }
-        else if (line[0] == 'f')
+        else if (line[0] == 'v' && line[1] == 't')
         {
-            // Store the first and third position for each vertex
-            // Ignore the texture position
-            sscanf(line, "f %d/%*d/%d %d/%*d/%d %d/%*d/%d\n",
-                &faceVertices[faceCount],
-                &faceNormals[faceCount],
-                &faceVertices[faceCount + 1],
-                &faceNormals[faceCount + 1],
-                &faceVertices[faceCount + 2],
-                &faceNormals[faceCount + 2]
+            sscanf(line, "vt %f %f\n",
+                &data.texcoords[textureCount],
+                &data.texcoords[textureCount + 1]
             );
 
-            // Since face numbers start from one, one is subtracted to match the
-            // programs convention of starting from zero
-            faceVertices[faceCount] -= 1;
-            faceNormals[faceCount] -= 1;
-            faceVertices[faceCount + 1] -= 1;
-            faceNormals[faceCount + 1] -= 1;
-            faceVertices[faceCount + 2] -= 1;
-            faceNormals[faceCount + 2] -= 1;
+            textureCount += 2;
+        }
+        else if ((line[0] == 'g' || line[0] == 'o') && (line[1] == ' ' || line[1] == '\n' || line[1] == '\r'))
+            currentGroup = switches[switchCount++];
+        else if (!strncmp(line, "usemtl ", 7))
+            currentMaterial = switches[switchCount++];
+        else if (line[0] == 'f')
+        {
+            // Faces before the first group or usemtl record use the defaults
+            if (currentGroup == -1)
+                currentGroup = findOrAddGroup(mesh, &groupCapacity, "default");
+            if (currentMaterial == -1)
+                currentMaterial = findOrAddMaterial(mesh, &materialCapacity, "default");
+
+            // Corners are read into place for triangulatePolygons, which
+            // splits polygons once every position is known
+            int vertices[LOAD_MODEL_MAX_FACE_CORNERS];
+            int textures[LOAD_MODEL_MAX_FACE_CORNERS];
+            int normals[LOAD_MODEL_MAX_FACE_CORNERS];
+
+            // The first face picks the parser for the file's layout, and any
+            // record it does not match is read by the generic one
+            if (faceParser == NULL)
+                faceParser = selectFaceParser(line + 1);
+
+            int cornerCount = faceParser(line + 1, vertices, textures, normals);
+
+            if (cornerCount == 0)
+                cornerCount = parseFaceGeneric(line + 1, vertices, textures, normals);
+
+            for (int corner = 0; corner < cornerCount; corner++)
+            {
+                // Since face numbers start from one, one is subtracted to match the
+                // programs convention of starting from zero. Relative indices count
+                // back from the records read so far, as parseFaceRange reads them.
+                // Missing indices, and ones outside those records, become -1.
+                vertices[corner] = resolveFaceIndex(vertices[corner], vertexCount / 3);
+                textures[corner] = resolveFaceIndex(textures[corner], textureCount / 2);
+                normals[corner] = resolveFaceIndex(normals[corner], normalCount / 3);
+
+                if (vertices[corner] == -1)
+                    cornerCount = 0;
+            }
+
+            if (cornerCount < 3 || faceCount / 3 + (size_t)cornerCount - 2 > triangleCapacity)
+                continue;
+
+            memcpy(&data.faceVertices[faceCount], vertices, sizeof(int) * cornerCount);
+            memcpy(&data.faceTexcoords[faceCount], textures, sizeof(int) * cornerCount);
+            memcpy(&data.faceNormals[faceCount], normals, sizeof(int) * cornerCount);
+
+            for (int triangle = 0; triangle < cornerCount - 2; triangle++)
+            {
+                data.faceGroups[faceCount / 3 + triangle] = currentGroup;
+                data.faceMaterials[faceCount / 3 + triangle] = currentMaterial;
+            }
+
+            data.polygonSizes[data.polygonCount++] = cornerCount;
+            faceCount += 3 * (cornerCount - 2);
+        }
+    }
+
+    fclose(input);
+
+    // Bounds are taken over every position, once they are all in memory
+    float center[3];
+    fitMeshToView(mesh, data.vertices, NULL, vertexCount / 3, center);
+
+    data.faceCount = faceCount / 3;
+    triangulatePolygons(&data);
+    writeMeshBatches(mesh, &data, center);
+
+    releaseOBJData(&data);
+    free(switches);
+
+    return faceCount * meshType;
+}
+
+// Private method(s)
+
+/*
+    Allocates and writes the mesh's corners, with the faces sorted by
+    material and then group and positions moved by -center and scaled by
+    the mesh's scale, and records a batch for each run of faces sharing
+    both. Two stable counting sorts give the order, by group first and then
+    by material. The corners are written by parallel jobs, and group bounds
+    are then reduced over each batch. Corners without a normal take
+    the smoothed normal of their position, unless normals are not wanted.
+*/
+void writeMeshBatches(Mesh * mesh, OBJData * data, float * center)
+{
+    size_t faceCount = data->faceCount;
+    int * faceGroups = data->faceGroups;
+    int * faceMaterials = data->faceMaterials;
+
+    mesh->vertices = (float *)malloc(sizeof(float) * 3 * TRIANGULAR_MESH_TYPE * faceCount);
+    mesh->normals = normalsSelected ? (float *)malloc(sizeof(float) * 3 * TRIANGULAR_MESH_TYPE * faceCount) : NULL;
+    mesh->texcoords = data->texcoords != NULL ? (float *)malloc(sizeof(float) * 2 * TRIANGULAR_MESH_TYPE * faceCount) : NULL;
+
+    float * vertices = mesh->vertices;
+    float * vertexNormals = NULL;
+
+    for (size_t corner = 0; corner < 3 * faceCount && mesh->normals != NULL && vertexNormals == NULL; corner++)
+    {
+        if (data->faceNormals[corner] < 0)
+            vertexNormals = generateVertexNormals(data);
+    }
+
+    int bucketCount = mesh->groupCount > mesh->materialCount ? mesh->groupCount : mesh->materialCount;
+    int * bucketStarts = (int *)calloc(bucketCount + 1, sizeof(int));
+    int * groupOrder = (int *)malloc(sizeof(int) * (faceCount + 1));
+    int * faceOrder = (int *)malloc(sizeof(int) * (faceCount + 1));
+
+    for (size_t face = 0; face < faceCount; face++)
+        bucketStarts[faceGroups[face] + 1]++;
+    for (int group = 0; group < mesh->groupCount; group++)
+        bucketStarts[group + 1] += bucketStarts[group];
+    for (size_t face = 0; face < faceCount; face++)
+        groupOrder[bucketStarts[faceGroups[face]]++] = face;
+
+    memset(bucketStarts, 0, sizeof(int) * (bucketCount + 1));
+
+    for (size_t face = 0; face < faceCount; face++)
+        bucketStarts[faceMaterials[face] + 1]++;
+    for (int material = 0; material < mesh->materialCount; material++)
+        bucketStarts[material + 1] += bucketStarts[material];
+    for (size_t i = 0; i < faceCount; i++)
+        faceOrder[bucketStarts[faceMaterials[groupOrder[i]]]++] = groupOrder[i];
+
+    for (int group = 0; group < mesh->groupCount; group++)
+    {
+        MeshGroup * meshGroup = &mesh->groups[group];
+        meshGroup->count = 0;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            meshGroup->boundsMin[axis] = INFINITY;
+            meshGroup->boundsMax[axis] = -INFINITY;
+        }
+    }
+
+    int batchCapacity = 0;
+    mesh->batches = NULL;
+    mesh->batchCount = 0;
+
+    for (size_t i = 0; i < faceCount; i++)
+    {
+        int face = faceOrder[i];
+        MeshBatch * batch = mesh->batchCount > 0 ? &mesh->batches[mesh->batchCount - 1] : NULL;
+
+        if (batch == NULL || batch->group != faceGroups[face] || batch->material != faceMaterials[face])
+        {
+            if (mesh->batchCount == batchCapacity)
+            {
+                batchCapacity = batchCapacity ? 2 * batchCapacity : 16;
+                mesh->batches = (MeshBatch *)realloc(mesh->batches, sizeof(MeshBatch) * batchCapacity);
+            }
+
+            batch = &mesh->batches[mesh->batchCount++];
+            batch->first = 3 * i;
+            batch->count = 0;
+            batch->group = faceGroups[face];
+            batch->material = faceMaterials[face];
+        }
+
+        batch->count += 3;
+        mesh->groups[faceGroups[face]].count += 3;
+    }
+
+    CornerScatter scatter = { mesh, data, center, faceOrder, vertexNormals };
+    parallelFor(faceCount, 0, writeMeshCorners, &scatter);
+
+    // Each batch's corners are contiguous, so group bounds reduce over them
+    for (int i = 0; i < mesh->batchCount; i++)
+    {
+        MeshBatch * batch = &mesh->batches[i];
+        MeshGroup * meshGroup = &mesh->groups[batch->group];
+        float boundsMin[3];
+        float boundsMax[3];
 
-            faceCount += 3;
+        computePositionBounds(&vertices[3 * batch->first], NULL, batch->count, boundsMin, boundsMax);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            meshGroup->boundsMin[axis] = fminf(meshGroup->boundsMin[axis], boundsMin[axis]);
+            meshGroup->boundsMax[axis] = fmaxf(meshGroup->boundsMax[axis], boundsMax[axis]);
         }
     }
 
-    *vertices = (float *)malloc(sizeof(float) * meshType * faceCount);
-    *normals = (float *)malloc(sizeof(float) * meshType * faceCount);
+    for (int group = 0; group < mesh->groupCount; group++)
+    {
+        MeshGroup * meshGroup = &mesh->groups[group];
+        meshGroup->radius = 0.0f;
 
-    vertexCount = 0;
-    normalCount = 0;
+        for (int axis = 0; axis < 3; axis++)
+            meshGroup->center[axis] = meshGroup->count > 0 ? (meshGroup->boundsMax[axis] + meshGroup->boundsMin[axis]) / 2 : 0.0f;
+    }
 
-    float xCenter = (xLargest + xSmallest) / 2;
-    float yCenter = (yLargest + ySmallest) / 2;
-    float zCenter = (zLargest + zSmallest) / 2;
+    // The sphere is centred on the box, and as tight as that allows
+    for (int i = 0; i < mesh->batchCount; i++)
+    {
+        MeshBatch * batch = &mesh->batches[i];
+        MeshGroup * meshGroup = &mesh->groups[batch->group];
+        float radius = computeBoundingRadius(&vertices[3 * batch->first], NULL, batch->count, meshGroup->center);
 
-    // Compute largest overall coordinate for scale calculation
-    float largestCoord = 0.0;
+        meshGroup->radius = fmaxf(meshGroup->radius, radius);
+    }
 
-    if ((fabs(xLargest) + fabs(xSmallest)) > largestCoord)
-        largestCoord = fabs(xLargest) + fabs(xSmallest);
-    if ((fabs(yLargest) + fabs(ySmallest)) > largestCoord)
-        largestCoord = fabs(yLargest) + fabs(ySmallest);
-    if ((fabs(zLargest) + fabs(zSmallest)) > largestCoord)
-        largestCoord = fabs(zLargest) + fabs(zSmallest);
+    free(bucketStarts);
+    free(groupOrder);
+    free(faceOrder);
+    free(vertexNormals);
+}
 
-    *scale = ZOOM_LEVEL_FAR / largestCoord;
+/*
+    Writes the corners of the sorted faces first to end - 1 in place. Each
+    corner's slot is known from its face's position in the order, so
+    ranges of faces are written by separate jobs.
+*/
+void writeMeshCorners(void * argument, size_t first, size_t end)
+{
+    CornerScatter * scatter = (CornerScatter *)argument;
+    OBJData * data = scatter->data;
+    float4 center = { scatter->center[0], scatter->center[1], scatter->center[2], 0.0f };
+    float scale = scatter->mesh->scale;
+    float * vertices = scatter->mesh->vertices;
+    float * normals = scatter->mesh->normals;
+    float * texcoords = scatter->mesh->texcoords;
 
-    for (int i = 0; i < faceCount; i++)
+    for (size_t i = first; i < end; i++)
     {
-        // Subtract center coordinate to center object at origin
-        int faceVertexIndex = 3 * faceVertices[i];
-        (*vertices)[vertexCount]     = uniqueVertices[faceVertexIndex] - xCenter;
-        (*vertices)[vertexCount + 1] = uniqueVertices[faceVertexIndex + 1] - yCenter;
-        (*vertices)[vertexCount + 2] = uniqueVertices[faceVertexIndex + 2] - zCenter;
+        size_t face = scatter->faceOrder[i];
 
-        int faceNormalIndex = 3 * faceNormals[i];
-        (*normals)[normalCount]       = uniqueNormals[faceNormalIndex];
-        (*normals)[normalCount + 1]   = uniqueNormals[faceNormalIndex + 1];
-        (*normals)[normalCount + 2]   = uniqueNormals[faceNormalIndex + 2];
+        for (size_t corner = 3 * i; corner < 3 * i + 3; corner++)
+        {
+            size_t faceCorner = 3 * face + corner - 3 * i;
+
+            // Centre the object at the origin and scale it to fit the view,
+            // as one vector operation per corner
+            size_t faceVertexIndex = 3 * (size_t)data->faceVertices[faceCorner];
+            float4 position = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            memcpy(&position, &data->vertices[faceVertexIndex], sizeof(float) * 3);
+            position = (position - center) * scale;
+            memcpy(&vertices[3 * corner], &position, sizeof(float) * 3);
+
+            if (normals != NULL)
+            {
+                float * normal = data->faceNormals[faceCorner] >= 0 ?
+                    &data->normals[3 * (size_t)data->faceNormals[faceCorner]] : &scatter->vertexNormals[faceVertexIndex];
 
-        vertexCount += 3;
-        normalCount += 3;
+                normals[3 * corner]       = normal[0];
+                normals[3 * corner + 1]   = normal[1];
+                normals[3 * corner + 2]   = normal[2];
+            }
+
+            if (texcoords != NULL)
+            {
+                // Corners without texture coordinates sample the map's corner
+                int faceTexture = data->faceTexcoords[faceCorner];
+                texcoords[2 * corner]     = faceTexture >= 0 ? data->texcoords[2 * (size_t)faceTexture] : 0.0f;
+                texcoords[2 * corner + 1] = faceTexture >= 0 ? data->texcoords[2 * (size_t)faceTexture + 1] : 0.0f;
+            }
+        }
     }
+}
+
+/*
+    Records the whole of a newly loaded mesh as its one model. The box
+    covers the groups drawn from their own corners, the spheres of the
+    instances and the boxes of point chunks.
+*/
+void describeMeshModel(Mesh * mesh)
+{
+    MeshModel * model = (MeshModel *)malloc(sizeof(MeshModel));
+
+    model->firstBatch = 0;
+    model->batchCount = mesh->batchCount;
+    model->firstGroup = 0;
+    model->groupCount = mesh->groupCount;
+    model->firstInstance = 0;
+    model->instanceCount = mesh->instanceCount;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        model->boundsMin[axis] = FLT_MAX;
+        model->boundsMax[axis] = -FLT_MAX;
+    }
+
+    for (int i = 0; i < mesh->groupCount; i++)
+    {
+        MeshGroup * group = &mesh->groups[i];
+
+        for (int axis = 0; axis < 3 && group->count > 0 && !group->instanced; axis++)
+        {
+            model->boundsMin[axis] = fminf(model->boundsMin[axis], group->boundsMin[axis]);
+            model->boundsMax[axis] = fmaxf(model->boundsMax[axis], group->boundsMax[axis]);
+        }
+    }
+
+    for (int i = 0; i < mesh->instanceCount; i++)
+    {
+        MeshInstance * instance = &mesh->instances[i];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            model->boundsMin[axis] = fminf(model->boundsMin[axis], instance->center[axis] - instance->radius);
+            model->boundsMax[axis] = fmaxf(model->boundsMax[axis], instance->center[axis] + instance->radius);
+        }
+    }
+
+    for (int i = 0; i < mesh->pointChunkCount; i++)
+    {
+        PointChunk * chunk = &mesh->pointChunks[i];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            model->boundsMin[axis] = fminf(model->boundsMin[axis], chunk->origin[axis]);
+            model->boundsMax[axis] = fmaxf(model->boundsMax[axis], chunk->origin[axis] + chunk->extent[axis]);
+        }
+    }
+
+    mesh->models = model;
+    mesh->modelCount = 1;
+}
+
+/*
+    Sets the mesh's scale to fit the positions in view once centred on the
+    middle of their box, and its radius to that of the sphere around the
+    origin which then encloses them. With indices, only the positions it
+    picks are counted. center receives the point moved to the origin, which
+    the mesh keeps as well.
+*/
+void fitMeshToView(Mesh * mesh, float * positions, int * indices, size_t count, float * center)
+{
+    float boundsMin[3];
+    float boundsMax[3];
+    float largestExtent = 0.0f;
+
+    computePositionBounds(positions, indices, count, boundsMin, boundsMax);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        center[axis] = (boundsMin[axis] + boundsMax[axis]) / 2;
+        largestExtent = fmaxf(largestExtent, boundsMax[axis] - boundsMin[axis]);
+    }
+
+    mesh->scale = largestExtent > 0.0f ? ZOOM_LEVEL_FAR / largestExtent : 1.0f;
+    memcpy(mesh->center, center, sizeof(mesh->center));
+    mesh->radius = computeBoundingRadius(positions, indices, count, center) * mesh->scale;
+}
+
+/*
+    Finds the box around count positions, or around the positions indices
+    picks, with jobs that each reduce their own range four positions at a
+    time. Without positions the box is empty at the origin.
+*/
+void computePositionBounds(float * positions, int * indices, size_t count, float * boundsMin, float * boundsMax)
+{
+    float partials[BOUNDS_MAX_JOBS][6];
+    BoundsReduction reduction = { positions, indices, boundsGrainSize(count), { 0.0f, 0.0f, 0.0f }, partials };
+
+    parallelFor(count, reduction.grainSize, reduceBoundsRange, &reduction);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        boundsMin[axis] = count > 0 ? INFINITY : 0.0f;
+        boundsMax[axis] = count > 0 ? -INFINITY : 0.0f;
+    }
+
+    for (size_t job = 0; job * reduction.grainSize < count; job++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            boundsMin[axis] = fminf(boundsMin[axis], partials[job][axis]);
+            boundsMax[axis] = fmaxf(boundsMax[axis], partials[job][3 + axis]);
+        }
+    }
+}
+
+/*
+    Returns the distance from center to the farthest of the positions,
+    reduced the same way as the bounds.
+*/
+float computeBoundingRadius(float * positions, int * indices, size_t count, float * center)
+{
+    float partials[BOUNDS_MAX_JOBS][6];
+    BoundsReduction reduction = { positions, indices, boundsGrainSize(count), { center[0], center[1], center[2] }, partials };
+
+    parallelFor(count, reduction.grainSize, reduceRadiusRange, &reduction);
+
+    float farthest = 0.0f;
+
+    for (size_t job = 0; job * reduction.grainSize < count; job++)
+        farthest = fmaxf(farthest, partials[job][0]);
+
+    return sqrtf(farthest);
+}
+
+size_t boundsGrainSize(size_t count)
+{
+    size_t grainSize = BOUNDS_POSITIONS_PER_JOB;
+
+    if ((count + grainSize - 1) / grainSize > BOUNDS_MAX_JOBS)
+        grainSize = (count + BOUNDS_MAX_JOBS - 1) / BOUNDS_MAX_JOBS;
+
+    return grainSize;
+}
+
+/*
+    Writes the box of positions first to end - 1 to the partial result of
+    its job. parallelFor starts every range at a multiple of the grain size,
+    which numbers the jobs.
+*/
+void reduceBoundsRange(void * argument, size_t first, size_t end)
+{
+    BoundsReduction * reduction = (BoundsReduction *)argument;
+    float * partial = reduction->partials[first / reduction->grainSize];
+
+    float4 minX = { INFINITY, INFINITY, INFINITY, INFINITY };
+    float4 minY = minX;
+    float4 minZ = minX;
+    float4 maxX = -minX;
+    float4 maxY = -minX;
+    float4 maxZ = -minX;
+    size_t i = first;
+
+    for (; i + 4 <= end; i += 4)
+    {
+        float4 x, y, z;
+        loadBoundedPositions(reduction, i, &x, &y, &z);
+
+        minX = FLOAT4_MIN(minX, x);
+        minY = FLOAT4_MIN(minY, y);
+        minZ = FLOAT4_MIN(minZ, z);
+        maxX = FLOAT4_MAX(maxX, x);
+        maxY = FLOAT4_MAX(maxY, y);
+        maxZ = FLOAT4_MAX(maxZ, z);
+    }
+
+    float4 * lanes[6] = { &minX, &minY, &minZ, &maxX, &maxY, &maxZ };
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float4 lowest = *lanes[axis];
+        float4 highest = *lanes[3 + axis];
+
+        partial[axis] = fminf(fminf(lowest[0], lowest[1]), fminf(lowest[2], lowest[3]));
+        partial[3 + axis] = fmaxf(fmaxf(highest[0], highest[1]), fmaxf(highest[2], highest[3]));
+    }
+
+    for (; i < end; i++)
+    {
+        float * position = boundedPosition(reduction, i);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            partial[axis] = fminf(partial[axis], position[axis]);
+            partial[3 + axis] = fmaxf(partial[3 + axis], position[axis]);
+        }
+    }
+}
+
+/*
+    Writes the largest squared distance from the reduction's center to
+    positions first to end - 1 to the partial result of its job.
+*/
+void reduceRadiusRange(void * argument, size_t first, size_t end)
+{
+    BoundsReduction * reduction = (BoundsReduction *)argument;
+    float * center = reduction->center;
+    float4 farthest = { 0.0f, 0.0f, 0.0f, 0.0f };
+    size_t i = first;
+
+    for (; i + 4 <= end; i += 4)
+    {
+        float4 x, y, z;
+        loadBoundedPositions(reduction, i, &x, &y, &z);
+
+        x -= center[0];
+        y -= center[1];
+        z -= center[2];
+        farthest = FLOAT4_MAX(farthest, x * x + y * y + z * z);
+    }
+
+    float largest = fmaxf(fmaxf(farthest[0], farthest[1]), fmaxf(farthest[2], farthest[3]));
+
+    for (; i < end; i++)
+    {
+        float * position = boundedPosition(reduction, i);
+        float x = position[0] - center[0];
+        float y = position[1] - center[1];
+        float z = position[2] - center[2];
+
+        largest = fmaxf(largest, x * x + y * y + z * z);
+    }
+
+    reduction->partials[first / reduction->grainSize][0] = largest;
+}
+
+/*
+    Loads four positions from first on with their axes split across
+    vectors, one position per lane.
+*/
+void loadBoundedPositions(BoundsReduction * reduction, size_t first, float4 * x, float4 * y, float4 * z)
+{
+    float * a = boundedPosition(reduction, first);
+    float * b = boundedPosition(reduction, first + 1);
+    float * c = boundedPosition(reduction, first + 2);
+    float * d = boundedPosition(reduction, first + 3);
+
+    *x = (float4){ a[0], b[0], c[0], d[0] };
+    *y = (float4){ a[1], b[1], c[1], d[1] };
+    *z = (float4){ a[2], b[2], c[2], d[2] };
+}
+
+float * boundedPosition(BoundsReduction * reduction, size_t i)
+{
+    return &reduction->positions[3 * (reduction->indices != NULL ? (size_t)reduction->indices[i] : i)];
+}
+
+/*
+    Returns a normal for every position, the average of the normals of the
+    faces around it weighted by their area. Face normals are computed by
+    jobs over slices of the faces, while another job scatters the faces into
+    a list of the faces at each position. Once both are done, each slice's
+    job reduces the lists of its own range of positions. Gathering per
+    position needs no atomics, nor a private copy of every normal for each
+    worker.
+*/
+float * generateVertexNormals(OBJData * data)
+{
+    double startTime = currentTime();
+
+    size_t faceCount = data->faceCount;
+    size_t vertexCount = 0;
+
+    for (size_t corner = 0; corner < 3 * faceCount; corner++)
+    {
+        if ((size_t)data->faceVertices[corner] >= vertexCount)
+            vertexCount = data->faceVertices[corner] + 1;
+    }
+
+    float * faceNormals = (float *)malloc(sizeof(float) * 3 * (faceCount + 1));
+    float * vertexNormals = (float *)malloc(sizeof(float) * 3 * (vertexCount + 1));
+    size_t * vertexFaceStarts = (size_t *)calloc(vertexCount + 1, sizeof(size_t));
+    int * vertexFaces = (int *)malloc(sizeof(int) * (3 * faceCount + 1));
+
+    int sliceCount = faceCount / NORMAL_FACES_PER_SLICE;
+
+    if (sliceCount > LOAD_MODEL_MAX_SLICES)
+        sliceCount = LOAD_MODEL_MAX_SLICES;
+    if (sliceCount < 1)
+        sliceCount = 1;
+
+    // One more slice covers every face and position, for the scatter
+    NormalSlice slices[LOAD_MODEL_MAX_SLICES + 1];
+
+    for (int i = 0; i <= sliceCount; i++)
+    {
+        int sliceIndex = i < sliceCount ? i : 0;
+        int sliceEnd = i < sliceCount ? i + 1 : sliceCount;
+
+        slices[i].data = data;
+        slices[i].faceNormals = faceNormals;
+        slices[i].vertexNormals = vertexNormals;
+        slices[i].vertexFaceStarts = vertexFaceStarts;
+        slices[i].vertexFaces = vertexFaces;
+        slices[i].firstFace = faceCount * sliceIndex / sliceCount;
+        slices[i].faceEnd = faceCount * sliceEnd / sliceCount;
+        slices[i].firstVertex = vertexCount * sliceIndex / sliceCount;
+        slices[i].vertexEnd = vertexCount * sliceEnd / sliceCount;
+    }
+
+    JobCounter facesReady;
+    JobCounter normalsReady;
+    initialiseJobCounter(&facesReady);
+    initialiseJobCounter(&normalsReady);
+
+    for (int i = 0; i < sliceCount; i++)
+        submitJob(faceNormalJob, &slices[i], &facesReady);
+
+    // The scatter is serial and the longest job, and is submitted last so
+    // this thread, which runs its newest job first, starts on it straight
+    // away while the others steal the slices
+    submitJob(scatterVertexFacesJob, &slices[sliceCount], &facesReady);
+
+    for (int i = 0; i < sliceCount; i++)
+        submitJobAfter(&facesReady, vertexNormalJob, &slices[i], &normalsReady);
+
+    waitForJobs(&normalsReady);
 
-    free(uniqueVertices);
-    free(uniqueNormals);
-    free(faceVertices);
     free(faceNormals);
+    free(vertexFaceStarts);
+    free(vertexFaces);
+
+    printf("Generated normals for %zu positions on %d workers in %.1f ms\n", vertexCount, jobWorkerCount(), (currentTime() - startTime) * 1000.0);
+
+    return vertexNormals;
+}
+
+void faceNormalJob(void * argument)
+{
+    NormalSlice * slice = (NormalSlice *)argument;
+    float * vertices = slice->data->vertices;
+    int * faceVertices = slice->data->faceVertices;
+
+    for (size_t face = slice->firstFace; face < slice->faceEnd; face++)
+    {
+        float * a = &vertices[3 * (size_t)faceVertices[3 * face]];
+        float * b = &vertices[3 * (size_t)faceVertices[3 * face + 1]];
+        float * c = &vertices[3 * (size_t)faceVertices[3 * face + 2]];
+
+        float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+        // Left unnormalised, its length is twice the face's area
+        float * normal = &slice->faceNormals[3 * face];
+        normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+        normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+        normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    }
+}
+
+/*
+    Counting sort of the corners by position. vertexFaceStarts[v] is where
+    the faces at position v begin.
+*/
+void scatterVertexFacesJob(void * argument)
+{
+    NormalSlice * slice = (NormalSlice *)argument;
+    int * faceVertices = slice->data->faceVertices;
+    size_t * vertexFaceStarts = slice->vertexFaceStarts;
+    size_t cornerCount = 3 * slice->faceEnd;
+    size_t vertexCount = slice->vertexEnd;
+
+    for (size_t corner = 0; corner < cornerCount; corner++)
+        vertexFaceStarts[faceVertices[corner] + 1]++;
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+        vertexFaceStarts[vertex + 1] += vertexFaceStarts[vertex];
+    for (size_t corner = 0; corner < cornerCount; corner++)
+        slice->vertexFaces[vertexFaceStarts[faceVertices[corner]]++] = corner / 3;
+
+    // The scatter advanced each start to the next position's, so shift back
+    for (size_t vertex = vertexCount; vertex > 0; vertex--)
+        vertexFaceStarts[vertex] = vertexFaceStarts[vertex - 1];
+
+    vertexFaceStarts[0] = 0;
+}
+
+void vertexNormalJob(void * argument)
+{
+    NormalSlice * slice = (NormalSlice *)argument;
+
+    for (size_t vertex = slice->firstVertex; vertex < slice->vertexEnd; vertex++)
+    {
+        float sum[3] = { 0.0f, 0.0f, 0.0f };
+
+        for (size_t i = slice->vertexFaceStarts[vertex]; i < slice->vertexFaceStarts[vertex + 1]; i++)
+        {
+            float * faceNormal = &slice->faceNormals[3 * (size_t)slice->vertexFaces[i]];
+
+            sum[0] += faceNormal[0];
+            sum[1] += faceNormal[1];
+            sum[2] += faceNormal[2];
+        }
+
+        // Positions only used by degenerate faces point along z
+        float length = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+        float * normal = &slice->vertexNormals[3 * vertex];
+
+        normal[0] = length > 0.0f ? sum[0] / length : 0.0f;
+        normal[1] = length > 0.0f ? sum[1] / length : 0.0f;
+        normal[2] = length > 0.0f ? sum[2] / length : 1.0f;
+    }
+}
+
+/*
+    Reads every corner of any face record, up to LOAD_MODEL_MAX_FACE_CORNERS,
+    and returns how many there are. A corner is anything up to the next
+    space, and a comment ends the record.
+*/
+int parseFaceGeneric(char * cursor, int * vertices, int * textures, int * normals)
+{
+    int cornerCount = 0;
+
+    for (cursor += strspn(cursor, " \t"); !isFaceRecordEnd(*cursor) && cornerCount < LOAD_MODEL_MAX_FACE_CORNERS; cornerCount++)
+    {
+        parseFaceCorner(cursor, &vertices[cornerCount], &textures[cornerCount], &normals[cornerCount]);
+
+        cursor += strcspn(cursor, " \t\r\n");
+        cursor += strspn(cursor, " \t");
+    }
+
+    return cornerCount;
+}
+
+/*
+    Counts the corners of a face record as parseFaceGeneric reads them.
+*/
+int countFaceCorners(char * record)
+{
+    int cornerCount = 0;
+
+    for (record += strspn(record, " \t"); !isFaceRecordEnd(*record) && cornerCount < LOAD_MODEL_MAX_FACE_CORNERS; cornerCount++)
+    {
+        record += strcspn(record, " \t\r\n");
+        record += strspn(record, " \t");
+    }
+
+    return cornerCount;
+}
+
+bool isFaceRecordEnd(char character)
+{
+    return character == '\0' || character == '\r' || character == '\n' || character == '#';
+}
+
+faceParserFP selectFaceParser(char * record)
+{
+    return faceParsers[detectFaceLayout(record)];
+}
+
+/*
+    Picks the layout from the first corner of a face record, or the generic
+    layout when the record is not a triangle or quad of that layout
+    throughout.
+*/
+FaceLayout detectFaceLayout(char * record)
+{
+    char * corner = record + strspn(record, " \t");
+    char * end = corner + strcspn(corner, " \t\r\n");
+    char * slash = memchr(corner, '/', end - corner);
+    FaceLayout layout;
+
+    if (slash == NULL)
+        layout = FACE_LAYOUT_V;
+    else if (slash[1] == '/')
+        layout = FACE_LAYOUT_V_VN;
+    else if (memchr(slash + 1, '/', end - slash - 1) != NULL)
+        layout = FACE_LAYOUT_V_VT_VN;
+    else
+        layout = FACE_LAYOUT_V_VT;
+
+    int vertices[LOAD_MODEL_MAX_FACE_CORNERS];
+    int textures[LOAD_MODEL_MAX_FACE_CORNERS];
+    int normals[LOAD_MODEL_MAX_FACE_CORNERS];
+
+    if (faceParsers[layout](record, vertices, textures, normals) == 0)
+        layout = FACE_LAYOUT_GENERIC;
+
+    return layout;
+}
+
+/*
+    Turns a face index as written, from one or relative to the end, into an
+    index into the recordCount records read so far, or -1 when it is
+    missing or outside them.
+*/
+int resolveFaceIndex(int index, size_t recordCount)
+{
+    long long resolved = index < 0 ? (long long)recordCount + index : (long long)index - 1;
+
+    return resolved >= 0 && (size_t)resolved < recordCount ? (int)resolved : -1;
+}
+
+/*
+    Reads the digits of a positive index, leaving the cursor after them.
+*/
+int readFaceIndex(char ** cursor)
+{
+    char * digit = *cursor;
+    int value = 0;
+
+    while ((unsigned char)(*digit - '0') < 10)
+        value = 10 * value + (*digit++ - '0');
+
+    *cursor = digit;
+
+    return value;
+}
+
+/*
+    Reads one corner of a face record, v, v/vt, v//vn or v/vt/vn, and
+    returns the text after it. Missing indices are read as zero, which no
+    record has.
+*/
+char * parseFaceCorner(char * cursor, int * vertex, int * texture, int * normal)
+{
+    *vertex = strtol(cursor, &cursor, 10);
+    *texture = 0;
+    *normal = 0;
+
+    if (*cursor == '/' && *++cursor != '/')
+        *texture = strtol(cursor, &cursor, 10);
+
+    if (*cursor == '/')
+        *normal = strtol(cursor + 1, &cursor, 10);
+
+    return cursor;
+}
+
+void releaseOBJData(OBJData * data)
+{
+    free(data->vertices);
+    free(data->normals);
+    free(data->texcoords);
+    free(data->faceVertices);
+    free(data->faceNormals);
+    free(data->faceTexcoords);
+    free(data->faceGroups);
+    free(data->faceMaterials);
+    free(data->polygonSizes);
+}
+
+/*
+    Splits every polygon of more than three corners in place. Each polygon's
+    corners were stored at the start of the room for its triangles, which
+    always fits them, so they are copied aside on the stack and the
+    triangles written over them.
+*/
+void triangulatePolygons(OBJData * data)
+{
+    int vertices[LOAD_MODEL_MAX_FACE_CORNERS];
+    int textures[LOAD_MODEL_MAX_FACE_CORNERS];
+    int normals[LOAD_MODEL_MAX_FACE_CORNERS];
+    int triangles[3 * (LOAD_MODEL_MAX_FACE_CORNERS - 2)];
+
+    size_t first = 0;
+
+    for (size_t polygon = 0; polygon < data->polygonCount; polygon++)
+    {
+        int cornerCount = data->polygonSizes[polygon];
+
+        if (cornerCount > 3)
+        {
+            memcpy(vertices, &data->faceVertices[first], sizeof(int) * cornerCount);
+            memcpy(textures, &data->faceTexcoords[first], sizeof(int) * cornerCount);
+            memcpy(normals, &data->faceNormals[first], sizeof(int) * cornerCount);
+
+            triangulatePolygon(data->vertices, vertices, cornerCount, triangles);
+
+            for (int i = 0; i < 3 * (cornerCount - 2); i++)
+            {
+                data->faceVertices[first + i] = vertices[triangles[i]];
+                data->faceTexcoords[first + i] = textures[triangles[i]];
+                data->faceNormals[first + i] = normals[triangles[i]];
+            }
+        }
+
+        first += 3 * (cornerCount - 2);
+    }
+}
+
+/*
+    Writes the corners of the cornerCount - 2 triangles of a polygon, in
+    the polygon's winding. The polygon is projected onto the plane of the
+    largest component of its Newell normal. A convex polygon is split as a
+    fan from its first corner. A concave one has ears clipped, corners whose
+    triangle is convex and holds no other corner, and whatever is left when
+    no ear can be found, from a self intersecting or degenerate polygon, is
+    split as a fan.
+*/
+void triangulatePolygon(float * positions, int * vertices, int cornerCount, int * triangles)
+{
+    float normal[3] = { 0.0f, 0.0f, 0.0f };
+
+    for (int i = 0; i < cornerCount; i++)
+    {
+        float * current = &positions[3 * (size_t)vertices[i]];
+        float * next = &positions[3 * (size_t)vertices[(i + 1) % cornerCount]];
+
+        normal[0] += (current[1] - next[1]) * (current[2] + next[2]);
+        normal[1] += (current[2] - next[2]) * (current[0] + next[0]);
+        normal[2] += (current[0] - next[0]) * (current[1] + next[1]);
+    }
+
+    // The two axes kept, ordered so counter clockwise turns are positive
+    int dropped = fabsf(normal[0]) > fabsf(normal[1]) ? (fabsf(normal[0]) > fabsf(normal[2]) ? 0 : 2) : (fabsf(normal[1]) > fabsf(normal[2]) ? 1 : 2);
+    int uAxis = (dropped + 1) % 3;
+    int vAxis = (dropped + 2) % 3;
+
+    if (normal[dropped] < 0.0f)
+    {
+        uAxis = (dropped + 2) % 3;
+        vAxis = (dropped + 1) % 3;
+    }
+
+    float projected[2 * LOAD_MODEL_MAX_FACE_CORNERS];
+    int previous[LOAD_MODEL_MAX_FACE_CORNERS];
+    int next[LOAD_MODEL_MAX_FACE_CORNERS];
+    bool convex = true;
+
+    for (int i = 0; i < cornerCount; i++)
+    {
+        projected[2 * i] = positions[3 * (size_t)vertices[i] + uAxis];
+        projected[2 * i + 1] = positions[3 * (size_t)vertices[i] + vAxis];
+        previous[i] = (i + cornerCount - 1) % cornerCount;
+        next[i] = (i + 1) % cornerCount;
+    }
+
+    for (int i = 0; i < cornerCount && convex; i++)
+        convex = polygonTurn(projected, previous[i], i, next[i]) >= 0.0f;
+
+    int triangleCount = 0;
+    int remaining = cornerCount;
+    int corner = 0;
+
+    // Each pass round the remaining corners must clip an ear
+    for (int sinceClip = 0; !convex && remaining > 3 && sinceClip < remaining; sinceClip++, corner = next[corner])
+    {
+        int before = previous[corner];
+        int after = next[corner];
+        bool ear = polygonTurn(projected, before, corner, after) > 0.0f;
+
+        for (int other = next[after]; ear && other != before; other = next[other])
+            ear = !pointInTriangle(projected, other, before, corner, after);
+
+        if (!ear)
+            continue;
+
+        triangles[3 * triangleCount] = before;
+        triangles[3 * triangleCount + 1] = corner;
+        triangles[3 * triangleCount + 2] = after;
+        triangleCount++;
+
+        next[before] = after;
+        previous[after] = before;
+        remaining--;
+        sinceClip = -1;
+        corner = before;
+    }
+
+    for (int i = next[corner]; next[i] != corner; i = next[i])
+    {
+        triangles[3 * triangleCount] = corner;
+        triangles[3 * triangleCount + 1] = i;
+        triangles[3 * triangleCount + 2] = next[i];
+        triangleCount++;
+    }
+}
+
+/*
+    Twice the signed area of the projected triangle a, b, c, positive when
+    it turns counter clockwise.
+*/
+float polygonTurn(float * projected, int a, int b, int c)
+{
+    return (projected[2 * b] - projected[2 * a]) * (projected[2 * c + 1] - projected[2 * a + 1])
+        - (projected[2 * b + 1] - projected[2 * a + 1]) * (projected[2 * c] - projected[2 * a]);
+}
+
+/*
+    Whether corner p is inside or on the counter clockwise triangle a, b, c.
+    A corner at the same place as one of the triangle's, where a polygon
+    touches itself, does not count.
+*/
+bool pointInTriangle(float * projected, int p, int a, int b, int c)
+{
+    int corners[3] = { a, b, c };
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (projected[2 * p] == projected[2 * corners[i]] && projected[2 * p + 1] == projected[2 * corners[i] + 1])
+            return false;
+    }
+
+    return polygonTurn(projected, a, b, p) >= 0.0f
+        && polygonTurn(projected, b, c, p) >= 0.0f
+        && polygonTurn(projected, c, a, p) >= 0.0f;
+}
+
+int findGroup(Mesh * mesh, char * name)
+{
+    // Searched from the end, since the latest group is the likeliest match
+    for (int i = mesh->groupCount - 1; i >= 0; i--)
+    {
+        if (!strcmp(mesh->groups[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+int findOrAddGroup(Mesh * mesh, int * groupCapacity, char * name)
+{
+    int group = findGroup(mesh, name);
+
+    if (group != -1)
+        return group;
+
+    if (mesh->groupCount == *groupCapacity)
+    {
+        *groupCapacity = *groupCapacity ? 2 * *groupCapacity : 8;
+        mesh->groups = (MeshGroup *)realloc(mesh->groups, sizeof(MeshGroup) * *groupCapacity);
+    }
+
+    MeshGroup * meshGroup = &mesh->groups[mesh->groupCount];
+    memset(meshGroup, 0, sizeof(MeshGroup));
+    snprintf(meshGroup->name, sizeof(meshGroup->name), "%s", name);
+    meshGroup->visible = true;
 
-    return vertexCount;
+    return mesh->groupCount++;
 }
\ No newline at end of file
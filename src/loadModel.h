@@ -1,8 +1,275 @@
 #ifndef LOAD_MODEL
 #define LOAD_MODEL
 
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "simdTypes.h"
+
+#define MESH_GROUP_NAME_LENGTH 64
+#define MESH_MATERIAL_NAME_LENGTH 64
+#define MESH_TEXTURE_PATH_LENGTH 512
+#define LOAD_MODEL_MAX_SLICES 64
+#define LOAD_MODEL_LINE_LENGTH 4096
+#define LOAD_MODEL_MAX_FACE_CORNERS 1024
+#define LOAD_MODEL_MAX_RECORDS INT_MAX
+
+// A g or o record's faces, count corners in all. Bounds are in the same
+// centred space as the mesh vertices. An instanced group's corners are
+// only drawn through the instances placing them.
+typedef struct MeshGroup
+{
+    char name[MESH_GROUP_NAME_LENGTH];
+    size_t count;
+    float boundsMin[3];
+    float boundsMax[3];
+    float center[3];
+    float radius;
+    bool visible;
+    bool instanced;
+}
+MeshGroup;
+
+// A placement of the corners of the group prototype. group is the one the
+// instance stands for, which may be the prototype itself, and hides it
+// with that group. transform is a column major matrix, rigid apart from
+// the uniform scale of grid scenes, and center and radius the instance's
+// bounding sphere.
+typedef struct MeshInstance
+{
+    float transform[4][4];
+    float center[3];
+    float radius;
+    int prototype;
+    int group;
+}
+MeshInstance;
+
+// A usemtl material. Faces before any usemtl, and materials missing from
+// the MTL library, use the scene's model colour. diffuseMap is the path of
+// the map_Kd image, or empty.
+typedef struct Material
+{
+    char name[MESH_MATERIAL_NAME_LENGTH];
+    char diffuseMap[MESH_TEXTURE_PATH_LENGTH];
+    float diffuse[3];
+    float specular[3];
+    float shininess;
+}
+Material;
+
+// Corners first to first + count - 1 share one group and one material.
+// Batches are sorted by material and then by group.
+typedef struct MeshBatch
+{
+    size_t first;
+    size_t count;
+    int group;
+    int material;
+}
+MeshBatch;
+
+// Unique records and zero based per face indices read by a loader, before
+// the faces are sorted into batches. texcoords is NULL without vt records.
+// A corner without a texture or normal index has -1 in its place.
+// polygonSizes has the corner count of each face record in order. Until
+// triangulatePolygons runs, a polygon of n corners has them at the start of
+// the room for its n - 2 triangles. Records and faces are numbered with int,
+// up to LOAD_MODEL_MAX_RECORDS of each, while counts of corners and floats,
+// which pass 2^31 first, are size_t.
+typedef struct OBJData
+{
+    float * vertices;
+    float * normals;
+    float * texcoords;
+    int * faceVertices;
+    int * faceNormals;
+    int * faceTexcoords;
+    int * faceGroups;
+    int * faceMaterials;
+    int * polygonSizes;
+    size_t polygonCount;
+    size_t faceCount;
+}
+OBJData;
+
+// Corner layouts of f records. Files nearly always keep the layout of their
+// first face, which picks a parser for the rest.
+typedef enum FaceLayout
+{
+    FACE_LAYOUT_GENERIC,
+    FACE_LAYOUT_V,
+    FACE_LAYOUT_V_VT,
+    FACE_LAYOUT_V_VN,
+    FACE_LAYOUT_V_VT_VN
+}
+FaceLayout;
+
+// Reads the position, texture and normal index of each corner of a face
+// record, as written in the file, with zero for missing ones. Returns the
+// number of corners, or 0 when the record does not have the parser's layout.
+typedef int (* faceParserFP)(char * cursor, int * vertices, int * textures, int * normals);
+
+// The faces and positions one job covers while generating normals
+typedef struct NormalSlice
+{
+    OBJData * data;
+    float * faceNormals;
+    float * vertexNormals;
+    size_t * vertexFaceStarts;
+    int * vertexFaces;
+    size_t firstFace;
+    size_t faceEnd;
+    size_t firstVertex;
+    size_t vertexEnd;
+}
+NormalSlice;
+
+// A point of a point cloud. position is quantized over the box of its
+// chunk, 0 to 65535 along each axis, and its fourth value only pads the
+// colour to a four byte boundary. Colours are RGBA with 8 bits each.
+typedef struct PointVertex
+{
+    unsigned short position[4];
+    unsigned char color[4];
+}
+PointVertex;
+
+// Points first to first + count - 1 of a point cloud, which lie in one
+// cell of a grid over the cloud. They are in random order, so any prefix
+// is an even subsample of the chunk. Positions are quantized over the box
+// from origin to origin + extent, and center and radius give the sphere
+// around the points themselves. spacing is the typical distance between
+// neighbouring points.
+typedef struct PointChunk
+{
+    size_t first;
+    size_t count;
+    float origin[3];
+    float extent[3];
+    float center[3];
+    float radius;
+    float spacing;
+}
+PointChunk;
+
+// The part of a mesh read from one file. Its batches, groups and instances
+// are contiguous, and the box around its corners and instances is in the
+// mesh's space.
+typedef struct MeshModel
+{
+    int firstBatch;
+    int batchCount;
+    int firstGroup;
+    int groupCount;
+    int firstInstance;
+    int instanceCount;
+    float boundsMin[3];
+    float boundsMax[3];
+}
+MeshModel;
+
+// texcoords has two floats per corner, or is NULL for models without vt.
+// normals is NULL when normals were not selected, for flat shading.
+// Vertices are centred and already multiplied by scale, which fits the
+// model in view, after moving center of the file's positions to the
+// origin. radius is that of the sphere around the origin which encloses
+// them. vertexCount is the number of position floats, three per
+// corner. A point cloud, a file of v records without faces, has points in
+// chunks instead of corners, and a vertexCount of 0. Instances are sorted
+// by prototype. A loaded file is one model, and merged scenes have one for
+// each of their files.
+typedef struct Mesh
+{
+    float * vertices;
+    float * normals;
+    float * texcoords;
+    size_t vertexCount;
+    float scale;
+    float center[3];
+    float radius;
+    MeshGroup * groups;
+    int groupCount;
+    Material * materials;
+    int materialCount;
+    MeshBatch * batches;
+    int batchCount;
+    MeshInstance * instances;
+    int instanceCount;
+    MeshModel * models;
+    int modelCount;
+    PointVertex * points;
+    size_t pointCount;
+    PointChunk * pointChunks;
+    int pointChunkCount;
+}
+Mesh;
+
+// What the jobs writing a mesh's sorted corners share
+typedef struct CornerScatter
+{
+    Mesh * mesh;
+    OBJData * data;
+    float * center;
+    int * faceOrder;
+    float * vertexNormals;
+}
+CornerScatter;
+
+// A reduction over positions, or over the positions indices picks when it
+// is not NULL. Each job writes its result to its own row of partials.
+typedef struct BoundsReduction
+{
+    float * positions;
+    int * indices;
+    size_t grainSize;
+    float center[3];
+    float (* partials)[6];
+}
+BoundsReduction;
+
 // Public method(s)
-int loadModel(char * filename, float * scale, float ** verticies, float ** normals);
-int loadOBJ(char * filename, float * scale, float ** verticies, float ** normals);
+void selectModelGroups(char * groupNames);
+void selectModelNormals(bool normals);
+long long loadModel(char * filename, Mesh * mesh);
+long long loadOBJ(char * filename, Mesh * mesh);
+void releaseMesh(Mesh * mesh);
+
+// Private method(s)
+void writeMeshBatches(Mesh * mesh, OBJData * data, float * center);
+void describeMeshModel(Mesh * mesh);
+void writeMeshCorners(void * argument, size_t first, size_t end);
+void fitMeshToView(Mesh * mesh, float * positions, int * indices, size_t count, float * center);
+void computePositionBounds(float * positions, int * indices, size_t count, float * boundsMin, float * boundsMax);
+float computeBoundingRadius(float * positions, int * indices, size_t count, float * center);
+size_t boundsGrainSize(size_t count);
+void reduceBoundsRange(void * argument, size_t first, size_t end);
+void reduceRadiusRange(void * argument, size_t first, size_t end);
+void loadBoundedPositions(BoundsReduction * reduction, size_t first, float4 * x, float4 * y, float4 * z);
+float * boundedPosition(BoundsReduction * reduction, size_t i);
+void releaseOBJData(OBJData * data);
+float * generateVertexNormals(OBJData * data);
+void faceNormalJob(void * argument);
+void scatterVertexFacesJob(void * argument);
+void vertexNormalJob(void * argument);
+void triangulatePolygons(OBJData * data);
+void triangulatePolygon(float * positions, int * vertices, int cornerCount, int * triangles);
+float polygonTurn(float * projected, int a, int b, int c);
+bool pointInTriangle(float * projected, int p, int a, int b, int c);
+int parseFaceGeneric(char * cursor, int * vertices, int * textures, int * normals);
+int parseFaceV(char * cursor, int * vertices, int * textures, int * normals);
+int parseFaceVT(char * cursor, int * vertices, int * textures, int * normals);
+int parseFaceVN(char * cursor, int * vertices, int * textures, int * normals);
+int parseFaceVTVN(char * cursor, int * vertices, int * textures, int * normals);
+int countFaceCorners(char * record);
+bool isFaceRecordEnd(char character);
+faceParserFP selectFaceParser(char * record);
+FaceLayout detectFaceLayout(char * record);
+int resolveFaceIndex(int index, size_t recordCount);
+int readFaceIndex(char ** cursor);
+char * parseFaceCorner(char * cursor, int * vertex, int * texture, int * normal);
+int findGroup(Mesh * mesh, char * name);
+int findOrAddGroup(Mesh * mesh, int * groupCapacity, char * name);
 
 #endif
\ No newline at end of file
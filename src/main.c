@@ -1,16 +1,19 @@
 #include <stdio.h>
 
 #include "application.h"
+#include "commandLine.h"
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    ApplicationOptions options;
+
+    if (!parseCommandLine(argc, argv, &options))
     {
-        printf("Usage: ./model-viewer <model>.obj\n");
+        printUsage();
         return 1;
     }
 
-    initialiseApplication(argv[1]);
+    initialiseApplication(&options);
     renderFrames();
     releaseResources();
 
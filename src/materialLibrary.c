@@ -0,0 +1,123 @@
+/******************************************************************************
+ * File:        materialLibrary.c
+ * Description: Reads the MTL library an OBJ file names with mtllib, filling
+ *              in the materials its usemtl records refer to.
+ *              - Kd, Ks and Ns are read, as the diffuse colour, specular
+ *                colour and specular exponent, and map_Kd as the path of the
+ *                diffuse texture.
+ *              - Materials the library does not define keep the scene's
+ *                model colour and reflectance.
+ ******************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "materialLibrary.h"
+#include "sceneSettings.h"
+
+// Public method(s)
+
+/*
+    The library is looked up next to the model, as exporters write it. Only
+    materials already in the mesh are filled in.
+*/
+bool loadMaterialLibrary(char * modelPath, char * libraryName, Mesh * mesh)
+{
+    char libraryPath[MATERIAL_LIBRARY_PATH_LENGTH];
+    char * separator = strrchr(modelPath, '/');
+    int directoryLength = separator != NULL ? (int)(separator - modelPath) + 1 : 0;
+
+    if (snprintf(libraryPath, sizeof(libraryPath), "%.*s%s", directoryLength, modelPath, libraryName) >= (int)sizeof(libraryPath))
+        return false;
+
+    FILE * input = fopen(libraryPath, "r");
+
+    if (input == NULL)
+    {
+        printf("Could not open material library %s, using the default material.\n", libraryPath);
+        return false;
+    }
+
+    char line[256];
+    Material * material = NULL;
+
+    while (fgets(line, sizeof(line), input) != NULL)
+    {
+        // Definitions are often indented under their newmtl
+        char * record = line + strspn(line, " \t");
+        char name[MESH_MATERIAL_NAME_LENGTH];
+
+        if (sscanf(record, "newmtl %63[^\r\n]", name) == 1)
+        {
+            int index = findMaterial(mesh, name);
+            material = index != -1 ? &mesh->materials[index] : NULL;
+        }
+        else if (material == NULL)
+            continue;
+        else if (!strncmp(record, "Kd ", 3))
+            sscanf(record, "Kd %f %f %f", &material->diffuse[0], &material->diffuse[1], &material->diffuse[2]);
+        else if (!strncmp(record, "Ks ", 3))
+            sscanf(record, "Ks %f %f %f", &material->specular[0], &material->specular[1], &material->specular[2]);
+        else if (!strncmp(record, "Ns ", 3))
+            sscanf(record, "Ns %f", &material->shininess);
+        else if (!strncmp(record, "map_Kd ", 7))
+        {
+            // Options such as -s or -bm come first, the file name is last
+            char * end = record + strcspn(record, "\r\n");
+
+            while (end > record && (end[-1] == ' ' || end[-1] == '\t'))
+                end--;
+
+            char * fileName = end;
+
+            while (fileName > record + 7 && fileName[-1] != ' ' && fileName[-1] != '\t')
+                fileName--;
+
+            snprintf(material->diffuseMap, sizeof(material->diffuseMap), "%.*s%.*s",
+                directoryLength, modelPath, (int)(end - fileName), fileName);
+        }
+    }
+
+    fclose(input);
+
+    return true;
+}
+
+int findMaterial(Mesh * mesh, char * name)
+{
+    // Searched from the end, since the latest material is the likeliest match
+    for (int i = mesh->materialCount - 1; i >= 0; i--)
+    {
+        if (!strcmp(mesh->materials[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+int findOrAddMaterial(Mesh * mesh, int * materialCapacity, char * name)
+{
+    int material = findMaterial(mesh, name);
+
+    if (material != -1)
+        return material;
+
+    if (mesh->materialCount == *materialCapacity)
+    {
+        *materialCapacity = *materialCapacity ? 2 * *materialCapacity : 8;
+        mesh->materials = (Material *)realloc(mesh->materials, sizeof(Material) * *materialCapacity);
+    }
+
+    Material * newMaterial = &mesh->materials[mesh->materialCount];
+    float modelColor[3] = SCENE_MODEL_COLOR;
+
+    snprintf(newMaterial->name, sizeof(newMaterial->name), "%s", name);
+    newMaterial->diffuseMap[0] = '\0';
+    memcpy(newMaterial->diffuse, modelColor, sizeof(modelColor));
+    memcpy(newMaterial->specular, modelColor, sizeof(modelColor));
+    newMaterial->shininess = SCENE_REFLECTANCE;
+
+    return mesh->materialCount++;
+}
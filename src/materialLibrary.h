@@ -0,0 +1,15 @@
+#ifndef MATERIAL_LIBRARY
+#define MATERIAL_LIBRARY
+
+#include <stdbool.h>
+
+#include "loadModel.h"
+
+#define MATERIAL_LIBRARY_PATH_LENGTH 1024
+
+// Public method(s)
+bool loadMaterialLibrary(char * modelPath, char * libraryName, Mesh * mesh);
+int findMaterial(Mesh * mesh, char * name);
+int findOrAddMaterial(Mesh * mesh, int * materialCapacity, char * name);
+
+#endif
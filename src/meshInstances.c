@@ -0,0 +1,653 @@
+/******************************************************************************
+ * File:        meshInstances.c
+ * Description: Draws repeated geometry from one copy of its corners.
+ *              - Groups whose corners match another group's after a rotation
+ *                and translation become instances of that group.
+ *              - An instance list file places further copies of groups.
+ *              - A grid scene repeats the whole model for benchmarks.
+ *              - Corners only reached through another group's instances are
+ *                removed from the mesh.
+ * Notes:       Corners are matched in the order they were written, which
+ *              exporters keep for copies of one part, so no search for
+ *              corresponding corners is needed.
+ ******************************************************************************/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meshInstances.h"
+
+static bool detectionSelected = false;
+static char * instanceListPath = NULL;
+static int gridColumns = 0;
+static int gridRows = 0;
+
+// Public method(s)
+
+/*
+    Whether later loads look for groups which repeat another group's
+    geometry. Off by default, since the software and path traced renderers
+    read every corner from the mesh.
+*/
+void selectInstanceDetection(bool detect)
+{
+    detectionSelected = detect;
+}
+
+/*
+    A file of further copies of groups for later loads to place, or NULL for
+    none. Each line is
+
+        x y z axisX axisY axisZ degrees group name
+
+    which rotates a copy of the group about its own centre and then moves it
+    by x y z in the model file's units. Lines starting with # are comments.
+*/
+void selectInstanceList(char * listPath)
+{
+    instanceListPath = listPath;
+}
+
+/*
+    Repeats the loaded model in a grid of columns by rows copies, scaled to
+    fit the view together, or not at all when either is 0.
+*/
+void selectInstanceGrid(int columns, int rows)
+{
+    gridColumns = columns;
+    gridRows = rows;
+}
+
+/*
+    Finds the mesh's instances as selected, and removes the corners which
+    are then drawn through another group's.
+*/
+void instanceMesh(Mesh * mesh)
+{
+    if (!detectionSelected && instanceListPath == NULL && (gridColumns == 0 || gridRows == 0))
+        return;
+
+    int instanceCapacity = 0;
+    size_t cornerCount = mesh->vertexCount / 3;
+    GroupBatches groupBatches;
+
+    collectGroupBatches(mesh, &groupBatches);
+
+    if (detectionSelected)
+        detectRepeatedGroups(mesh, &groupBatches, &instanceCapacity);
+
+    if (instanceListPath != NULL)
+        loadInstanceList(mesh, instanceListPath, &instanceCapacity);
+
+    if (gridColumns > 0 && gridRows > 0)
+        applyInstanceGrid(mesh, &instanceCapacity);
+
+    releaseGroupBatches(&groupBatches);
+
+    if (mesh->instanceCount == 0)
+        return;
+
+    qsort(mesh->instances, mesh->instanceCount, sizeof(MeshInstance), compareInstances);
+    removeUnusedCorners(mesh);
+
+    int prototypeCount = 0;
+
+    for (int i = 0; i < mesh->groupCount; i++)
+        prototypeCount += mesh->groups[i].instanced;
+
+    printf("Drawing %d instances of %d groups, %zu of %zu corners kept\n",
+        mesh->instanceCount, prototypeCount, mesh->vertexCount / 3, cornerCount);
+}
+
+// Private method(s)
+
+void collectGroupBatches(Mesh * mesh, GroupBatches * groupBatches)
+{
+    int * batchStarts = (int *)calloc(mesh->groupCount + 1, sizeof(int));
+    int * batchIndices = (int *)malloc(sizeof(int) * (mesh->batchCount + 1));
+
+    for (int i = 0; i < mesh->batchCount; i++)
+        batchStarts[mesh->batches[i].group + 1]++;
+
+    for (int group = 0; group < mesh->groupCount; group++)
+        batchStarts[group + 1] += batchStarts[group];
+
+    int * cursors = (int *)malloc(sizeof(int) * (mesh->groupCount + 1));
+    memcpy(cursors, batchStarts, sizeof(int) * (mesh->groupCount + 1));
+
+    for (int i = 0; i < mesh->batchCount; i++)
+        batchIndices[cursors[mesh->batches[i].group]++] = i;
+
+    free(cursors);
+
+    groupBatches->batchStarts = batchStarts;
+    groupBatches->batchIndices = batchIndices;
+}
+
+void releaseGroupBatches(GroupBatches * groupBatches)
+{
+    free(groupBatches->batchStarts);
+    free(groupBatches->batchIndices);
+}
+
+/*
+    Compares every group with the prototypes found so far which have the
+    same batches and spread of corners, and makes it an instance of the
+    first whose corners it matches. Prototypes with at least one copy are
+    instanced as well, in their own place.
+*/
+void detectRepeatedGroups(Mesh * mesh, GroupBatches * groupBatches, int * instanceCapacity)
+{
+    InstanceCandidate * candidates = (InstanceCandidate *)calloc(mesh->groupCount, sizeof(InstanceCandidate));
+    int * prototypes = (int *)malloc(sizeof(int) * mesh->groupCount);
+    bool * repeated = (bool *)calloc(mesh->groupCount, sizeof(bool));
+    int prototypeCount = 0;
+
+    for (int group = 0; group < mesh->groupCount; group++)
+    {
+        if (mesh->groups[group].count == 0)
+            continue;
+
+        describeCandidate(mesh, groupBatches, group, &candidates[group]);
+
+        bool matched = false;
+
+        for (int i = 0; i < prototypeCount && !matched; i++)
+        {
+            int prototype = prototypes[i];
+            float spreadTolerance = 2.0f * INSTANCE_POSITION_TOLERANCE * candidates[prototype].spread;
+            mat4 transform;
+
+            if (!sameBatchLayout(mesh, groupBatches, prototype, group) ||
+                fabsf(candidates[prototype].spread - candidates[group].spread) > spreadTolerance)
+                continue;
+
+            if (findRigidTransform(mesh, groupBatches, prototype, group, candidates, transform))
+            {
+                MeshGroup * meshGroup = &mesh->groups[group];
+                addMeshInstance(mesh, instanceCapacity, prototype, group, transform, meshGroup->center, meshGroup->radius);
+                repeated[prototype] = true;
+                matched = true;
+            }
+        }
+
+        // Groups without a well defined frame, such as a single line of
+        // corners, are always drawn on their own
+        if (!matched && candidates[group].framed)
+            prototypes[prototypeCount++] = group;
+    }
+
+    for (int group = 0; group < mesh->groupCount; group++)
+    {
+        if (!repeated[group])
+            continue;
+
+        mat4 identity = GLM_MAT4_IDENTITY_INIT;
+        MeshGroup * meshGroup = &mesh->groups[group];
+        addMeshInstance(mesh, instanceCapacity, group, group, identity, meshGroup->center, meshGroup->radius);
+    }
+
+    free(candidates);
+    free(prototypes);
+    free(repeated);
+}
+
+bool sameBatchLayout(Mesh * mesh, GroupBatches * groupBatches, int a, int b)
+{
+    int firstA = groupBatches->batchStarts[a];
+    int firstB = groupBatches->batchStarts[b];
+    int batchCount = groupBatches->batchStarts[a + 1] - firstA;
+
+    if (batchCount != groupBatches->batchStarts[b + 1] - firstB)
+        return false;
+
+    for (int i = 0; i < batchCount; i++)
+    {
+        MeshBatch * batchA = &mesh->batches[groupBatches->batchIndices[firstA + i]];
+        MeshBatch * batchB = &mesh->batches[groupBatches->batchIndices[firstB + i]];
+
+        if (batchA->count != batchB->count || batchA->material != batchB->material)
+            return false;
+    }
+
+    return true;
+}
+
+// Mesh corner of the group's index-th corner, counted through its batches
+size_t groupCorner(Mesh * mesh, GroupBatches * groupBatches, int group, size_t index)
+{
+    for (int i = groupBatches->batchStarts[group]; i < groupBatches->batchStarts[group + 1]; i++)
+    {
+        MeshBatch * batch = &mesh->batches[groupBatches->batchIndices[i]];
+
+        if (index < batch->count)
+            return batch->first + index;
+
+        index -= batch->count;
+    }
+
+    return 0;
+}
+
+/*
+    Finds the centroid of the group's corners and their mean squared
+    distance from it, which a rigid transform keeps. The anchors are the
+    corner farthest from the centroid, and the one farthest from the line
+    through both, which give a frame unless every corner lies on that line.
+*/
+void describeCandidate(Mesh * mesh, GroupBatches * groupBatches, int group, InstanceCandidate * candidate)
+{
+    size_t count = mesh->groups[group].count;
+    float * vertices = mesh->vertices;
+    vec3 centroid = GLM_VEC3_ZERO_INIT;
+
+    for (size_t i = 0; i < count; i++)
+        glm_vec3_add(centroid, &vertices[3 * groupCorner(mesh, groupBatches, group, i)], centroid);
+
+    glm_vec3_scale(centroid, 1.0f / count, centroid);
+
+    float spread = 0.0f;
+    float farthest = -1.0f;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float distance = glm_vec3_distance2(centroid, &vertices[3 * groupCorner(mesh, groupBatches, group, i)]);
+        spread += distance;
+
+        if (distance > farthest)
+        {
+            farthest = distance;
+            candidate->anchors[0] = i;
+        }
+    }
+
+    vec3 axis;
+    glm_vec3_sub(&vertices[3 * groupCorner(mesh, groupBatches, group, candidate->anchors[0])], centroid, axis);
+
+    float widest = 0.0f;
+    candidate->anchors[1] = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        vec3 offset;
+        vec3 across;
+
+        glm_vec3_sub(&vertices[3 * groupCorner(mesh, groupBatches, group, i)], centroid, offset);
+        glm_vec3_cross(axis, offset, across);
+
+        if (glm_vec3_norm2(across) > widest)
+        {
+            widest = glm_vec3_norm2(across);
+            candidate->anchors[1] = i;
+        }
+    }
+
+    glm_vec3_copy(centroid, candidate->centroid);
+    candidate->spread = spread / count;
+
+    // The frame is only trusted well above the precision of the positions
+    float scale = glm_vec3_norm2(axis);
+    candidate->framed = scale > 0.0f && widest > scale * scale * INSTANCE_POSITION_TOLERANCE;
+}
+
+/*
+    Builds the orthonormal frame of a group from its centroid and the
+    corners at the prototype's anchors. Returns false when they are
+    collinear.
+*/
+bool candidateFrame(Mesh * mesh, GroupBatches * groupBatches, int group, InstanceCandidate * prototype, float * centroid, mat3 frame)
+{
+    float * first = &mesh->vertices[3 * groupCorner(mesh, groupBatches, group, prototype->anchors[0])];
+    float * second = &mesh->vertices[3 * groupCorner(mesh, groupBatches, group, prototype->anchors[1])];
+    vec3 offset;
+
+    glm_vec3_sub(first, centroid, frame[0]);
+    glm_vec3_sub(second, centroid, offset);
+
+    if (glm_vec3_norm(frame[0]) == 0.0f)
+        return false;
+
+    glm_vec3_normalize(frame[0]);
+    glm_vec3_muladds(frame[0], -glm_vec3_dot(offset, frame[0]), offset);
+
+    if (glm_vec3_norm(offset) == 0.0f)
+        return false;
+
+    glm_vec3_normalize_to(offset, frame[1]);
+    glm_vec3_cross(frame[0], frame[1], frame[2]);
+
+    return true;
+}
+
+/*
+    Finds the rotation and translation taking the prototype's frame onto
+    the group's, and keeps it when every corner then matches.
+*/
+bool findRigidTransform(Mesh * mesh, GroupBatches * groupBatches, int prototype, int group, InstanceCandidate * candidates, mat4 transform)
+{
+    InstanceCandidate * source = &candidates[prototype];
+    mat3 sourceFrame;
+    mat3 targetFrame;
+
+    if (!candidateFrame(mesh, groupBatches, prototype, source, source->centroid, sourceFrame) ||
+        !candidateFrame(mesh, groupBatches, group, source, candidates[group].centroid, targetFrame))
+        return false;
+
+    // Frames are orthonormal, so the inverse of the source is its transpose
+    mat3 rotation;
+    glm_mat3_transpose(sourceFrame);
+    glm_mat3_mul(targetFrame, sourceFrame, rotation);
+
+    vec3 moved;
+    glm_mat3_mulv(rotation, source->centroid, moved);
+
+    glm_mat4_identity(transform);
+    glm_mat4_ins3(rotation, transform);
+    glm_vec3_sub(candidates[group].centroid, moved, transform[3]);
+
+    return cornersMatch(mesh, groupBatches, prototype, group, transform);
+}
+
+bool cornersMatch(Mesh * mesh, GroupBatches * groupBatches, int prototype, int group, mat4 transform)
+{
+    float tolerance = INSTANCE_POSITION_TOLERANCE * mesh->groups[group].radius;
+    int firstPrototype = groupBatches->batchStarts[prototype];
+    int firstGroup = groupBatches->batchStarts[group];
+    int batchCount = groupBatches->batchStarts[prototype + 1] - firstPrototype;
+    mat3 rotation;
+
+    glm_mat4_pick3(transform, rotation);
+
+    for (int i = 0; i < batchCount; i++)
+    {
+        MeshBatch * source = &mesh->batches[groupBatches->batchIndices[firstPrototype + i]];
+        MeshBatch * target = &mesh->batches[groupBatches->batchIndices[firstGroup + i]];
+
+        for (size_t corner = 0; corner < source->count; corner++)
+        {
+            size_t from = source->first + corner;
+            size_t to = target->first + corner;
+            vec3 moved;
+
+            glm_mat4_mulv3(transform, &mesh->vertices[3 * from], 1.0f, moved);
+
+            if (glm_vec3_distance(moved, &mesh->vertices[3 * to]) > tolerance)
+                return false;
+
+            if (mesh->normals != NULL)
+            {
+                glm_mat3_mulv(rotation, &mesh->normals[3 * from], moved);
+
+                if (glm_vec3_distance(moved, &mesh->normals[3 * to]) > INSTANCE_NORMAL_TOLERANCE * glm_vec3_norm(moved))
+                    return false;
+            }
+
+            if (mesh->texcoords != NULL &&
+                (fabsf(mesh->texcoords[2 * from] - mesh->texcoords[2 * to]) > INSTANCE_TEXCOORD_TOLERANCE ||
+                 fabsf(mesh->texcoords[2 * from + 1] - mesh->texcoords[2 * to + 1]) > INSTANCE_TEXCOORD_TOLERANCE))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+    Places the copies listed in the file. A listed group is drawn only at
+    its listed places, each relative to where the group is in the model.
+    Returns false when the file could not be read.
+*/
+bool loadInstanceList(Mesh * mesh, char * listPath, int * instanceCapacity)
+{
+    FILE * input = fopen(listPath, "r");
+
+    if (input == NULL)
+    {
+        printf("Could not open instance list %s.\n", listPath);
+        return false;
+    }
+
+    bool * listed = (bool *)calloc(mesh->groupCount, sizeof(bool));
+    int * prototypes = (int *)malloc(sizeof(int) * mesh->groupCount);
+    mat4 * bases = (mat4 *)malloc(sizeof(mat4) * mesh->groupCount);
+    char line[INSTANCE_LIST_LINE_LENGTH];
+    int lineNumber = 0;
+
+    while(fgets(line, sizeof(line), input) != NULL)
+    {
+        char name[MESH_GROUP_NAME_LENGTH];
+        vec3 offset;
+        vec3 axis;
+        float degrees;
+
+        lineNumber++;
+
+        if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+
+        if (sscanf(line, "%f %f %f %f %f %f %f %63[^\r\n]", &offset[0], &offset[1], &offset[2],
+                &axis[0], &axis[1], &axis[2], &degrees, name) != 8)
+        {
+            printf("Skipping line %d of %s, expected x y z axisX axisY axisZ degrees group.\n", lineNumber, listPath);
+            continue;
+        }
+
+        int group = findGroup(mesh, name);
+
+        if (group == -1 || mesh->groups[group].count == 0)
+        {
+            printf("Skipping line %d of %s, the model has no group %s.\n", lineNumber, listPath, name);
+            continue;
+        }
+
+        // The first time a group is listed, the places it had are dropped,
+        // keeping only the transform from its prototype to itself
+        if (!listed[group])
+        {
+            int kept = 0;
+
+            prototypes[group] = group;
+            glm_mat4_identity(bases[group]);
+
+            for (int i = 0; i < mesh->instanceCount; i++)
+            {
+                MeshInstance * instance = &mesh->instances[i];
+
+                if (instance->group != group)
+                    mesh->instances[kept++] = *instance;
+                else if (instance->prototype != group)
+                {
+                    prototypes[group] = instance->prototype;
+                    glm_mat4_copy(instance->transform, bases[group]);
+                }
+            }
+
+            mesh->instanceCount = kept;
+            listed[group] = true;
+        }
+
+        // Rotated about the group's centre, then moved in file units
+        MeshGroup * meshGroup = &mesh->groups[group];
+        mat4 placement = GLM_MAT4_IDENTITY_INIT;
+        vec3 center;
+
+        glm_vec3_scale(offset, mesh->scale, offset);
+        glm_vec3_add(meshGroup->center, offset, center);
+        glm_translate(placement, center);
+
+        if (glm_vec3_norm(axis) > 0.0f)
+            glm_rotate(placement, glm_rad(degrees), axis);
+
+        glm_translate(placement, (vec3){ -meshGroup->center[0], -meshGroup->center[1], -meshGroup->center[2] });
+        glm_mat4_mul(placement, bases[group], placement);
+
+        addMeshInstance(mesh, instanceCapacity, prototypes[group], group, placement, center, meshGroup->radius);
+    }
+
+    fclose(input);
+    free(listed);
+    free(prototypes);
+    free(bases);
+
+    return true;
+}
+
+/*
+    Makes every group drawn on its own an instance of itself, then repeats
+    every instance in each cell of the grid, and scales the grid to the size
+    of the original model.
+*/
+void applyInstanceGrid(Mesh * mesh, int * instanceCapacity)
+{
+    bool * placed = (bool *)calloc(mesh->groupCount, sizeof(bool));
+    mat4 identity = GLM_MAT4_IDENTITY_INIT;
+
+    for (int i = 0; i < mesh->instanceCount; i++)
+        placed[mesh->instances[i].group] = true;
+
+    for (int group = 0; group < mesh->groupCount; group++)
+    {
+        MeshGroup * meshGroup = &mesh->groups[group];
+
+        if (!placed[group] && meshGroup->count > 0)
+            addMeshInstance(mesh, instanceCapacity, group, group, identity, meshGroup->center, meshGroup->radius);
+    }
+
+    free(placed);
+
+    int cellCount = gridColumns * gridRows;
+    int modelInstances = mesh->instanceCount;
+    float scale = 1.0f / (gridColumns > gridRows ? gridColumns : gridRows);
+    float spacing = 2.0f * mesh->radius * INSTANCE_GRID_SPACING;
+
+    *instanceCapacity = modelInstances * cellCount;
+    mesh->instances = (MeshInstance *)realloc(mesh->instances, sizeof(MeshInstance) * *instanceCapacity);
+    mesh->instanceCount = *instanceCapacity;
+
+    // Cells are filled from the last, so the originals are read before
+    // the first cell overwrites them
+    for (int cell = cellCount - 1; cell >= 0; cell--)
+    {
+        vec3 offset = {
+            ((cell % gridColumns) - (gridColumns - 1) / 2.0f) * spacing,
+            ((gridRows - 1) / 2.0f - (cell / gridColumns)) * spacing,
+            0.0f
+        };
+
+        mat4 placement = GLM_MAT4_IDENTITY_INIT;
+        glm_scale_uni(placement, scale);
+        glm_translate(placement, offset);
+
+        for (int i = 0; i < modelInstances; i++)
+        {
+            MeshInstance * source = &mesh->instances[i];
+            MeshInstance * target = &mesh->instances[cell * modelInstances + i];
+
+            *target = *source;
+            glm_mat4_mul(placement, source->transform, target->transform);
+            glm_mat4_mulv3(placement, source->center, 1.0f, target->center);
+            target->radius = source->radius * scale;
+        }
+    }
+
+    float corner = hypotf((gridColumns - 1) / 2.0f, (gridRows - 1) / 2.0f) * spacing;
+    mesh->radius = (mesh->radius + corner) * scale;
+
+    printf("Grid scene of %d x %d copies\n", gridColumns, gridRows);
+}
+
+void addMeshInstance(Mesh * mesh, int * instanceCapacity, int prototype, int group, mat4 transform, float * center, float radius)
+{
+    if (mesh->instanceCount == *instanceCapacity)
+    {
+        *instanceCapacity = *instanceCapacity ? 2 * *instanceCapacity : 16;
+        mesh->instances = (MeshInstance *)realloc(mesh->instances, sizeof(MeshInstance) * *instanceCapacity);
+    }
+
+    MeshInstance * instance = &mesh->instances[mesh->instanceCount++];
+    glm_mat4_copy(transform, instance->transform);
+    glm_vec3_copy(center, instance->center);
+    instance->radius = radius;
+    instance->prototype = prototype;
+    instance->group = group;
+}
+
+/*
+    Marks each instance's prototype as instanced, and removes the corners
+    of groups which are only drawn through another group's instances. The
+    remaining corners and batches keep their order.
+*/
+void removeUnusedCorners(Mesh * mesh)
+{
+    bool * kept = (bool *)malloc(sizeof(bool) * mesh->groupCount);
+
+    for (int group = 0; group < mesh->groupCount; group++)
+        kept[group] = true;
+
+    for (int i = 0; i < mesh->instanceCount; i++)
+        kept[mesh->instances[i].group] = false;
+
+    for (int i = 0; i < mesh->instanceCount; i++)
+    {
+        kept[mesh->instances[i].prototype] = true;
+        mesh->groups[mesh->instances[i].prototype].instanced = true;
+    }
+
+    size_t cornerCount = 0;
+    int batchCount = 0;
+
+    for (int i = 0; i < mesh->batchCount; i++)
+    {
+        MeshBatch batch = mesh->batches[i];
+
+        if (!kept[batch.group])
+            continue;
+
+        memmove(&mesh->vertices[3 * cornerCount], &mesh->vertices[3 * batch.first], sizeof(float) * 3 * batch.count);
+
+        if (mesh->normals != NULL)
+            memmove(&mesh->normals[3 * cornerCount], &mesh->normals[3 * batch.first], sizeof(float) * 3 * batch.count);
+
+        if (mesh->texcoords != NULL)
+            memmove(&mesh->texcoords[2 * cornerCount], &mesh->texcoords[2 * batch.first], sizeof(float) * 2 * batch.count);
+
+        batch.first = cornerCount;
+        mesh->batches[batchCount++] = batch;
+        cornerCount += batch.count;
+    }
+
+    for (int group = 0; group < mesh->groupCount; group++)
+    {
+        if (!kept[group])
+            mesh->groups[group].count = 0;
+    }
+
+    mesh->batchCount = batchCount;
+    mesh->vertexCount = 3 * cornerCount;
+
+    // A shrink which fails leaves the larger block, which is kept
+    float * vertices = (float *)realloc(mesh->vertices, sizeof(float) * 3 * cornerCount + 1);
+    float * normals = mesh->normals != NULL ? (float *)realloc(mesh->normals, sizeof(float) * 3 * cornerCount + 1) : NULL;
+    float * texcoords = mesh->texcoords != NULL ? (float *)realloc(mesh->texcoords, sizeof(float) * 2 * cornerCount + 1) : NULL;
+
+    mesh->vertices = vertices != NULL ? vertices : mesh->vertices;
+    mesh->normals = normals != NULL ? normals : mesh->normals;
+    mesh->texcoords = texcoords != NULL ? texcoords : mesh->texcoords;
+
+    free(kept);
+}
+
+// Orders instances by prototype, and then by the group they stand for
+int compareInstances(const void * a, const void * b)
+{
+    const MeshInstance * first = (const MeshInstance *)a;
+    const MeshInstance * second = (const MeshInstance *)b;
+
+    if (first->prototype != second->prototype)
+        return first->prototype - second->prototype;
+
+    return first->group - second->group;
+}
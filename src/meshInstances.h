@@ -0,0 +1,64 @@
+#ifndef MESH_INSTANCES
+#define MESH_INSTANCES
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <cglm/cglm.h>
+
+#include "loadModel.h"
+
+// Corners of a repeated group may be this far from the transformed ones of
+// its prototype, relative to the group's radius
+#define INSTANCE_POSITION_TOLERANCE 1e-4f
+#define INSTANCE_NORMAL_TOLERANCE 1e-3f
+#define INSTANCE_TEXCOORD_TOLERANCE 1e-5f
+
+#define INSTANCE_LIST_LINE_LENGTH 1024
+
+// Grid scene copies are this many model diameters apart
+#define INSTANCE_GRID_SPACING 1.1f
+
+// The batches of each group, in batch order, from batchStarts[group] to
+// batchStarts[group + 1] - 1 of batchIndices
+typedef struct GroupBatches
+{
+    int * batchStarts;
+    int * batchIndices;
+}
+GroupBatches;
+
+// What is known of a group which may be a prototype. anchors are the
+// corners, counted through the group's batches, which fix its frame.
+typedef struct InstanceCandidate
+{
+    float centroid[3];
+    float spread;
+    size_t anchors[2];
+    bool framed;
+}
+InstanceCandidate;
+
+// Public method(s)
+void selectInstanceDetection(bool detect);
+void selectInstanceList(char * listPath);
+void selectInstanceGrid(int columns, int rows);
+void instanceMesh(Mesh * mesh);
+
+// Private method(s)
+void collectGroupBatches(Mesh * mesh, GroupBatches * groupBatches);
+void releaseGroupBatches(GroupBatches * groupBatches);
+void detectRepeatedGroups(Mesh * mesh, GroupBatches * groupBatches, int * instanceCapacity);
+bool sameBatchLayout(Mesh * mesh, GroupBatches * groupBatches, int a, int b);
+size_t groupCorner(Mesh * mesh, GroupBatches * groupBatches, int group, size_t index);
+void describeCandidate(Mesh * mesh, GroupBatches * groupBatches, int group, InstanceCandidate * candidate);
+bool candidateFrame(Mesh * mesh, GroupBatches * groupBatches, int group, InstanceCandidate * prototype, float * centroid, mat3 frame);
+bool findRigidTransform(Mesh * mesh, GroupBatches * groupBatches, int prototype, int group, InstanceCandidate * candidates, mat4 transform);
+bool cornersMatch(Mesh * mesh, GroupBatches * groupBatches, int prototype, int group, mat4 transform);
+bool loadInstanceList(Mesh * mesh, char * listPath, int * instanceCapacity);
+void applyInstanceGrid(Mesh * mesh, int * instanceCapacity);
+void addMeshInstance(Mesh * mesh, int * instanceCapacity, int prototype, int group, mat4 transform, float * center, float radius);
+void removeUnusedCorners(Mesh * mesh);
+int compareInstances(const void * a, const void * b);
+
+#endif
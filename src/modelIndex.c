@@ -0,0 +1,857 @@
+/******************************************************************************
+ * File:        modelIndex.c
+ * Description: Loads chosen groups of a large OBJ file without parsing the
+ *              rest of it.
+ *              - A sidecar index, <model>.obj.idx, records the byte ranges of
+ *                each group's faces and of every block of v, vn and vt records,
+ *                with the global index each block starts from.
+ *              - usemtl records are indexed too, so each face range knows the
+ *                material in use where it starts.
+ *              - Later loads read only the requested groups' face ranges, then
+ *                only the vertex blocks those faces refer to.
+ * Notes:       The index is rebuilt whenever the OBJ file's size or
+ *              modification time no longer match the ones it was built from.
+ ******************************************************************************/
+
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "materialLibrary.h"
+#include "modelIndex.h"
+
+#define TRIANGULAR_MESH_TYPE 3
+
+// Public method(s)
+
+/*
+    Reads the sidecar index of an OBJ file, building and saving it first when
+    it is missing or out of date.
+*/
+bool loadModelIndex(char * filename, ModelIndex * index)
+{
+    memset(index, 0, sizeof(ModelIndex));
+
+    char indexPath[MODEL_INDEX_PATH_LENGTH];
+
+    if (snprintf(indexPath, sizeof(indexPath), "%s.idx", filename) >= (int)sizeof(indexPath))
+        return false;
+
+    long long fileSize;
+    long long modifiedTime;
+
+    if (!readModelStatus(filename, &fileSize, &modifiedTime))
+    {
+        printf("Could not open file.\n");
+        return false;
+    }
+
+    if (readModelIndex(indexPath, index))
+    {
+        if (index->fileSize == fileSize && index->modifiedTime == modifiedTime)
+            return true;
+
+        releaseModelIndex(index);
+    }
+
+    double startTime = currentTime();
+
+    if (!buildModelIndex(filename, index))
+        return false;
+
+    index->fileSize = fileSize;
+    index->modifiedTime = modifiedTime;
+
+    printf("Indexed %d groups of %s in %.3f seconds\n", index->groupCount, filename, currentTime() - startTime);
+
+    // An index which cannot be saved still serves this load
+    saveModelIndex(indexPath, index);
+
+    return true;
+}
+
+/*
+    Loads the comma separated groups in groupNames from an OBJ file into a
+    mesh, in the order they are named. Returns the number of vertices, as
+    loadOBJ does, or -1 when a group does not exist or the file is invalid.
+*/
+long long loadOBJGroups(char * filename, char * groupNames, Mesh * mesh)
+{
+    double startTime = currentTime();
+
+    ModelIndex index;
+
+    if (!loadModelIndex(filename, &index))
+        return -1;
+
+    int descriptor = open(filename, O_RDONLY);
+
+    if (descriptor == -1)
+    {
+        printf("Could not open file.\n");
+        releaseModelIndex(&index);
+        return -1;
+    }
+
+    int groupCapacity = 0;
+    int materialCapacity = 0;
+    int * selectedGroups = (int *)malloc(sizeof(int) * (index.groupCount + 1));
+    char * names = strdup(groupNames);
+    size_t cornerCount = 0;
+    bool valid = true;
+
+    for (char * name = strtok(names, ","); name != NULL && valid; name = strtok(NULL, ","))
+    {
+        int group = findIndexedGroup(&index, name);
+
+        if (group == -1)
+        {
+            printf("No group named %s in %s\n", name, filename);
+            valid = false;
+        }
+        else if (findGroup(mesh, name) == -1)
+        {
+            selectedGroups[findOrAddGroup(mesh, &groupCapacity, name)] = group;
+            cornerCount += index.groups[group].cornerCount;
+        }
+    }
+
+    free(names);
+
+    if (valid && cornerCount / 3 > LOAD_MODEL_MAX_RECORDS)
+    {
+        printf("Too many triangles in the groups selected from %s, at most %d are supported.\n", filename, LOAD_MODEL_MAX_RECORDS);
+        valid = false;
+        cornerCount = 0;
+    }
+
+    OBJData data;
+    data.vertices = NULL;
+    data.normals = NULL;
+    data.texcoords = NULL;
+    data.faceVertices = (int *)malloc(sizeof(int) * (cornerCount + 1));
+    data.faceNormals = (int *)malloc(sizeof(int) * (cornerCount + 1));
+    data.faceTexcoords = (int *)malloc(sizeof(int) * (cornerCount + 1));
+    data.faceGroups = (int *)malloc(sizeof(int) * (cornerCount / 3 + 1));
+    data.faceMaterials = (int *)malloc(sizeof(int) * (cornerCount / 3 + 1));
+    data.polygonSizes = (int *)malloc(sizeof(int) * (cornerCount / 3 + 1));
+    data.polygonCount = 0;
+    data.faceCount = cornerCount / 3;
+    char * buffer = NULL;
+    long long bufferSize = 0;
+    long long bytesRead = 0;
+
+    // Gather the corners of every selected group from its face ranges
+    size_t corner = 0;
+
+    for (int i = 0; i < mesh->groupCount && valid; i++)
+    {
+        IndexedGroup * group = &index.groups[selectedGroups[i]];
+        size_t groupStart = corner;
+        size_t groupEnd = corner + group->cornerCount;
+        size_t droppedCorners = 0;
+
+        for (int range = group->firstRange; range < group->firstRange + group->rangeCount && valid; range++)
+        {
+            FaceRange * faceRange = &index.ranges[range];
+            valid = readFileRange(descriptor, faceRange->offset, faceRange->length, &buffer, &bufferSize);
+
+            // The material in use where the range starts carries into it
+            char * materialName = faceRange->material != -1 ? index.materials[faceRange->material].name : "default";
+            int material = findOrAddMaterial(mesh, &materialCapacity, materialName);
+
+            if (valid)
+                corner += parseFaceRange(buffer, faceRange, mesh, &materialCapacity, material, &data, corner, groupEnd - droppedCorners - corner, &droppedCorners);
+
+            bytesRead += faceRange->length;
+        }
+
+        for (size_t face = groupStart / 3; face < corner / 3; face++)
+            data.faceGroups[face] = i;
+
+        // Fewer corners than indexed means the file changed under the index.
+        // Dropped polygons leave their room unused, and the next group
+        // starts where this one's corners end.
+        valid = valid && corner + droppedCorners == groupEnd;
+    }
+
+    cornerCount = corner;
+    data.faceCount = cornerCount / 3;
+
+    if (valid && index.materialLibrary[0] != '\0')
+        loadMaterialLibrary(filename, index.materialLibrary, mesh);
+
+    // Replace global indices with indices into the loaded blocks
+    valid = valid && loadVertexBlocks(descriptor, index.vertexBlocks, index.vertexBlockCount, "v ", 3,
+        data.faceVertices, cornerCount, &data.vertices, &buffer, &bufferSize, &bytesRead);
+    valid = valid && loadVertexBlocks(descriptor, index.normalBlocks, index.normalBlockCount, "vn", 3,
+        data.faceNormals, cornerCount, &data.normals, &buffer, &bufferSize, &bytesRead);
+
+    // Texture coordinates are optional, and only loaded when the file has them
+    if (index.textureBlockCount > 0)
+        valid = valid && loadVertexBlocks(descriptor, index.textureBlocks, index.textureBlockCount, "vt", 2,
+            data.faceTexcoords, cornerCount, &data.texcoords, &buffer, &bufferSize, &bytesRead);
+
+    close(descriptor);
+
+    if (valid && cornerCount > 0)
+    {
+        triangulatePolygons(&data);
+
+        // Bounds cover the loaded groups only, so the selection fills the view
+        float center[3];
+        fitMeshToView(mesh, data.vertices, data.faceVertices, cornerCount, center);
+        writeMeshBatches(mesh, &data, center);
+
+        printf("Loaded %d of %d groups from %s, reading %.1f KB in %.1f ms\n",
+            mesh->groupCount,
+            index.groupCount,
+            filename,
+            bytesRead / 1024.0,
+            (currentTime() - startTime) * 1000.0
+        );
+    }
+    else
+    {
+        valid = false;
+        releaseMesh(mesh);
+    }
+
+    free(selectedGroups);
+    releaseOBJData(&data);
+    free(buffer);
+    releaseModelIndex(&index);
+
+    return valid ? (long long)cornerCount * TRIANGULAR_MESH_TYPE : -1;
+}
+
+void releaseModelIndex(ModelIndex * index)
+{
+    free(index->groups);
+    free(index->materials);
+    free(index->ranges);
+    free(index->vertexBlocks);
+    free(index->normalBlocks);
+    free(index->textureBlocks);
+
+    memset(index, 0, sizeof(ModelIndex));
+}
+
+// Private method(s)
+
+/*
+    One pass over the file which only looks at the start of each line. A
+    face range ends at the next v, vn, vt, g or o record, and a vertex block
+    ends at the next face or group record, so neither holds much of the
+    other's data.
+*/
+bool buildModelIndex(char * filename, ModelIndex * index)
+{
+    FILE * input = fopen(filename, "rb");
+
+    if (input == NULL)
+    {
+        printf("Could not open file.\n");
+        return false;
+    }
+
+    int groupCapacity = 0;
+    int materialCapacity = 0;
+    int rangeCapacity = 0;
+    int vertexBlockCapacity = 0;
+    int normalBlockCapacity = 0;
+    int textureBlockCapacity = 0;
+
+    int vertexCount = 0;
+    int normalCount = 0;
+    int textureCount = 0;
+    int currentGroup = -1;
+    int currentMaterial = -1;
+
+    // Records still being extended, or -1
+    int openRange = -1;
+    int openVertexBlock = -1;
+    int openNormalBlock = -1;
+    int openTextureBlock = -1;
+
+    char line[LOAD_MODEL_LINE_LENGTH];
+    long long offset = 0;
+    bool lineStart = true;
+
+    while (fgets(line, sizeof(line), input) != NULL)
+    {
+        long long lineOffset = offset;
+        size_t length = strlen(line);
+        bool continuation = !lineStart;
+
+        offset += length;
+        lineStart = length > 0 && line[length - 1] == '\n';
+
+        // The rest of a line longer than the buffer belongs to whatever range
+        // its start was in
+        if (continuation)
+            continue;
+
+        bool vertexRecord = line[0] == 'v' && line[1] == ' ';
+        bool normalRecord = line[0] == 'v' && line[1] == 'n';
+        bool textureRecord = line[0] == 'v' && line[1] == 't';
+        bool faceRecord = line[0] == 'f' && line[1] == ' ';
+        bool groupRecord = (line[0] == 'g' || line[0] == 'o') && (line[1] == ' ' || line[1] == '\n' || line[1] == '\r');
+
+        if (openRange != -1 && (vertexRecord || normalRecord || textureRecord || groupRecord))
+        {
+            index->ranges[openRange].length = lineOffset - index->ranges[openRange].offset;
+            openRange = -1;
+        }
+
+        if (openVertexBlock != -1 && (faceRecord || groupRecord || (vertexRecord && index->vertexBlocks[openVertexBlock].count == MODEL_INDEX_BLOCK_RECORDS)))
+        {
+            index->vertexBlocks[openVertexBlock].length = lineOffset - index->vertexBlocks[openVertexBlock].offset;
+            openVertexBlock = -1;
+        }
+
+        if (openNormalBlock != -1 && (faceRecord || groupRecord || (normalRecord && index->normalBlocks[openNormalBlock].count == MODEL_INDEX_BLOCK_RECORDS)))
+        {
+            index->normalBlocks[openNormalBlock].length = lineOffset - index->normalBlocks[openNormalBlock].offset;
+            openNormalBlock = -1;
+        }
+
+        if (openTextureBlock != -1 && (faceRecord || groupRecord || (textureRecord && index->textureBlocks[openTextureBlock].count == MODEL_INDEX_BLOCK_RECORDS)))
+        {
+            index->textureBlocks[openTextureBlock].length = lineOffset - index->textureBlocks[openTextureBlock].offset;
+            openTextureBlock = -1;
+        }
+
+        if (vertexRecord)
+        {
+            if (openVertexBlock == -1)
+                openVertexBlock = addVertexBlock(&index->vertexBlocks, &index->vertexBlockCount, &vertexBlockCapacity, lineOffset, vertexCount);
+
+            index->vertexBlocks[openVertexBlock].count++;
+            vertexCount++;
+        }
+        else if (normalRecord)
+        {
+            if (openNormalBlock == -1)
+                openNormalBlock = addVertexBlock(&index->normalBlocks, &index->normalBlockCount, &normalBlockCapacity, lineOffset, normalCount);
+
+            index->normalBlocks[openNormalBlock].count++;
+            normalCount++;
+        }
+        else if (textureRecord)
+        {
+            if (openTextureBlock == -1)
+                openTextureBlock = addVertexBlock(&index->textureBlocks, &index->textureBlockCount, &textureBlockCapacity, lineOffset, textureCount);
+
+            index->textureBlocks[openTextureBlock].count++;
+            textureCount++;
+        }
+        else if (groupRecord)
+        {
+            char name[MESH_GROUP_NAME_LENGTH] = "default";
+            sscanf(line + 1, " %63[^\r\n]", name);
+
+            currentGroup = addIndexedGroup(index, &groupCapacity, name);
+        }
+        else if (!strncmp(line, "usemtl ", 7))
+        {
+            char name[MESH_MATERIAL_NAME_LENGTH] = "default";
+            sscanf(line + 6, " %63[^\r\n]", name);
+
+            currentMaterial = addIndexedMaterial(index, &materialCapacity, name);
+        }
+        else if (!strncmp(line, "mtllib ", 7))
+            sscanf(line + 6, " %255[^\r\n]", index->materialLibrary);
+        else if (faceRecord)
+        {
+            // Faces before the first group record belong to the default group
+            if (currentGroup == -1)
+                currentGroup = addIndexedGroup(index, &groupCapacity, "default");
+
+            if (openRange == -1)
+            {
+                if (index->rangeCount == rangeCapacity)
+                {
+                    rangeCapacity = rangeCapacity ? 2 * rangeCapacity : 64;
+                    index->ranges = (FaceRange *)realloc(index->ranges, sizeof(FaceRange) * rangeCapacity);
+                }
+
+                openRange = index->rangeCount++;
+                index->ranges[openRange].offset = lineOffset;
+                index->ranges[openRange].length = 0;
+                index->ranges[openRange].group = currentGroup;
+                index->ranges[openRange].material = currentMaterial;
+                index->ranges[openRange].vertexBase = vertexCount;
+                index->ranges[openRange].normalBase = normalCount;
+                index->ranges[openRange].textureBase = textureCount;
+            }
+
+            // Corners of the triangles the polygon will be split into
+            int polygonCorners = countFaceCorners(line + 1);
+
+            if (polygonCorners > 2)
+                index->groups[currentGroup].cornerCount += TRIANGULAR_MESH_TYPE * (polygonCorners - 2);
+        }
+    }
+
+    fclose(input);
+
+    if (openRange != -1)
+        index->ranges[openRange].length = offset - index->ranges[openRange].offset;
+    if (openVertexBlock != -1)
+        index->vertexBlocks[openVertexBlock].length = offset - index->vertexBlocks[openVertexBlock].offset;
+    if (openNormalBlock != -1)
+        index->normalBlocks[openNormalBlock].length = offset - index->normalBlocks[openNormalBlock].offset;
+    if (openTextureBlock != -1)
+        index->textureBlocks[openTextureBlock].length = offset - index->textureBlocks[openTextureBlock].offset;
+
+    sortFaceRanges(index);
+
+    return true;
+}
+
+bool readModelIndex(char * indexPath, ModelIndex * index)
+{
+    FILE * input = fopen(indexPath, "rb");
+
+    if (input == NULL)
+        return false;
+
+    ModelIndexHeader header;
+    bool valid = fread(&header, sizeof(header), 1, input) == 1
+        && !memcmp(header.magic, MODEL_INDEX_MAGIC, sizeof(header.magic))
+        && header.groupCount >= 0 && header.materialCount >= 0 && header.rangeCount >= 0
+        && header.vertexBlockCount >= 0 && header.normalBlockCount >= 0 && header.textureBlockCount >= 0;
+
+    if (valid)
+    {
+        index->fileSize = header.fileSize;
+        index->modifiedTime = header.modifiedTime;
+        memcpy(index->materialLibrary, header.materialLibrary, sizeof(index->materialLibrary));
+        index->materialLibrary[sizeof(index->materialLibrary) - 1] = '\0';
+        index->groupCount = header.groupCount;
+        index->materialCount = header.materialCount;
+        index->rangeCount = header.rangeCount;
+        index->vertexBlockCount = header.vertexBlockCount;
+        index->normalBlockCount = header.normalBlockCount;
+        index->textureBlockCount = header.textureBlockCount;
+
+        index->groups = (IndexedGroup *)malloc(sizeof(IndexedGroup) * (header.groupCount + 1));
+        index->materials = (IndexedMaterial *)malloc(sizeof(IndexedMaterial) * (header.materialCount + 1));
+        index->ranges = (FaceRange *)malloc(sizeof(FaceRange) * (header.rangeCount + 1));
+        index->vertexBlocks = (VertexBlock *)malloc(sizeof(VertexBlock) * (header.vertexBlockCount + 1));
+        index->normalBlocks = (VertexBlock *)malloc(sizeof(VertexBlock) * (header.normalBlockCount + 1));
+        index->textureBlocks = (VertexBlock *)malloc(sizeof(VertexBlock) * (header.textureBlockCount + 1));
+
+        valid = fread(index->groups, sizeof(IndexedGroup), header.groupCount, input) == (size_t)header.groupCount
+            && fread(index->materials, sizeof(IndexedMaterial), header.materialCount, input) == (size_t)header.materialCount
+            && fread(index->ranges, sizeof(FaceRange), header.rangeCount, input) == (size_t)header.rangeCount
+            && fread(index->vertexBlocks, sizeof(VertexBlock), header.vertexBlockCount, input) == (size_t)header.vertexBlockCount
+            && fread(index->normalBlocks, sizeof(VertexBlock), header.normalBlockCount, input) == (size_t)header.normalBlockCount
+            && fread(index->textureBlocks, sizeof(VertexBlock), header.textureBlockCount, input) == (size_t)header.textureBlockCount;
+
+        if (!valid)
+            releaseModelIndex(index);
+    }
+
+    fclose(input);
+
+    return valid;
+}
+
+/*
+    Written to a temporary file and renamed, so a viewer reading the index
+    at the same time never sees half of it.
+*/
+void saveModelIndex(char * indexPath, ModelIndex * index)
+{
+    char temporaryPath[MODEL_INDEX_PATH_LENGTH + 8];
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.%d", indexPath, (int)getpid());
+
+    FILE * output = fopen(temporaryPath, "wb");
+
+    if (output == NULL)
+        return;
+
+    ModelIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_INDEX_MAGIC, sizeof(header.magic));
+    header.fileSize = index->fileSize;
+    header.modifiedTime = index->modifiedTime;
+    memcpy(header.materialLibrary, index->materialLibrary, sizeof(header.materialLibrary));
+    header.groupCount = index->groupCount;
+    header.materialCount = index->materialCount;
+    header.rangeCount = index->rangeCount;
+    header.vertexBlockCount = index->vertexBlockCount;
+    header.normalBlockCount = index->normalBlockCount;
+    header.textureBlockCount = index->textureBlockCount;
+
+    bool written = fwrite(&header, sizeof(header), 1, output) == 1
+        && fwrite(index->groups, sizeof(IndexedGroup), index->groupCount, output) == (size_t)index->groupCount
+        && fwrite(index->materials, sizeof(IndexedMaterial), index->materialCount, output) == (size_t)index->materialCount
+        && fwrite(index->ranges, sizeof(FaceRange), index->rangeCount, output) == (size_t)index->rangeCount
+        && fwrite(index->vertexBlocks, sizeof(VertexBlock), index->vertexBlockCount, output) == (size_t)index->vertexBlockCount
+        && fwrite(index->normalBlocks, sizeof(VertexBlock), index->normalBlockCount, output) == (size_t)index->normalBlockCount
+        && fwrite(index->textureBlocks, sizeof(VertexBlock), index->textureBlockCount, output) == (size_t)index->textureBlockCount;
+
+    written = fclose(output) == 0 && written;
+
+    if (!written || rename(temporaryPath, indexPath) != 0)
+        remove(temporaryPath);
+}
+
+bool readModelStatus(char * filename, long long * fileSize, long long * modifiedTime)
+{
+    struct stat status;
+
+    if (stat(filename, &status) != 0)
+        return false;
+
+    *fileSize = status.st_size;
+    *modifiedTime = status.st_mtime;
+
+    return true;
+}
+
+int findIndexedGroup(ModelIndex * index, char * name)
+{
+    // Searched from the end, since the latest group is the likeliest match
+    for (int i = index->groupCount - 1; i >= 0; i--)
+    {
+        if (!strcmp(index->groups[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+int addIndexedGroup(ModelIndex * index, int * groupCapacity, char * name)
+{
+    int group = findIndexedGroup(index, name);
+
+    if (group != -1)
+        return group;
+
+    if (index->groupCount == *groupCapacity)
+    {
+        *groupCapacity = *groupCapacity ? 2 * *groupCapacity : 8;
+        index->groups = (IndexedGroup *)realloc(index->groups, sizeof(IndexedGroup) * *groupCapacity);
+    }
+
+    IndexedGroup * indexedGroup = &index->groups[index->groupCount];
+    memset(indexedGroup, 0, sizeof(IndexedGroup));
+    snprintf(indexedGroup->name, sizeof(indexedGroup->name), "%s", name);
+
+    return index->groupCount++;
+}
+
+int findIndexedMaterial(ModelIndex * index, char * name)
+{
+    for (int i = index->materialCount - 1; i >= 0; i--)
+    {
+        if (!strcmp(index->materials[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+int addIndexedMaterial(ModelIndex * index, int * materialCapacity, char * name)
+{
+    int material = findIndexedMaterial(index, name);
+
+    if (material != -1)
+        return material;
+
+    if (index->materialCount == *materialCapacity)
+    {
+        *materialCapacity = *materialCapacity ? 2 * *materialCapacity : 8;
+        index->materials = (IndexedMaterial *)realloc(index->materials, sizeof(IndexedMaterial) * *materialCapacity);
+    }
+
+    snprintf(index->materials[index->materialCount].name, sizeof(index->materials[0].name), "%s", name);
+
+    return index->materialCount++;
+}
+
+int addVertexBlock(VertexBlock ** blocks, int * blockCount, int * blockCapacity, long long offset, int first)
+{
+    if (*blockCount == *blockCapacity)
+    {
+        *blockCapacity = *blockCapacity ? 2 * *blockCapacity : 64;
+        *blocks = (VertexBlock *)realloc(*blocks, sizeof(VertexBlock) * *blockCapacity);
+    }
+
+    VertexBlock * block = &(*blocks)[*blockCount];
+    block->offset = offset;
+    block->length = 0;
+    block->first = first;
+    block->count = 0;
+
+    return (*blockCount)++;
+}
+
+/*
+    Counting sort of the face ranges by group, keeping file order within
+    each group.
+*/
+void sortFaceRanges(ModelIndex * index)
+{
+    FaceRange * sorted = (FaceRange *)malloc(sizeof(FaceRange) * (index->rangeCount + 1));
+
+    for (int i = 0; i < index->groupCount; i++)
+        index->groups[i].rangeCount = 0;
+
+    for (int i = 0; i < index->rangeCount; i++)
+        index->groups[index->ranges[i].group].rangeCount++;
+
+    for (int i = 0, first = 0; i < index->groupCount; i++)
+    {
+        index->groups[i].firstRange = first;
+        first += index->groups[i].rangeCount;
+        index->groups[i].rangeCount = 0;
+    }
+
+    for (int i = 0; i < index->rangeCount; i++)
+    {
+        IndexedGroup * group = &index->groups[index->ranges[i].group];
+        sorted[group->firstRange + group->rangeCount++] = index->ranges[i];
+    }
+
+    free(index->ranges);
+    index->ranges = sorted;
+}
+
+// Blocks are in index order, so the block holding an index is found by bisection
+int findVertexBlock(VertexBlock * blocks, int blockCount, int vertexIndex)
+{
+    int low = 0;
+    int high = blockCount - 1;
+
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+
+        if (vertexIndex < blocks[middle].first)
+            high = middle - 1;
+        else if (vertexIndex >= blocks[middle].first + blocks[middle].count)
+            low = middle + 1;
+        else
+            return middle;
+    }
+
+    return -1;
+}
+
+/*
+    Reads a byte range into a buffer which grows as needed, and terminates it
+    so it can be parsed as a string.
+*/
+bool readFileRange(int descriptor, long long offset, long long length, char ** buffer, long long * bufferSize)
+{
+    if (length + 1 > *bufferSize)
+    {
+        *bufferSize = length + 1;
+        *buffer = (char *)realloc(*buffer, *bufferSize);
+    }
+
+    long long done = 0;
+
+    while (done < length)
+    {
+        ssize_t result = pread(descriptor, *buffer + done, length - done, offset + done);
+
+        if (result <= 0)
+            return false;
+
+        done += result;
+    }
+
+    (*buffer)[length] = '\0';
+
+    return true;
+}
+
+/*
+    Parses the triangles of a face range into zero based global indices,
+    written from corner onwards, and the material of each triangle starting
+    from material. Returns the number of corners written, at most cornerLimit
+    less the corners of polygons dropped for a missing position, which are
+    added to droppedCorners.
+*/
+size_t parseFaceRange(char * text, FaceRange * range, Mesh * mesh, int * materialCapacity, int material, OBJData * data, size_t corner, size_t cornerLimit, size_t * droppedCorners)
+{
+    size_t cornerCount = 0;
+    faceParserFP faceParser = NULL;
+
+    for (char * line = text; line != NULL && *line != '\0'; line = strchr(line, '\n'), line = line ? line + 1 : NULL)
+    {
+        if (!strncmp(line, "usemtl ", 7))
+        {
+            char name[MESH_MATERIAL_NAME_LENGTH] = "default";
+            sscanf(line + 6, " %63[^\r\n]", name);
+
+            material = findOrAddMaterial(mesh, materialCapacity, name);
+        }
+
+        if (line[0] != 'f' || line[1] != ' ')
+            continue;
+
+        // Files with relative indices always take the generic parser
+        int vertices[LOAD_MODEL_MAX_FACE_CORNERS];
+        int textures[LOAD_MODEL_MAX_FACE_CORNERS];
+        int normals[LOAD_MODEL_MAX_FACE_CORNERS];
+
+        // The index counted corners in the part of the line loadOBJ reads
+        size_t lineLength = strcspn(line, "\n");
+        char * cut = lineLength > LOAD_MODEL_LINE_LENGTH - 1 ? line + LOAD_MODEL_LINE_LENGTH - 1 : NULL;
+        char cutCharacter = cut != NULL ? *cut : '\0';
+
+        if (cut != NULL)
+            *cut = '\0';
+
+        if (faceParser == NULL)
+            faceParser = selectFaceParser(line + 1);
+
+        int polygonCorners = faceParser(line + 1, vertices, textures, normals);
+
+        if (polygonCorners == 0)
+            polygonCorners = parseFaceGeneric(line + 1, vertices, textures, normals);
+
+        if (cut != NULL)
+            *cut = cutCharacter;
+
+        if (polygonCorners < 3 || cornerCount + TRIANGULAR_MESH_TYPE * (polygonCorners - 2) > cornerLimit)
+            continue;
+
+        // Relative indices count back from the records before this range, as
+        // loadOBJ counts them. Missing indices, and ones outside those
+        // records, become -1, and a polygon missing a position is dropped.
+        bool positioned = true;
+
+        for (int i = 0; i < polygonCorners; i++)
+        {
+            vertices[i] = resolveFaceIndex(vertices[i], range->vertexBase);
+            textures[i] = resolveFaceIndex(textures[i], range->textureBase);
+            normals[i] = resolveFaceIndex(normals[i], range->normalBase);
+            positioned = positioned && vertices[i] != -1;
+        }
+
+        if (!positioned)
+        {
+            *droppedCorners += TRIANGULAR_MESH_TYPE * (polygonCorners - 2);
+            cornerLimit -= TRIANGULAR_MESH_TYPE * (polygonCorners - 2);
+            continue;
+        }
+
+        size_t face = (corner + cornerCount) / 3;
+
+        for (int i = 0; i < polygonCorners - 2; i++)
+            data->faceMaterials[face + i] = material;
+
+        data->polygonSizes[data->polygonCount++] = polygonCorners;
+
+        // Corners go at the start of the polygon's triangles, which are
+        // split once the positions have been read. The rest of the room is
+        // marked missing, so loadVertexBlocks passes over it.
+        for (int i = polygonCorners; i < TRIANGULAR_MESH_TYPE * (polygonCorners - 2); i++)
+        {
+            data->faceVertices[corner + cornerCount + i] = -1;
+            data->faceTexcoords[corner + cornerCount + i] = -1;
+            data->faceNormals[corner + cornerCount + i] = -1;
+        }
+
+        for (int i = 0; i < polygonCorners; i++)
+        {
+            data->faceVertices[corner + cornerCount + i] = vertices[i];
+            data->faceTexcoords[corner + cornerCount + i] = textures[i];
+            data->faceNormals[corner + cornerCount + i] = normals[i];
+        }
+
+        cornerCount += TRIANGULAR_MESH_TYPE * (polygonCorners - 2);
+    }
+
+    return cornerCount;
+}
+
+/*
+    Reads only the blocks which the given global indices fall in, and
+    replaces each index with its position in the returned values. Indices
+    of -1, for corners without the record, are left as they are.
+*/
+bool loadVertexBlocks(int descriptor, VertexBlock * blocks, int blockCount, char * prefix, int componentCount, int * indices, size_t indexCount, float ** values, char ** buffer, long long * bufferSize, long long * bytesRead)
+{
+    // Start of each needed block in values, or -1
+    int * blockSlots = (int *)malloc(sizeof(int) * (blockCount + 1));
+    int * indexBlocks = (int *)malloc(sizeof(int) * (indexCount + 1));
+    int valueCount = 0;
+    bool valid = true;
+
+    for (int i = 0; i < blockCount; i++)
+        blockSlots[i] = -1;
+
+    for (size_t i = 0; i < indexCount && valid; i++)
+    {
+        if (indices[i] == -1)
+        {
+            indexBlocks[i] = -1;
+            continue;
+        }
+
+        indexBlocks[i] = findVertexBlock(blocks, blockCount, indices[i]);
+        valid = indexBlocks[i] != -1;
+
+        if (valid && blockSlots[indexBlocks[i]] == -1)
+        {
+            blockSlots[indexBlocks[i]] = valueCount;
+            valueCount += blocks[indexBlocks[i]].count;
+        }
+    }
+
+    *values = (float *)malloc(sizeof(float) * componentCount * (valueCount + 1));
+
+    for (int block = 0; block < blockCount && valid; block++)
+    {
+        if (blockSlots[block] == -1)
+            continue;
+
+        valid = readFileRange(descriptor, blocks[block].offset, blocks[block].length, buffer, bufferSize);
+        *bytesRead += blocks[block].length;
+
+        float * value = &(*values)[(size_t)componentCount * blockSlots[block]];
+        int recordCount = 0;
+
+        for (char * line = *buffer; valid && line != NULL && *line != '\0'; line = strchr(line, '\n'), line = line ? line + 1 : NULL)
+        {
+            if (line[0] != prefix[0] || line[1] != prefix[1] || recordCount == blocks[block].count)
+                continue;
+
+            char * cursor = line + 2;
+
+            for (int axis = 0; axis < componentCount; axis++)
+                value[axis] = strtof(cursor, &cursor);
+
+            value += componentCount;
+            recordCount++;
+        }
+
+        valid = valid && recordCount == blocks[block].count;
+    }
+
+    for (size_t i = 0; i < indexCount && valid; i++)
+    {
+        if (indexBlocks[i] != -1)
+            indices[i] = blockSlots[indexBlocks[i]] + indices[i] - blocks[indexBlocks[i]].first;
+    }
+
+    free(blockSlots);
+    free(indexBlocks);
+
+    return valid;
+}
@@ -0,0 +1,114 @@
+#ifndef MODEL_INDEX
+#define MODEL_INDEX
+
+#include <stdbool.h>
+
+#include "loadModel.h"
+
+#define MODEL_INDEX_BLOCK_RECORDS 4096
+#define MODEL_INDEX_PATH_LENGTH 1024
+#define MODEL_INDEX_MAGIC "OBJIDX05"
+#define MODEL_INDEX_LIBRARY_LENGTH 256
+
+// Face lines of one group. vertexBase, normalBase and textureBase are the
+// number of v, vn and vt records before the range, which relative (negative)
+// indices count from.
+// material is the one in use where the range starts, or -1 before any usemtl.
+typedef struct FaceRange
+{
+    long long offset;
+    long long length;
+    int group;
+    int material;
+    int vertexBase;
+    int normalBase;
+    int textureBase;
+}
+FaceRange;
+
+// Up to MODEL_INDEX_BLOCK_RECORDS v, vn or vt records, the first of which has the
+// zero based global index first
+typedef struct VertexBlock
+{
+    long long offset;
+    long long length;
+    int first;
+    int count;
+}
+VertexBlock;
+
+// A group's face ranges are stored together, starting at firstRange
+typedef struct IndexedGroup
+{
+    char name[MESH_GROUP_NAME_LENGTH];
+    int firstRange;
+    int rangeCount;
+    long long cornerCount;
+}
+IndexedGroup;
+
+typedef struct IndexedMaterial
+{
+    char name[MESH_MATERIAL_NAME_LENGTH];
+}
+IndexedMaterial;
+
+typedef struct ModelIndex
+{
+    long long fileSize;
+    long long modifiedTime;
+    char materialLibrary[MODEL_INDEX_LIBRARY_LENGTH];
+    IndexedGroup * groups;
+    int groupCount;
+    IndexedMaterial * materials;
+    int materialCount;
+    FaceRange * ranges;
+    int rangeCount;
+    VertexBlock * vertexBlocks;
+    int vertexBlockCount;
+    VertexBlock * normalBlocks;
+    int normalBlockCount;
+    VertexBlock * textureBlocks;
+    int textureBlockCount;
+}
+ModelIndex;
+
+// Sidecar file layout, followed by the groups, materials, ranges, vertex
+// blocks, normal blocks and texture blocks arrays
+typedef struct ModelIndexHeader
+{
+    char magic[8];
+    long long fileSize;
+    long long modifiedTime;
+    char materialLibrary[MODEL_INDEX_LIBRARY_LENGTH];
+    int groupCount;
+    int materialCount;
+    int rangeCount;
+    int vertexBlockCount;
+    int normalBlockCount;
+    int textureBlockCount;
+}
+ModelIndexHeader;
+
+// Public method(s)
+bool loadModelIndex(char * filename, ModelIndex * index);
+long long loadOBJGroups(char * filename, char * groupNames, Mesh * mesh);
+void releaseModelIndex(ModelIndex * index);
+
+// Private method(s)
+bool buildModelIndex(char * filename, ModelIndex * index);
+bool readModelIndex(char * indexPath, ModelIndex * index);
+void saveModelIndex(char * indexPath, ModelIndex * index);
+bool readModelStatus(char * filename, long long * fileSize, long long * modifiedTime);
+int findIndexedGroup(ModelIndex * index, char * name);
+int addIndexedGroup(ModelIndex * index, int * groupCapacity, char * name);
+int findIndexedMaterial(ModelIndex * index, char * name);
+int addIndexedMaterial(ModelIndex * index, int * materialCapacity, char * name);
+int addVertexBlock(VertexBlock ** blocks, int * blockCount, int * blockCapacity, long long offset, int first);
+void sortFaceRanges(ModelIndex * index);
+int findVertexBlock(VertexBlock * blocks, int blockCount, int vertexIndex);
+bool readFileRange(int descriptor, long long offset, long long length, char ** buffer, long long * bufferSize);
+size_t parseFaceRange(char * text, FaceRange * range, Mesh * mesh, int * materialCapacity, int material, OBJData * data, size_t corner, size_t cornerLimit, size_t * droppedCorners);
+bool loadVertexBlocks(int descriptor, VertexBlock * blocks, int blockCount, char * prefix, int componentCount, int * indices, size_t indexCount, float ** values, char ** buffer, long long * bufferSize, long long * bytesRead);
+
+#endif
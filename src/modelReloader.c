@@ -0,0 +1,161 @@
+/******************************************************************************
+ * File:        modelReloader.c
+ * Description: Reloads the model file while the viewer runs, for exporters
+ *              which rewrite the OBJ during design iteration.
+ *              - The file is watched through fileWatcher and re-parsed on a
+ *                background thread, so the render loop never waits for it.
+ *              - Saves which arrive while a parse is running are folded into
+ *                one more parse once it finishes.
+ * Notes:       A file which fails to parse is ignored, keeping the resident
+ *              mesh until the next save.
+ ******************************************************************************/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark.h"
+#include "fileWatcher.h"
+#include "modelReloader.h"
+
+static char * reloadPath;
+static int modelWatch = -1;
+static pthread_t reloaderThread;
+static bool reloaderRunning;
+static pthread_mutex_t reloadMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reloadRequested = PTHREAD_COND_INITIALIZER;
+
+// Shared with the reloader thread under reloadMutex
+static bool requestPending;
+static bool reloaderShutdown;
+static double requestTime;
+static bool meshReady;
+static Mesh readyMesh;
+static double readyRequestTime;
+
+// Public method(s)
+
+bool initialiseModelReloader(char * modelPath)
+{
+    modelWatch = watchFile(modelPath);
+
+    if (modelWatch == -1)
+        return false;
+
+    reloadPath = modelPath;
+    requestPending = false;
+    reloaderShutdown = false;
+    meshReady = false;
+
+    reloaderRunning = pthread_create(&reloaderThread, NULL, reloaderThreadMain, NULL) == 0;
+
+    return reloaderRunning;
+}
+
+/*
+    Called once per frame. Queues a parse when the file has changed and hands
+    over a parsed mesh once one is ready, with the time its change was seen.
+*/
+bool pollModelReloader(Mesh * reloadedMesh, double * changeTime)
+{
+    if (!reloaderRunning)
+        return false;
+
+    pollFileWatcher();
+    bool changed = consumeFileChange(modelWatch);
+    bool ready = false;
+
+    pthread_mutex_lock(&reloadMutex);
+
+    if (changed)
+    {
+        // Later saves keep the time of the first one not yet shown
+        if (!requestPending)
+            requestTime = currentTime();
+
+        requestPending = true;
+        pthread_cond_signal(&reloadRequested);
+    }
+
+    if (meshReady)
+    {
+        *reloadedMesh = readyMesh;
+        *changeTime = readyRequestTime;
+        meshReady = false;
+        ready = true;
+    }
+
+    pthread_mutex_unlock(&reloadMutex);
+
+    return ready;
+}
+
+void releaseModelReloader()
+{
+    if (!reloaderRunning)
+        return;
+
+    pthread_mutex_lock(&reloadMutex);
+    reloaderShutdown = true;
+    pthread_cond_signal(&reloadRequested);
+    pthread_mutex_unlock(&reloadMutex);
+
+    pthread_join(reloaderThread, NULL);
+    reloaderRunning = false;
+
+    if (meshReady)
+        releaseMesh(&readyMesh);
+
+    meshReady = false;
+}
+
+// Private method(s)
+
+void * reloaderThreadMain(void * argument)
+{
+    pthread_mutex_lock(&reloadMutex);
+
+    while (true)
+    {
+        while (!requestPending && !reloaderShutdown)
+            pthread_cond_wait(&reloadRequested, &reloadMutex);
+
+        if (reloaderShutdown)
+            break;
+
+        double parseRequestTime = requestTime;
+        requestPending = false;
+        pthread_mutex_unlock(&reloadMutex);
+
+        Mesh mesh;
+        bool loaded = loadModel(reloadPath, &mesh) > 0;
+
+        if (!loaded)
+        {
+            printf("Could not reload %s, keeping the current model.\n", reloadPath);
+            releaseMesh(&mesh);
+        }
+
+        pthread_mutex_lock(&reloadMutex);
+
+        if (loaded)
+        {
+            // A newer parse replaces one the render loop has not taken yet
+            if (meshReady)
+            {
+                releaseMesh(&readyMesh);
+                parseRequestTime = readyRequestTime;
+            }
+
+            readyMesh = mesh;
+            readyRequestTime = parseRequestTime;
+            meshReady = true;
+        }
+    }
+
+    pthread_mutex_unlock(&reloadMutex);
+
+    return NULL;
+}
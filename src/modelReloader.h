@@ -0,0 +1,16 @@
+#ifndef MODEL_RELOADER
+#define MODEL_RELOADER
+
+#include <stdbool.h>
+
+#include "loadModel.h"
+
+// Public method(s)
+bool initialiseModelReloader(char * modelPath);
+bool pollModelReloader(Mesh * reloadedMesh, double * changeTime);
+void releaseModelReloader();
+
+// Private method(s)
+void * reloaderThreadMain(void * argument);
+
+#endif
@@ -0,0 +1,111 @@
+/******************************************************************************
+ * File:        offscreenTarget.c
+ * Description: Framebuffer objects for rendering at a fixed resolution
+ *              independent of the window, used when frames are written to
+ *              disk rather than shown on screen.
+ *              Rendering goes to a multisampled framebuffer, matching the
+ *              window's antialiasing, which is then resolved into a single
+ *              sampled framebuffer that glReadPixels can read from.
+ ******************************************************************************/
+
+
+#include <stdio.h>
+
+#include <glad/glad.h>
+
+#include "getGLErrors.h"
+#include "offscreenTarget.h"
+
+// Public method(s)
+
+bool createOffscreenTarget(OffscreenTarget * target, int width, int height, int samples)
+{
+    target->width = width;
+    target->height = height;
+
+    glGenFramebuffers(1, &target->multisampleFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->multisampleFramebuffer);
+
+    glGenRenderbuffers(1, &target->multisampleColorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->multisampleColorBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->multisampleColorBuffer);
+
+    glGenRenderbuffers(1, &target->multisampleDepthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->multisampleDepthBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->multisampleDepthBuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &target->resolveFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->resolveFramebuffer);
+
+    glGenRenderbuffers(1, &target->resolveColorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->resolveColorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->resolveColorBuffer);
+
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GET_GL_ERRORS();
+
+    if (!complete)
+        printf("Offscreen framebuffer is incomplete.\n");
+
+    return complete;
+}
+
+void bindOffscreenTarget(OffscreenTarget * target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target->multisampleFramebuffer);
+    glViewport(0, 0, target->width, target->height);
+}
+
+/*
+    Resolves the multisampled image and leaves the resolved framebuffer bound
+    for reading, ready for glReadPixels.
+*/
+void resolveOffscreenTarget(OffscreenTarget * target)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->multisampleFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->resolveFramebuffer);
+    glBlitFramebuffer(
+        0, 0, target->width, target->height,
+        0, 0, target->width, target->height,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST
+    );
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->resolveFramebuffer);
+    GET_GL_ERRORS();
+}
+
+/*
+    Copies the resolved image to the window so progress can be watched while
+    capturing. The window may be a different size, so the image is scaled.
+*/
+void presentOffscreenTarget(OffscreenTarget * target, int windowWidth, int windowHeight)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->resolveFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(
+        0, 0, target->width, target->height,
+        0, 0, windowWidth, windowHeight,
+        GL_COLOR_BUFFER_BIT, GL_LINEAR
+    );
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GET_GL_ERRORS();
+}
+
+void releaseOffscreenTarget(OffscreenTarget * target)
+{
+    glDeleteFramebuffers(1, &target->multisampleFramebuffer);
+    glDeleteFramebuffers(1, &target->resolveFramebuffer);
+    glDeleteRenderbuffers(1, &target->multisampleColorBuffer);
+    glDeleteRenderbuffers(1, &target->multisampleDepthBuffer);
+    glDeleteRenderbuffers(1, &target->resolveColorBuffer);
+}
@@ -0,0 +1,25 @@
+#ifndef OFFSCREEN_TARGET
+#define OFFSCREEN_TARGET
+
+#include <stdbool.h>
+
+typedef struct OffscreenTarget
+{
+    unsigned int multisampleFramebuffer;
+    unsigned int multisampleColorBuffer;
+    unsigned int multisampleDepthBuffer;
+    unsigned int resolveFramebuffer;
+    unsigned int resolveColorBuffer;
+    int width;
+    int height;
+}
+OffscreenTarget;
+
+// Public method(s)
+bool createOffscreenTarget(OffscreenTarget * target, int width, int height, int samples);
+void bindOffscreenTarget(OffscreenTarget * target);
+void resolveOffscreenTarget(OffscreenTarget * target);
+void presentOffscreenTarget(OffscreenTarget * target, int windowWidth, int windowHeight);
+void releaseOffscreenTarget(OffscreenTarget * target);
+
+#endif
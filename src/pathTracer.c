@@ -0,0 +1,391 @@
+/******************************************************************************
+ * File:        pathTracer.c
+ * Description: Progressive CPU path tracer, used as a ground truth image for
+ *              the OpenGL and software rasterizers.
+ *              - The scene is the one in sceneSettings.h: a grey diffuse and
+ *                Blinn-Phong specular model lit by one point light, under a
+ *                uniform sky standing in for the rasterizers' ambient term.
+ *              - Each pass adds one sample per pixel to a float accumulation
+ *                buffer, and the image is written after every power of two
+ *                passes so convergence can be watched.
+ *              - Tiles are handed out one at a time to the job system's
+ *                workers, which steal from each other, so uneven tiles
+ *                (open sky next to dense geometry) do not leave cores idle.
+ * Notes:       Light falloff and the diffuse normalisation are left out to
+ *              match fragment.shader, so both images can be compared.
+ ******************************************************************************/
+
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cglm/cglm.h>
+
+#include "benchmark.h"
+#include "bvh.h"
+#include "imageWriter.h"
+#include "jobSystem.h"
+#include "pathTracer.h"
+#include "sceneSettings.h"
+
+#define PATH_TILE_SIZE 32
+#define PATH_MAX_DEPTH 5
+#define PATH_ROULETTE_DEPTH 2
+#define PATH_RAY_OFFSET 1e-4f
+
+static Mesh mesh;
+static BoundingVolumeHierarchy bvh;
+static float * worldPositions;
+static float * worldNormals;
+static int triangleCount;
+static vec3 cameraPosition;
+static vec3 cameraRight;
+static vec3 cameraUp;
+static vec3 cameraForward;
+static vec3 lightPosition;
+static vec3 lightColor;
+static vec3 modelColor;
+static vec3 clearColor;
+static vec3 skyColor;
+
+static int width;
+static int height;
+static float * accumulation;
+static int tilesAcross;
+static int tileCount;
+static int currentPass;
+
+// Rays traced in the current pass, added to once per tile
+static _Atomic unsigned long long passRayCount;
+
+// Public method(s)
+
+bool initialisePathTracer(ScreenSize * screenSize, char * modelName)
+{
+    if (loadModel(modelName, &mesh) <= 0)
+        return false;
+
+    // Points have no surface to rasterize or trace
+    if (mesh.pointCount > 0)
+    {
+        printf("Point clouds are drawn by the OpenGL renderer only.\n");
+        releaseMesh(&mesh);
+        return false;
+    }
+
+    triangleCount = mesh.vertexCount / 9;
+
+    // The loader has already fitted the model to the view, so its
+    // vertices are in world space
+    worldPositions = mesh.vertices;
+    worldNormals = mesh.normals;
+
+    double buildTime = benchmark(buildSceneBVH);
+
+    printf("Built BVH over %d triangles in %.3f seconds (%d nodes)\n", triangleCount, buildTime, bvh.nodeCount);
+
+    glm_vec3_copy((vec3)SCENE_CAMERA_POSITION, cameraPosition);
+    glm_vec3_sub((vec3)SCENE_CAMERA_TARGET, cameraPosition, cameraForward);
+    glm_vec3_normalize(cameraForward);
+    glm_vec3_cross(cameraForward, (vec3)SCENE_CAMERA_UP, cameraRight);
+    glm_vec3_normalize(cameraRight);
+    glm_vec3_cross(cameraRight, cameraForward, cameraUp);
+
+    glm_vec3_copy((vec3)SCENE_MODEL_COLOR, modelColor);
+    glm_vec3_copy((vec3)SCENE_LIGHT_COLOR, lightColor);
+    glm_vec3_copy((vec3)SCENE_LIGHT_POSITION, lightPosition);
+    glm_vec3_copy((vec3)SCENE_CLEAR_COLOR, clearColor);
+
+    // An unoccluded surface gathers exactly the rasterizers' ambient term
+    glm_vec3_scale(lightColor, SCENE_AMBIENT_STRENGTH, skyColor);
+
+    width = screenSize->width;
+    height = screenSize->height;
+    accumulation = (float *)calloc((size_t)width * height * 3, sizeof(float));
+
+    tilesAcross = (width + PATH_TILE_SIZE - 1) / PATH_TILE_SIZE;
+    tileCount = tilesAcross * ((height + PATH_TILE_SIZE - 1) / PATH_TILE_SIZE);
+
+    return true;
+}
+
+/*
+    Adds sampleCount passes to the image, writing it after passes 1, 2, 4, 8
+    and so on, and once more at the end.
+*/
+bool renderPathTracer(char * outputPath, int sampleCount)
+{
+    bool written = false;
+    double totalTime = 0.0;
+    unsigned long long totalRays = 0;
+
+    for (currentPass = 0; currentPass < sampleCount; currentPass++)
+    {
+        double passTime = benchmark(runPathTracerPass);
+
+        unsigned long long passRays = atomic_load(&passRayCount);
+
+        totalTime += passTime;
+        totalRays += passRays;
+
+        printf("Pass %d/%d: %.3f seconds, %.2f Mrays/s\n",
+            currentPass + 1,
+            sampleCount,
+            passTime,
+            passRays / passTime / 1e6
+        );
+
+        int passCount = currentPass + 1;
+
+        if ((passCount & (passCount - 1)) == 0 || passCount == sampleCount)
+            written = writePathTracerImage(outputPath, passCount);
+    }
+
+    printf("Path traced %d samples per pixel in %.3f seconds (%.2f Mrays/s)\n",
+        sampleCount,
+        totalTime,
+        totalRays / totalTime / 1e6
+    );
+
+    return written;
+}
+
+void releasePathTracer()
+{
+    releaseBVH(&bvh);
+    releaseMesh(&mesh);
+    free(accumulation);
+
+    worldPositions = NULL;
+    worldNormals = NULL;
+    accumulation = NULL;
+}
+
+// Private method(s)
+
+void buildSceneBVH()
+{
+    buildBVH(&bvh, worldPositions, triangleCount);
+}
+
+/*
+    Traces every tile of the pass as jobs, with the calling thread taking
+    tiles as well, and returns once all of them have finished.
+*/
+void runPathTracerPass()
+{
+    atomic_store(&passRayCount, 0);
+    parallelFor(tileCount, 1, traceTiles, NULL);
+}
+
+void traceTiles(void * argument, size_t first, size_t end)
+{
+    unsigned int rayCount = 0;
+
+    for (size_t tile = first; tile < end; tile++)
+        renderTile(tile, &rayCount);
+
+    atomic_fetch_add(&passRayCount, rayCount);
+}
+
+void renderTile(int tile, unsigned int * rayCount)
+{
+    int minX = (tile % tilesAcross) * PATH_TILE_SIZE;
+    int minY = (tile / tilesAcross) * PATH_TILE_SIZE;
+    int maxX = minX + PATH_TILE_SIZE < width ? minX + PATH_TILE_SIZE : width;
+    int maxY = minY + PATH_TILE_SIZE < height ? minY + PATH_TILE_SIZE : height;
+
+    float aspect = (float)width / height;
+    float halfHeight = tanf(glm_rad(SCENE_FIELD_OF_VIEW) * 0.5f);
+
+    for (int y = minY; y < maxY; y++)
+    {
+        for (int x = minX; x < maxX; x++)
+        {
+            // Seeded by pixel and pass so every run gives the same image
+            unsigned int seed = (unsigned int)(y * width + x) * 9781u + (unsigned int)currentPass * 6271u + 1u;
+            seed ^= seed >> 16;
+            seed *= 0x7FEB352Du;
+            seed ^= seed >> 15;
+            seed *= 0x846CA68Bu;
+            seed ^= seed >> 16;
+
+            // Rows are bottom-up, as in the OpenGL and software renderers
+            float screenX = ((x + randomFloat(&seed)) / width * 2.0f - 1.0f) * halfHeight * aspect;
+            float screenY = ((y + randomFloat(&seed)) / height * 2.0f - 1.0f) * halfHeight;
+
+            vec3 direction;
+            for (int i = 0; i < 3; i++)
+                direction[i] = cameraForward[i] + screenX * cameraRight[i] + screenY * cameraUp[i];
+            glm_vec3_normalize(direction);
+
+            vec3 radiance;
+            tracePath(cameraPosition, direction, &seed, rayCount, radiance);
+
+            float * pixel = &accumulation[3 * (y * width + x)];
+            pixel[0] += radiance[0];
+            pixel[1] += radiance[1];
+            pixel[2] += radiance[2];
+        }
+    }
+}
+
+/*
+    Follows one path, adding the point light through a shadow ray at every
+    bounce and continuing with a cosine weighted diffuse bounce.
+*/
+void tracePath(float * rayOrigin, float * rayDirection, unsigned int * seed, unsigned int * rayCount, float * radiance)
+{
+    vec3 origin, direction, throughput = {1.0f, 1.0f, 1.0f};
+
+    glm_vec3_copy(rayOrigin, origin);
+    glm_vec3_copy(rayDirection, direction);
+    glm_vec3_zero(radiance);
+
+    for (int depth = 0; depth < PATH_MAX_DEPTH; depth++)
+    {
+        Ray ray;
+        RayHit hit;
+
+        initialiseRay(&ray, origin, direction);
+        (*rayCount)++;
+
+        if (!intersectBVH(&bvh, &ray, SCENE_FAR_PLANE, &hit))
+        {
+            vec3 background;
+            glm_vec3_copy(depth == 0 ? clearColor : skyColor, background);
+            glm_vec3_muladd(throughput, background, radiance);
+            return;
+        }
+
+        vec3 position, geometricNormal, shadingNormal;
+        shadePoint(hit.triangleIndex, &hit, direction, position, geometricNormal, shadingNormal);
+
+        vec3 offsetPosition;
+        glm_vec3_copy(position, offsetPosition);
+        glm_vec3_muladds(geometricNormal, PATH_RAY_OFFSET, offsetPosition);
+
+        vec3 lightDirection, viewDirection, halfVector;
+        glm_vec3_sub(lightPosition, position, lightDirection);
+        float lightDistance = glm_vec3_norm(lightDirection);
+        glm_vec3_scale(lightDirection, 1.0f / lightDistance, lightDirection);
+
+        float diffuse = glm_vec3_dot(shadingNormal, lightDirection);
+
+        if (diffuse > 0.0f)
+        {
+            Ray shadowRay;
+            initialiseRay(&shadowRay, offsetPosition, lightDirection);
+            (*rayCount)++;
+
+            if (!occludedBVH(&bvh, &shadowRay, lightDistance))
+            {
+                glm_vec3_negate_to(direction, viewDirection);
+                glm_vec3_add(lightDirection, viewDirection, halfVector);
+                glm_vec3_normalize(halfVector);
+                float specular = powf(fmaxf(glm_vec3_dot(shadingNormal, halfVector), 0.0f), SCENE_REFLECTANCE);
+
+                for (int i = 0; i < 3; i++)
+                    radiance[i] += throughput[i] * lightColor[i] * modelColor[i] * (diffuse + specular);
+            }
+        }
+
+        glm_vec3_mul(throughput, modelColor, throughput);
+
+        if (depth >= PATH_ROULETTE_DEPTH)
+        {
+            float survival = fminf(glm_vec3_max(throughput), 0.95f);
+
+            if (randomFloat(seed) >= survival)
+                return;
+
+            glm_vec3_scale(throughput, 1.0f / survival, throughput);
+        }
+
+        // Cosine weighted direction about the shading normal
+        float radius = sqrtf(randomFloat(seed));
+        float angle = 2.0f * GLM_PIf * randomFloat(seed);
+        float tangentX = radius * cosf(angle);
+        float tangentY = radius * sinf(angle);
+        float normalZ = sqrtf(fmaxf(1.0f - radius * radius, 0.0f));
+
+        vec3 tangent, bitangent, helper = {1.0f, 0.0f, 0.0f};
+        if (fabsf(shadingNormal[0]) > 0.9f)
+            glm_vec3_copy((vec3){0.0f, 1.0f, 0.0f}, helper);
+
+        glm_vec3_cross(shadingNormal, helper, tangent);
+        glm_vec3_normalize(tangent);
+        glm_vec3_cross(shadingNormal, tangent, bitangent);
+
+        for (int i = 0; i < 3; i++)
+            direction[i] = tangentX * tangent[i] + tangentY * bitangent[i] + normalZ * shadingNormal[i];
+
+        glm_vec3_normalize(direction);
+        glm_vec3_copy(offsetPosition, origin);
+    }
+}
+
+/*
+    Finds the hit position with both normals turned to face the ray. The
+    geometric normal offsets new rays, the interpolated normal shades.
+*/
+void shadePoint(int triangleIndex, RayHit * hit, float * direction, float * position, float * geometricNormal, float * shadingNormal)
+{
+    float * corners = &worldPositions[9 * (size_t)triangleIndex];
+    float * normals = &worldNormals[9 * (size_t)triangleIndex];
+    float w0 = 1.0f - hit->u - hit->v;
+
+    vec3 edge1, edge2;
+    glm_vec3_sub(&corners[3], corners, edge1);
+    glm_vec3_sub(&corners[6], corners, edge2);
+    glm_vec3_cross(edge1, edge2, geometricNormal);
+    glm_vec3_normalize(geometricNormal);
+
+    for (int i = 0; i < 3; i++)
+    {
+        position[i] = w0 * corners[i] + hit->u * corners[3 + i] + hit->v * corners[6 + i];
+        shadingNormal[i] = w0 * normals[i] + hit->u * normals[3 + i] + hit->v * normals[6 + i];
+    }
+
+    glm_vec3_normalize(shadingNormal);
+
+    if (glm_vec3_dot(geometricNormal, direction) > 0.0f)
+        glm_vec3_negate(geometricNormal);
+
+    if (glm_vec3_dot(shadingNormal, geometricNormal) < 0.0f)
+        glm_vec3_negate(shadingNormal);
+}
+
+float randomFloat(unsigned int * seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+
+    return (*seed >> 8) * (1.0f / 16777216.0f);
+}
+
+bool writePathTracerImage(char * filePath, int passCount)
+{
+    unsigned char * pixels = (unsigned char *)malloc((size_t)width * height * 4);
+    float inverseCount = 1.0f / passCount;
+
+    for (int i = 0; i < width * height; i++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            float value = fminf(accumulation[3 * i + channel] * inverseCount, 1.0f);
+            pixels[4 * i + channel] = (unsigned char)(value * 255.0f + 0.5f);
+        }
+
+        pixels[4 * i + 3] = 255;
+    }
+
+    bool written = writePNG(filePath, pixels, width, height, true);
+    free(pixels);
+
+    return written;
+}
@@ -0,0 +1,25 @@
+#ifndef PATH_TRACER
+#define PATH_TRACER
+
+#include <stdbool.h>
+
+#include "bvh.h"
+#include "inputTracking.h"
+#include "loadModel.h"
+
+// Public method(s)
+bool initialisePathTracer(ScreenSize * screenSize, char * modelName);
+bool renderPathTracer(char * outputPath, int sampleCount);
+void releasePathTracer();
+
+// Private method(s)
+void buildSceneBVH();
+void runPathTracerPass();
+void traceTiles(void * argument, size_t first, size_t end);
+void renderTile(int tile, unsigned int * rayCount);
+void tracePath(float * origin, float * direction, unsigned int * seed, unsigned int * rayCount, float * radiance);
+void shadePoint(int triangleIndex, RayHit * hit, float * direction, float * position, float * geometricNormal, float * shadingNormal);
+float randomFloat(unsigned int * seed);
+bool writePathTracerImage(char * filePath, int passCount);
+
+#endif
@@ -0,0 +1,344 @@
+/******************************************************************************
+ * File:        pointCloud.c
+ * Description: Loads OBJ files of v records without faces, as written by
+ *              scanners, as point clouds.
+ *              - Records may carry a colour, v x y z r g b, with components
+ *                from 0 to 1 or from 0 to 255, the same range throughout
+ *                the file.
+ *              - Points are centred and scaled like a mesh, then sorted into
+ *                the cells of a grid over the cloud, each cell one or more
+ *                chunks with bounds for culling.
+ *              - Positions are stored as 16 bits per axis over their cell's
+ *                box, and colours as 8 bits per channel, 12 bytes a point.
+ * Notes:       Each chunk's points are shuffled, so drawing only the first
+ *              part of a chunk draws an even subsample of it.
+ ******************************************************************************/
+
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jobSystem.h"
+#include "pointCloud.h"
+#include "sceneSettings.h"
+
+// Axes shorter than this fraction of the longest are not split, so flat
+// scans are divided into columns rather than thin slabs
+#define POINT_GRID_FLAT_RATIO 0.001f
+
+#define POINT_QUANTIZE_STEPS 65535.0f
+
+// Chunks shuffled and bounded by each job
+#define POINT_CHUNKS_PER_JOB 8
+
+// Files whose largest colour component is above this have colours from 0
+// to 255, and others from 0 to 1, leaving room for rounding a little past 1
+#define POINT_COLOR_UNIT_LIMIT 2.0f
+
+// Public method(s)
+
+/*
+    Reads the v records of a file already found to have no faces, and
+    stores them in the mesh's points and chunks. Returns the number of
+    position floats read.
+*/
+long long loadPointCloud(FILE * input, size_t pointCount, Mesh * mesh)
+{
+    float * positions = (float *)malloc(sizeof(float) * 3 * pointCount);
+    float * colors = (float *)malloc(sizeof(float) * 3 * pointCount);
+    char line[LOAD_MODEL_LINE_LENGTH];
+    size_t loadedCount = 0;
+    float largestComponent = 0.0f;
+
+    fseek(input, 0, SEEK_SET);
+
+    while(loadedCount < pointCount && fgets(line, sizeof(line), input) != NULL)
+    {
+        float * color = &colors[3 * loadedCount];
+
+        if (line[0] == 'v' && line[1] == ' ' && parsePointRecord(line, &positions[3 * loadedCount], color))
+        {
+            largestComponent = fmaxf(largestComponent, fmaxf(color[0], fmaxf(color[1], color[2])));
+            loadedCount++;
+        }
+    }
+
+    if (loadedCount == 0)
+    {
+        free(positions);
+        free(colors);
+        return 0;
+    }
+
+    // The range is decided once for the file, since a single dark point of
+    // a 0 to 255 scan looks like one from 0 to 1
+    float colorScale = largestComponent > POINT_COLOR_UNIT_LIMIT ? 1.0f : 255.0f;
+
+    // Points are centred and scaled to fit the view, as mesh corners are
+    float center[3];
+    fitMeshToView(mesh, positions, NULL, loadedCount, center);
+
+    for (size_t i = 0; i < 3 * loadedCount; i++)
+        positions[i] = (positions[i] - center[i % 3]) * mesh->scale;
+
+    float boundsMin[3];
+    float boundsMax[3];
+    computePositionBounds(positions, NULL, loadedCount, boundsMin, boundsMax);
+
+    PointGrid grid;
+    fitPointGrid(&grid, boundsMin, boundsMax, loadedCount);
+
+    // A counting sort by cell, which cellStarts then holds the start of
+    size_t cellCount = (size_t)grid.dimensions[0] * grid.dimensions[1] * grid.dimensions[2];
+    size_t * cellStarts = (size_t *)calloc(cellCount + 1, sizeof(size_t));
+
+    for (size_t i = 0; i < loadedCount; i++)
+        cellStarts[pointGridCell(&grid, &positions[3 * i]) + 1]++;
+
+    for (size_t cell = 1; cell <= cellCount; cell++)
+        cellStarts[cell] += cellStarts[cell - 1];
+
+    // Cells too full for one chunk are split between several
+    int chunkCount = 0;
+
+    for (size_t cell = 0; cell < cellCount; cell++)
+        chunkCount += (cellStarts[cell + 1] - cellStarts[cell] + POINT_CHUNK_MAX_POINTS - 1) / POINT_CHUNK_MAX_POINTS;
+
+    mesh->points = (PointVertex *)malloc(sizeof(PointVertex) * loadedCount);
+    mesh->pointCount = loadedCount;
+    mesh->pointChunks = (PointChunk *)malloc(sizeof(PointChunk) * chunkCount);
+    mesh->pointChunkCount = 0;
+
+    for (size_t cell = 0; cell < cellCount; cell++)
+    {
+        for (size_t first = cellStarts[cell]; first < cellStarts[cell + 1]; first += POINT_CHUNK_MAX_POINTS)
+        {
+            PointChunk * chunk = &mesh->pointChunks[mesh->pointChunkCount++];
+            size_t remaining = cellStarts[cell + 1] - first;
+
+            chunk->first = first;
+            chunk->count = remaining < POINT_CHUNK_MAX_POINTS ? remaining : POINT_CHUNK_MAX_POINTS;
+            pointGridCellOrigin(&grid, cell, chunk->origin);
+            memcpy(chunk->extent, grid.cellSize, sizeof(grid.cellSize));
+        }
+    }
+
+    // Each point is quantized over the box of the cell it is written to
+    for (size_t i = 0; i < loadedCount; i++)
+    {
+        size_t cell = pointGridCell(&grid, &positions[3 * i]);
+        float origin[3];
+        pointGridCellOrigin(&grid, cell, origin);
+
+        PointVertex * point = &mesh->points[cellStarts[cell]++];
+        quantizePoint(point, &positions[3 * i], origin, grid.cellSize);
+        encodePointColor(point, &colors[3 * i], colorScale);
+    }
+
+    free(positions);
+    free(colors);
+    free(cellStarts);
+
+    parallelFor(mesh->pointChunkCount, POINT_CHUNKS_PER_JOB, finishPointChunks, mesh);
+
+    printf("Loaded a point cloud of %zu points in %d chunks (%.1f MB)\n",
+        loadedCount, mesh->pointChunkCount, sizeof(PointVertex) * loadedCount / 1048576.0);
+
+    return 3 * loadedCount;
+}
+
+// Private method(s)
+
+/*
+    Reads the position of a v record, and its colour when it has one, as
+    written. Points without a colour are marked with a negative colour.
+    Returns false when the record has fewer than three coordinates.
+*/
+bool parsePointRecord(char * line, float * position, float * color)
+{
+    float values[6];
+    int valueCount = 0;
+    char * cursor = line + 1;
+
+    for (; valueCount < 6; valueCount++)
+    {
+        char * end;
+        values[valueCount] = strtof(cursor, &end);
+
+        if (end == cursor)
+            break;
+
+        cursor = end;
+    }
+
+    if (valueCount < 3)
+        return false;
+
+    memcpy(position, values, sizeof(float) * 3);
+
+    for (int channel = 0; channel < 3; channel++)
+        color[channel] = valueCount == 6 ? values[3 + channel] : -1.0f;
+
+    return true;
+}
+
+/*
+    Stores a colour read from the file as 8 bits per channel, multiplied by
+    the file's scale. Points without a colour take the scene's model colour.
+*/
+void encodePointColor(PointVertex * point, float * color, float colorScale)
+{
+    float modelColor[3] = SCENE_MODEL_COLOR;
+    float * rgb = color[0] < 0.0f ? modelColor : color;
+    float scale = color[0] < 0.0f ? 255.0f : colorScale;
+
+    for (int channel = 0; channel < 3; channel++)
+        point->color[channel] = (unsigned char)fminf(fmaxf(rgb[channel] * scale + 0.5f, 0.0f), 255.0f);
+
+    point->color[3] = 255;
+}
+
+/*
+    Sizes a grid over the bounds with about POINT_CHUNK_TARGET_POINTS points
+    a cell, were they spread evenly. Cells are close to cubes along the axes
+    which are split.
+*/
+void fitPointGrid(PointGrid * grid, float * boundsMin, float * boundsMax, size_t pointCount)
+{
+    float extents[3];
+    float largestExtent = 0.0f;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        extents[axis] = boundsMax[axis] - boundsMin[axis];
+        largestExtent = fmaxf(largestExtent, extents[axis]);
+    }
+
+    float volume = 1.0f;
+    int splitAxes = 0;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (extents[axis] > largestExtent * POINT_GRID_FLAT_RATIO)
+        {
+            volume *= extents[axis];
+            splitAxes++;
+        }
+    }
+
+    float targetCells = pointCount > POINT_CHUNK_TARGET_POINTS ? (float)pointCount / POINT_CHUNK_TARGET_POINTS : 1.0f;
+    float cellSize = splitAxes > 0 ? powf(volume / targetCells, 1.0f / splitAxes) : 0.0f;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        bool split = cellSize > 0.0f && extents[axis] > largestExtent * POINT_GRID_FLAT_RATIO;
+
+        grid->boundsMin[axis] = boundsMin[axis];
+        grid->dimensions[axis] = split ? (int)fmaxf(ceilf(extents[axis] / cellSize), 1.0f) : 1;
+        grid->cellSize[axis] = extents[axis] / grid->dimensions[axis];
+    }
+}
+
+size_t pointGridCell(PointGrid * grid, float * position)
+{
+    int coordinates[3];
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float cell = grid->cellSize[axis] > 0.0f ? (position[axis] - grid->boundsMin[axis]) / grid->cellSize[axis] : 0.0f;
+        coordinates[axis] = (int)fminf(fmaxf(cell, 0.0f), grid->dimensions[axis] - 1);
+    }
+
+    return ((size_t)coordinates[2] * grid->dimensions[1] + coordinates[1]) * grid->dimensions[0] + coordinates[0];
+}
+
+// Lowest corner of a cell's box
+void pointGridCellOrigin(PointGrid * grid, size_t cell, float * origin)
+{
+    size_t coordinates[3] = {
+        cell % grid->dimensions[0],
+        cell / grid->dimensions[0] % grid->dimensions[1],
+        cell / grid->dimensions[0] / grid->dimensions[1]
+    };
+
+    for (int axis = 0; axis < 3; axis++)
+        origin[axis] = grid->boundsMin[axis] + coordinates[axis] * grid->cellSize[axis];
+}
+
+void quantizePoint(PointVertex * point, float * position, float * origin, float * extent)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float step = extent[axis] > 0.0f ? (position[axis] - origin[axis]) / extent[axis] * POINT_QUANTIZE_STEPS : 0.0f;
+        point->position[axis] = (unsigned short)fminf(fmaxf(step + 0.5f, 0.0f), POINT_QUANTIZE_STEPS);
+    }
+
+    point->position[3] = 0;
+}
+
+/*
+    Shuffles the points of each chunk in the range, and finds the sphere
+    around them and their spacing. Scans sample surfaces, so the spacing is
+    taken from the area of the two longest sides of the chunk's box.
+*/
+void finishPointChunks(void * argument, size_t first, size_t end)
+{
+    Mesh * mesh = (Mesh *)argument;
+
+    for (size_t index = first; index < end; index++)
+    {
+        PointChunk * chunk = &mesh->pointChunks[index];
+        PointVertex * points = &mesh->points[chunk->first];
+
+        // Fisher-Yates with a xorshift generator seeded by the chunk, so a
+        // file always loads in the same order
+        uint64_t state = 0x9E3779B97F4A7C15ull * (index + 1);
+
+        for (size_t i = chunk->count - 1; i > 0; i--)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+
+            size_t j = state % (i + 1);
+            PointVertex swapped = points[i];
+            points[i] = points[j];
+            points[j] = swapped;
+        }
+
+        unsigned short low[3] = {65535, 65535, 65535};
+        unsigned short high[3] = {0, 0, 0};
+
+        for (size_t i = 0; i < chunk->count; i++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                low[axis] = points[i].position[axis] < low[axis] ? points[i].position[axis] : low[axis];
+                high[axis] = points[i].position[axis] > high[axis] ? points[i].position[axis] : high[axis];
+            }
+        }
+
+        float sides[3];
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float scale = chunk->extent[axis] / POINT_QUANTIZE_STEPS;
+            chunk->center[axis] = chunk->origin[axis] + (low[axis] + high[axis]) * 0.5f * scale;
+            sides[axis] = (high[axis] - low[axis]) * scale;
+        }
+
+        chunk->radius = 0.5f * sqrtf(sides[0] * sides[0] + sides[1] * sides[1] + sides[2] * sides[2]);
+
+        // The area of the two longest sides, or the length of a line
+        float longest = fmaxf(sides[0], fmaxf(sides[1], sides[2]));
+        float shortest = fminf(sides[0], fminf(sides[1], sides[2]));
+        float middle = sides[0] + sides[1] + sides[2] - longest - shortest;
+
+        if (middle > 0.0f)
+            chunk->spacing = sqrtf(longest * middle / chunk->count);
+        else
+            chunk->spacing = longest / chunk->count;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef POINT_CLOUD
+#define POINT_CLOUD
+
+#include <stdio.h>
+
+#include "loadModel.h"
+
+// Chunks hold about this many points, and at most POINT_CHUNK_MAX_POINTS
+#define POINT_CHUNK_TARGET_POINTS 65536
+#define POINT_CHUNK_MAX_POINTS (1 << 20)
+
+// Grid whose non-empty cells become a point cloud's chunks, in the same
+// centred space as the positions
+typedef struct PointGrid
+{
+    float boundsMin[3];
+    float cellSize[3];
+    int dimensions[3];
+}
+PointGrid;
+
+// Public method(s)
+long long loadPointCloud(FILE * input, size_t pointCount, Mesh * mesh);
+
+// Private method(s)
+bool parsePointRecord(char * line, float * position, float * color);
+void encodePointColor(PointVertex * point, float * color, float colorScale);
+void fitPointGrid(PointGrid * grid, float * boundsMin, float * boundsMax, size_t pointCount);
+size_t pointGridCell(PointGrid * grid, float * position);
+void pointGridCellOrigin(PointGrid * grid, size_t cell, float * origin);
+void quantizePoint(PointVertex * point, float * position, float * origin, float * extent);
+void finishPointChunks(void * argument, size_t first, size_t end);
+
+#endif
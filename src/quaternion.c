@@ -29,6 +29,14 @@ void quaternionRotation(mat4 * modelMatrix, MousePosition * positions, ScreenSiz
     float rotationSpeed = size->width / 80.0 + size->height / 60.0;
     angle *= rotationSpeed;
 
+    quaternionRotationAxisAngle(modelMatrix, axisOfRotation, angle);
+
+    positions->xPrevPosition = positions->xPosition;
+    positions->yPrevPosition = positions->yPosition;
+}
+
+void quaternionRotationAxisAngle(mat4 * modelMatrix, vec3 axisOfRotation, float angle)
+{
     vec4 quaternion = {
         sin(angle / 2) * axisOfRotation[0],
         sin(angle / 2) * axisOfRotation[1], 
@@ -42,9 +50,6 @@ void quaternionRotation(mat4 * modelMatrix, MousePosition * positions, ScreenSiz
     glm_quat_mat4(quaternion, quaternionMat);
 
     glm_mat4_mul(quaternionMat, *modelMatrix, *modelMatrix);
-
-    positions->xPrevPosition = positions->xPosition;
-    positions->yPrevPosition = positions->yPosition;
 }
 
 void screenCoordsToVector(int xCoord, int yCoord, ScreenSize * size, vec3 * v)
@@ -8,6 +8,7 @@
 
 // Public method(s)
 void quaternionRotation(mat4 * modelMatrix, MousePosition * positions, ScreenSize * screen);
+void quaternionRotationAxisAngle(mat4 * modelMatrix, vec3 axisOfRotation, float angle);
 
 // Private method(s)
 void screenCoordsToVector(int xCoord, int yCoord, ScreenSize * size, vec3 * v);
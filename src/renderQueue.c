@@ -0,0 +1,123 @@
+/******************************************************************************
+ * File:        renderQueue.c
+ * Description: Collects a frame's draws with a 64 bit key each and puts
+ *              them in the order they are submitted in.
+ *              - Keys order draws by program, material and buffer chunk, so
+ *                draws sharing all three are neighbours and can be
+ *                submitted with one multi-draw call, and then front to back
+ *                so near surfaces fill the depth buffer first.
+ *              - Draws are ordered by a least significant digit first radix
+ *                sort, which is linear in the number of draws. Digits that
+ *                are the same in every key are skipped.
+ * Notes:       Key fields wider than their bits are clamped, which only
+ *              affects the order. Renderers compare the fields of the draws
+ *              themselves to decide which can share a call.
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "renderQueue.h"
+
+// Public method(s)
+
+// Empties the queue, keeping its memory for the next frame
+void clearRenderQueue(RenderQueue * queue)
+{
+    queue->count = 0;
+}
+
+// Room for one more draw at the end of the queue, to be filled in
+RenderItem * pushRenderItem(RenderQueue * queue)
+{
+    if (queue->count == queue->capacity)
+    {
+        queue->capacity = queue->capacity ? 2 * queue->capacity : 256;
+        queue->items = (RenderItem *)realloc(queue->items, sizeof(RenderItem) * queue->capacity);
+        queue->sorted = (RenderItem *)realloc(queue->sorted, sizeof(RenderItem) * queue->capacity);
+    }
+
+    return &queue->items[queue->count++];
+}
+
+/*
+    Sorts the draws by key, keeping the order of equal keys. Each pass
+    counts one digit of every key, and the draws are then moved into the
+    other array at the offsets the counts give.
+*/
+void sortRenderQueue(RenderQueue * queue)
+{
+    int counts[1 << RENDER_QUEUE_RADIX_BITS];
+
+    for (int pass = 0; pass < RENDER_QUEUE_RADIX_PASSES; pass++)
+    {
+        int shift = pass * RENDER_QUEUE_RADIX_BITS;
+        uint64_t mask = (1 << RENDER_QUEUE_RADIX_BITS) - 1;
+
+        memset(counts, 0, sizeof(counts));
+
+        for (int i = 0; i < queue->count; i++)
+            counts[(queue->items[i].key >> shift) & mask]++;
+
+        // A digit every key shares leaves the order as it is
+        if (queue->count == 0 || counts[(queue->items[0].key >> shift) & mask] == queue->count)
+            continue;
+
+        for (int digit = 0, offset = 0; digit <= (int)mask; digit++)
+        {
+            int count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+
+        for (int i = 0; i < queue->count; i++)
+            queue->sorted[counts[(queue->items[i].key >> shift) & mask]++] = queue->items[i];
+
+        RenderItem * swap = queue->items;
+        queue->items = queue->sorted;
+        queue->sorted = swap;
+    }
+}
+
+/*
+    Packs a draw's program, material, chunk, depth and transform into a key.
+    depth runs from 0 at the camera to 1 at the far plane, so lower keys are
+    nearer. With transformFirst, draws with the same transform are kept
+    together ahead of depth, for renderers which must switch transforms
+    between calls.
+*/
+uint64_t renderSortKey(int program, int material, int chunk, float depth, int transform, bool transformFirst)
+{
+    float depthScale = (float)((1 << RENDER_KEY_DEPTH_BITS) - 1);
+    uint64_t depthField = depth <= 0.0f ? 0 : depth >= 1.0f ? (uint64_t)depthScale : (uint64_t)(depth * depthScale);
+    uint64_t transformField = clampKeyField(transform, RENDER_KEY_TRANSFORM_BITS);
+    uint64_t key = clampKeyField(program, RENDER_KEY_PROGRAM_BITS);
+
+    key = key << RENDER_KEY_MATERIAL_BITS | clampKeyField(material, RENDER_KEY_MATERIAL_BITS);
+    key = key << RENDER_KEY_CHUNK_BITS | clampKeyField(chunk, RENDER_KEY_CHUNK_BITS);
+
+    if (transformFirst)
+        return (key << RENDER_KEY_TRANSFORM_BITS | transformField) << RENDER_KEY_DEPTH_BITS | depthField;
+
+    return (key << RENDER_KEY_DEPTH_BITS | depthField) << RENDER_KEY_TRANSFORM_BITS | transformField;
+}
+
+void releaseRenderQueue(RenderQueue * queue)
+{
+    free(queue->items);
+    free(queue->sorted);
+    queue->items = NULL;
+    queue->sorted = NULL;
+    queue->count = 0;
+    queue->capacity = 0;
+}
+
+// Private method(s)
+
+uint64_t clampKeyField(uint64_t value, int bits)
+{
+    uint64_t largest = ((uint64_t)1 << bits) - 1;
+
+    return value < largest ? value : largest;
+}
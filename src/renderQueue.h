@@ -0,0 +1,61 @@
+#ifndef RENDER_QUEUE
+#define RENDER_QUEUE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bits of each field of a sort key, from the most significant. Programs
+// are switched least often, then materials, then buffer chunks, and draws
+// sharing all three are ordered by depth and transform.
+#define RENDER_KEY_PROGRAM_BITS 4
+#define RENDER_KEY_MATERIAL_BITS 16
+#define RENDER_KEY_CHUNK_BITS 8
+#define RENDER_KEY_DEPTH_BITS 20
+#define RENDER_KEY_TRANSFORM_BITS 16
+
+// Digits the radix sort orders keys by, one pass each
+#define RENDER_QUEUE_RADIX_BITS 8
+#define RENDER_QUEUE_RADIX_PASSES (64 / RENDER_QUEUE_RADIX_BITS)
+
+// One draw of a frame. elementCount elements from firstElement of the
+// shared element buffer index the chunk's corners from baseVertex, for
+// instanceCount instances whose transforms start at firstInstance. A draw
+// of clusterCount clusters from firstCluster is culled and drawn a cluster
+// at a time, with the elements of each cluster.
+typedef struct RenderItem
+{
+    uint64_t key;
+    size_t firstElement;
+    int elementCount;
+    int baseVertex;
+    int instanceCount;
+    int firstInstance;
+    int material;
+    int chunk;
+    int firstCluster;
+    int clusterCount;
+}
+RenderItem;
+
+// A frame's draws, and room for the radix sort to move them between
+typedef struct RenderQueue
+{
+    RenderItem * items;
+    RenderItem * sorted;
+    int count;
+    int capacity;
+}
+RenderQueue;
+
+// Public method(s)
+void clearRenderQueue(RenderQueue * queue);
+RenderItem * pushRenderItem(RenderQueue * queue);
+void sortRenderQueue(RenderQueue * queue);
+uint64_t renderSortKey(int program, int material, int chunk, float depth, int transform, bool transformFirst);
+void releaseRenderQueue(RenderQueue * queue);
+
+// Private method(s)
+uint64_t clampKeyField(uint64_t value, int bits);
+
+#endif
@@ -0,0 +1,155 @@
+#version 430 core
+
+// One thread for each cluster of the spans queued this frame, which tests
+// the cluster's sphere against the view and the last frame's depth pyramid
+// and writes its indirect draw command, drawing no instances when it is
+// hidden
+layout (local_size_x = 64) in;
+
+struct Cluster
+{
+    vec4 sphere;
+    int baseVertex;
+    int cornerCount;
+    int group;
+    int material;
+};
+
+struct Run
+{
+    int firstThread;
+    int firstCluster;
+    int clusterCount;
+    int firstCommand;
+    int transform;
+};
+
+struct Command
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Clusters { Cluster clusters[]; };
+layout (std430, binding = 1) readonly buffer Runs { Run runs[]; };
+layout (std430, binding = 2) readonly buffer Transforms { mat4 transforms[]; };
+layout (std430, binding = 3) readonly buffer Groups { uint groupVisible[]; };
+layout (std430, binding = 4) writeonly buffer Commands { Command commands[]; };
+
+// Clusters tested against the depth pyramid, and those it hid
+layout (std430, binding = 5) buffer Statistics { uint testedCount; uint occludedCount; };
+
+// Frustum planes in the scene's space, facing inwards
+uniform vec4 planes[6];
+uniform int runCount;
+uniform int threadCount;
+
+// Farthest depth of each texel's area, the view it was drawn from, and its
+// number of levels, 0 before the first frame
+uniform sampler2D depthPyramid;
+uniform mat4 depthViewProjection;
+uniform int pyramidLevels;
+uniform float depthBias;
+
+// Whether the box around the sphere lay behind the depth everywhere it
+// covered, on the level where it spans at most two texels a side
+bool occluded(vec3 center, float radius)
+{
+    vec2 low = vec2(1.0);
+    vec2 high = vec2(0.0);
+    float nearest = 1.0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = depthViewProjection * vec4(corner, 1.0);
+
+        // Boxes reaching behind the camera cover it
+        if (clip.w <= 0.0 || clip.z < -clip.w)
+            return false;
+
+        vec3 window = clip.xyz / clip.w * 0.5 + 0.5;
+        low = min(low, window.xy);
+        high = max(high, window.xy);
+        nearest = min(nearest, window.z);
+    }
+
+    low = clamp(low, 0.0, 1.0);
+    high = clamp(high, 0.0, 1.0);
+
+    vec2 extent = (high - low) * vec2(textureSize(depthPyramid, 0));
+    int level = min(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), pyramidLevels - 1);
+    ivec2 size = textureSize(depthPyramid, level);
+    ivec2 first = min(ivec2(low * vec2(size)), size - 1);
+    ivec2 last = min(ivec2(high * vec2(size)), size - 1);
+    float farthest = 0.0;
+
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+            farthest = max(farthest, texelFetch(depthPyramid, ivec2(x, y), level).r);
+    }
+
+    return nearest > farthest + depthBias;
+}
+
+void main()
+{
+    int thread = int(gl_GlobalInvocationID.x);
+
+    if (thread >= threadCount)
+        return;
+
+    // Runs are in thread order, so the thread's run is the last starting
+    // at or before it
+    int low = 0;
+    int high = runCount - 1;
+
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+
+        if (runs[middle].firstThread <= thread)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    Run run = runs[low];
+    int index = thread - run.firstThread;
+    Cluster cluster = clusters[run.firstCluster + index];
+    mat4 transform = transforms[run.transform];
+
+    // Scenes scale uniformly, but the longest axis keeps any sphere whole
+    vec3 center = (transform * vec4(cluster.sphere.xyz, 1.0)).xyz;
+    float scale = max(length(transform[0].xyz), max(length(transform[1].xyz), length(transform[2].xyz)));
+    float radius = cluster.sphere.w * scale;
+
+    bool visible = groupVisible[cluster.group] != 0u;
+
+    for (int i = 0; i < 6 && visible; i++)
+        visible = dot(planes[i].xyz, center) + planes[i].w >= -radius;
+
+    if (visible && pyramidLevels > 0)
+    {
+        atomicAdd(testedCount, 1u);
+
+        if (occluded(center, radius))
+        {
+            atomicAdd(occludedCount, 1u);
+            visible = false;
+        }
+    }
+
+    Command command;
+    command.count = uint(cluster.cornerCount);
+    command.instanceCount = visible ? 1u : 0u;
+    command.firstIndex = 0u;
+    command.baseVertex = cluster.baseVertex;
+    command.baseInstance = uint(run.transform);
+
+    commands[run.firstCommand + index] = command;
+}
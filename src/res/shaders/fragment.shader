@@ -1,8 +1,37 @@
 #version 330 core
 
+// Variants are selected by defines inserted after the version line:
+// GOURAUD_SHADING, FLAT_SHADING, NO_SPECULAR and DEPTH_ONLY
+
+#if defined(DEPTH_ONLY)
+// No colour is written, the depth comes from the rasterizer
+void main()
+{
+}
+#elif defined(GOURAUD_SHADING)
+// Lighting from the Vertex Shader
+in vec3 shadedDiffuse;
+in vec3 shadedSpecular;
+in vec2 texcoords;
+
+// Output to Frame Buffer
+out vec4 FinalFragmentColor;
+
+// Diffuse map, images are stored top row first
+uniform sampler2D diffuseMap;
+
+void main()
+{
+    vec3 texel = texture(diffuseMap, vec2(texcoords.x, 1.0 - texcoords.y)).rgb;
+    FinalFragmentColor = vec4(shadedDiffuse * texel + shadedSpecular, 1.0);
+}
+#else
 // Information from Vertex Shader
 in vec3 vertices;
+in vec2 texcoords;
+#ifndef FLAT_SHADING
 in vec3 normals;
+#endif
 
 // Output to Frame Buffer
 out vec4 FinalFragmentColor;
@@ -10,9 +39,17 @@ out vec4 FinalFragmentColor;
 // Information transfer from C code
 uniform vec3 lightPosition;
 uniform vec3 lightColor;
-uniform vec3 modelColor;
 uniform vec3 cameraPosition;
-uniform float modelReflectance;
+
+// Diffuse map, images are stored top row first
+uniform sampler2D diffuseMap;
+
+// Material of the current draw, the specular exponent is in specular.w
+layout (std140) uniform Material
+{
+    vec4 diffuse;
+    vec4 specular;
+} material;
 
 void main()
 {
@@ -20,23 +57,34 @@ void main()
     float lightingStrength = 0.7;
     vec3 ambient = lightingStrength * lightColor;
 
+#ifdef FLAT_SHADING
+    // One normal per triangle from the screen space derivatives of position
+    vec3 norm = normalize(cross(dFdx(vertices), dFdy(vertices)));
+#else
     // Normalise normals
     vec3 norm = normalize(normals);
+#endif
 
     // Diffuse lighting
     vec3 lightDir = normalize(lightPosition - vertices);
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = diff * lightColor;
 
+#ifdef NO_SPECULAR
+    vec3 specular = vec3(0.0);
+#else
     // Specular lighting
     vec3 viewDir = normalize(cameraPosition - vertices);
     vec3 halfVec = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(norm, halfVec), 0.0), modelReflectance);
+    float spec = pow(max(dot(norm, halfVec), 0.0), material.specular.w);
     vec3 specular = spec * lightColor;
+#endif
 
     // Combine lighting componenets
-    vec3 absoluteColor = (ambient + diffuse + specular) * modelColor;
+    vec3 texel = texture(diffuseMap, vec2(texcoords.x, 1.0 - texcoords.y)).rgb;
+    vec3 absoluteColor = (ambient + diffuse) * material.diffuse.rgb * texel + specular * material.specular.rgb;
 
     // Set the final fragment color
     FinalFragmentColor = vec4(absoluteColor, 1.0);
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,14 @@
+#version 330 core
+
+// Information from Vertex Shader
+in vec3 pointColor;
+
+// Output to Frame Buffer
+out vec4 FinalFragmentColor;
+
+void main()
+{
+    // Points are drawn as squares, without lighting since scans have no
+    // normals, and the colours were captured under the scanned lighting
+    FinalFragmentColor = vec4(pointColor, 1.0);
+}
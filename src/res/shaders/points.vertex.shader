@@ -0,0 +1,26 @@
+#version 330 core
+
+// Point cloud positions, quantized over the box of their chunk, and colours
+layout (location = 0) in vec3 quantizedPosition;
+layout (location = 1) in vec4 colorBuffer;
+
+// Information transfer from C code
+uniform mat4 MVP;
+uniform vec3 chunkOrigin;
+uniform vec3 chunkExtent;
+
+// Size in pixels of a point one unit in front of the camera
+uniform float pointScale;
+
+// Output to Fragment Shader
+out vec3 pointColor;
+
+void main()
+{
+    gl_Position = MVP * vec4(chunkOrigin + quantizedPosition * chunkExtent, 1.0);
+
+    // Points shrink with distance, as the surface they sample does
+    gl_PointSize = clamp(pointScale / gl_Position.w, 1.0, 64.0);
+
+    pointColor = colorBuffer.rgb;
+}
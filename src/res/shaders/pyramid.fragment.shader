@@ -0,0 +1,28 @@
+#version 330 core
+
+// The level below, or the copy of the depth buffer for the first level
+uniform sampler2D source;
+uniform ivec2 sourceSize;
+uniform ivec2 targetSize;
+
+// Output to the pyramid level
+out float farthestDepth;
+
+void main()
+{
+    // Every source texel this texel overlaps, at most three a side since
+    // each level is at least half the size of the one below
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 first = texel * sourceSize / targetSize;
+    ivec2 end = ((texel + 1) * sourceSize + targetSize - 1) / targetSize;
+
+    float farthest = 0.0;
+
+    for (int y = first.y; y < end.y; y++)
+    {
+        for (int x = first.x; x < end.x; x++)
+            farthest = max(farthest, texelFetch(source, ivec2(x, y), 0).r);
+    }
+
+    farthestDepth = farthest;
+}
@@ -1,24 +1,101 @@
 #version 330 core
 
-// Vertices and Normals from OBJ file
+// Variants are selected by defines inserted after the version line:
+// GOURAUD_SHADING, FLAT_SHADING, NO_SPECULAR and DEPTH_ONLY
+
+// Vertices, Normals and Texture Coordinates from OBJ file
 layout (location = 0) in vec3 vertexBuffer;
 layout (location = 1) in vec3 normalBuffer;
+layout (location = 2) in vec2 texcoordBuffer;
+
+// Placement of the instance being drawn, the identity for other draws
+layout (location = 3) in mat4 instanceTransform;
+
+// The depth pre-pass and the shading pass after it, which only shades
+// fragments at exactly the depth the pre-pass stored, must place every
+// vertex identically
+invariant gl_Position;
 
 // Information transfer from C code
 uniform mat4 MVP;
 uniform mat4 model;
 uniform mat3 normalMatrix;
 
+#if defined(DEPTH_ONLY)
+// Only the depth is written
+#elif defined(GOURAUD_SHADING)
+uniform vec3 lightPosition;
+uniform vec3 lightColor;
+uniform vec3 cameraPosition;
+
+// Material of the current draw, the specular exponent is in specular.w
+layout (std140) uniform Material
+{
+    vec4 diffuse;
+    vec4 specular;
+} material;
+
+// Output to Fragment Shader, the diffuse part is textured there
+out vec3 shadedDiffuse;
+out vec3 shadedSpecular;
+out vec2 texcoords;
+
+void blinnPhong(vec3 position, vec3 norm)
+{
+    // Ambient lighting
+    float lightingStrength = 0.7;
+    vec3 ambient = lightingStrength * lightColor;
+
+    // Diffuse lighting
+    vec3 lightDir = normalize(lightPosition - position);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+#ifdef NO_SPECULAR
+    vec3 specular = vec3(0.0);
+#else
+    // Specular lighting
+    vec3 viewDir = normalize(cameraPosition - position);
+    vec3 halfVec = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(norm, halfVec), 0.0), material.specular.w);
+    vec3 specular = spec * lightColor;
+#endif
+
+    // Combine lighting componenets
+    shadedDiffuse = (ambient + diffuse) * material.diffuse.rgb;
+    shadedSpecular = specular * material.specular.rgb;
+}
+#elif defined(FLAT_SHADING)
+// Output to Fragment Shader, normals are derived there per triangle
+out vec3 vertices;
+out vec2 texcoords;
+#else
 // Output to Fragment Shader
 out vec3 normals;
 out vec3 vertices;
+out vec2 texcoords;
+#endif
 
 void main()
 {
-    vec4 worldPosition = vec4(vertexBuffer, 1.0);
+    vec4 worldPosition = instanceTransform * vec4(vertexBuffer, 1.0);
+
+#if defined(GOURAUD_SHADING) && !defined(DEPTH_ONLY)
+    // Lighting is evaluated once per vertex and interpolated
+    blinnPhong(vec3(model * worldPosition), normalize(normalMatrix * (mat3(instanceTransform) * normalBuffer)));
+#elif defined(FLAT_SHADING) && !defined(DEPTH_ONLY)
+    vertices = vec3(model * worldPosition);
+#elif !defined(DEPTH_ONLY)
     vertices = vec3(model * worldPosition);
 
-    normals = normalMatrix * normalBuffer;
+    // Instances are rigid apart from a uniform scale, so their rotation
+    // turns normals as it turns positions
+    normals = normalMatrix * (mat3(instanceTransform) * normalBuffer);
+#endif
+
+#if !defined(DEPTH_ONLY)
+    texcoords = texcoordBuffer;
+#endif
     
     gl_Position = MVP * worldPosition;
-}
\ No newline at end of file
+}
@@ -0,0 +1,647 @@
+/******************************************************************************
+ * File:        sceneGraph.c
+ * Description: Places several models in one scene.
+ *              - The models named on the command line and in a scene file
+ *                are loaded in parallel and merged into one mesh.
+ *              - Nodes form a hierarchy of transforms. Changing a node marks
+ *                it dirty, and only dirty subtrees have their world
+ *                matrices recomputed.
+ *              - Every node keeps the box around its subtree, so renderers
+ *                can skip whole subtrees outside the view.
+ * Notes:       Nodes are stored after their parents, so a pass in order
+ *              always reaches a parent first.
+ ******************************************************************************/
+
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jobSystem.h"
+#include "sceneGraph.h"
+
+static char * sceneFilePath = NULL;
+
+// Public method(s)
+
+/*
+    A scene file for later scenes to place their nodes from, or NULL for
+    none. Each line is
+
+        name parent x y z axisX axisY axisZ degrees scale spin [model.obj]
+
+    which places the node in its parent, - for the scene itself, moved by
+    x y z after being scaled and then rotated about the axis. A node with a
+    model draws it in its file's units. spin turns the node that many
+    degrees a second about the same axis. Parents must come before their
+    children, and lines starting with # are comments.
+*/
+void selectSceneFile(char * scenePath)
+{
+    sceneFilePath = scenePath;
+}
+
+/*
+    Loads every model named on the command line or in the scene file, each
+    on its own job, and merges them into one mesh with a node for each. A
+    model the scene file does not place keeps the position of its file, so
+    parts exported from one assembly line up. A single model without a scene
+    file is kept as loaded. Returns false when no model could be loaded.
+*/
+bool loadScene(char ** modelNames, int modelCount, SceneGraph * scene, Mesh * mesh)
+{
+    SceneModelLoad load = { NULL, NULL, NULL, 0 };
+    mat4 identity = GLM_MAT4_IDENTITY_INIT;
+
+    scene->nodes = NULL;
+    scene->nodeCount = 0;
+    scene->nodeCapacity = 0;
+    addSceneNode(scene, "scene", -1, identity);
+
+    // Until the models are merged, file nodes hold the index of their path
+    if (sceneFilePath != NULL)
+        readSceneFile(sceneFilePath, scene, &load);
+
+    int fileNodeCount = scene->nodeCount;
+    int * commandLinePaths = (int *)malloc(sizeof(int) * (modelCount + 1));
+
+    for (int i = 0; i < modelCount; i++)
+        commandLinePaths[i] = addScenePath(&load, modelNames[i]);
+
+    load.meshes = (Mesh *)malloc(sizeof(Mesh) * (load.pathCount + 1));
+    load.loaded = (bool *)calloc(load.pathCount + 1, sizeof(bool));
+    parallelFor(load.pathCount, 1, loadSceneModels, &load);
+
+    // Point clouds have no batches to merge, so they are only shown alone
+    Mesh * models = (Mesh *)malloc(sizeof(Mesh) * (load.pathCount + 1));
+    mat4 * fileTransforms = (mat4 *)malloc(sizeof(mat4) * (load.pathCount + 1));
+    int * pathModels = (int *)malloc(sizeof(int) * (load.pathCount + 1));
+    int mergedCount = 0;
+
+    for (int i = 0; i < load.pathCount; i++)
+    {
+        pathModels[i] = -1;
+
+        if (!load.loaded[i])
+            continue;
+
+        if (load.meshes[i].pointCount > 0 && load.pathCount > 1)
+        {
+            printf("Point clouds are only shown on their own, skipping %s.\n", load.paths[i]);
+            releaseMesh(&load.meshes[i]);
+            continue;
+        }
+
+        // Undoes the centring and scaling the loader fitted the model with
+        Mesh * loaded = &load.meshes[i];
+        glm_translate_make(fileTransforms[mergedCount], loaded->center);
+        glm_scale_uni(fileTransforms[mergedCount], 1.0f / loaded->scale);
+
+        pathModels[i] = mergedCount;
+        models[mergedCount++] = *loaded;
+    }
+
+    bool loaded = mergedCount > 0;
+    bool single = mergedCount == 1 && sceneFilePath == NULL;
+
+    if (loaded)
+        mergeMeshes(models, mergedCount, mesh);
+
+    for (int i = 1; i < fileNodeCount && loaded; i++)
+    {
+        int path = scene->nodes[i].model;
+        scene->nodes[i].model = -1;
+
+        if (path != -1 && pathModels[path] != -1)
+            setSceneNodeModel(scene, i, mesh, pathModels[path], fileTransforms[pathModels[path]]);
+    }
+
+    // Command line models the scene file does not place hang from the root
+    for (int i = 0; i < modelCount && loaded; i++)
+    {
+        int model = pathModels[commandLinePaths[i]];
+        bool placed = false;
+
+        for (int node = 1; node < fileNodeCount && !placed; node++)
+            placed = scene->nodes[node].model == model;
+
+        if (model == -1 || placed)
+            continue;
+
+        int node = addSceneNode(scene, modelNames[i], 0, identity);
+        setSceneNodeModel(scene, node, mesh, model, single ? identity : fileTransforms[model]);
+    }
+
+    if (loaded && !single)
+    {
+        fitSceneToView(scene);
+        printf("Scene of %d models in %d nodes\n", mergedCount, scene->nodeCount);
+    }
+
+    updateSceneGraph(scene);
+
+    for (int i = 0; i < load.pathCount; i++)
+        free(load.paths[i]);
+
+    free(load.paths);
+    free(load.meshes);
+    free(load.loaded);
+    free(models);
+    free(fileTransforms);
+    free(pathModels);
+    free(commandLinePaths);
+
+    return loaded;
+}
+
+/*
+    Builds a scene of the mesh as it was loaded, a root with a node for each
+    of the mesh's models, all without transforms.
+*/
+void createModelScene(SceneGraph * scene, Mesh * mesh)
+{
+    mat4 identity = GLM_MAT4_IDENTITY_INIT;
+
+    releaseSceneGraph(scene);
+    addSceneNode(scene, "scene", -1, identity);
+
+    for (int i = 0; i < mesh->modelCount; i++)
+        setSceneNodeModel(scene, addSceneNode(scene, "model", 0, identity), mesh, i, identity);
+
+    updateSceneGraph(scene);
+}
+
+/*
+    Takes the boxes of a new version of the scene's mesh, with the same
+    models, into the nodes drawing them.
+*/
+void refreshSceneModels(SceneGraph * scene, Mesh * mesh)
+{
+    for (int i = 0; i < scene->nodeCount; i++)
+    {
+        SceneNode * node = &scene->nodes[i];
+
+        if (node->model == -1 || node->model >= mesh->modelCount)
+            continue;
+
+        glm_vec3_copy(mesh->models[node->model].boundsMin, node->modelBoundsMin);
+        glm_vec3_copy(mesh->models[node->model].boundsMax, node->modelBoundsMax);
+        setSceneNodeTransform(scene, i, node->local);
+    }
+
+    updateSceneGraph(scene);
+}
+
+/*
+    Adds a node without a model as the last child of parent, or as the root
+    when parent is -1. Returns its index.
+*/
+int addSceneNode(SceneGraph * scene, char * name, int parent, mat4 placement)
+{
+    if (scene->nodeCount == scene->nodeCapacity)
+    {
+        scene->nodeCapacity = scene->nodeCapacity ? 2 * scene->nodeCapacity : 16;
+        scene->nodes = (SceneNode *)realloc(scene->nodes, sizeof(SceneNode) * scene->nodeCapacity);
+    }
+
+    int index = scene->nodeCount++;
+    SceneNode * node = &scene->nodes[index];
+
+    snprintf(node->name, sizeof(node->name), "%s", name);
+    glm_mat4_copy(placement, node->placement);
+    glm_mat4_identity(node->modelTransform);
+    glm_mat4_copy(placement, node->local);
+    glm_vec3_copy((vec3){ 0.0f, 1.0f, 0.0f }, node->spinAxis);
+    node->spin = 0.0f;
+    node->parent = parent;
+    node->firstChild = -1;
+    node->nextSibling = -1;
+    node->model = -1;
+    node->dirty = false;
+    node->childDirty = false;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        node->modelBoundsMin[axis] = node->boundsMin[axis] = FLT_MAX;
+        node->modelBoundsMax[axis] = node->boundsMax[axis] = -FLT_MAX;
+    }
+
+    if (parent != -1)
+    {
+        int * link = &scene->nodes[parent].firstChild;
+
+        while(*link != -1)
+            link = &scene->nodes[*link].nextSibling;
+
+        *link = index;
+    }
+
+    setSceneNodeTransform(scene, index, placement);
+
+    return index;
+}
+
+/*
+    Replaces the node's transform within its parent. The node is marked
+    dirty, and its ancestors as having a dirty node below them, up to the
+    first ancestor already marked.
+*/
+void setSceneNodeTransform(SceneGraph * scene, int node, mat4 local)
+{
+    SceneNode * sceneNode = &scene->nodes[node];
+
+    glm_mat4_copy(local, sceneNode->local);
+    sceneNode->dirty = true;
+
+    for (int parent = sceneNode->parent; parent != -1 && !scene->nodes[parent].childDirty; parent = scene->nodes[parent].parent)
+        scene->nodes[parent].childDirty = true;
+}
+
+// Turns each spinning node to its angle at time seconds
+void animateSceneGraph(SceneGraph * scene, double time)
+{
+    for (int i = 0; i < scene->nodeCount; i++)
+    {
+        SceneNode * node = &scene->nodes[i];
+
+        if (node->spin == 0.0f)
+            continue;
+
+        mat4 local;
+        glm_mat4_copy(node->placement, local);
+        glm_rotate(local, glm_rad(fmod(node->spin * time, 360.0)), node->spinAxis);
+        setSceneNodeTransform(scene, i, local);
+    }
+}
+
+/*
+    Recomputes the world matrices of the dirty nodes and of every node
+    below them, and the boxes of them and of their ancestors. Clean subtrees
+    are not visited. Returns the number of nodes whose matrices were
+    recomputed.
+*/
+int updateSceneGraph(SceneGraph * scene)
+{
+    if (scene->nodeCount == 0)
+        return 0;
+
+    return updateSceneNode(scene, 0, false);
+}
+
+int findSceneNode(SceneGraph * scene, char * name)
+{
+    for (int i = 0; i < scene->nodeCount; i++)
+    {
+        if (!strcmp(scene->nodes[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+void releaseSceneGraph(SceneGraph * scene)
+{
+    free(scene->nodes);
+    scene->nodes = NULL;
+    scene->nodeCount = 0;
+    scene->nodeCapacity = 0;
+}
+
+// Private method(s)
+
+/*
+    Adds a node for every line of the scene file, with the index of its
+    model's path in load. Returns false when the file could not be read.
+*/
+bool readSceneFile(char * scenePath, SceneGraph * scene, SceneModelLoad * load)
+{
+    FILE * input = fopen(scenePath, "r");
+
+    if (input == NULL)
+    {
+        printf("Could not open scene file %s.\n", scenePath);
+        return false;
+    }
+
+    char line[SCENE_LINE_LENGTH];
+    int lineNumber = 0;
+
+    while(fgets(line, sizeof(line), input) != NULL)
+    {
+        char name[SCENE_NODE_NAME_LENGTH];
+        char parentName[SCENE_NODE_NAME_LENGTH];
+        char modelPath[SCENE_LINE_LENGTH];
+        vec3 offset;
+        vec3 axis;
+        float degrees;
+        float scale;
+        float spin;
+
+        lineNumber++;
+
+        if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+
+        int fieldCount = sscanf(line, "%63s %63s %f %f %f %f %f %f %f %f %f %1023s", name, parentName,
+            &offset[0], &offset[1], &offset[2], &axis[0], &axis[1], &axis[2], &degrees, &scale, &spin, modelPath);
+
+        if (fieldCount < 11)
+        {
+            printf("Skipping line %d of %s, expected name parent x y z axisX axisY axisZ degrees scale spin [model].\n", lineNumber, scenePath);
+            continue;
+        }
+
+        int parent = strcmp(parentName, "-") ? findSceneNode(scene, parentName) : 0;
+
+        if (parent == -1)
+        {
+            printf("Skipping line %d of %s, no node %s comes before it.\n", lineNumber, scenePath, parentName);
+            continue;
+        }
+
+        mat4 placement;
+        glm_translate_make(placement, offset);
+
+        if (glm_vec3_norm(axis) > 0.0f)
+            glm_rotate(placement, glm_rad(degrees), axis);
+
+        glm_scale_uni(placement, scale);
+
+        int node = addSceneNode(scene, name, parent, placement);
+        scene->nodes[node].spin = spin;
+
+        if (glm_vec3_norm(axis) > 0.0f)
+            glm_vec3_normalize_to(axis, scene->nodes[node].spinAxis);
+
+        if (fieldCount == 12)
+            scene->nodes[node].model = addScenePath(load, modelPath);
+    }
+
+    fclose(input);
+
+    return true;
+}
+
+// Index of the path in the load, added unless already listed
+int addScenePath(SceneModelLoad * load, char * path)
+{
+    for (int i = 0; i < load->pathCount; i++)
+    {
+        if (!strcmp(load->paths[i], path))
+            return i;
+    }
+
+    load->paths = (char **)realloc(load->paths, sizeof(char *) * (load->pathCount + 1));
+    load->paths[load->pathCount] = strdup(path);
+
+    return load->pathCount++;
+}
+
+void loadSceneModels(void * argument, size_t first, size_t end)
+{
+    SceneModelLoad * load = (SceneModelLoad *)argument;
+
+    for (size_t i = first; i < end; i++)
+    {
+        load->loaded[i] = loadModel(load->paths[i], &load->meshes[i]) > 0;
+
+        if (!load->loaded[i])
+        {
+            printf("Could not load %s.\n", load->paths[i]);
+            releaseMesh(&load->meshes[i]);
+        }
+    }
+}
+
+/*
+    Appends the meshes' corners, groups, materials, batches and instances
+    one after another, with each mesh's indices moved past those before it,
+    and records each mesh as one model. The meshes are released as they are
+    copied. When only some have texture coordinates or normals, the others
+    are given zeros.
+*/
+void mergeMeshes(Mesh * meshes, int count, Mesh * merged)
+{
+    if (count == 1)
+    {
+        *merged = meshes[0];
+        return;
+    }
+
+    size_t cornerCount = 0;
+    int groupCount = 0;
+    int materialCount = 0;
+    int batchCount = 0;
+    int instanceCount = 0;
+    bool normals = false;
+    bool texcoords = false;
+    float radius = 0.0f;
+
+    for (int i = 0; i < count; i++)
+    {
+        cornerCount += meshes[i].vertexCount / 3;
+        groupCount += meshes[i].groupCount;
+        materialCount += meshes[i].materialCount;
+        batchCount += meshes[i].batchCount;
+        instanceCount += meshes[i].instanceCount;
+        normals = normals || meshes[i].normals != NULL;
+        texcoords = texcoords || meshes[i].texcoords != NULL;
+        radius = fmaxf(radius, meshes[i].radius);
+    }
+
+    merged->vertices = (float *)malloc(sizeof(float) * 3 * cornerCount + 1);
+    merged->normals = normals ? (float *)calloc(3 * cornerCount + 1, sizeof(float)) : NULL;
+    merged->texcoords = texcoords ? (float *)calloc(2 * cornerCount + 1, sizeof(float)) : NULL;
+    merged->vertexCount = 3 * cornerCount;
+    merged->scale = 1.0f;
+    merged->center[0] = merged->center[1] = merged->center[2] = 0.0f;
+    merged->radius = radius;
+    merged->groups = (MeshGroup *)malloc(sizeof(MeshGroup) * groupCount + 1);
+    merged->groupCount = groupCount;
+    merged->materials = (Material *)malloc(sizeof(Material) * materialCount + 1);
+    merged->materialCount = materialCount;
+    merged->batches = (MeshBatch *)malloc(sizeof(MeshBatch) * batchCount + 1);
+    merged->batchCount = batchCount;
+    merged->instances = instanceCount > 0 ? (MeshInstance *)malloc(sizeof(MeshInstance) * instanceCount) : NULL;
+    merged->instanceCount = instanceCount;
+    merged->models = (MeshModel *)malloc(sizeof(MeshModel) * count);
+    merged->modelCount = count;
+    merged->points = NULL;
+    merged->pointCount = 0;
+    merged->pointChunks = NULL;
+    merged->pointChunkCount = 0;
+
+    size_t corner = 0;
+    int group = 0;
+    int material = 0;
+    int batch = 0;
+    int instance = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        Mesh * mesh = &meshes[i];
+        size_t corners = mesh->vertexCount / 3;
+        MeshModel * model = &merged->models[i];
+
+        memcpy(&merged->vertices[3 * corner], mesh->vertices, sizeof(float) * 3 * corners);
+
+        if (mesh->normals != NULL)
+            memcpy(&merged->normals[3 * corner], mesh->normals, sizeof(float) * 3 * corners);
+
+        if (mesh->texcoords != NULL)
+            memcpy(&merged->texcoords[2 * corner], mesh->texcoords, sizeof(float) * 2 * corners);
+
+        memcpy(&merged->groups[group], mesh->groups, sizeof(MeshGroup) * mesh->groupCount);
+        memcpy(&merged->materials[material], mesh->materials, sizeof(Material) * mesh->materialCount);
+
+        for (int j = 0; j < mesh->batchCount; j++)
+        {
+            MeshBatch * moved = &merged->batches[batch + j];
+
+            *moved = mesh->batches[j];
+            moved->first += corner;
+            moved->group += group;
+            moved->material += material;
+        }
+
+        for (int j = 0; j < mesh->instanceCount; j++)
+        {
+            MeshInstance * moved = &merged->instances[instance + j];
+
+            *moved = mesh->instances[j];
+            moved->prototype += group;
+            moved->group += group;
+        }
+
+        *model = mesh->models[0];
+        model->firstBatch = batch;
+        model->batchCount = mesh->batchCount;
+        model->firstGroup = group;
+        model->groupCount = mesh->groupCount;
+        model->firstInstance = instance;
+        model->instanceCount = mesh->instanceCount;
+
+        corner += corners;
+        group += mesh->groupCount;
+        material += mesh->materialCount;
+        batch += mesh->batchCount;
+        instance += mesh->instanceCount;
+
+        releaseMesh(mesh);
+    }
+}
+
+// Makes the node draw model, which modelTransform takes into its space
+void setSceneNodeModel(SceneGraph * scene, int node, Mesh * mesh, int model, mat4 modelTransform)
+{
+    SceneNode * sceneNode = &scene->nodes[node];
+
+    sceneNode->model = model;
+    glm_mat4_copy(modelTransform, sceneNode->modelTransform);
+    glm_vec3_copy(mesh->models[model].boundsMin, sceneNode->modelBoundsMin);
+    glm_vec3_copy(mesh->models[model].boundsMax, sceneNode->modelBoundsMax);
+
+    setSceneNodeTransform(scene, node, sceneNode->local);
+}
+
+/*
+    Centres the scene's box on the origin and scales it to SCENE_FIT_EXTENT
+    along its longest axis, through the root's transform.
+*/
+void fitSceneToView(SceneGraph * scene)
+{
+    SceneNode * root = &scene->nodes[0];
+
+    updateSceneGraph(scene);
+
+    if (root->boundsMin[0] > root->boundsMax[0])
+        return;
+
+    vec3 center;
+    float largestExtent = 0.0f;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        center[axis] = -(root->boundsMin[axis] + root->boundsMax[axis]) / 2.0f;
+        largestExtent = fmaxf(largestExtent, root->boundsMax[axis] - root->boundsMin[axis]);
+    }
+
+    mat4 local = GLM_MAT4_IDENTITY_INIT;
+    glm_scale_uni(local, largestExtent > 0.0f ? SCENE_FIT_EXTENT / largestExtent : 1.0f);
+    glm_translate(local, center);
+    glm_mat4_mul(local, root->placement, local);
+
+    setSceneNodeTransform(scene, 0, local);
+}
+
+/*
+    Updates a node which is dirty, has a dirty node below it, or whose
+    parent moved, and then the nodes below it. Its box is rebuilt from its
+    model's and its children's, which are final by then.
+*/
+int updateSceneNode(SceneGraph * scene, int index, bool parentMoved)
+{
+    SceneNode * node = &scene->nodes[index];
+
+    if (!parentMoved && !node->dirty && !node->childDirty)
+        return 0;
+
+    bool moved = parentMoved || node->dirty;
+    int updatedCount = 0;
+
+    if (moved)
+    {
+        if (node->parent != -1)
+            glm_mat4_mul(scene->nodes[node->parent].world, node->local, node->world);
+        else
+            glm_mat4_copy(node->local, node->world);
+
+        glm_mat4_mul(node->world, node->modelTransform, node->modelWorld);
+        updatedCount++;
+    }
+
+    if (node->model != -1 && node->modelBoundsMin[0] <= node->modelBoundsMax[0])
+        transformBox(node->modelWorld, node->modelBoundsMin, node->modelBoundsMax, node->boundsMin, node->boundsMax);
+    else
+    {
+        glm_vec3_copy((vec3){ FLT_MAX, FLT_MAX, FLT_MAX }, node->boundsMin);
+        glm_vec3_copy((vec3){ -FLT_MAX, -FLT_MAX, -FLT_MAX }, node->boundsMax);
+    }
+
+    for (int child = node->firstChild; child != -1; child = scene->nodes[child].nextSibling)
+    {
+        updatedCount += updateSceneNode(scene, child, moved);
+
+        // The array may not move while updating, so node stays valid
+        glm_vec3_minv(node->boundsMin, scene->nodes[child].boundsMin, node->boundsMin);
+        glm_vec3_maxv(node->boundsMax, scene->nodes[child].boundsMax, node->boundsMax);
+    }
+
+    node->dirty = false;
+    node->childDirty = false;
+
+    return updatedCount;
+}
+
+/*
+    The box around a box once transformed, built from how far each column
+    of the transform moves the box's corners along each axis.
+*/
+void transformBox(mat4 transform, float * boxMin, float * boxMax, float * outMin, float * outMax)
+{
+    for (int row = 0; row < 3; row++)
+    {
+        outMin[row] = outMax[row] = transform[3][row];
+
+        for (int column = 0; column < 3; column++)
+        {
+            float low = transform[column][row] * boxMin[column];
+            float high = transform[column][row] * boxMax[column];
+
+            outMin[row] += fminf(low, high);
+            outMax[row] += fmaxf(low, high);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef SCENE_GRAPH
+#define SCENE_GRAPH
+
+#include <stdbool.h>
+
+#include <cglm/cglm.h>
+
+#include "loadModel.h"
+
+#define SCENE_NODE_NAME_LENGTH 64
+#define SCENE_LINE_LENGTH 1024
+
+// Scenes of several models are scaled to this size along their longest
+// axis, as single models are when they load
+#define SCENE_FIT_EXTENT 4.0f
+
+// A node of the scene's hierarchy. local places it in its parent, and
+// world in the scene. A model node draws model of the merged mesh, which
+// modelTransform takes from the mesh's space back to its file's units, and
+// modelWorld from the mesh's space into the scene. Nodes scale uniformly,
+// so normals are turned by modelWorld itself and renormalised, and need no
+// matrix of their own. Children are placed by world alone. The
+// box encloses the node's model and every node below it, in the scene's
+// space, and is empty while boundsMin is above boundsMax. A node turns
+// spin degrees a second about spinAxis, after placement.
+typedef struct SceneNode
+{
+    char name[SCENE_NODE_NAME_LENGTH];
+    float placement[4][4];
+    float modelTransform[4][4];
+    float local[4][4];
+    float world[4][4];
+    float modelWorld[4][4];
+    float modelBoundsMin[3];
+    float modelBoundsMax[3];
+    float boundsMin[3];
+    float boundsMax[3];
+    float spinAxis[3];
+    float spin;
+    int parent;
+    int firstChild;
+    int nextSibling;
+    int model;
+    bool dirty;
+    bool childDirty;
+}
+SceneNode;
+
+// Nodes are stored after their parents, and node 0 is the root
+typedef struct SceneGraph
+{
+    SceneNode * nodes;
+    int nodeCount;
+    int nodeCapacity;
+}
+SceneGraph;
+
+// The models a scene loads, one job each
+typedef struct SceneModelLoad
+{
+    char ** paths;
+    Mesh * meshes;
+    bool * loaded;
+    int pathCount;
+}
+SceneModelLoad;
+
+// Public method(s)
+void selectSceneFile(char * scenePath);
+bool loadScene(char ** modelNames, int modelCount, SceneGraph * scene, Mesh * mesh);
+void createModelScene(SceneGraph * scene, Mesh * mesh);
+void refreshSceneModels(SceneGraph * scene, Mesh * mesh);
+int addSceneNode(SceneGraph * scene, char * name, int parent, mat4 placement);
+void setSceneNodeTransform(SceneGraph * scene, int node, mat4 local);
+void animateSceneGraph(SceneGraph * scene, double time);
+int updateSceneGraph(SceneGraph * scene);
+int findSceneNode(SceneGraph * scene, char * name);
+void releaseSceneGraph(SceneGraph * scene);
+
+// Private method(s)
+bool readSceneFile(char * scenePath, SceneGraph * scene, SceneModelLoad * load);
+int addScenePath(SceneModelLoad * load, char * path);
+void loadSceneModels(void * argument, size_t first, size_t end);
+void mergeMeshes(Mesh * meshes, int count, Mesh * merged);
+void setSceneNodeModel(SceneGraph * scene, int node, Mesh * mesh, int model, mat4 modelTransform);
+void fitSceneToView(SceneGraph * scene);
+int updateSceneNode(SceneGraph * scene, int index, bool parentMoved);
+void transformBox(mat4 transform, float * boxMin, float * boxMax, float * outMin, float * outMax);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef SCENE_SETTINGS
+#define SCENE_SETTINGS
+
+/*
+    Camera and lighting shared by every renderer, so the OpenGL, software and
+    reference renderers all show the same scene.
+*/
+
+#define SCENE_CAMERA_POSITION {0.0f, 0.0f, 10.0f}
+#define SCENE_CAMERA_TARGET {0.0f, 0.0f, 0.0f}
+#define SCENE_CAMERA_UP {0.0f, 1.0f, 0.0f}
+#define SCENE_FIELD_OF_VIEW 45.0f
+#define SCENE_NEAR_PLANE 0.1f
+#define SCENE_FAR_PLANE 100.0f
+
+#define SCENE_MODEL_COLOR {0.5f, 0.5f, 0.5f}
+#define SCENE_LIGHT_COLOR {0.8f, 0.1f, 0.2f}
+#define SCENE_LIGHT_POSITION {5.0f, 5.0f, 10.0f}
+#define SCENE_CLEAR_COLOR {0.1f, 0.1f, 0.1f}
+
+// Matches lightingStrength in fragment.shader
+#define SCENE_AMBIENT_STRENGTH 0.7f
+
+// Lower values yeild more reflectance. 80 = Medium reflectance
+#define SCENE_REFLECTANCE 80.0f
+
+#endif
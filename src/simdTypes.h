@@ -0,0 +1,17 @@
+#ifndef SIMD_TYPES
+#define SIMD_TYPES
+
+/*
+    Four-wide vectors using GCC/Clang vector extensions, which compile to
+    SSE on x86 and NEON on Apple Silicon without per-platform intrinsics.
+    Comparisons produce int4 lane masks of 0 or -1.
+*/
+
+typedef float float4 __attribute__((vector_size(16)));
+typedef int int4 __attribute__((vector_size(16)));
+
+// Lane-wise minimum and maximum, selecting through the comparison mask
+#define FLOAT4_MIN(a, b) ((float4)((((a) < (b)) & (int4)(a)) | (~((a) < (b)) & (int4)(b))))
+#define FLOAT4_MAX(a, b) ((float4)((((a) > (b)) & (int4)(a)) | (~((a) > (b)) & (int4)(b))))
+
+#endif
@@ -0,0 +1,549 @@
+/******************************************************************************
+ * File:        softwareRenderer.c
+ * Description: CPU rendering backend for machines without a usable GPU.
+ *              Each frame runs three stages as jobs on the job system,
+ *              each split into one slice per requested thread:
+ *              - Transform: vertices are projected to clip space and moved to
+ *                world space for lighting, exactly as vertex.shader does.
+ *              - Bin: triangles are culled, set up in screen space and
+ *                appended to per-thread lists for every tile they overlap.
+ *              - Raster: threads claim whole tiles, so no two threads touch
+ *                the same pixels. Coverage and depth are tested four pixels
+ *                at a time and visible pixels are shaded with the same
+ *                Blinn-Phong model as fragment.shader.
+ *              The colour buffer is bottom-up RGBA, the same layout OpenGL
+ *              reads back, so it can be presented through a texture or
+ *              written straight to a PNG.
+ * Notes:       Triangles crossing the near plane are dropped rather than
+ *              clipped. Four-wide vectors use GCC/Clang vector extensions.
+ ******************************************************************************/
+
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cglm/cglm.h>
+#include <glad/glad.h>
+
+#include "getGLErrors.h"
+#include "imageWriter.h"
+#include "jobSystem.h"
+#include "quaternion.h"
+#include "sceneSettings.h"
+#include "simdTypes.h"
+#include "softwareRenderer.h"
+
+#define SOFTWARE_TILE_SIZE 64
+#define SOFTWARE_MAX_THREADS 64
+
+static Mesh mesh;
+static mat4 proj;
+static mat4 view;
+static mat4 model;
+static mat4 mvp;
+static mat3 normalMatrix;
+static vec3 lightPosition;
+static vec3 lightColor;
+static vec3 modelColor;
+static vec3 cameraPosition;
+static ScreenSize *screenPtr;
+
+// Framebuffer, depth rows are padded so four-wide loads never leave the row
+static int width;
+static int height;
+static int depthStride;
+static unsigned char *colorBuffer;
+static float *depthBuffer;
+static int tilesAcross;
+static int tilesDown;
+static int tileCount;
+
+// Per corner and per triangle stage outputs
+static size_t cornerCount;
+static size_t triangleCount;
+static float *clipPositions;
+static float *worldPositions;
+static float *worldNormals;
+static SoftwareTriangle *triangles;
+
+// Triangle bins, one list per slice per tile so binning needs no locks
+static int **bins;
+static int *binCounts;
+static int *binCapacities;
+static atomic_int nextTile;
+
+// Slices each stage is split into, and the stage the jobs are running
+static int threadCount;
+static softwareStageFP currentStage;
+
+// Presentation through OpenGL when a window is available
+static unsigned int presentTexture;
+static unsigned int presentFramebuffer;
+static int presentWidth;
+static int presentHeight;
+
+// Public method(s)
+
+bool initialiseSoftwareRenderer(ScreenSize *screenSize, char *modelName, int requestedThreads)
+{
+    screenPtr = screenSize;
+
+    if (loadModel(modelName, &mesh) <= 0)
+        return false;
+
+    // Points have no surface to rasterize or trace
+    if (mesh.pointCount > 0)
+    {
+        printf("Point clouds are drawn by the OpenGL renderer only.\n");
+        releaseMesh(&mesh);
+        return false;
+    }
+
+    cornerCount = mesh.vertexCount / 3;
+    triangleCount = cornerCount / 3;
+
+    clipPositions = (float *)malloc(sizeof(float) * 4 * cornerCount);
+    worldPositions = (float *)malloc(sizeof(float) * 3 * cornerCount);
+    worldNormals = (float *)malloc(sizeof(float) * 3 * cornerCount);
+    triangles = (SoftwareTriangle *)malloc(sizeof(SoftwareTriangle) * triangleCount);
+
+    glm_mat4_identity(model);
+
+    glm_vec3_copy((vec3)SCENE_CAMERA_POSITION, cameraPosition);
+    glm_lookat(cameraPosition, (vec3)SCENE_CAMERA_TARGET, (vec3)SCENE_CAMERA_UP, view);
+    glm_vec3_copy((vec3)SCENE_MODEL_COLOR, modelColor);
+    glm_vec3_copy((vec3)SCENE_LIGHT_COLOR, lightColor);
+    glm_vec3_copy((vec3)SCENE_LIGHT_POSITION, lightPosition);
+
+    threadCount = requestedThreads;
+
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > SOFTWARE_MAX_THREADS)
+        threadCount = SOFTWARE_MAX_THREADS;
+
+    resizeSoftwareFramebuffer(screenPtr->width, screenPtr->height);
+
+    return true;
+}
+
+void renderSoftware()
+{
+    if ((int)screenPtr->width != width || (int)screenPtr->height != height)
+        resizeSoftwareFramebuffer(screenPtr->width, screenPtr->height);
+
+    glm_perspective(glm_rad(SCENE_FIELD_OF_VIEW), screenPtr->width / screenPtr->height, SCENE_NEAR_PLANE, SCENE_FAR_PLANE, proj);
+    glm_mat4_mulN((mat4 *[]){&proj, &view, &model}, 3, mvp);
+    glm_mat4_pick3(model, normalMatrix);
+    glm_mat3_inv(normalMatrix, normalMatrix);
+    glm_mat3_transpose(normalMatrix);
+
+    for (int i = 0; i < threadCount * tileCount; i++)
+        binCounts[i] = 0;
+
+    atomic_store(&nextTile, 0);
+
+    runSoftwareStage(transformStage);
+    runSoftwareStage(binStage);
+    runSoftwareStage(rasterStage);
+}
+
+void initialiseSoftwarePresentation(void *procAddressFunction)
+{
+    if (!gladLoadGLLoader((GLADloadproc)procAddressFunction))
+        printf("Failed to initialise GLAD.\n");
+
+    glGenTextures(1, &presentTexture);
+    glGenFramebuffers(1, &presentFramebuffer);
+    presentWidth = 0;
+    presentHeight = 0;
+}
+
+/*
+    Uploads the colour buffer and blits it to the window. This is the only
+    OpenGL work done per frame, so even slow software drivers keep up.
+*/
+void presentSoftware()
+{
+    glBindTexture(GL_TEXTURE_2D, presentTexture);
+
+    if (presentWidth != width || presentHeight != height)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, colorBuffer);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, presentFramebuffer);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, presentTexture, 0);
+
+        presentWidth = width;
+        presentHeight = height;
+    }
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, colorBuffer);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, presentFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GET_GL_ERRORS();
+}
+
+bool writeSoftwareImage(char *filePath)
+{
+    return writePNG(filePath, colorBuffer, width, height, true);
+}
+
+void releaseSoftwareRenderer()
+{
+    if (presentTexture != 0)
+    {
+        glDeleteTextures(1, &presentTexture);
+        glDeleteFramebuffers(1, &presentFramebuffer);
+    }
+
+    for (int i = 0; i < threadCount * tileCount; i++)
+        free(bins[i]);
+
+    free(bins);
+    free(binCounts);
+    free(binCapacities);
+    free(colorBuffer);
+    free(depthBuffer);
+    free(clipPositions);
+    free(worldPositions);
+    free(worldNormals);
+    free(triangles);
+    releaseMesh(&mesh);
+}
+
+void softwareViewPortResizeCallback(ScreenSize *screenSize)
+{
+    resizeSoftwareFramebuffer(screenSize->width, screenSize->height);
+}
+
+void softwareMouseDragCallback(MousePosition *positions, ScreenSize *screenSize)
+{
+    quaternionRotation(&model, positions, screenSize);
+}
+
+void softwareScrollCallBack(ScrollPosition *positions)
+{
+    float zoomInFactor = 1.05, zoomOutFactor = 0.95;
+
+    if (positions->yOffset > 0)
+        glm_scale(model, (vec3){zoomInFactor, zoomInFactor, zoomInFactor});
+    else if (positions->yOffset < 0)
+        glm_scale(model, (vec3){zoomOutFactor, zoomOutFactor, zoomOutFactor});
+}
+
+// Private method(s)
+
+void resizeSoftwareFramebuffer(int newWidth, int newHeight)
+{
+    if (newWidth < 1)
+        newWidth = 1;
+    if (newHeight < 1)
+        newHeight = 1;
+
+    for (int i = 0; i < threadCount * tileCount; i++)
+        free(bins[i]);
+
+    free(bins);
+    free(binCounts);
+    free(binCapacities);
+    free(colorBuffer);
+    free(depthBuffer);
+
+    width = newWidth;
+    height = newHeight;
+    depthStride = width + 4;
+
+    colorBuffer = (unsigned char *)malloc((size_t)width * height * 4);
+    depthBuffer = (float *)calloc((size_t)depthStride * height, sizeof(float));
+
+    tilesAcross = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    tilesDown = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    tileCount = tilesAcross * tilesDown;
+
+    bins = (int **)calloc(threadCount * tileCount, sizeof(int *));
+    binCounts = (int *)calloc(threadCount * tileCount, sizeof(int));
+    binCapacities = (int *)calloc(threadCount * tileCount, sizeof(int));
+}
+
+/*
+    Runs a stage over every slice as jobs, with the caller taking slices as
+    well, and returns once all of them have finished. Each slice bins into
+    its own lists, so slices that share a worker do not interfere.
+*/
+void runSoftwareStage(softwareStageFP stage)
+{
+    currentStage = stage;
+    parallelFor(threadCount, 1, runSoftwareStageSlices, NULL);
+}
+
+void runSoftwareStageSlices(void *argument, size_t first, size_t end)
+{
+    for (size_t slice = first; slice < end; slice++)
+        currentStage(slice);
+}
+
+void transformStage(int threadIndex)
+{
+    size_t first = cornerCount * threadIndex / threadCount;
+    size_t last = cornerCount * (threadIndex + 1) / threadCount;
+
+    for (size_t i = first; i < last; i++)
+    {
+        vec4 position = {mesh.vertices[3 * i], mesh.vertices[3 * i + 1], mesh.vertices[3 * i + 2], 1.0f};
+
+        glm_mat4_mulv(mvp, position, &clipPositions[4 * i]);
+        glm_mat4_mulv3(model, position, 1.0f, &worldPositions[3 * i]);
+        glm_mat3_mulv(normalMatrix, &mesh.normals[3 * i], &worldNormals[3 * i]);
+    }
+}
+
+void binStage(int threadIndex)
+{
+    size_t first = triangleCount * threadIndex / threadCount;
+    size_t last = triangleCount * (threadIndex + 1) / threadCount;
+
+    for (size_t i = first; i < last; i++)
+    {
+        SoftwareTriangle *triangle = &triangles[i];
+        bool visible = true;
+
+        for (int corner = 0; corner < 3; corner++)
+        {
+            float *clip = &clipPositions[4 * (3 * i + corner)];
+
+            // Dropped rather than clipped when any corner is before the near plane
+            if (clip[2] < -clip[3] || clip[3] <= 0.0f)
+            {
+                visible = false;
+                break;
+            }
+
+            float inverseW = 1.0f / clip[3];
+            triangle->x[corner] = (clip[0] * inverseW * 0.5f + 0.5f) * width;
+            triangle->y[corner] = (clip[1] * inverseW * 0.5f + 0.5f) * height;
+            triangle->z[corner] = clip[2] * inverseW * 0.5f + 0.5f;
+            triangle->inverseW[corner] = inverseW;
+        }
+
+        if (!visible)
+            continue;
+
+        // Counter-clockwise triangles face the camera, matching GL_CULL_FACE
+        triangle->area = (triangle->x[1] - triangle->x[0]) * (triangle->y[2] - triangle->y[0]) -
+                         (triangle->x[2] - triangle->x[0]) * (triangle->y[1] - triangle->y[0]);
+
+        if (triangle->area <= 0.0f)
+            continue;
+
+        float minX = fminf(fminf(triangle->x[0], triangle->x[1]), triangle->x[2]);
+        float maxX = fmaxf(fmaxf(triangle->x[0], triangle->x[1]), triangle->x[2]);
+        float minY = fminf(fminf(triangle->y[0], triangle->y[1]), triangle->y[2]);
+        float maxY = fmaxf(fmaxf(triangle->y[0], triangle->y[1]), triangle->y[2]);
+
+        if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+            continue;
+
+        int firstTileX = (int)fmaxf(minX, 0.0f) / SOFTWARE_TILE_SIZE;
+        int firstTileY = (int)fmaxf(minY, 0.0f) / SOFTWARE_TILE_SIZE;
+        int lastTileX = (int)fminf(maxX, width - 1) / SOFTWARE_TILE_SIZE;
+        int lastTileY = (int)fminf(maxY, height - 1) / SOFTWARE_TILE_SIZE;
+
+        for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+        {
+            for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
+            {
+                int bin = threadIndex * tileCount + tileY * tilesAcross + tileX;
+
+                if (binCounts[bin] == binCapacities[bin])
+                {
+                    binCapacities[bin] = binCapacities[bin] == 0 ? 256 : binCapacities[bin] * 2;
+                    bins[bin] = (int *)realloc(bins[bin], sizeof(int) * binCapacities[bin]);
+                }
+
+                bins[bin][binCounts[bin]++] = i;
+            }
+        }
+    }
+}
+
+void rasterStage(int threadIndex)
+{
+    vec3 clearColor = SCENE_CLEAR_COLOR;
+    unsigned char clearPixel[4] = {
+        (unsigned char)(clearColor[0] * 255.0f + 0.5f),
+        (unsigned char)(clearColor[1] * 255.0f + 0.5f),
+        (unsigned char)(clearColor[2] * 255.0f + 0.5f),
+        255
+    };
+
+    int tile;
+
+    while ((tile = atomic_fetch_add(&nextTile, 1)) < tileCount)
+    {
+        int tileMinX = (tile % tilesAcross) * SOFTWARE_TILE_SIZE;
+        int tileMinY = (tile / tilesAcross) * SOFTWARE_TILE_SIZE;
+        int tileMaxX = tileMinX + SOFTWARE_TILE_SIZE < width ? tileMinX + SOFTWARE_TILE_SIZE : width;
+        int tileMaxY = tileMinY + SOFTWARE_TILE_SIZE < height ? tileMinY + SOFTWARE_TILE_SIZE : height;
+
+        for (int y = tileMinY; y < tileMaxY; y++)
+        {
+            unsigned char *colorRow = colorBuffer + ((size_t)y * width + tileMinX) * 4;
+            float *depthRow = depthBuffer + (size_t)y * depthStride;
+
+            for (int x = 0; x < tileMaxX - tileMinX; x++)
+                memcpy(colorRow + x * 4, clearPixel, 4);
+
+            for (int x = tileMinX; x < tileMaxX; x++)
+                depthRow[x] = 1.0f;
+        }
+
+        // Bins are walked in thread order, which keeps submission order
+        for (int thread = 0; thread < threadCount; thread++)
+        {
+            int bin = thread * tileCount + tile;
+
+            for (int i = 0; i < binCounts[bin]; i++)
+                rasterizeTriangle(bins[bin][i], tileMinX, tileMinY, tileMaxX, tileMaxY);
+        }
+    }
+}
+
+/*
+    Edge functions are evaluated at pixel centres four pixels at a time.
+    Groups start on a multiple of four from the tile edge, so loads stay
+    inside the tile, or inside the row padding for the last tile.
+*/
+void rasterizeTriangle(int triangleIndex, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+    SoftwareTriangle *triangle = &triangles[triangleIndex];
+
+    float minXf = fminf(fminf(triangle->x[0], triangle->x[1]), triangle->x[2]);
+    float maxXf = fmaxf(fmaxf(triangle->x[0], triangle->x[1]), triangle->x[2]);
+    float minYf = fminf(fminf(triangle->y[0], triangle->y[1]), triangle->y[2]);
+    float maxYf = fmaxf(fmaxf(triangle->y[0], triangle->y[1]), triangle->y[2]);
+
+    int minX = (int)fmaxf(floorf(minXf), tileMinX);
+    int maxX = (int)fminf(ceilf(maxXf), tileMaxX);
+    int minY = (int)fmaxf(floorf(minYf), tileMinY);
+    int maxY = (int)fminf(ceilf(maxYf), tileMaxY);
+
+    if (minX >= maxX || minY >= maxY)
+        return;
+
+    minX = tileMinX + ((minX - tileMinX) & ~3);
+
+    float *x = triangle->x;
+    float *y = triangle->y;
+
+    float a0 = y[1] - y[2], b0 = x[2] - x[1], c0 = x[1] * y[2] - y[1] * x[2];
+    float a1 = y[2] - y[0], b1 = x[0] - x[2], c1 = x[2] * y[0] - y[2] * x[0];
+    float a2 = y[0] - y[1], b2 = x[1] - x[0], c2 = x[0] * y[1] - y[0] * x[1];
+    float inverseArea = 1.0f / triangle->area;
+
+    const float4 laneCentres = {0.5f, 1.5f, 2.5f, 3.5f};
+    const int4 laneIndices = {0, 1, 2, 3};
+
+    for (int row = minY; row < maxY; row++)
+    {
+        float pixelY = row + 0.5f;
+        float *depthRow = depthBuffer + (size_t)row * depthStride;
+        unsigned char *colorRow = colorBuffer + (size_t)row * width * 4;
+
+        float rowEdge0 = b0 * pixelY + c0;
+        float rowEdge1 = b1 * pixelY + c1;
+        float rowEdge2 = b2 * pixelY + c2;
+
+        for (int column = minX; column < maxX; column += 4)
+        {
+            float4 pixelX = (float)column + laneCentres;
+
+            float4 edge0 = a0 * pixelX + rowEdge0;
+            float4 edge1 = a1 * pixelX + rowEdge1;
+            float4 edge2 = a2 * pixelX + rowEdge2;
+
+            int4 covered = (edge0 >= 0.0f) & (edge1 >= 0.0f) & (edge2 >= 0.0f) & ((column + laneIndices) < maxX);
+
+            if (!(covered[0] | covered[1] | covered[2] | covered[3]))
+                continue;
+
+            float4 barycentric0 = edge0 * inverseArea;
+            float4 barycentric1 = edge1 * inverseArea;
+            float4 barycentric2 = edge2 * inverseArea;
+            float4 depth = barycentric0 * triangle->z[0] + barycentric1 * triangle->z[1] + barycentric2 * triangle->z[2];
+
+            float4 storedDepth;
+            memcpy(&storedDepth, depthRow + column, sizeof(storedDepth));
+
+            int4 passed = covered & (depth < storedDepth);
+
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!passed[lane])
+                    continue;
+
+                depthRow[column + lane] = depth[lane];
+                shadeFragment(triangleIndex, barycentric0[lane], barycentric1[lane], barycentric2[lane], colorRow + (column + lane) * 4);
+            }
+        }
+    }
+}
+
+/*
+    Blinn-Phong, as in fragment.shader, with perspective correct world space
+    position and normal.
+*/
+void shadeFragment(int triangleIndex, float b0, float b1, float b2, unsigned char *pixel)
+{
+    SoftwareTriangle *triangle = &triangles[triangleIndex];
+
+    float w0 = b0 * triangle->inverseW[0];
+    float w1 = b1 * triangle->inverseW[1];
+    float w2 = b2 * triangle->inverseW[2];
+    float inverseSum = 1.0f / (w0 + w1 + w2);
+    w0 *= inverseSum;
+    w1 *= inverseSum;
+    w2 *= inverseSum;
+
+    float *positions = &worldPositions[9 * triangleIndex];
+    float *normals = &worldNormals[9 * triangleIndex];
+
+    vec3 position, normal, lightDirection, viewDirection, halfVector;
+
+    for (int i = 0; i < 3; i++)
+    {
+        position[i] = w0 * positions[i] + w1 * positions[3 + i] + w2 * positions[6 + i];
+        normal[i] = w0 * normals[i] + w1 * normals[3 + i] + w2 * normals[6 + i];
+    }
+
+    glm_vec3_normalize(normal);
+
+    glm_vec3_sub(lightPosition, position, lightDirection);
+    glm_vec3_normalize(lightDirection);
+    float diffuse = fmaxf(glm_vec3_dot(normal, lightDirection), 0.0f);
+
+    glm_vec3_sub(cameraPosition, position, viewDirection);
+    glm_vec3_normalize(viewDirection);
+    glm_vec3_add(lightDirection, viewDirection, halfVector);
+    glm_vec3_normalize(halfVector);
+    float specular = powf(fmaxf(glm_vec3_dot(normal, halfVector), 0.0f), SCENE_REFLECTANCE);
+
+    float lighting = SCENE_AMBIENT_STRENGTH + diffuse + specular;
+
+    for (int i = 0; i < 3; i++)
+    {
+        float channel = lighting * lightColor[i] * modelColor[i];
+        pixel[i] = (unsigned char)(fminf(channel, 1.0f) * 255.0f + 0.5f);
+    }
+
+    pixel[3] = 255;
+}
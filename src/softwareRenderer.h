@@ -0,0 +1,43 @@
+#ifndef SOFTWARE_RENDERER
+#define SOFTWARE_RENDERER
+
+#include <stdbool.h>
+
+#include "inputTracking.h"
+#include "loadModel.h"
+
+typedef void (*softwareStageFP) (int);
+
+// Screen space data for one triangle, written during binning
+typedef struct SoftwareTriangle
+{
+    float x[3];
+    float y[3];
+    float z[3];
+    float inverseW[3];
+    float area;
+}
+SoftwareTriangle;
+
+// Public method(s)
+bool initialiseSoftwareRenderer(ScreenSize * screenSize, char * modelName, int threadCount);
+void renderSoftware();
+void initialiseSoftwarePresentation(void * procAddressFunction);
+void presentSoftware();
+bool writeSoftwareImage(char * filePath);
+void releaseSoftwareRenderer();
+void softwareViewPortResizeCallback(ScreenSize * screenSize);
+void softwareMouseDragCallback(MousePosition * positions, ScreenSize * screenSize);
+void softwareScrollCallBack(ScrollPosition * positions);
+
+// Private method(s)
+void resizeSoftwareFramebuffer(int width, int height);
+void runSoftwareStage(softwareStageFP stage);
+void runSoftwareStageSlices(void * argument, size_t first, size_t end);
+void transformStage(int threadIndex);
+void binStage(int threadIndex);
+void rasterStage(int threadIndex);
+void rasterizeTriangle(int triangleIndex, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+void shadeFragment(int triangleIndex, float b0, float b1, float b2, unsigned char * pixel);
+
+#endif
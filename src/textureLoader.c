@@ -0,0 +1,284 @@
+/******************************************************************************
+ * File:        textureLoader.c
+ * Description: Loads the texture maps of a model's materials.
+ *              - Images are decoded by jobs with stb_image, one per image,
+ *                and each job also builds the image's mip chain on the CPU.
+ *              - The render thread uploads every image as soon as it has
+ *                been decoded, through a pixel unpack buffer, while the rest
+ *                are still decoding.
+ * Notes:       Images are uploaded top row first, so texture coordinates are
+ *              flipped vertically in the shaders rather than here.
+ ******************************************************************************/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <glad/glad.h>
+
+#include "benchmark.h"
+#include "getGLErrors.h"
+#include "jobSystem.h"
+#include "textureLoader.h"
+
+static TextureImage * textureImages;
+static int textureImageCount;
+
+// Shared with the decode jobs under textureMutex
+static pthread_mutex_t textureMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t textureDecoded = PTHREAD_COND_INITIALIZER;
+static int * decodedImages;
+static int decodedImageCount;
+
+// Public method(s)
+
+/*
+    Creates one texture per path, with its full mip chain. Textures whose
+    image cannot be decoded are left as 0. Returns the number loaded.
+*/
+int loadTexturesOpenGL(char ** paths, int pathCount, unsigned int * textures)
+{
+    if (pathCount == 0)
+        return 0;
+
+    double startTime = currentTime();
+
+    textureImages = (TextureImage *)calloc(pathCount, sizeof(TextureImage));
+    decodedImages = (int *)malloc(sizeof(int) * pathCount);
+    textureImageCount = pathCount;
+    decodedImageCount = 0;
+
+    JobCounter decodesDone;
+    initialiseJobCounter(&decodesDone);
+
+    for (int i = 0; i < pathCount; i++)
+    {
+        textureImages[i].path = paths[i];
+        submitJob(decodeTextureJob, &textureImages[i], &decodesDone);
+    }
+
+    unsigned int pixelBuffer;
+    glGenBuffers(1, &pixelBuffer);
+
+    long long textureBytes = 0;
+    double uploadTime = 0.0;
+    int loadedCount = 0;
+
+    for (int uploadedCount = 0; uploadedCount < pathCount; uploadedCount++)
+    {
+        pthread_mutex_lock(&textureMutex);
+
+        // Decode here while nothing is ready, and sleep only once every
+        // remaining image is already being decoded elsewhere
+        while (decodedImageCount == uploadedCount)
+        {
+            pthread_mutex_unlock(&textureMutex);
+            bool helped = runOneJob();
+            pthread_mutex_lock(&textureMutex);
+
+            if (!helped && decodedImageCount == uploadedCount)
+                pthread_cond_wait(&textureDecoded, &textureMutex);
+        }
+
+        TextureImage * image = &textureImages[decodedImages[uploadedCount]];
+        unsigned int * texture = &textures[decodedImages[uploadedCount]];
+
+        pthread_mutex_unlock(&textureMutex);
+
+        if (image->pixels == NULL)
+        {
+            *texture = 0;
+            continue;
+        }
+
+        double uploadStart = currentTime();
+
+        glGenTextures(1, texture);
+        uploadTextureOpenGL(image, pixelBuffer, *texture);
+
+        uploadTime += currentTime() - uploadStart;
+        textureBytes += image->size;
+        loadedCount++;
+
+        stbi_image_free(image->pixels);
+        image->pixels = NULL;
+    }
+
+    waitForJobs(&decodesDone);
+
+    glDeleteBuffers(1, &pixelBuffer);
+    GET_GL_ERRORS();
+
+    printf("Loaded %d of %d textures, %.1f MB with mipmaps, in %.1f ms (%.1f ms uploading)\n",
+        loadedCount,
+        pathCount,
+        textureBytes / 1048576.0,
+        (currentTime() - startTime) * 1000.0,
+        uploadTime * 1000.0
+    );
+
+    free(textureImages);
+    free(decodedImages);
+    textureImages = NULL;
+    decodedImages = NULL;
+
+    return loadedCount;
+}
+
+// Private method(s)
+
+void decodeTextureJob(void * argument)
+{
+    TextureImage * image = (TextureImage *)argument;
+
+    if (!decodeTexture(image))
+        printf("Could not load texture %s\n", image->path);
+
+    pthread_mutex_lock(&textureMutex);
+    decodedImages[decodedImageCount++] = image - textureImages;
+    pthread_cond_signal(&textureDecoded);
+    pthread_mutex_unlock(&textureMutex);
+}
+
+/*
+    Decodes an image to RGBA and appends every mip level down to 1x1 to the
+    same allocation, so it is uploaded with a single copy.
+*/
+bool decodeTexture(TextureImage * image)
+{
+    int channels;
+    unsigned char * pixels = stbi_load(image->path, &image->width, &image->height, &channels, 4);
+
+    if (pixels == NULL)
+        return false;
+
+    // Each level is a quarter of the one before, so the chain fits in 4/3
+    long long size = 0;
+    int levelCount = 0;
+
+    for (int width = image->width, height = image->height;; width = width > 1 ? width / 2 : 1, height = height > 1 ? height / 2 : 1)
+    {
+        size += 4LL * width * height;
+        levelCount++;
+
+        if (width == 1 && height == 1)
+            break;
+    }
+
+    // stb_image allocates with malloc, so the chain can grow in place
+    unsigned char * chain = (unsigned char *)realloc(pixels, size);
+
+    if (chain == NULL)
+    {
+        stbi_image_free(pixels);
+        return false;
+    }
+
+    unsigned char * level = chain;
+    int width = image->width;
+    int height = image->height;
+
+    for (int i = 1; i < levelCount; i++)
+    {
+        unsigned char * nextLevel = level + 4LL * width * height;
+        downsampleTexture(level, width, height, nextLevel);
+
+        level = nextLevel;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    image->pixels = chain;
+    image->levelCount = levelCount;
+    image->size = size;
+
+    return true;
+}
+
+/*
+    Averages 2x2 blocks into the next level. An odd last row or column is
+    dropped, and a side which is already one texel is sampled twice.
+*/
+void downsampleTexture(unsigned char * source, int width, int height, unsigned char * destination)
+{
+    int nextWidth = width > 1 ? width / 2 : 1;
+    int nextHeight = height > 1 ? height / 2 : 1;
+
+    for (int y = 0; y < nextHeight; y++)
+    {
+        int row0 = 2 * y < height ? 2 * y : height - 1;
+        int row1 = 2 * y + 1 < height ? 2 * y + 1 : height - 1;
+
+        for (int x = 0; x < nextWidth; x++)
+        {
+            int column0 = 2 * x < width ? 2 * x : width - 1;
+            int column1 = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+
+            for (int channel = 0; channel < 4; channel++)
+            {
+                int sum = source[4 * (row0 * width + column0) + channel]
+                    + source[4 * (row0 * width + column1) + channel]
+                    + source[4 * (row1 * width + column0) + channel]
+                    + source[4 * (row1 * width + column1) + channel];
+
+                destination[4 * (y * nextWidth + x) + channel] = (sum + 2) / 4;
+            }
+        }
+    }
+}
+
+/*
+    Copies the mip chain into the unpack buffer and specifies every level
+    from it. The buffer is orphaned first, so the driver can keep copying
+    the previous texture while this one is written.
+*/
+void uploadTextureOpenGL(TextureImage * image, unsigned int pixelBuffer, unsigned int texture)
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, image->size, NULL, GL_STREAM_DRAW);
+
+    void * mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image->size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    // Without a mapping the levels are specified from client memory instead
+    if (mapped != NULL)
+    {
+        memcpy(mapped, image->pixels, image->size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    long long offset = 0;
+    int width = image->width;
+    int height = image->height;
+
+    for (int level = 0; level < image->levelCount; level++)
+    {
+        // Offsets into the bound unpack buffer are passed as pointers
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+            mapped != NULL ? (void *)(size_t)offset : image->pixels + offset);
+
+        offset += 4LL * width * height;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image->levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    GET_GL_ERRORS();
+}
@@ -0,0 +1,28 @@
+#ifndef TEXTURE_LOADER
+#define TEXTURE_LOADER
+
+#include <stdbool.h>
+
+// Decoded RGBA image with its whole mip chain, level 0 first and each level
+// directly after the one before it
+typedef struct TextureImage
+{
+    char * path;
+    unsigned char * pixels;
+    int width;
+    int height;
+    int levelCount;
+    long long size;
+}
+TextureImage;
+
+// Public method(s)
+int loadTexturesOpenGL(char ** paths, int pathCount, unsigned int * textures);
+
+// Private method(s)
+void decodeTextureJob(void * argument);
+bool decodeTexture(TextureImage * image);
+void downsampleTexture(unsigned char * source, int width, int height, unsigned char * destination);
+void uploadTextureOpenGL(TextureImage * image, unsigned int pixelBuffer, unsigned int texture);
+
+#endif
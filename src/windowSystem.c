@@ -11,20 +11,39 @@
 static void windowSizeCallback(GLFWwindow* window, int width, int height);
 static void cursorPositionCallback(GLFWwindow* window, double xpos, double ypos);
 static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 static GLFWwindow* window;
 static viewportResizeFP viewportResizeFunctionPointer;
 static mouseMovementFP mouseMovementFunctionPointer;
 static mouseScrollFP mouseScrollFunctionPointer;
+static keyPressFP keyPressFunctionPointer;
 static ScreenSize screenSize = {.width = SCREEN_WIDTH, .height = SCREEN_HEIGHT};
 
 void initialiseGLFW()
+{
+    createWindowGLFW(true);
+}
+
+/*
+    Creates a hidden window which only provides an OpenGL context, for
+    rendering frames to disk. Buffer swaps are unthrottled so rendering is
+    only limited by the GPU.
+*/
+void initialiseHeadlessGLFW()
+{
+    createWindowGLFW(false);
+    glfwSwapInterval(0);
+}
+
+void createWindowGLFW(bool visible)
 {
     if(!glfwInit())
         printf("Failed to initialise GLFW.\n");
 
     // Antialiasing
     glfwWindowHint(GLFW_SAMPLES, 4);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     // OpenGL version 4.1, newest working version on M1 Macbooks
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4); 
@@ -87,6 +106,16 @@ void processFrameGLFW(double elapsedTime, int fps)
     }
 }
 
+/*
+    Swaps and polls without the sleep in processFrameGLFW, for captures which
+    show progress in the window but should not be held to the interactive FPS.
+*/
+void presentFrameGLFW()
+{
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+}
+
 void processInputGLFW()
 {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -129,6 +158,12 @@ void initialiseMouseScrollCallbackGLFW(mouseScrollFP mouseScroll)
     glfwSetScrollCallback(window, scroll_callback);
 }
 
+void initialiseKeyPressCallbackGLFW(keyPressFP keyPress)
+{
+    keyPressFunctionPointer = keyPress;
+    glfwSetKeyCallback(window, keyCallback);
+}
+
 /*
     Fixed prototype of GLFW resize callback function
     Triggered in initialiseWindowSizeCallbackGLFW using glfwSetFramebufferSizeCallback
@@ -181,3 +216,13 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     (*mouseScrollFunctionPointer)(&scrollPositions);
 }
 
+/*
+    Fixed prototype of GLFW key callback function
+    Triggered in initialiseKeyPressCallbackGLFW using glfwSetKeyCallback
+    GLFW key codes for digits and letters match their ASCII characters
+*/
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_PRESS)
+        (*keyPressFunctionPointer)(key);
+}
\ No newline at end of file
@@ -7,17 +7,24 @@
 typedef void (*viewportResizeFP) (ScreenSize *);
 typedef void (*mouseMovementFP) (MousePosition *, ScreenSize *);
 typedef void (*mouseScrollFP) (ScrollPosition*);
+typedef void (*keyPressFP) (int);
 
 // Public method(s)
 void initialiseGLFW();
+void initialiseHeadlessGLFW();
 void initialiseWindowSizeCallbackGLFW(viewportResizeFP viewportResize);
 void initialiseMouseMovementCallbackGLFW(mouseMovementFP mouseMovement);
 void initialiseMouseScrollCallbackGLFW(mouseScrollFP mouseScroll);
+void initialiseKeyPressCallbackGLFW(keyPressFP keyPress);
 void * procAddressGLFW();
 void processFrameGLFW(double elapsedTime, int fps);
+void presentFrameGLFW();
 void processInputGLFW();
 bool applicationOpenGLFW();
 void releaseGLFW();
 ScreenSize * getScreenSize();
 
+// Private method(s)
+void createWindowGLFW(bool visible);
+
 #endif
\ No newline at end of file